@@ -20,4 +20,11 @@ set BINARIES_FOLDER="./shaders/"
 %GLSL_COMPILER% --target-env vulkan1.2 -V -S rmiss %SOURCE_FOLDER%ray_miss.glsl -o %BINARIES_FOLDER%ray_miss.bin
 %GLSL_COMPILER% --target-env vulkan1.2 -V -S rmiss %SOURCE_FOLDER%indirect_ray_miss.glsl -o %BINARIES_FOLDER%indirect_ray_miss.bin
 %GLSL_COMPILER% --target-env vulkan1.2 -V -S rmiss %SOURCE_FOLDER%shadow_ray_miss.glsl -o %BINARIES_FOLDER%shadow_ray_miss.bin
+
+:: intersection shaders
+%GLSL_COMPILER% --target-env vulkan1.2 -V -S rint %SOURCE_FOLDER%analytic_ray_rint.glsl -o %BINARIES_FOLDER%analytic_ray_rint.bin
+
+:: overlay
+%GLSL_COMPILER% --target-env vulkan1.2 -V -S vert %SOURCE_FOLDER%overlay_vert.glsl -o %BINARIES_FOLDER%overlay_vert.bin
+%GLSL_COMPILER% --target-env vulkan1.2 -V -S frag %SOURCE_FOLDER%overlay_frag.glsl -o %BINARIES_FOLDER%overlay_frag.bin
 pause
\ No newline at end of file
@@ -0,0 +1,330 @@
+#include "benchreport.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Just enough json to read our own reports back: objects, arrays, strings (no \u escapes), numbers, literals
+class JsonReader {
+public:
+    explicit JsonReader(const std::string& text) : mText(text), mPos(0), mOk(true) {}
+
+    bool    IsOk() const { return mOk; }
+
+    bool    Expect(const char c) {
+        this->SkipSpace();
+        if (mPos < mText.size() && mText[mPos] == c) {
+            ++mPos;
+            return true;
+        }
+        mOk = false;
+        return false;
+    }
+
+    bool    Peek(const char c) {
+        this->SkipSpace();
+        return mPos < mText.size() && mText[mPos] == c;
+    }
+
+    bool    ReadString(std::string& out) {
+        out.clear();
+        if (!this->Expect('"')) {
+            return false;
+        }
+        while (mPos < mText.size() && mText[mPos] != '"') {
+            char c = mText[mPos++];
+            if (c == '\\' && mPos < mText.size()) {
+                c = mText[mPos++];
+                c = (c == 'n') ? '\n' : (c == 't') ? '\t' : c;
+            }
+            out += c;
+        }
+        return this->Expect('"');
+    }
+
+    bool    ReadNumber(double& out) {
+        this->SkipSpace();
+        const char* begin = mText.c_str() + mPos;
+        char* end = nullptr;
+        out = strtod(begin, &end);
+        if (end == begin) {
+            mOk = false;
+            return false;
+        }
+        mPos += static_cast<size_t>(end - begin);
+        return true;
+    }
+
+    // anything we don't care about
+    bool    SkipValue() {
+        this->SkipSpace();
+        if (mPos >= mText.size()) {
+            mOk = false;
+            return false;
+        }
+        const char c = mText[mPos];
+        if (c == '"') {
+            std::string unused;
+            return this->ReadString(unused);
+        }
+        if (c == '{' || c == '[') {
+            const char close = (c == '{') ? '}' : ']';
+            ++mPos;
+            if (this->Peek(close)) {
+                return this->Expect(close);
+            }
+            do {
+                if (c == '{') {
+                    std::string key;
+                    if (!this->ReadString(key) || !this->Expect(':')) {
+                        return false;
+                    }
+                }
+                if (!this->SkipValue()) {
+                    return false;
+                }
+            } while (this->Peek(',') && this->Expect(','));
+            return this->Expect(close);
+        }
+        if (c == 't' || c == 'f' || c == 'n') {
+            while (mPos < mText.size() && isalpha(static_cast<unsigned char>(mText[mPos]))) {
+                ++mPos;
+            }
+            return true;
+        }
+        double unused;
+        return this->ReadNumber(unused);
+    }
+
+private:
+    void    SkipSpace() {
+        while (mPos < mText.size() && isspace(static_cast<unsigned char>(mText[mPos]))) {
+            ++mPos;
+        }
+    }
+
+private:
+    const std::string&  mText;
+    size_t              mPos;
+    bool                mOk;
+};
+
+static bool ReadMetric(JsonReader& json, BenchReport::Metric& metric) {
+    metric = BenchReport::Metric();
+    metric.better = BenchReport::Better::Lower;
+    metric.median = metric.p95 = metric.min = metric.max = 0.0;
+
+    if (!json.Expect('{')) {
+        return false;
+    }
+    if (json.Peek('}')) {
+        return json.Expect('}');
+    }
+    do {
+        std::string key;
+        if (!json.ReadString(key) || !json.Expect(':')) {
+            return false;
+        }
+        if (key == "scene") {
+            json.ReadString(metric.scene);
+        } else if (key == "name") {
+            json.ReadString(metric.name);
+        } else if (key == "unit") {
+            json.ReadString(metric.unit);
+        } else if (key == "better") {
+            std::string better;
+            json.ReadString(better);
+            metric.better = (better == "higher") ? BenchReport::Better::Higher : BenchReport::Better::Lower;
+        } else if (key == "median") {
+            json.ReadNumber(metric.median);
+        } else if (key == "p95") {
+            json.ReadNumber(metric.p95);
+        } else if (key == "min") {
+            json.ReadNumber(metric.min);
+        } else if (key == "max") {
+            json.ReadNumber(metric.max);
+        } else {
+            json.SkipValue();
+        }
+    } while (json.IsOk() && json.Peek(',') && json.Expect(','));
+    return json.Expect('}');
+}
+
+
+void BenchReport::Add(const std::string& scene, const std::string& name, const std::string& unit, const Better better, const double value) {
+    for (Metric& metric : mMetrics) {
+        if (metric.scene == scene && metric.name == name) {
+            metric.samples.push_back(value);
+            return;
+        }
+    }
+
+    Metric metric;
+    metric.scene = scene;
+    metric.name = name;
+    metric.unit = unit;
+    metric.better = better;
+    metric.samples.push_back(value);
+    metric.median = metric.p95 = metric.min = metric.max = 0.0;
+    mMetrics.push_back(metric);
+}
+
+void BenchReport::Finalize() {
+    for (Metric& metric : mMetrics) {
+        std::vector<double> sorted = metric.samples;
+        std::sort(sorted.begin(), sorted.end());
+        if (sorted.empty()) {
+            continue;
+        }
+        metric.median = BenchReport::Median(sorted);
+        metric.p95 = BenchReport::Percentile(sorted, (metric.better == Better::Lower) ? 0.95 : 0.05);
+        metric.min = sorted.front();
+        metric.max = sorted.back();
+    }
+}
+
+const std::vector<BenchReport::Metric>& BenchReport::GetMetrics() const {
+    return mMetrics;
+}
+
+const BenchReport::Metric* BenchReport::Find(const std::string& scene, const std::string& name) const {
+    for (const Metric& metric : mMetrics) {
+        if (metric.scene == scene && metric.name == name) {
+            return &metric;
+        }
+    }
+    return nullptr;
+}
+
+bool BenchReport::SaveJson(const std::string& fileName, const uint32_t numRuns) const {
+    FILE* file = fopen(fileName.c_str(), "w");
+    if (!file) {
+        printf("Can't write %s\n", fileName.c_str());
+        return false;
+    }
+
+    fprintf(file, "{\n  \"version\": 1,\n  \"runs\": %u,\n  \"metrics\": [", numRuns);
+    for (size_t i = 0; i < mMetrics.size(); ++i) {
+        const Metric& m = mMetrics[i];
+        fprintf(file, "%s\n    { \"scene\": \"%s\", \"name\": \"%s\", \"unit\": \"%s\", \"better\": \"%s\", "
+                      "\"median\": %.9g, \"p95\": %.9g, \"min\": %.9g, \"max\": %.9g, \"samples\": [",
+                (i ? "," : ""), m.scene.c_str(), m.name.c_str(), m.unit.c_str(),
+                (m.better == Better::Higher) ? "higher" : "lower", m.median, m.p95, m.min, m.max);
+        for (size_t s = 0; s < m.samples.size(); ++s) {
+            fprintf(file, "%s%.9g", (s ? ", " : ""), m.samples[s]);
+        }
+        fprintf(file, "] }");
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    return fclose(file) == 0;
+}
+
+bool BenchReport::LoadJson(const std::string& fileName) {
+    mMetrics.clear();
+
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        printf("Can't open %s\n", fileName.c_str());
+        return false;
+    }
+    std::string text;
+    char buffer[4096];
+    size_t numRead;
+    while ((numRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, numRead);
+    }
+    fclose(file);
+
+    JsonReader json(text);
+    bool ok = json.Expect('{');
+    while (ok && !json.Peek('}')) {
+        std::string key;
+        ok = json.ReadString(key) && json.Expect(':');
+        if (ok && key == "metrics") {
+            ok = json.Expect('[');
+            while (ok && !json.Peek(']')) {
+                Metric metric;
+                ok = ReadMetric(json, metric);
+                if (ok) {
+                    mMetrics.push_back(metric);
+                }
+                if (ok && json.Peek(',')) {
+                    json.Expect(',');
+                }
+            }
+            ok = ok && json.Expect(']');
+        } else if (ok) {
+            ok = json.SkipValue();
+        }
+        if (ok && json.Peek(',')) {
+            json.Expect(',');
+        }
+    }
+    ok = ok && json.Expect('}');
+
+    if (!ok) {
+        printf("%s is not a benchmark report\n", fileName.c_str());
+        mMetrics.clear();
+    }
+    return ok;
+}
+
+void BenchReport::Print() const {
+    printf("%-20s %-16s %14s %14s %14s  %s\n", "scene", "metric", "median", "p95", "max - min", "unit");
+    for (const Metric& m : mMetrics) {
+        printf("%-20s %-16s %14.4f %14.4f %14.4f  %s\n", m.scene.c_str(), m.name.c_str(), m.median, m.p95, m.max - m.min, m.unit.c_str());
+    }
+}
+
+uint32_t BenchReport::Compare(const BenchReport& baseline, const double threshold) const {
+    uint32_t numRegressions = 0;
+
+    printf("\n%-20s %-16s %14s %14s %9s\n", "scene", "metric", "baseline", "current", "change");
+    for (const Metric& m : mMetrics) {
+        const Metric* base = baseline.Find(m.scene, m.name);
+        if (!base) {
+            printf("%-20s %-16s %14s %14.4f %9s\n", m.scene.c_str(), m.name.c_str(), "-", m.median, "new");
+            continue;
+        }
+
+        // positive change = better, whichever way the metric goes
+        double change = 0.0;
+        if (base->median != 0.0) {
+            change = (m.median - base->median) / std::fabs(base->median);
+            if (m.better == Better::Lower) {
+                change = -change;
+            }
+        }
+        // and it has to be out of the baseline's own run to run noise, or tiny timings flag all the time
+        const bool outsideNoise = (m.better == Better::Lower) ? (m.median > base->p95) : (m.median < base->p95);
+        const bool regressed = (change < -threshold) && outsideNoise;
+        numRegressions += regressed ? 1 : 0;
+
+        printf("%-20s %-16s %14.4f %14.4f %+8.1f%%%s\n", m.scene.c_str(), m.name.c_str(), base->median, m.median,
+               change * 100.0, regressed ? "  REGRESSION" : "");
+    }
+
+    printf("\n%u regression(s) over %.1f%%\n", numRegressions, threshold * 100.0);
+    return numRegressions;
+}
+
+double BenchReport::Percentile(const std::vector<double>& sorted, const double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const double rank = std::ceil(p * static_cast<double>(sorted.size()));
+    const size_t index = static_cast<size_t>(std::max(rank, 1.0)) - 1;
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+double BenchReport::Median(const std::vector<double>& sorted) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const size_t half = sorted.size() / 2;
+    return (sorted.size() & 1) ? sorted[half] : 0.5 * (sorted[half - 1] + sorted[half]);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Benchmark results: every metric gets one sample per run and is summarised as median / p95 once all the runs
+// are in. Saved as json, and a saved report can be loaded back as the baseline of a later run.
+class BenchReport {
+public:
+    enum class Better : uint32_t {
+        Lower,      // times, memory
+        Higher      // throughputs
+    };
+
+    struct Metric {
+        std::string         scene;
+        std::string         name;
+        std::string         unit;
+        Better              better;
+        std::vector<double> samples;
+        double              median;     // filled by Finalize()
+        double              p95;        // of the "bad" side: the slow end for times, the low end for throughputs
+        double              min;
+        double              max;
+    };
+
+    BenchReport() = default;
+    ~BenchReport() = default;
+
+    void        Add(const std::string& scene, const std::string& name, const std::string& unit, const Better better, const double value);
+    void        Finalize();
+
+    const std::vector<Metric>& GetMetrics() const;
+    const Metric* Find(const std::string& scene, const std::string& name) const;
+
+    bool        SaveJson(const std::string& fileName, const uint32_t numRuns) const;
+    bool        LoadJson(const std::string& fileName);
+
+    void        Print() const;
+    // prints current vs baseline medians, returns how many metrics got worse by more than threshold (0.05 = 5%)
+    // and past the baseline's p95
+    uint32_t    Compare(const BenchReport& baseline, const double threshold) const;
+
+    // nearest rank, p in [0, 1]
+    static double Percentile(const std::vector<double>& sorted, const double p);
+    static double Median(const std::vector<double>& sorted);
+
+private:
+    std::vector<Metric> mMetrics;
+};
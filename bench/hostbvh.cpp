@@ -0,0 +1,338 @@
+#include "hostbvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+static const uint32_t kNumBins = 12;
+static const uint32_t kMaxLeafSize = 4;
+static const uint32_t kStackSize = 128;
+// below this depth nodes are split in half by count, which keeps any tree within the traversal stack
+static const uint32_t kMaxSAHDepth = 64;
+
+struct Bounds {
+    float   lo[3];
+    float   hi[3];
+
+    void Reset() {
+        lo[0] = lo[1] = lo[2] = FLT_MAX;
+        hi[0] = hi[1] = hi[2] = -FLT_MAX;
+    }
+    void Grow(const float p[3]) {
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], p[k]);
+            hi[k] = std::max(hi[k], p[k]);
+        }
+    }
+    void Grow(const Bounds& b) {
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], b.lo[k]);
+            hi[k] = std::max(hi[k], b.hi[k]);
+        }
+    }
+    float HalfArea() const {
+        const float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+        return (dx < 0.0f) ? 0.0f : (dx * dy + dy * dz + dz * dx);
+    }
+};
+
+static void TriangleBounds(const float* tri, Bounds& b) {
+    b.Reset();
+    b.Grow(tri);
+    b.Grow(tri + 3);
+    b.Grow(tri + 6);
+}
+
+
+HostBVH::HostBVH()
+    : mDepth(0)
+{
+}
+
+bool HostBVH::Build(const std::vector<float>& triangles) {
+    mNodes.clear();
+    mTriangles = triangles;
+    mDepth = 0;
+
+    const uint32_t numTriangles = static_cast<uint32_t>(triangles.size() / 9);
+    mIndices.resize(numTriangles);
+    mCentroids.resize(numTriangles * 3);
+    for (uint32_t i = 0; i < numTriangles; ++i) {
+        mIndices[i] = i;
+        const float* tri = &triangles[i * 9];
+        for (int k = 0; k < 3; ++k) {
+            mCentroids[i * 3 + k] = (tri[k] + tri[3 + k] + tri[6 + k]) * (1.0f / 3.0f);
+        }
+    }
+    if (!numTriangles) {
+        return false;
+    }
+
+    mNodes.reserve(2 * numTriangles / kMaxLeafSize + 1);
+    this->BuildRecursive(0, numTriangles, 1);
+
+    // leaves address triangles by their sorted position
+    for (uint32_t i = 0; i < numTriangles; ++i) {
+        memcpy(&mTriangles[i * 9], &triangles[mIndices[i] * 9], 9 * sizeof(float));
+    }
+    mCentroids.clear();
+    mCentroids.shrink_to_fit();
+    return true;
+}
+
+uint32_t HostBVH::BuildRecursive(const uint32_t begin, const uint32_t end, const uint32_t depth) {
+    mDepth = std::max(mDepth, depth);
+
+    const uint32_t nodeIndex = static_cast<uint32_t>(mNodes.size());
+    mNodes.push_back(Node());
+
+    Bounds bounds, centroidBounds;
+    bounds.Reset();
+    centroidBounds.Reset();
+    for (uint32_t i = begin; i < end; ++i) {
+        Bounds tb;
+        TriangleBounds(&mTriangles[mIndices[i] * 9], tb);
+        bounds.Grow(tb);
+        centroidBounds.Grow(&mCentroids[mIndices[i] * 3]);
+    }
+
+    Node& node = mNodes[nodeIndex];
+    for (int k = 0; k < 3; ++k) {
+        node.boundsMin[k] = bounds.lo[k];
+        node.boundsMax[k] = bounds.hi[k];
+    }
+
+    const uint32_t count = end - begin;
+    if (count <= kMaxLeafSize) {
+        node.first = begin;
+        node.count = count;
+        return nodeIndex;
+    }
+
+    // binned SAH over the centroid bounds, every axis
+    float bestCost = FLT_MAX;
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    for (int axis = 0; axis < 3 && depth < kMaxSAHDepth; ++axis) {
+        const float extent = centroidBounds.hi[axis] - centroidBounds.lo[axis];
+        if (extent <= 0.0f) {
+            continue;
+        }
+        const float scale = kNumBins / extent;
+
+        Bounds binBounds[kNumBins];
+        uint32_t binCounts[kNumBins] = {};
+        for (Bounds& b : binBounds) {
+            b.Reset();
+        }
+        for (uint32_t i = begin; i < end; ++i) {
+            const uint32_t bin = std::min(static_cast<uint32_t>((mCentroids[mIndices[i] * 3 + axis] - centroidBounds.lo[axis]) * scale), kNumBins - 1);
+            Bounds tb;
+            TriangleBounds(&mTriangles[mIndices[i] * 9], tb);
+            binBounds[bin].Grow(tb);
+            ++binCounts[bin];
+        }
+
+        // sweep from the right, then evaluate the splits from the left
+        float rightAreas[kNumBins];
+        uint32_t rightCounts[kNumBins];
+        Bounds acc;
+        acc.Reset();
+        uint32_t accCount = 0;
+        for (uint32_t b = kNumBins - 1; b > 0; --b) {
+            acc.Grow(binBounds[b]);
+            accCount += binCounts[b];
+            rightAreas[b] = acc.HalfArea();
+            rightCounts[b] = accCount;
+        }
+        acc.Reset();
+        accCount = 0;
+        for (uint32_t b = 1; b < kNumBins; ++b) {
+            acc.Grow(binBounds[b - 1]);
+            accCount += binCounts[b - 1];
+            if (!accCount || !rightCounts[b]) {
+                continue;
+            }
+            const float cost = acc.HalfArea() * accCount + rightAreas[b] * rightCounts[b];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    uint32_t middle = begin;
+    if (bestAxis >= 0) {
+        const float scale = kNumBins / (centroidBounds.hi[bestAxis] - centroidBounds.lo[bestAxis]);
+        const float lo = centroidBounds.lo[bestAxis];
+        const float* centroids = mCentroids.data();
+        middle = static_cast<uint32_t>(std::partition(mIndices.begin() + begin, mIndices.begin() + end, [=](const uint32_t i) {
+            return std::min(static_cast<uint32_t>((centroids[i * 3 + bestAxis] - lo) * scale), kNumBins - 1) < bestSplit;
+        }) - mIndices.begin());
+    }
+    if (middle == begin || middle == end) {
+        // every centroid in the same spot (or too deep already), split by count
+        middle = begin + count / 2;
+    }
+
+    this->BuildRecursive(begin, middle, depth + 1);
+    const uint32_t right = this->BuildRecursive(middle, end, depth + 1);
+    mNodes[nodeIndex].first = right;
+    mNodes[nodeIndex].count = 0;
+    return nodeIndex;
+}
+
+static inline bool IntersectBounds(const HostBVH::Node& node, const float origin[3], const float invDir[3], const float tMax, float& tNear) {
+    float t0 = 0.0f, t1 = tMax;
+    for (int k = 0; k < 3; ++k) {
+        float tA = (node.boundsMin[k] - origin[k]) * invDir[k];
+        float tB = (node.boundsMax[k] - origin[k]) * invDir[k];
+        if (tA > tB) {
+            std::swap(tA, tB);
+        }
+        t0 = std::max(t0, tA);
+        t1 = std::min(t1, tB);
+    }
+    tNear = t0;
+    return t0 <= t1;
+}
+
+// Moller-Trumbore
+static inline bool IntersectTriangle(const float* tri, const float origin[3], const float dir[3], float& t, float& u, float& v) {
+    const float e1[3] = { tri[3] - tri[0], tri[4] - tri[1], tri[5] - tri[2] };
+    const float e2[3] = { tri[6] - tri[0], tri[7] - tri[1], tri[8] - tri[2] };
+    const float p[3] = { dir[1] * e2[2] - dir[2] * e2[1], dir[2] * e2[0] - dir[0] * e2[2], dir[0] * e2[1] - dir[1] * e2[0] };
+    const float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (std::fabs(det) < 1e-12f) {
+        return false;
+    }
+    const float invDet = 1.0f / det;
+    const float s[3] = { origin[0] - tri[0], origin[1] - tri[1], origin[2] - tri[2] };
+    u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+    const float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+    v = (dir[0] * q[0] + dir[1] * q[1] + dir[2] * q[2]) * invDet;
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+    t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * invDet;
+    return t > 0.0f;
+}
+
+template <bool AnyHit>
+bool HostBVH::Traverse(const float origin[3], const float direction[3], const float tMax, Hit& hit) const {
+    if (mNodes.empty()) {
+        return false;
+    }
+
+    const float invDir[3] = {
+        1.0f / ((direction[0] != 0.0f) ? direction[0] : 1e-20f),
+        1.0f / ((direction[1] != 0.0f) ? direction[1] : 1e-20f),
+        1.0f / ((direction[2] != 0.0f) ? direction[2] : 1e-20f)
+    };
+
+    bool found = false;
+    hit.t = tMax;
+
+    uint32_t stack[kStackSize];
+    uint32_t stackSize = 0;
+    uint32_t nodeIndex = 0;
+    float tNear;
+    if (!IntersectBounds(mNodes[0], origin, invDir, hit.t, tNear)) {
+        return false;
+    }
+
+    for (;;) {
+        const Node& node = mNodes[nodeIndex];
+        if (node.count) {
+            for (uint32_t i = node.first, end = node.first + node.count; i < end; ++i) {
+                float t, u, v;
+                if (IntersectTriangle(&mTriangles[i * 9], origin, direction, t, u, v) && t < hit.t) {
+                    hit.t = t;
+                    hit.u = u;
+                    hit.v = v;
+                    hit.triangle = mIndices[i];
+                    hit.slot = i;
+                    found = true;
+                    if (AnyHit) {
+                        return true;
+                    }
+                }
+            }
+        } else {
+            // near child first, the far one waits on the stack
+            const uint32_t left = nodeIndex + 1;
+            const uint32_t right = node.first;
+            float tLeft, tRight;
+            const bool hitLeft = IntersectBounds(mNodes[left], origin, invDir, hit.t, tLeft);
+            const bool hitRight = IntersectBounds(mNodes[right], origin, invDir, hit.t, tRight);
+            if (hitLeft && hitRight) {
+                const bool leftFirst = tLeft <= tRight;
+                stack[stackSize++] = leftFirst ? right : left;
+                nodeIndex = leftFirst ? left : right;
+                continue;
+            }
+            if (hitLeft || hitRight) {
+                nodeIndex = hitLeft ? left : right;
+                continue;
+            }
+        }
+
+        if (!stackSize) {
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+
+    return found;
+}
+
+bool HostBVH::Intersect(const float origin[3], const float direction[3], const float tMax, Hit& hit) const {
+    return this->Traverse<false>(origin, direction, tMax, hit);
+}
+
+bool HostBVH::Occluded(const float origin[3], const float direction[3], const float tMax) const {
+    Hit hit;
+    return this->Traverse<true>(origin, direction, tMax, hit);
+}
+
+void HostBVH::GetNormal(const Hit& hit, float normal[3]) const {
+    const float* tri = &mTriangles[hit.slot * 9];
+    const float e1[3] = { tri[3] - tri[0], tri[4] - tri[1], tri[5] - tri[2] };
+    const float e2[3] = { tri[6] - tri[0], tri[7] - tri[1], tri[8] - tri[2] };
+    normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    const float len = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    const float invLen = (len > 0.0f) ? (1.0f / len) : 0.0f;
+    for (int k = 0; k < 3; ++k) {
+        normal[k] *= invLen;
+    }
+}
+
+void HostBVH::GetBounds(float boundsMin[3], float boundsMax[3]) const {
+    for (int k = 0; k < 3; ++k) {
+        boundsMin[k] = mNodes.empty() ? 0.0f : mNodes[0].boundsMin[k];
+        boundsMax[k] = mNodes.empty() ? 0.0f : mNodes[0].boundsMax[k];
+    }
+}
+
+size_t HostBVH::GetNumTriangles() const {
+    return mIndices.size();
+}
+
+uint32_t HostBVH::GetDepth() const {
+    return mDepth;
+}
+
+size_t HostBVH::GetMemorySize() const {
+    return mNodes.size() * sizeof(Node) + mTriangles.size() * sizeof(float) + mIndices.size() * sizeof(uint32_t);
+}
+
+const std::vector<HostBVH::Node>& HostBVH::GetNodes() const {
+    return mNodes;
+}
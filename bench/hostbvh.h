@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Binned SAH BVH over plain triangles with closest hit and any hit traversal.
+// Benchmark stand-in for the acceleration structure the driver builds: it gives the host side of the scene
+// setup something to build and the ray throughput numbers a CPU baseline that doesn't need a device.
+class HostBVH {
+public:
+    struct Node {
+        float       boundsMin[3];
+        uint32_t    first;          // leaf: first triangle, interior: index of the right child (left one follows the node)
+        float       boundsMax[3];
+        uint32_t    count;          // triangles in the leaf, 0 for interior nodes
+    };
+
+    struct Hit {
+        float       t;
+        uint32_t    triangle;       // index into the triangles passed to Build()
+        float       u, v;           // barycentrics of v1 and v2
+        uint32_t    slot;           // where the triangle sits in the BVH, for GetNormal()
+    };
+
+    HostBVH();
+    ~HostBVH() = default;
+
+    // 9 floats (3 vertices) per triangle
+    bool            Build(const std::vector<float>& triangles);
+
+    bool            Intersect(const float origin[3], const float direction[3], const float tMax, Hit& hit) const;
+    bool            Occluded(const float origin[3], const float direction[3], const float tMax) const;
+
+    void            GetNormal(const Hit& hit, float normal[3]) const;     // geometric, normalized
+    void            GetBounds(float boundsMin[3], float boundsMax[3]) const;
+
+    size_t          GetNumTriangles() const;
+    uint32_t        GetDepth() const;
+    size_t          GetMemorySize() const;  // nodes + reordered triangles, in bytes
+    const std::vector<Node>& GetNodes() const;
+
+private:
+    uint32_t        BuildRecursive(const uint32_t begin, const uint32_t end, const uint32_t depth);
+
+    template <bool AnyHit>
+    bool            Traverse(const float origin[3], const float direction[3], const float tMax, Hit& hit) const;
+
+private:
+    std::vector<Node>       mNodes;
+    std::vector<float>      mTriangles;     // reordered so every leaf is contiguous, 9 floats per triangle
+    std::vector<uint32_t>   mIndices;       // reordered position -> original triangle
+    std::vector<float>      mCentroids;     // build only
+    uint32_t                mDepth;
+};
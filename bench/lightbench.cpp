@@ -0,0 +1,243 @@
+// Noise at equal time of the emitter sampling strategies (uniform / power alias table / light BVH).
+// Scatters lots of small emissive triangles over a big volume and estimates the direct (unoccluded) irradiance
+// at random points of the ground with each strategy for the same wall clock budget, then compares to a reference.
+//
+// usage: lightbench [numEmitters = 100000] [numPoints = 256] [secondsPerStrategy = 2]
+
+#include "framework/aliastable.h"
+#include "framework/lightbvh.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct ShadingPoint {
+    float p[3];
+    float n[3];
+};
+
+struct Scene {
+    std::vector<LightBVH::Emitter>  emitters;
+    std::vector<float>              areas;
+    std::vector<float>              radiance;
+    std::vector<float>              normals;    // 3 per emitter
+    std::vector<ShadingPoint>       points;
+};
+
+enum class Strategy {
+    Uniform,
+    Power,
+    LightBVH
+};
+
+static const char* sStrategyNames[] = { "uniform", "power", "light bvh" };
+
+
+static double Seconds(const Clock::time_point& start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void MakeScene(Scene& scene, const uint32_t numEmitters, const uint32_t numPoints, std::mt19937& rng) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    scene.emitters.resize(numEmitters);
+    scene.areas.resize(numEmitters);
+    scene.radiance.resize(numEmitters);
+    scene.normals.resize(3 * numEmitters);
+
+    for (uint32_t i = 0; i < numEmitters; ++i) {
+        // a "city at night": small lamps over 200 x 200 units, up to 20 units high, random orientations
+        const float center[3] = { -100.0f + 200.0f * unit(rng), 1.0f + 19.0f * unit(rng), -100.0f + 200.0f * unit(rng) };
+        const float size = 0.05f + 0.25f * unit(rng);
+
+        LightBVH::Emitter& e = scene.emitters[i];
+        float* verts[3] = { e.v0, e.v1, e.v2 };
+        for (int v = 0; v < 3; ++v) {
+            for (int k = 0; k < 3; ++k) {
+                verts[v][k] = center[k] + size * (2.0f * unit(rng) - 1.0f);
+            }
+        }
+
+        float e1[3], e2[3], n[3];
+        for (int k = 0; k < 3; ++k) {
+            e1[k] = e.v1[k] - e.v0[k];
+            e2[k] = e.v2[k] - e.v0[k];
+        }
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        const float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+        scene.areas[i] = 0.5f * len;
+        scene.radiance[i] = std::pow(10.0f, -1.0f + 2.0f * unit(rng)); // 0.1 .. 10
+        for (int k = 0; k < 3; ++k) {
+            scene.normals[3 * i + k] = (len > 0.0f) ? (n[k] / len) : 0.0f;
+        }
+        e.power = scene.areas[i] * scene.radiance[i];
+    }
+
+    scene.points.resize(numPoints);
+    for (ShadingPoint& sp : scene.points) {
+        sp.p[0] = -100.0f + 200.0f * unit(rng);
+        sp.p[1] = 0.0f;
+        sp.p[2] = -100.0f + 200.0f * unit(rng);
+        sp.n[0] = 0.0f;
+        sp.n[1] = 1.0f;
+        sp.n[2] = 0.0f;
+    }
+}
+
+// uniform point on the emitter, returns L * cosSurface * cosLight / d^2 (the area measure integrand)
+static float Integrand(const Scene& scene, const uint32_t emitter, const ShadingPoint& sp, float u, float v) {
+    const LightBVH::Emitter& e = scene.emitters[emitter];
+    const float su = std::sqrt(u);
+    const float b0 = 1.0f - su, b1 = su * (1.0f - v), b2 = su * v;
+
+    float dir[3];
+    for (int k = 0; k < 3; ++k) {
+        dir[k] = e.v0[k] * b0 + e.v1[k] * b1 + e.v2[k] * b2 - sp.p[k];
+    }
+    const float distSq = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+    const float dist = std::sqrt(distSq);
+
+    const float* nl = &scene.normals[3 * emitter];
+    const float cosSurface = (dir[0] * sp.n[0] + dir[1] * sp.n[1] + dir[2] * sp.n[2]) / dist;
+    const float cosLight = std::fabs(dir[0] * nl[0] + dir[1] * nl[1] + dir[2] * nl[2]) / dist;
+    if (cosSurface <= 0.0f) {
+        return 0.0f;
+    }
+    return scene.radiance[emitter] * cosSurface * cosLight / distSq;
+}
+
+// brute force over all the emitters with a few samples each
+static void ComputeReference(const Scene& scene, std::vector<double>& reference, std::mt19937& rng) {
+    static const int kSamplesPerEmitter = 4;
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    reference.assign(scene.points.size(), 0.0);
+    for (size_t i = 0; i < scene.points.size(); ++i) {
+        double sum = 0.0;
+        for (uint32_t e = 0; e < scene.emitters.size(); ++e) {
+            double emitterSum = 0.0;
+            for (int s = 0; s < kSamplesPerEmitter; ++s) {
+                emitterSum += Integrand(scene, e, scene.points[i], unit(rng), unit(rng));
+            }
+            sum += emitterSum * scene.areas[e] / kSamplesPerEmitter;
+        }
+        reference[i] = sum;
+    }
+}
+
+static float SampleOnce(const Strategy strategy, const Scene& scene, const AliasTable& aliasTable, const LightBVH& lightBVH,
+                        const ShadingPoint& sp, std::mt19937& rng) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const float u0 = unit(rng), u1 = unit(rng), u2 = unit(rng);
+
+    uint32_t emitter = 0;
+    float pmf = 0.0f;
+    switch (strategy) {
+        case Strategy::Uniform: {
+            const uint32_t count = static_cast<uint32_t>(scene.emitters.size());
+            emitter = std::min(static_cast<uint32_t>(u0 * count), count - 1);
+            pmf = 1.0f / static_cast<float>(count);
+        } break;
+        case Strategy::Power: {
+            emitter = aliasTable.Sample(u0);
+            pmf = aliasTable.GetPdf(emitter);
+        } break;
+        case Strategy::LightBVH: {
+            emitter = lightBVH.Sample(sp.p, sp.n, u0, pmf);
+            if (emitter == LightBVH::kInvalidIndex) {
+                return 0.0f;
+            }
+        } break;
+    }
+
+    if (pmf <= 0.0f) {
+        return 0.0f;
+    }
+    return Integrand(scene, emitter, sp, u1, u2) * scene.areas[emitter] / pmf;
+}
+
+int main(int argc, const char** argv) {
+    const uint32_t numEmitters = (argc > 1) ? static_cast<uint32_t>(std::atoi(argv[1])) : 100000;
+    const uint32_t numPoints = (argc > 2) ? static_cast<uint32_t>(std::atoi(argv[2])) : 256;
+    const double secondsPerStrategy = (argc > 3) ? std::atof(argv[3]) : 2.0;
+
+    if (!numEmitters || !numPoints || secondsPerStrategy <= 0.0) {
+        printf("usage: lightbench [numEmitters] [numPoints] [secondsPerStrategy]\n");
+        return 1;
+    }
+
+    std::mt19937 rng(1234);
+    Scene scene;
+    MakeScene(scene, numEmitters, numPoints, rng);
+
+    std::vector<float> powers(numEmitters);
+    for (uint32_t i = 0; i < numEmitters; ++i) {
+        powers[i] = scene.emitters[i].power;
+    }
+
+    Clock::time_point start = Clock::now();
+    AliasTable aliasTable;
+    aliasTable.Build(powers);
+    const double aliasBuildTime = Seconds(start);
+
+    start = Clock::now();
+    LightBVH lightBVH;
+    lightBVH.Build(scene.emitters);
+    const double bvhBuildTime = Seconds(start);
+
+    printf("%u emitters, %u shading points, %.1f s per strategy\n", numEmitters, numPoints, secondsPerStrategy);
+    printf("alias table build: %.1f ms\n", aliasBuildTime * 1000.0);
+    printf("light bvh build:   %.1f ms (%zu nodes, depth %u)\n", bvhBuildTime * 1000.0, lightBVH.GetNodes().size(), lightBVH.GetDepth());
+
+    start = Clock::now();
+    std::vector<double> reference;
+    ComputeReference(scene, reference, rng);
+    printf("reference:         %.1f s\n\n", Seconds(start));
+
+    printf("%-10s %12s %10s %12s %14s\n", "strategy", "Msamples/s", "spp", "rel. RMSE", "time to match");
+    double uniformMse = 0.0;
+    for (int s = 0; s < 3; ++s) {
+        const Strategy strategy = static_cast<Strategy>(s);
+        std::vector<double> sums(numPoints, 0.0);
+        uint64_t passes = 0;
+
+        // round robin over the points until the budget is spent, so every point gets the same number of samples
+        start = Clock::now();
+        do {
+            for (uint32_t i = 0; i < numPoints; ++i) {
+                sums[i] += SampleOnce(strategy, scene, aliasTable, lightBVH, scene.points[i], rng);
+            }
+            ++passes;
+        } while (Seconds(start) < secondsPerStrategy);
+        const double elapsed = Seconds(start);
+
+        double mse = 0.0;
+        uint32_t numValid = 0;
+        for (uint32_t i = 0; i < numPoints; ++i) {
+            if (reference[i] > 0.0) {
+                const double err = (sums[i] / static_cast<double>(passes) - reference[i]) / reference[i];
+                mse += err * err;
+                ++numValid;
+            }
+        }
+        mse /= std::max(numValid, 1u);
+        if (strategy == Strategy::Uniform) {
+            uniformMse = mse;
+        }
+
+        // error goes down as 1/sqrt(time), so matching the uniform noise takes time * mse / uniformMse
+        const double samplesPerSecond = static_cast<double>(passes) * numPoints / elapsed;
+        printf("%-10s %12.2f %10llu %12.5f %13.3fx\n", sStrategyNames[s], samplesPerSecond * 1e-6,
+               static_cast<unsigned long long>(passes), std::sqrt(mse), (uniformMse > 0.0) ? (mse / uniformMse) : 1.0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+// Analytic spheres against tessellated ones: _data/scenes/sphere.obj (8k triangles) through a HostBVH, then the
+// sphere it approximates as one AnalyticPrimitive, hit with shared.h's IntersectSphere, what analytic_ray_rint.glsl
+// runs on the GPU. Primary rays on one thread, best of a few repetitions:
+//  memory      what the app's buffers hold for it (positions, attribs, indices & faces / an AABB & the primitive),
+//              plus the host BVH, which stands in for the triangles' BLAS (the analytic one is a single AABB)
+//  trace       Mrays/s, every pixel of a camera the sphere fills most of
+//  error       how far the triangles are from the surface: pixels only one of them hits, hit distance & normal
+//              (the facets' geometric ones) differences where both do
+// A capsule of the same size is traced too (IntersectCapsule), it has no tessellated counterpart.
+//
+// usage: primitivebench [obj file = _data/scenes/sphere.obj] [resolution = 512] [repetitions = 5]
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include "framework/objmesh.h"
+#include "shared.h"
+#include "hostbvh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double Seconds(const Clock::time_point& start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static double MB(const size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+// looking down -z at the sphere from 3 radii away, it covers most of the 45 degrees
+struct Pinhole {
+    vec3    eye;
+    float   tanHalfFov;
+
+    vec3 GetDir(const uint32_t x, const uint32_t y, const uint32_t resolution) const {
+        const float px = (2.0f * (x + 0.5f) / resolution - 1.0f) * tanHalfFov;
+        const float py = (1.0f - 2.0f * (y + 0.5f) / resolution) * tanHalfFov;
+        return normalize(vec3(px, py, -1.0f));
+    }
+};
+
+struct TraceStats {
+    double      seconds;
+    uint32_t    numHits;
+};
+
+// per pixel t, negative on a miss, plus the normal there
+template <typename Intersect>
+static TraceStats Trace(const Pinhole& camera, const uint32_t resolution, const int repetitions, std::vector<float>& ts,
+                        std::vector<vec3>& normals, const Intersect& intersect) {
+    ts.assign(static_cast<size_t>(resolution) * resolution, -1.0f);
+    normals.assign(ts.size(), vec3(0.0f));
+
+    TraceStats stats = { 1e30, 0 };
+    for (int r = 0; r < repetitions; ++r) {
+        uint32_t numHits = 0;
+        const Clock::time_point start = Clock::now();
+        for (uint32_t y = 0; y < resolution; ++y) {
+            for (uint32_t x = 0; x < resolution; ++x) {
+                const size_t pixel = static_cast<size_t>(y) * resolution + x;
+                if (intersect(camera.eye, camera.GetDir(x, y, resolution), ts[pixel], normals[pixel])) {
+                    ++numHits;
+                }
+            }
+        }
+        stats.seconds = std::min(stats.seconds, Seconds(start));
+        stats.numHits = numHits;
+    }
+    return stats;
+}
+
+int main(int argc, const char** argv) {
+    const std::string fileName = (argc > 1) ? argv[1] : "_data/scenes/sphere.obj";
+    const uint32_t resolution = (argc > 2) ? static_cast<uint32_t>(std::atoi(argv[2])) : 512;
+    const int repetitions = (argc > 3) ? std::atoi(argv[3]) : 5;
+    if (!resolution || repetitions < 1) {
+        printf("usage: primitivebench [obj file] [resolution] [repetitions]\n");
+        return 1;
+    }
+
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, error;
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &error, fileName.c_str(), nullptr, true)) {
+        printf("Failed to load %s: %s\n", fileName.c_str(), error.c_str());
+        return 1;
+    }
+
+    std::vector<float> triangles;
+    for (const tinyobj::shape_t& shape : shapes) {
+        for (const tinyobj::index_t& index : shape.mesh.indices) {
+            for (int k = 0; k < 3; ++k) {
+                triangles.push_back(attrib.vertices[3 * index.vertex_index + k]);
+            }
+        }
+    }
+    const size_t numTriangles = triangles.size() / 9;
+
+    HostBVH bvh;
+    if (!bvh.Build(triangles)) {
+        printf("%s has no triangles\n", fileName.c_str());
+        return 1;
+    }
+
+    // the sphere the triangles approximate: their vertices are on it
+    float boundsMin[3], boundsMax[3];
+    bvh.GetBounds(boundsMin, boundsMax);
+    const vec3 center = 0.5f * (vec3(boundsMin[0], boundsMin[1], boundsMin[2]) + vec3(boundsMax[0], boundsMax[1], boundsMax[2]));
+    float radius = 0.0f;
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        radius = std::max(radius, length(vec3(triangles[i], triangles[i + 1], triangles[i + 2]) - center));
+    }
+
+    AnalyticPrimitive sphere;
+    sphere.p0 = vec4(center, radius);
+    sphere.p1 = vec4(center, 0.0f);
+    sphere.info = uvec4(SWS_ANALYTIC_SPHERE, 0u, 0u, 0u);
+
+    // as long as the sphere is wide, half as thick
+    AnalyticPrimitive capsule;
+    capsule.p0 = vec4(center - vec3(0.5f * radius, 0.0f, 0.0f), 0.5f * radius);
+    capsule.p1 = vec4(center + vec3(0.5f * radius, 0.0f, 0.0f), 0.0f);
+    capsule.info = uvec4(SWS_ANALYTIC_CAPSULE, 0u, 0u, 0u);
+
+    Pinhole camera;
+    camera.eye = center + vec3(0.0f, 0.0f, 3.0f * radius);
+    camera.tanHalfFov = std::tan(0.5f * 45.0f * 3.14159265f / 180.0f);
+
+    // the app's per mesh buffers (CreateMeshBuffers / CreateAnalyticMeshBuffers), the mesh info vec4 they both have left out
+    const size_t meshBytes = numTriangles * (3 * kObjPositionSize + 3 * kObjAttribSize + 3 * sizeof(uint32_t) + 4 * sizeof(uint32_t));
+    const size_t analyticBytes = 6 * sizeof(float) + sizeof(AnalyticPrimitive) + sizeof(VertexAttribute);
+
+    std::vector<float> meshTs, sphereTs, capsuleTs;
+    std::vector<vec3> meshNormals, sphereNormals, capsuleNormals;
+    const TraceStats meshStats = Trace(camera, resolution, repetitions, meshTs, meshNormals,
+        [&bvh](const vec3& origin, const vec3& dir, float& t, vec3& normal) -> bool {
+            HostBVH::Hit hit;
+            if (!bvh.Intersect(&origin.x, &dir.x, 1e30f, hit)) {
+                return false;
+            }
+            bvh.GetNormal(hit, &normal.x);
+            t = hit.t;
+            return true;
+        });
+    const auto intersectAnalytic = [](const AnalyticPrimitive& primitive) {
+        return [&primitive](const vec3& origin, const vec3& dir, float& t, vec3& normal) -> bool {
+            t = IntersectAnalyticPrimitive(primitive, origin, dir, 0.0f, 1e30f);
+            if (t < 0.0f) {
+                return false;
+            }
+            normal = AnalyticPrimitiveNormal(primitive, origin + dir * t);
+            return true;
+        };
+    };
+    const TraceStats sphereStats = Trace(camera, resolution, repetitions, sphereTs, sphereNormals, intersectAnalytic(sphere));
+    const TraceStats capsuleStats = Trace(camera, resolution, repetitions, capsuleTs, capsuleNormals, intersectAnalytic(capsule));
+
+    // where the triangles & the sphere disagree, the normals are the facets' so they're off by up to half a facet
+    uint32_t numMismatches = 0, numBoth = 0;
+    double sumDt = 0.0, maxDt = 0.0, sumAngle = 0.0, maxAngle = 0.0;
+    for (size_t i = 0; i < meshTs.size(); ++i) {
+        if ((meshTs[i] >= 0.0f) != (sphereTs[i] >= 0.0f)) {
+            ++numMismatches;
+            continue;
+        }
+        if (meshTs[i] < 0.0f) {
+            continue;
+        }
+        ++numBoth;
+        const double dt = std::fabs(meshTs[i] - sphereTs[i]) / radius;
+        sumDt += dt;
+        maxDt = std::max(maxDt, dt);
+        const float cosAngle = std::fabs(dot(meshNormals[i], sphereNormals[i]));
+        const double angle = std::acos(std::min(cosAngle, 1.0f)) * 180.0 / 3.14159265358979;
+        sumAngle += angle;
+        maxAngle = std::max(maxAngle, angle);
+    }
+
+    const double numRays = static_cast<double>(resolution) * resolution;
+    printf("%s: %u triangles, sphere of radius %.3f, %ux%u primary rays\n", fileName.c_str(), static_cast<uint32_t>(numTriangles),
+           radius, resolution, resolution);
+    printf("%-10s %12s %12s %12s %10s\n", "geometry", "buffers MB", "bvh MB", "Mrays/s", "hits");
+    printf("%-10s %12.3f %12.3f %12.2f %10u\n", "triangles", MB(meshBytes), MB(bvh.GetMemorySize()),
+           numRays * 1e-6 / meshStats.seconds, meshStats.numHits);
+    printf("%-10s %12.6f %12.6f %12.2f %10u\n", "sphere", MB(analyticBytes), MB(sizeof(HostBVH::Node)),
+           numRays * 1e-6 / sphereStats.seconds, sphereStats.numHits);
+    printf("%-10s %12.6f %12.6f %12.2f %10u\n", "capsule", MB(analyticBytes), MB(sizeof(HostBVH::Node)),
+           numRays * 1e-6 / capsuleStats.seconds, capsuleStats.numHits);
+    printf("triangles vs sphere: %u pixels hit by one only (%.3f%%), hit distance off by %.2e radii on average (%.2e at most),"
+           " normals by %.3f degrees (%.3f at most)\n", numMismatches, 100.0 * numMismatches / numRays,
+           numBoth ? sumDt / numBoth : 0.0, maxDt, numBoth ? sumAngle / numBoth : 0.0, maxAngle);
+
+    return 0;
+}
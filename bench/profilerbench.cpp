@@ -0,0 +1,129 @@
+// Cost of the profiler's instrumentation: a tick read, a zone (two tick reads + one ring write) on one thread and
+// on several threads at once, and the Chrome trace export of full rings. Zone cost is the loop time minus the
+// same loop without the zone, best of a few repetitions.
+//
+// usage: profilerbench [numThreads = 4, at most the hardware threads] [maxZoneNs = 100]
+//   exits with 1 when a zone costs more than maxZoneNs, so it can gate CI
+
+#define SWS_PROFILER 1
+#include "framework/profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::high_resolution_clock;
+
+static const uint32_t sNumIterations = 2000000;
+static const int sNumRepetitions = 5;
+
+static std::atomic<uint64_t> sSink(0);
+
+static double Seconds(const Clock::time_point& start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// the work the zones wrap, small enough that the zone dominates and opaque enough not to be optimized out
+static inline uint64_t Work(const uint64_t x) {
+    return x * 6364136223846793005ull + 1442695040888963407ull;
+}
+
+static double EmptyLoopNs() {
+    double best = 1e30;
+    for (int r = 0; r < sNumRepetitions; ++r) {
+        uint64_t x = r;
+        const Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < sNumIterations; ++i) {
+            x = Work(x);
+        }
+        sSink += x;
+        best = std::min(best, Seconds(start) * 1e9 / sNumIterations);
+    }
+    return best;
+}
+
+static double TicksNs() {
+    double best = 1e30;
+    for (int r = 0; r < sNumRepetitions; ++r) {
+        uint64_t x = 0;
+        const Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < sNumIterations; ++i) {
+            x += profiler::Ticks();
+        }
+        sSink += x;
+        best = std::min(best, Seconds(start) * 1e9 / sNumIterations);
+    }
+    return best;
+}
+
+static double ZoneLoopNs() {
+    double best = 1e30;
+    for (int r = 0; r < sNumRepetitions; ++r) {
+        uint64_t x = r;
+        const Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < sNumIterations; ++i) {
+            PROFILE_ZONE("zone");
+            x = Work(x);
+        }
+        sSink += x;
+        best = std::min(best, Seconds(start) * 1e9 / sNumIterations);
+    }
+    return best;
+}
+
+int main(int argc, const char** argv) {
+    uint32_t numThreads = (argc > 1) ? static_cast<uint32_t>(std::atoi(argv[1])) : 4;
+    const double maxZoneNs = (argc > 2) ? std::atof(argv[2]) : 100.0;
+
+    if (!numThreads || maxZoneNs <= 0.0) {
+        printf("usage: profilerbench [numThreads] [maxZoneNs]\n");
+        return 1;
+    }
+    // time sliced threads would measure the scheduler, not the rings
+    const uint32_t numCores = std::max(1u, std::thread::hardware_concurrency());
+    if (numThreads > numCores) {
+        printf("%u threads requested, only %u hardware threads: using %u\n", numThreads, numCores, numCores);
+        numThreads = numCores;
+    }
+
+    PROFILE_THREAD_NAME("main");
+
+    const double emptyNs = EmptyLoopNs();
+    const double ticksNs = TicksNs();
+    const double zoneNs = ZoneLoopNs() - emptyNs;
+    printf("%u iterations, best of %d\n", sNumIterations, sNumRepetitions);
+    printf("tick read:           %6.1f ns (%s, %.3f GHz)\n", ticksNs, SWS_PROFILER_TSC ? "tsc" : "steady_clock", profiler::GetTicksPerSecond() * 1e-9);
+    printf("zone, 1 thread:      %6.1f ns\n", zoneNs);
+
+    // every thread has its own ring, nothing is shared: the cost shouldn't move with the thread count
+    std::vector<double> threadNs(numThreads);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < numThreads; ++t) {
+        threads.emplace_back([t, emptyNs, &threadNs]() {
+            threadNs[t] = ZoneLoopNs() - emptyNs;
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double worstThreadNs = *std::max_element(threadNs.begin(), threadNs.end());
+    printf("zone, %2u threads:    %6.1f ns (slowest thread)\n", numThreads, worstThreadNs);
+
+    std::vector<const profiler::Track*> tracks;
+    profiler::GetTracks(tracks);
+    const Clock::time_point start = Clock::now();
+    const bool exported = profiler::SaveChromeTrace("profilerbench_trace.json");
+    printf("export:              %6.1f ms (%zu tracks of %zu events)\n", Seconds(start) * 1000.0, tracks.size(), profiler::kTrackCapacity);
+    remove("profilerbench_trace.json");
+
+    const double worstNs = std::max(zoneNs, worstThreadNs);
+    if (!exported || worstNs > maxZoneNs) {
+        printf("FAILED: %s\n", exported ? "zone overhead above the limit" : "export failed");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,444 @@
+// Scene setup and trace throughput over the bundled _data/scenes assets, one scenario per scene:
+//  parse           tinyobj::LoadObj, ms and MB/s of .obj text
+//  fill            FillObjMeshBuffers into host memory laid out like the GPU buffers, ms
+//  bvh_build       HostBVH (binned SAH) over all the triangles, ms
+//  primary/shadow/path   rays traced through the HostBVH on one thread, Mrays/s
+//  peak_rss        process peak resident memory after the scene, MB (scenes run smallest first)
+//  scene_mem       what the scene itself holds: parsed obj, filled buffers and BVH, MB
+// Every scene runs --runs times after --warmup untimed runs (at least one, it prints the scene's stats) and
+// reports median & p95. The GPU trace itself
+// is timed by the app: --headless prints the time per pass.
+//
+// usage: scenebench [--scenes a,b,...] [--runs N = 5] [--warmup N = 1] [--resolution N = 256]
+//                   [--folder _data/scenes/] [--json out.json] [--baseline base.json] [--threshold 0.05]
+// exits with 1 when a metric got worse than the baseline by more than the threshold, 2 on bad arguments / files
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include "framework/objmesh.h"
+#include "framework/pathtracer.h"
+#include "hostbvh.h"
+#include "benchreport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using Clock = std::chrono::high_resolution_clock;
+
+// smallest to largest, so the process peak memory grows with the scenes
+static const char* sDefaultScenes[] = {
+    "cube", "cube_multi", "plane", "cornell_box", "suzanne", "wuson", "sphere", "stanford-bunny", "bs_ears", "Medieval_building"
+};
+
+struct Options {
+    std::vector<std::string>    scenes;
+    std::string                 folder;
+    std::string                 jsonFile;
+    std::string                 baselineFile;
+    uint32_t                    numRuns;
+    uint32_t                    numWarmupRuns;
+    uint32_t                    resolution;
+    double                      threshold;
+};
+
+// everything a scene holds while it's being measured
+struct SceneData {
+    tinyobj::attrib_t                   attrib;
+    std::vector<tinyobj::shape_t>       shapes;
+    std::vector<tinyobj::material_t>    materials;
+    std::vector<float>                  positions;
+    std::vector<float>                  attribs;
+    std::vector<uint32_t>               indices;
+    std::vector<uint32_t>               faces;
+    HostBVH                             bvh;
+};
+
+
+static double Seconds(const Clock::time_point& start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static double GetPeakMemoryMB() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return static_cast<double>(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+#else
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<double>(usage.ru_maxrss) / (1024.0 * 1024.0);   // bytes
+#else
+    return static_cast<double>(usage.ru_maxrss) / 1024.0;              // kilobytes
+#endif
+#endif
+}
+
+static size_t GetFileSize(const std::string& fileName) {
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fclose(file);
+    return (size > 0) ? static_cast<size_t>(size) : 0;
+}
+
+static void CosineSampleHemisphere(const float n[3], const float u1, const float u2, float dir[3]) {
+    // orthonormal basis around n (Duff et al.)
+    const float sign = std::copysign(1.0f, n[2]);
+    const float a = -1.0f / (sign + n[2]);
+    const float b = n[0] * n[1] * a;
+    const float t[3] = { 1.0f + sign * n[0] * n[0] * a, sign * b, -sign * n[0] };
+    const float s[3] = { b, sign + n[1] * n[1] * a, -n[1] };
+
+    const float r = std::sqrt(u1);
+    const float phi = 2.0f * 3.14159265f * u2;
+    const float x = r * std::cos(phi), y = r * std::sin(phi), z = std::sqrt(std::max(0.0f, 1.0f - u1));
+    for (int k = 0; k < 3; ++k) {
+        dir[k] = t[k] * x + s[k] * y + n[k] * z;
+    }
+}
+
+// pinhole looking at the scene from the front and a bit above, like the app's default camera
+struct BenchCamera {
+    float   eye[3];
+    float   forward[3];
+    float   right[3];
+    float   up[3];
+    float   tanHalfFov;
+
+    void Setup(const float boundsMin[3], const float boundsMax[3]) {
+        float center[3], extent[3];
+        for (int k = 0; k < 3; ++k) {
+            center[k] = 0.5f * (boundsMin[k] + boundsMax[k]);
+            extent[k] = boundsMax[k] - boundsMin[k];
+        }
+        const float radius = 0.5f * std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+        eye[0] = center[0];
+        eye[1] = center[1] + 0.5f * radius;
+        eye[2] = center[2] + 2.5f * radius;
+
+        float len = 0.0f;
+        for (int k = 0; k < 3; ++k) {
+            forward[k] = center[k] - eye[k];
+            len += forward[k] * forward[k];
+        }
+        len = std::sqrt(len);
+        for (int k = 0; k < 3; ++k) {
+            forward[k] /= len;
+        }
+        // right = forward x (0, 1, 0), up = right x forward
+        right[0] = -forward[2];
+        right[1] = 0.0f;
+        right[2] = forward[0];
+        len = std::sqrt(right[0] * right[0] + right[2] * right[2]);
+        right[0] /= len;
+        right[2] /= len;
+        up[0] = right[1] * forward[2] - right[2] * forward[1];
+        up[1] = right[2] * forward[0] - right[0] * forward[2];
+        up[2] = right[0] * forward[1] - right[1] * forward[0];
+        tanHalfFov = std::tan(0.5f * 45.0f * 3.14159265f / 180.0f);
+    }
+
+    void GetRay(const uint32_t x, const uint32_t y, const uint32_t resolution, float dir[3]) const {
+        const float px = (2.0f * (x + 0.5f) / resolution - 1.0f) * tanHalfFov;
+        const float py = (1.0f - 2.0f * (y + 0.5f) / resolution) * tanHalfFov;
+        float len = 0.0f;
+        for (int k = 0; k < 3; ++k) {
+            dir[k] = forward[k] + px * right[k] + py * up[k];
+            len += dir[k] * dir[k];
+        }
+        len = std::sqrt(len);
+        for (int k = 0; k < 3; ++k) {
+            dir[k] /= len;
+        }
+    }
+};
+
+static bool RunScene(const std::string& sceneName, const Options& options, const bool timed, BenchReport& report) {
+    const std::string fileName = options.folder + sceneName + ".obj";
+    const size_t fileSize = GetFileSize(fileName);
+    if (!fileSize) {
+        printf("Can't open %s\n", fileName.c_str());
+        return false;
+    }
+
+    SceneData scene;
+
+    // parse
+    std::string warn, error;
+    Clock::time_point start = Clock::now();
+    const bool loaded = tinyobj::LoadObj(&scene.attrib, &scene.shapes, &scene.materials, &warn, &error, fileName.c_str(), options.folder.c_str(), true);
+    const double parseSeconds = Seconds(start);
+    if (!loaded) {
+        printf("Failed to load %s: %s\n", fileName.c_str(), error.c_str());
+        return false;
+    }
+
+    // fill, into buffers allocated up front like the app's mapped ones
+    size_t numFaces = 0;
+    for (const tinyobj::shape_t& shape : scene.shapes) {
+        numFaces += shape.mesh.num_face_vertices.size();
+    }
+    scene.positions.resize(numFaces * 9);
+    scene.attribs.resize(numFaces * 3 * 8);
+    scene.indices.resize(numFaces * 3);
+    scene.faces.resize(numFaces * 4);
+
+    start = Clock::now();
+    size_t firstFace = 0;
+    for (const tinyobj::shape_t& shape : scene.shapes) {
+        ObjMeshBuffers buffers;
+        buffers.positions = scene.positions.data() + firstFace * 9;
+        buffers.attribs = scene.attribs.data() + firstFace * 3 * 8;
+        buffers.indices = scene.indices.data() + firstFace * 3;
+        buffers.faces = scene.faces.data() + firstFace * 4;
+        FillObjMeshBuffers(scene.attrib, shape, buffers);
+        firstFace += shape.mesh.num_face_vertices.size();
+    }
+    const double fillSeconds = Seconds(start);
+
+    // de-indexed positions are the triangles already
+    start = Clock::now();
+    if (!scene.bvh.Build(scene.positions)) {
+        printf("%s has no triangles\n", fileName.c_str());
+        return false;
+    }
+    const double buildSeconds = Seconds(start);
+
+    float boundsMin[3], boundsMax[3];
+    scene.bvh.GetBounds(boundsMin, boundsMax);
+    BenchCamera camera;
+    camera.Setup(boundsMin, boundsMax);
+    const float sceneSize = std::max(boundsMax[0] - boundsMin[0], std::max(boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2]));
+    const float epsilon = 1e-4f * sceneSize;
+    const float light[3] = { boundsMax[0] + 0.5f * sceneSize, boundsMax[1] + sceneSize, boundsMax[2] + 0.5f * sceneSize };
+
+    // primary, keeping the hits for the shadow rays
+    const uint32_t resolution = options.resolution;
+    const size_t numPixels = static_cast<size_t>(resolution) * resolution;
+    std::vector<float> hitPoints;
+    hitPoints.reserve(numPixels * 3);
+    start = Clock::now();
+    for (uint32_t y = 0; y < resolution; ++y) {
+        for (uint32_t x = 0; x < resolution; ++x) {
+            float dir[3];
+            camera.GetRay(x, y, resolution, dir);
+            HostBVH::Hit hit;
+            if (scene.bvh.Intersect(camera.eye, dir, FLT_MAX, hit)) {
+                float n[3];
+                scene.bvh.GetNormal(hit, n);
+                const float flip = (n[0] * dir[0] + n[1] * dir[1] + n[2] * dir[2] > 0.0f) ? -1.0f : 1.0f;
+                for (int k = 0; k < 3; ++k) {
+                    hitPoints.push_back(camera.eye[k] + dir[k] * hit.t + flip * n[k] * epsilon);
+                }
+            }
+        }
+    }
+    const double primarySeconds = Seconds(start);
+
+    // shadow rays towards a point light above the scene
+    const size_t numHits = hitPoints.size() / 3;
+    uint32_t numOccluded = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < numHits; ++i) {
+        const float* p = &hitPoints[i * 3];
+        float dir[3] = { light[0] - p[0], light[1] - p[1], light[2] - p[2] };
+        const float dist = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+        for (int k = 0; k < 3; ++k) {
+            dir[k] /= dist;
+        }
+        numOccluded += scene.bvh.Occluded(p, dir, dist) ? 1 : 0;
+    }
+    const double shadowSeconds = Seconds(start);
+
+    // diffuse paths under a white sky through the same bounce loop as the shaders, fixed seed for the same work every run
+    PathTracer pathTracer;
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const PathTracer::RandomFunc random = [&]() { return unit(rng); };
+    uint64_t numPathRays = 0;
+    float origin[3], dir[3];
+    const PathTracer::VertexFunc vertexFunc = [&](const uint32_t, PathTracer::Vertex& vertex) {
+        ++numPathRays;
+        HostBVH::Hit hit;
+        if (!scene.bvh.Intersect(origin, dir, FLT_MAX, hit)) {
+            vertex.radiance[0] = vertex.radiance[1] = vertex.radiance[2] = 1.0f;
+            vertex.terminate = true;
+            return;
+        }
+        float n[3];
+        scene.bvh.GetNormal(hit, n);
+        if (n[0] * dir[0] + n[1] * dir[1] + n[2] * dir[2] > 0.0f) {
+            n[0] = -n[0];
+            n[1] = -n[1];
+            n[2] = -n[2];
+        }
+        for (int k = 0; k < 3; ++k) {
+            origin[k] += dir[k] * hit.t + n[k] * epsilon;
+        }
+        vertex.weight[0] = vertex.weight[1] = vertex.weight[2] = 0.7f;   // cosine sampled lambert: albedo
+        CosineSampleHemisphere(n, unit(rng), unit(rng), dir);
+    };
+    start = Clock::now();
+    for (uint32_t y = 0; y < resolution; ++y) {
+        for (uint32_t x = 0; x < resolution; ++x) {
+            memcpy(origin, camera.eye, sizeof(origin));
+            camera.GetRay(x, y, resolution, dir);
+            float radiance[3];
+            pathTracer.Trace(vertexFunc, random, radiance);
+        }
+    }
+    const double pathSeconds = Seconds(start);
+
+    const double sceneBytes = static_cast<double>(
+        (scene.attrib.vertices.size() + scene.attrib.normals.size() + scene.attrib.texcoords.size()) * sizeof(float) +
+        (scene.positions.size() + scene.attribs.size()) * sizeof(float) +
+        (scene.indices.size() + scene.faces.size()) * sizeof(uint32_t) +
+        scene.bvh.GetMemorySize());
+    const double peakMemory = GetPeakMemoryMB();
+
+    if (!timed) {
+        printf("%-20s %9u triangles, %7.2f MB obj, bvh %u nodes (depth %u), %5.1f%% coverage, %5.1f%% in shadow\n",
+               sceneName.c_str(), static_cast<uint32_t>(numFaces), fileSize / (1024.0 * 1024.0),
+               static_cast<uint32_t>(scene.bvh.GetNodes().size()), scene.bvh.GetDepth(),
+               100.0 * numHits / numPixels, numHits ? (100.0 * numOccluded / numHits) : 0.0);
+        return true;
+    }
+
+    using Better = BenchReport::Better;
+    report.Add(sceneName, "parse", "ms", Better::Lower, parseSeconds * 1000.0);
+    report.Add(sceneName, "parse_rate", "MB/s", Better::Higher, fileSize / (1024.0 * 1024.0) / std::max(parseSeconds, 1e-9));
+    report.Add(sceneName, "fill", "ms", Better::Lower, fillSeconds * 1000.0);
+    report.Add(sceneName, "bvh_build", "ms", Better::Lower, buildSeconds * 1000.0);
+    report.Add(sceneName, "primary", "Mrays/s", Better::Higher, numPixels / std::max(primarySeconds, 1e-9) * 1e-6);
+    report.Add(sceneName, "shadow", "Mrays/s", Better::Higher, numHits / std::max(shadowSeconds, 1e-9) * 1e-6);
+    report.Add(sceneName, "path", "Mrays/s", Better::Higher, numPathRays / std::max(pathSeconds, 1e-9) * 1e-6);
+    report.Add(sceneName, "peak_rss", "MB", Better::Lower, peakMemory);
+    report.Add(sceneName, "scene_mem", "MB", Better::Lower, sceneBytes / (1024.0 * 1024.0));
+    return true;
+}
+
+static void PrintUsage() {
+    printf("usage: scenebench [--scenes a,b,...] [--runs N] [--warmup N] [--resolution N]\n"
+           "                  [--folder _data/scenes/] [--json out.json] [--baseline base.json] [--threshold 0.05]\n");
+}
+
+static bool ParseOptions(const int argc, const char** argv, Options& options) {
+    options.folder = "_data/scenes/";
+    options.numRuns = 5;
+    options.numWarmupRuns = 1;
+    options.resolution = 256;
+    options.threshold = 0.05;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = (i + 1) < argc;
+        if (arg == "--scenes" && hasValue) {
+            std::string list = argv[++i];
+            size_t begin = 0;
+            while (begin <= list.size()) {
+                const size_t comma = std::min(list.find(',', begin), list.size());
+                if (comma > begin) {
+                    options.scenes.push_back(list.substr(begin, comma - begin));
+                }
+                begin = comma + 1;
+            }
+        } else if (arg == "--runs" && hasValue) {
+            options.numRuns = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--warmup" && hasValue) {
+            options.numWarmupRuns = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--resolution" && hasValue) {
+            options.resolution = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--folder" && hasValue) {
+            options.folder = argv[++i];
+            if (!options.folder.empty() && options.folder.back() != '/' && options.folder.back() != '\\') {
+                options.folder += '/';
+            }
+        } else if (arg == "--json" && hasValue) {
+            options.jsonFile = argv[++i];
+        } else if (arg == "--baseline" && hasValue) {
+            options.baselineFile = argv[++i];
+        } else if (arg == "--threshold" && hasValue) {
+            options.threshold = strtod(argv[++i], nullptr);
+        } else {
+            printf("Unknown or incomplete argument: %s\n", arg.c_str());
+            return false;
+        }
+    }
+
+    if (options.scenes.empty()) {
+        options.scenes.assign(std::begin(sDefaultScenes), std::end(sDefaultScenes));
+    }
+    if (!options.numRuns || !options.resolution || options.threshold < 0.0) {
+        printf("--runs and --resolution must be greater than 0, --threshold can't be negative\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, const char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+
+    BenchReport baseline;
+    if (!options.baselineFile.empty() && !baseline.LoadJson(options.baselineFile)) {
+        return 2;
+    }
+
+    printf("%u scenes, %u runs (+%u warmup), %ux%u rays per pass\n\n", static_cast<uint32_t>(options.scenes.size()),
+           options.numRuns, options.numWarmupRuns, options.resolution, options.resolution);
+
+    // scene by scene so the peak memory stays attributable, runs of a scene back to back
+    BenchReport report;
+    for (const std::string& scene : options.scenes) {
+        // the first untimed run checks the scene loads and describes it
+        if (!RunScene(scene, options, false, report)) {
+            return 2;
+        }
+        for (uint32_t run = 1; run < options.numWarmupRuns; ++run) {
+            RunScene(scene, options, false, report);
+        }
+        for (uint32_t run = 0; run < options.numRuns; ++run) {
+            RunScene(scene, options, true, report);
+        }
+    }
+    report.Finalize();
+
+    printf("\n");
+    report.Print();
+
+    if (!options.jsonFile.empty()) {
+        if (!report.SaveJson(options.jsonFile, options.numRuns)) {
+            return 2;
+        }
+        printf("\nResults written to %s\n", options.jsonFile.c_str());
+    }
+
+    if (!options.baselineFile.empty()) {
+        return report.Compare(baseline, options.threshold) ? 1 : 0;
+    }
+    return 0;
+}
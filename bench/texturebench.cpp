@@ -0,0 +1,137 @@
+// Cost of the texture cache's CPU stages: mip chain generation and BC1 / BC7 encoding of the whole chain, plus
+// the quality the encoders get (PSNR of level 0 against the source). Best of a few repetitions, the cache runs
+// them on its worker threads, one texture per job, so single threaded throughput is what matters here.
+//
+// usage: texturebench [image file = a generated 1024x1024 test pattern] [repetitions = 3]
+
+#include "framework/texturecodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double Seconds(const Clock::time_point& start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// smooth gradients, hard edges & noise, roughly what diffuse maps mix
+static void MakeTestPattern(const uint32_t width, const uint32_t height, std::vector<uint8_t>& rgba) {
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> noise(-12, 12);
+
+    rgba.resize(static_cast<size_t>(width) * height * 4);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            const float u = static_cast<float>(x) / width, v = static_cast<float>(y) / height;
+            const bool checker = ((x / 64) + (y / 64)) & 1;
+            const int base[3] = {
+                static_cast<int>(255.0f * u),
+                static_cast<int>(255.0f * v),
+                checker ? 200 : static_cast<int>(127.5f + 127.5f * std::sin(20.0f * (u + v)))
+            };
+
+            uint8_t* texel = &rgba[4 * (static_cast<size_t>(y) * width + x)];
+            for (int c = 0; c < 3; ++c) {
+                texel[c] = static_cast<uint8_t>(std::min(std::max(base[c] + noise(rng), 0), 255));
+            }
+            texel[3] = 255;
+        }
+    }
+}
+
+static double Psnr(const TextureMips& encoded, const TextureMips& source) {
+    const uint32_t width = source.width, height = source.height;
+    const uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    const size_t blockSize = GetTextureBlockSize(encoded.format);
+
+    double sum = 0.0;
+    uint8_t texels[64];
+    for (uint32_t by = 0; by < blocksY; ++by) {
+        for (uint32_t bx = 0; bx < blocksX; ++bx) {
+            const uint8_t* block = encoded.data.data() + (static_cast<size_t>(by) * blocksX + bx) * blockSize;
+            if (encoded.format == TextureFormat::BC1) {
+                DecodeBC1Block(block, texels);
+            } else {
+                DecodeBC7Block(block, texels);
+            }
+
+            for (uint32_t i = 0; i < 16; ++i) {
+                const uint32_t x = 4 * bx + (i & 3), y = 4 * by + (i >> 2);
+                if (x >= width || y >= height) {
+                    continue;
+                }
+                // BC1 has no alpha, only rgb counts for it
+                const int numChannels = (encoded.format == TextureFormat::BC1) ? 3 : 4;
+                for (int c = 0; c < numChannels; ++c) {
+                    const double d = static_cast<double>(texels[4 * i + c]) - source.data[4 * (static_cast<size_t>(y) * width + x) + c];
+                    sum += d * d;
+                }
+            }
+        }
+    }
+
+    const int numChannels = (encoded.format == TextureFormat::BC1) ? 3 : 4;
+    const double mse = sum / (static_cast<double>(width) * height * numChannels);
+    return (mse > 0.0) ? (10.0 * std::log10(255.0 * 255.0 / mse)) : 99.0;
+}
+
+int main(int argc, const char** argv) {
+    const int repetitions = (argc > 2) ? std::atoi(argv[2]) : 3;
+    if (repetitions < 1) {
+        printf("usage: texturebench [image file] [repetitions]\n");
+        return 1;
+    }
+
+    std::vector<uint8_t> rgba;
+    uint32_t width = 1024, height = 1024;
+    if (argc > 1) {
+        if (!LoadTextureRGBA8(argv[1], rgba, width, height)) {
+            printf("Couldn't load %s\n", argv[1]);
+            return 1;
+        }
+    } else {
+        MakeTestPattern(width, height, rgba);
+    }
+
+    TextureMips mips;
+    double mipsTime = 1e30;
+    for (int r = 0; r < repetitions; ++r) {
+        const Clock::time_point start = Clock::now();
+        GenerateTextureMips(rgba.data(), width, height, true, mips);
+        mipsTime = std::min(mipsTime, Seconds(start));
+    }
+
+    // every level counts, that's what a texture load does
+    double chainPixels = 0.0;
+    for (uint32_t level = 0; level < mips.GetNumLevels(); ++level) {
+        chainPixels += static_cast<double>(mips.GetLevelWidth(level)) * mips.GetLevelHeight(level);
+    }
+
+    printf("%s: %ux%u, %u levels, %.2f MB as rgba8\n", (argc > 1) ? argv[1] : "test pattern", width, height,
+           mips.GetNumLevels(), mips.data.size() / (1024.0 * 1024.0));
+    printf("%-8s %10s %12s %10s %10s\n", "stage", "ms", "Mpixels/s", "MB", "PSNR dB");
+    printf("%-8s %10.2f %12.2f %10.2f %10s\n", "mips", mipsTime * 1000.0, chainPixels * 1e-6 / mipsTime,
+           mips.data.size() / (1024.0 * 1024.0), "-");
+
+    const TextureFormat formats[] = { TextureFormat::BC1, TextureFormat::BC7 };
+    for (const TextureFormat format : formats) {
+        TextureMips encoded;
+        double encodeTime = 1e30;
+        for (int r = 0; r < repetitions; ++r) {
+            const Clock::time_point start = Clock::now();
+            EncodeTextureMips(mips, format, encoded);
+            encodeTime = std::min(encodeTime, Seconds(start));
+        }
+
+        printf("%-8s %10.2f %12.2f %10.2f %10.2f\n", GetTextureFormatName(format), encodeTime * 1000.0,
+               chainPixels * 1e-6 / encodeTime, encoded.data.size() / (1024.0 * 1024.0), Psnr(encoded, mips));
+    }
+
+    return 0;
+}
@@ -0,0 +1,36 @@
+# cmake -DSHADERS_DIR=dir -DSHADERS=a,b,... -DOUTPUT=file.cpp -P embedshaders.cmake
+# Writes the SPIR-V of SHADERS_DIR/<name>.bin as constexpr word arrays plus the table
+# framework/embeddedshaders.cpp looks them up in.
+
+string(REPLACE "," ";" SHADERS "${SHADERS}")
+
+# 8 words per line
+set(word "0x[0-9a-f]+u, ")
+set(line "${word}${word}${word}${word}${word}${word}${word}${word}")
+
+set(arrays "")
+set(table "")
+foreach(name ${SHADERS})
+    set(file "${SHADERS_DIR}/${name}.bin")
+    file(READ "${file}" hex HEX)
+    string(LENGTH "${hex}" length)
+    math(EXPR remainder "${length} % 8")
+    if(length EQUAL 0 OR NOT remainder EQUAL 0)
+        message(FATAL_ERROR "${file} isn't SPIR-V (${length} hex digits)")
+    endif()
+
+    # SPIR-V is little endian words, byte order flipped back
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])" "0x\\4\\3\\2\\1u, " words "${hex}")
+    string(REGEX REPLACE "(${line})" "\\1\n    " words "${words}")
+    string(REGEX REPLACE "[ \n]+$" "" words "${words}")
+    string(REPLACE ", \n" ",\n" words "${words}")
+
+    set(arrays "${arrays}static constexpr uint32_t ${name}_bin[] = {\n    ${words}\n};\n\n")
+    set(table "${table}    { \"${name}.bin\", ${name}_bin, sizeof(${name}_bin) },\n")
+endforeach()
+
+set(content "// generated by cmake/embedshaders.cmake, don't edit\n#include \"framework/embeddedshaders.h\"\n\n")
+set(content "${content}${arrays}extern const EmbeddedShader gEmbeddedShaders[] = {\n${table}};\n")
+set(content "${content}extern const size_t gNumEmbeddedShaders = sizeof(gEmbeddedShaders) / sizeof(gEmbeddedShaders[0]);\n")
+
+file(WRITE "${OUTPUT}" "${content}")
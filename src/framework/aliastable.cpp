@@ -0,0 +1,103 @@
+#include "aliastable.h"
+
+#include <algorithm>
+
+AliasTable::AliasTable()
+    : mTotalWeight(0.0)
+{
+}
+
+bool AliasTable::Build(const std::vector<float>& weights) {
+    this->Clear();
+
+    const size_t count = weights.size();
+    for (const float w : weights) {
+        mTotalWeight += (w > 0.0f) ? static_cast<double>(w) : 0.0;
+    }
+    if (!count || mTotalWeight <= 0.0) {
+        mTotalWeight = 0.0;
+        return false;
+    }
+
+    mEntries.resize(count);
+    mPdfs.resize(count);
+
+    // scale so the average bin is exactly 1, then pair every under-full bin with an over-full one
+    std::vector<double> scaled(count);
+    std::vector<uint32_t> small, large;
+    small.reserve(count);
+    large.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const double w = (weights[i] > 0.0f) ? static_cast<double>(weights[i]) : 0.0;
+        mPdfs[i] = static_cast<float>(w / mTotalWeight);
+        scaled[i] = w * static_cast<double>(count) / mTotalWeight;
+        if (scaled[i] < 1.0) {
+            small.push_back(static_cast<uint32_t>(i));
+        } else {
+            large.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    while (!small.empty() && !large.empty()) {
+        const uint32_t s = small.back();
+        small.pop_back();
+        const uint32_t l = large.back();
+
+        mEntries[s].probability = static_cast<float>(scaled[s]);
+        mEntries[s].alias = l;
+
+        scaled[l] -= (1.0 - scaled[s]);
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+
+    // whatever is left is 1 up to rounding errors
+    const uint32_t anyNonZero = static_cast<uint32_t>(std::find_if(mPdfs.begin(), mPdfs.end(), [](const float p) { return p > 0.0f; }) - mPdfs.begin());
+    for (const uint32_t i : large) {
+        mEntries[i].probability = 1.0f;
+        mEntries[i].alias = i;
+    }
+    for (const uint32_t i : small) {
+        // ... but a zero weight must never be picked
+        const bool zero = (mPdfs[i] <= 0.0f);
+        mEntries[i].probability = zero ? 0.0f : 1.0f;
+        mEntries[i].alias = zero ? anyNonZero : i;
+    }
+
+    return true;
+}
+
+void AliasTable::Clear() {
+    mEntries.clear();
+    mPdfs.clear();
+    mTotalWeight = 0.0;
+}
+
+uint32_t AliasTable::Sample(const float u) const {
+    const size_t count = mEntries.size();
+    const float scaled = u * static_cast<float>(count);
+    const uint32_t index = std::min(static_cast<uint32_t>(scaled), static_cast<uint32_t>(count - 1));
+    const float remainder = scaled - static_cast<float>(index);
+
+    const Entry& entry = mEntries[index];
+    return (remainder < entry.probability) ? index : entry.alias;
+}
+
+float AliasTable::GetPdf(const uint32_t index) const {
+    return (index < mPdfs.size()) ? mPdfs[index] : 0.0f;
+}
+
+size_t AliasTable::GetSize() const {
+    return mEntries.size();
+}
+
+double AliasTable::GetTotalWeight() const {
+    return mTotalWeight;
+}
+
+const std::vector<AliasTable::Entry>& AliasTable::GetEntries() const {
+    return mEntries;
+}
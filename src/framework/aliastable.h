@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Walker / Vose alias table: O(n) build, O(1) sampling of a discrete distribution.
+// Sample() is mirrored by sampleEmissiveTriangleIndex() in shaders/lights.glsl, so both sides pick the same index for the same u.
+class AliasTable {
+public:
+    struct Entry {
+        float       probability;    // chance to keep this bin, otherwise we jump to alias
+        uint32_t    alias;
+    };
+
+    AliasTable();
+    ~AliasTable() = default;
+
+    // weights don't have to be normalized, returns false if there's nothing to sample (empty or all zeros)
+    bool                        Build(const std::vector<float>& weights);
+    void                        Clear();
+
+    // u in [0, 1)
+    uint32_t                    Sample(const float u) const;
+    // probability of Sample() returning index
+    float                       GetPdf(const uint32_t index) const;
+
+    size_t                      GetSize() const;
+    double                      GetTotalWeight() const;
+    const std::vector<Entry>&   GetEntries() const;
+
+private:
+    std::vector<Entry>          mEntries;
+    std::vector<float>          mPdfs;
+    double                      mTotalWeight;
+};
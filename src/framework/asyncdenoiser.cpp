@@ -0,0 +1,142 @@
+#include "asyncdenoiser.h"
+#include "profiler.h"
+
+#include <cassert>
+
+AsyncDenoiser::AsyncDenoiser()
+    : mHasWork(false)
+    , mBusy(false)
+    , mResetPending(false)
+    , mQuit(false)
+    , mEpoch(0)
+    , mLastDenoiseTime(0.0f)
+    , mNumAccumulatedFrames(0)
+    , mNumDenoisedFrames(0)
+{
+}
+AsyncDenoiser::~AsyncDenoiser() {
+    this->Destroy();
+}
+
+void AsyncDenoiser::Initialize(const uint32_t width, const uint32_t height, ThreadPool* pool) {
+    this->Destroy();
+
+    mDenoiser.Initialize(width, height, pool);
+    mHasWork = false;
+    mBusy = false;
+    mResetPending = false;
+    mQuit = false;
+    mWorker = std::thread(&AsyncDenoiser::WorkerLoop, this);
+}
+
+void AsyncDenoiser::Destroy() {
+    if (mWorker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQuit = true;
+        }
+        mWorkAvailable.notify_all();
+        mWorker.join();
+    }
+    mDenoiser.Destroy();
+}
+
+bool AsyncDenoiser::IsInitialized() const {
+    return mWorker.joinable();
+}
+
+Denoiser::GBuffer* AsyncDenoiser::AcquireInput(const bool wait) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (mBusy) {
+        if (!wait) {
+            return nullptr;
+        }
+        PROFILE_ZONE("WaitDenoiser");
+        mWorkDone.wait(lock, [this]() { return !mBusy; });
+    }
+    return &mDenoiser.GetInput();
+}
+
+void AsyncDenoiser::Submit(const Callback& done) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        assert(!mBusy && "AcquireInput() first");
+        mCallback = done;
+        mHasWork = true;
+        mBusy = true;
+    }
+    mWorkAvailable.notify_one();
+}
+
+void AsyncDenoiser::WaitIdle() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mWorkDone.wait(lock, [this]() { return !mBusy; });
+}
+
+void AsyncDenoiser::ResetHistory() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mResetPending = true;
+    ++mEpoch;
+}
+
+float AsyncDenoiser::GetLastDenoiseTime() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mLastDenoiseTime;
+}
+
+uint32_t AsyncDenoiser::GetNumAccumulatedFrames() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mNumAccumulatedFrames;
+}
+
+uint64_t AsyncDenoiser::GetNumDenoisedFrames() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mNumDenoisedFrames;
+}
+
+void AsyncDenoiser::WorkerLoop() {
+    PROFILE_THREAD_NAME("denoiser");
+    for (;;) {
+        Callback callback;
+        bool reset;
+        uint64_t epoch;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWorkAvailable.wait(lock, [this]() { return mQuit || mHasWork; });
+            if (!mHasWork) {
+                return;
+            }
+            mHasWork = false;
+            callback.swap(mCallback);
+            reset = mResetPending;
+            mResetPending = false;
+            epoch = mEpoch;
+        }
+
+        if (reset) {
+            mDenoiser.ResetHistory();
+        }
+        {
+            PROFILE_ZONE("Denoise");
+            mDenoiser.Denoise();
+        }
+
+        bool current;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            current = (epoch == mEpoch);
+            mLastDenoiseTime = mDenoiser.GetLastDenoiseTime();
+            mNumAccumulatedFrames = mDenoiser.GetNumAccumulatedFrames();
+            ++mNumDenoisedFrames;
+        }
+        if (callback) {
+            callback(mDenoiser, current);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mBusy = false;
+        }
+        mWorkDone.notify_all();
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "denoiser.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+// Runs the Denoiser off the render thread, one frame at a time. The render thread fills the input of an idle
+// denoiser (AcquireInput) and submits it, the filter runs on a thread of its own - it splits its rows over the
+// pool, so it can't be a pool job itself - and hands its output to the submitted callback, still on that thread.
+// ResetHistory() only flags the reset, the next filter applies it before it starts, so the render thread never
+// waits for the frame in flight.
+class AsyncDenoiser {
+public:
+    // current - no ResetHistory() since the frame was submitted, the output still matches what's on screen
+    using Callback = std::function<void(const Denoiser& denoiser, const bool current)>;
+
+    AsyncDenoiser();
+    ~AsyncDenoiser();
+
+    void                Initialize(const uint32_t width, const uint32_t height, ThreadPool* pool);
+    void                Destroy();      // waits for the frame in flight
+    bool                IsInitialized() const;
+
+    // the input to fill, nullptr while a frame is being filtered unless wait is set: it blocks until it's done
+    Denoiser::GBuffer*  AcquireInput(const bool wait);
+    void                Submit(const Callback& done);
+    void                WaitIdle();
+    void                ResetHistory();
+
+    float               GetLastDenoiseTime() const;     // in milliseconds, of the last frame filtered
+    uint32_t            GetNumAccumulatedFrames() const;
+    uint64_t            GetNumDenoisedFrames() const;
+
+private:
+    void                WorkerLoop();
+
+private:
+    Denoiser                    mDenoiser;
+    std::thread                 mWorker;
+    mutable std::mutex          mMutex;
+    std::condition_variable     mWorkAvailable;
+    std::condition_variable     mWorkDone;
+    Callback                    mCallback;
+    bool                        mHasWork;       // submitted, not picked up yet
+    bool                        mBusy;          // submitted, callback not returned yet
+    bool                        mResetPending;
+    bool                        mQuit;
+    uint64_t                    mEpoch;         // ResetHistory() calls
+    float                       mLastDenoiseTime;
+    uint32_t                    mNumAccumulatedFrames;
+    uint64_t                    mNumDenoisedFrames;
+};
@@ -0,0 +1,122 @@
+#include "batchrender.h"
+
+#include <cstdio>
+
+// adaptive frames never stop before this many passes, the error estimate needs a few to settle
+static const uint32_t sMinAdaptivePasses = 4;
+
+BatchRender::BatchRender()
+    : mNumFrames(0)
+    , mFrame(0)
+    , mPass(0)
+    , mPassIsFinal(false)
+{
+    mSettings.numFrames = 0;
+    mSettings.maxPasses = 1;
+    mSettings.errorThreshold = 0.0f;
+    mSettings.frameRate = 24.0f;
+    mSettings.resume = false;
+}
+
+void BatchRender::Initialize(const Settings& settings) {
+    mSettings = settings;
+    mNumFrames = settings.numFrames;
+    mCameraPath.Clear();
+    mConvergence.Reset();
+
+    if (!settings.cameraPath.empty()) {
+        if (mCameraPath.Load(settings.cameraPath)) {
+            mNumFrames = mCameraPath.GetNumFrames(settings.frameRate);
+            printf("Camera path %s: %u keys, %.2f s at %.2f fps\n", settings.cameraPath.c_str(),
+                   static_cast<uint32_t>(mCameraPath.GetKeys().size()),
+                   mCameraPath.GetEndTime() - mCameraPath.GetStartTime(), settings.frameRate);
+        } else {
+            printf("Camera path failed to load, nothing to render\n");
+            mNumFrames = 0;
+        }
+    }
+
+    mFrame = 0;
+    mPass = 0;
+    mPassIsFinal = false;
+    if (settings.resume) {
+        // frames are renamed into place only once fully written, so the first missing one is where we stopped
+        for (; mFrame < mNumFrames; ++mFrame) {
+            FILE* file = fopen((settings.outputFolder + GetFrameFileName(mFrame, settings.extension)).c_str(), "rb");
+            if (!file) {
+                break;
+            }
+            fclose(file);
+        }
+        printf("Resuming at frame %u of %u\n", mFrame, mNumFrames);
+    }
+}
+
+uint32_t BatchRender::GetNumFrames() const {
+    return mNumFrames;
+}
+
+bool BatchRender::IsFinished() const {
+    return mFrame >= mNumFrames;
+}
+
+uint32_t BatchRender::GetFrame() const {
+    return mFrame;
+}
+
+uint32_t BatchRender::GetPass() const {
+    return mPass;
+}
+
+bool BatchRender::IsPassFinal() const {
+    return mPassIsFinal;
+}
+
+bool BatchRender::BeginPass() {
+    const bool firstPass = !mPass;
+    if (firstPass) {
+        mConvergence.Reset();
+    }
+
+    const uint32_t numPasses = mPass + 1;
+    mPassIsFinal = numPasses >= mSettings.maxPasses;
+    if (!mPassIsFinal && mSettings.errorThreshold > 0.0f && numPasses >= sMinAdaptivePasses) {
+        const float error = mConvergence.GetError();
+        mPassIsFinal = (error >= 0.0f) && (error <= mSettings.errorThreshold);
+    }
+    return firstPass;
+}
+
+void BatchRender::EndPass() {
+    if (mPassIsFinal) {
+        ++mFrame;
+        mPass = 0;
+    } else {
+        ++mPass;
+    }
+}
+
+bool BatchRender::GetCameraKey(CameraPath::Key& key) const {
+    if (mCameraPath.IsEmpty()) {
+        return false;
+    }
+    mCameraPath.Evaluate(mCameraPath.GetStartTime() + static_cast<float>(mFrame) / mSettings.frameRate, key);
+    return true;
+}
+
+bool BatchRender::NeedsSnapshot(const uint32_t frameIndex) const {
+    // the frame's readbacks still in flight when it's done are of no use to the next one
+    return mSettings.errorThreshold > 0.0f && frameIndex == mFrame;
+}
+
+void BatchRender::AddSnapshot(const uint8_t* texels, const size_t numPixels, const uint32_t frameIndex, const uint32_t passIndex) {
+    if (this->NeedsSnapshot(frameIndex)) {
+        mConvergence.AddSnapshot(texels, numPixels, passIndex + 1);
+    }
+}
+
+std::string BatchRender::GetFrameFileName(const uint32_t index, const std::string& extension) {
+    char fileName[64];
+    snprintf(fileName, sizeof(fileName), "frame_%05u.%s", index, extension.c_str());
+    return fileName;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "camerapath.h"
+#include "convergence.h"
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Schedules a headless batch render: every output frame accumulates passes until its pass budget or its error
+// threshold is met, the camera optionally follows a keyframed path. The render thread sets every pass up between
+// BeginPass() and EndPass(); the readbacks of a frame's intermediate passes come back frames in flight later
+// through AddSnapshot(), which is what the error estimate is made from - so an adaptive frame may get a pass or
+// two more than it needed. Output frames are named after their place in the sequence, a resumed render starts
+// at the first one missing.
+class BatchRender {
+public:
+    struct Settings {
+        uint32_t    numFrames;          // without a camera path, which sets its own
+        uint32_t    maxPasses;          // accumulated into every frame, the most an adaptive one gets
+        float       errorThreshold;     // relative error that ends a frame early, 0 - every frame gets maxPasses
+        std::string cameraPath;         // keyframes to follow, empty - the camera is left alone
+        float       frameRate;          // the camera path's frames per second
+        bool        resume;             // skip the frames already in outputFolder
+        std::string outputFolder;
+        std::string extension;          // of the frame files
+    };
+
+    BatchRender();
+    ~BatchRender() = default;
+
+    void            Initialize(const Settings& settings);
+
+    uint32_t        GetNumFrames() const;
+    bool            IsFinished() const;
+    uint32_t        GetFrame() const;           // output frame the next pass belongs to
+    uint32_t        GetPass() const;            // passes already submitted for it
+    bool            IsPassFinal() const;        // the pass being set up is the last one of its frame
+
+    // true for a frame's first pass: the camera moves there (GetCameraKey()), passes after it accumulate in place
+    bool            BeginPass();
+    void            EndPass();
+    // the current frame's camera, false without a path
+    bool            GetCameraKey(CameraPath::Key& key) const;
+
+    // the adaptive sampling wants the readback of frameIndex's intermediate passes
+    bool            NeedsSnapshot(const uint32_t frameIndex) const;
+    // 4 bytes per texel, of the pass passIndex of frameIndex
+    void            AddSnapshot(const uint8_t* texels, const size_t numPixels, const uint32_t frameIndex, const uint32_t passIndex);
+
+    static std::string GetFrameFileName(const uint32_t index, const std::string& extension);
+
+private:
+    Settings                mSettings;
+    CameraPath              mCameraPath;
+    ConvergenceEstimator    mConvergence;
+    uint32_t                mNumFrames;
+    uint32_t                mFrame;
+    uint32_t                mPass;
+    bool                    mPassIsFinal;
+};
@@ -0,0 +1,242 @@
+#include "bindlessregistry.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+BindlessRegistry::BindlessRegistry()
+    : mDevice(VK_NULL_HANDLE)
+    , mPool(VK_NULL_HANDLE)
+    , mUpdateAfterBind(false) {
+}
+
+BindlessRegistry::~BindlessRegistry() {
+    this->Destroy();
+}
+
+uint32_t BindlessRegistry::AddTable(const Kind kind, const VkDescriptorType type, const VkShaderStageFlags stages) {
+    assert(!mPool && "tables have to be added before Create()");
+
+    Table table;
+    table.kind = kind;
+    table.type = type;
+    table.stages = stages;
+    table.layout = VK_NULL_HANDLE;
+    table.set = VK_NULL_HANDLE;
+    mTables.push_back(table);
+    return static_cast<uint32_t>(mTables.size() - 1);
+}
+
+bool BindlessRegistry::Create(VkDevice device, VkPhysicalDevice physicalDevice, const uint32_t maxBuffers, const uint32_t maxTextures, const uint32_t reservedStorageBuffers) {
+    mDevice = device;
+
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &indexingFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    bool updateAfterBind = indexingFeatures.descriptorBindingUpdateUnusedWhilePending && indexingFeatures.descriptorBindingPartiallyBound;
+    for (const Table& table : mTables) {
+        if (table.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+            updateAfterBind = updateAfterBind && indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind;
+        } else if (table.type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || table.type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE) {
+            updateAfterBind = updateAfterBind && indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+        } else if (table.type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE) {
+            updateAfterBind = updateAfterBind && indexingFeatures.descriptorBindingStorageImageUpdateAfterBind;
+        } else {
+            updateAfterBind = false;
+        }
+    }
+    mUpdateAfterBind = updateAfterBind;
+
+    // per-stage limits, the update-after-bind ones when that's what the tables are
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProps = {};
+    indexingProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 props = {};
+    props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props.pNext = &indexingProps;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &props);
+    const VkPhysicalDeviceLimits& limits = props.properties.limits;
+
+    const uint32_t maxStorageBuffers = mUpdateAfterBind ? indexingProps.maxPerStageDescriptorUpdateAfterBindStorageBuffers : limits.maxPerStageDescriptorStorageBuffers;
+    const uint32_t maxSampledImages = mUpdateAfterBind ? indexingProps.maxPerStageDescriptorUpdateAfterBindSampledImages : limits.maxPerStageDescriptorSampledImages;
+    const uint32_t maxStorageImages = mUpdateAfterBind ? indexingProps.maxPerStageDescriptorUpdateAfterBindStorageImages : limits.maxPerStageDescriptorStorageImages;
+
+    uint32_t capacities[static_cast<size_t>(Kind::Count)] = { maxBuffers, maxTextures };
+    for (size_t kind = 0; kind < static_cast<size_t>(Kind::Count); ++kind) {
+        uint32_t numStorageBuffers = 0, numSampledImages = 0, numStorageImages = 0;
+        for (const Table& table : mTables) {
+            if (static_cast<size_t>(table.kind) != kind) {
+                continue;
+            }
+            numStorageBuffers += (table.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) ? 1 : 0;
+            numSampledImages += (table.type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || table.type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE) ? 1 : 0;
+            numStorageImages += (table.type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE) ? 1 : 0;
+        }
+
+        uint32_t& capacity = capacities[kind];
+        if (numStorageBuffers) {
+            const uint32_t available = (maxStorageBuffers > reservedStorageBuffers) ? (maxStorageBuffers - reservedStorageBuffers) : 0;
+            capacity = std::min(capacity, available / numStorageBuffers);
+        }
+        if (numSampledImages) {
+            capacity = std::min(capacity, maxSampledImages / numSampledImages);
+        }
+        if (numStorageImages) {
+            capacity = std::min(capacity, maxStorageImages / numStorageImages);
+        }
+        mSlots[kind].Initialize(capacity);
+    }
+
+    Array<VkDescriptorPoolSize> poolSizes;
+    for (const Table& table : mTables) {
+        const uint32_t capacity = mSlots[static_cast<size_t>(table.kind)].GetCapacity();
+        if (!capacity) {
+            printf("Bindless registry: the device has no room for the tables\n");
+            return false;
+        }
+        poolSizes.push_back(VkDescriptorPoolSize{ table.type, capacity });
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = mUpdateAfterBind ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0;
+    poolInfo.maxSets = static_cast<uint32_t>(mTables.size());
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+
+    VkResult error = vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mPool);
+    if (VK_SUCCESS != error) {
+        printf("Bindless registry: vkCreateDescriptorPool failed (%d)\n", static_cast<int>(error));
+        return false;
+    }
+
+    // only the slots written so far are ever indexed
+    VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    if (mUpdateAfterBind) {
+        bindingFlags |= VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    }
+
+    for (Table& table : mTables) {
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsInfo.bindingCount = 1;
+        bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.binding = 0;
+        binding.descriptorType = table.type;
+        binding.descriptorCount = mSlots[static_cast<size_t>(table.kind)].GetCapacity();
+        binding.stageFlags = table.stages;
+        binding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = &bindingFlagsInfo;
+        layoutInfo.flags = mUpdateAfterBind ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &binding;
+
+        error = vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &table.layout);
+        if (VK_SUCCESS != error) {
+            printf("Bindless registry: vkCreateDescriptorSetLayout failed (%d)\n", static_cast<int>(error));
+            return false;
+        }
+
+        VkDescriptorSetAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocateInfo.descriptorPool = mPool;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &table.layout;
+
+        error = vkAllocateDescriptorSets(mDevice, &allocateInfo, &table.set);
+        if (VK_SUCCESS != error) {
+            printf("Bindless registry: vkAllocateDescriptorSets failed (%d)\n", static_cast<int>(error));
+            return false;
+        }
+    }
+
+    printf("Bindless registry: %u tables, %u buffer & %u texture slots, %s\n", static_cast<uint32_t>(mTables.size()),
+           mSlots[static_cast<size_t>(Kind::Buffer)].GetCapacity(), mSlots[static_cast<size_t>(Kind::Texture)].GetCapacity(),
+           mUpdateAfterBind ? "update-after-bind" : "no update-after-bind");
+    return true;
+}
+
+void BindlessRegistry::Destroy() {
+    // the sets go with the pool
+    for (Table& table : mTables) {
+        if (table.layout) {
+            vkDestroyDescriptorSetLayout(mDevice, table.layout, nullptr);
+        }
+    }
+    mTables.clear();
+
+    if (mPool) {
+        vkDestroyDescriptorPool(mDevice, mPool, nullptr);
+        mPool = VK_NULL_HANDLE;
+    }
+
+    for (SlotAllocator& slots : mSlots) {
+        slots.Initialize(0);
+    }
+    mUpdateAfterBind = false;
+}
+
+bool BindlessRegistry::IsUpdateAfterBind() const {
+    return mUpdateAfterBind;
+}
+
+uint32_t BindlessRegistry::GetCapacity(const Kind kind) const {
+    return mSlots[static_cast<size_t>(kind)].GetCapacity();
+}
+
+VkDescriptorSetLayout BindlessRegistry::GetLayout(const uint32_t table) const {
+    return mTables[table].layout;
+}
+
+VkDescriptorSet BindlessRegistry::GetSet(const uint32_t table) const {
+    return mTables[table].set;
+}
+
+uint32_t BindlessRegistry::Allocate(const Kind kind) {
+    return mSlots[static_cast<size_t>(kind)].Allocate();
+}
+
+void BindlessRegistry::Release(const Kind kind, const uint32_t slot, const uint64_t serial) {
+    mSlots[static_cast<size_t>(kind)].Release(slot, serial);
+}
+
+void BindlessRegistry::Recycle(const uint64_t completedSerial) {
+    for (SlotAllocator& slots : mSlots) {
+        slots.Recycle(completedSerial);
+    }
+}
+
+const SlotAllocator& BindlessRegistry::GetSlots(const Kind kind) const {
+    return mSlots[static_cast<size_t>(kind)];
+}
+
+void BindlessRegistry::WriteBuffer(const uint32_t table, const uint32_t slot, const VkDescriptorBufferInfo& info) {
+    this->Write(table, slot, &info, nullptr);
+}
+
+void BindlessRegistry::WriteImage(const uint32_t table, const uint32_t slot, const VkDescriptorImageInfo& info) {
+    this->Write(table, slot, nullptr, &info);
+}
+
+void BindlessRegistry::Write(const uint32_t table, const uint32_t slot, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo) {
+    assert(mSlots[static_cast<size_t>(mTables[table].kind)].IsAllocated(slot) && "writing a slot that isn't allocated");
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = mTables[table].set;
+    write.dstBinding = 0;
+    write.dstArrayElement = slot;
+    write.descriptorCount = 1;
+    write.descriptorType = mTables[table].type;
+    write.pBufferInfo = bufferInfo;
+    write.pImageInfo = imageInfo;
+    vkUpdateDescriptorSets(mDevice, 1, &write, 0, nullptr);
+}
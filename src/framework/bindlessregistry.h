@@ -0,0 +1,65 @@
+#pragma once
+
+#include "vulkanhelpers.h"
+#include "slotallocator.h"
+#include "common.h"
+
+#include <cstdint>
+
+// Bindless resources: descriptor arrays of a fixed capacity, written once per resource and indexed by slot in the
+// shaders, so adding or removing a resource is a single descriptor write instead of new layouts, pool & sets.
+// Every table is a set of its own (binding 0, the whole array). Tables share the slots of their kind: a buffer
+// slot is the same resource in every buffer table (a mesh's attribs, faces & infos...).
+// Partially bound, and update-after-bind where the device supports it: slots not in use can be written while the
+// command buffers that bind the tables are pending. Without it they can only be written with nothing in flight,
+// and the command buffers have to be re-recorded after that.
+class BindlessRegistry {
+public:
+    enum class Kind : uint32_t {
+        Buffer,
+        Texture,
+
+        Count
+    };
+
+    BindlessRegistry();
+    ~BindlessRegistry();
+
+    // tables first, Create() makes them all (table ids are in the order they were added)
+    uint32_t                AddTable(const Kind kind, const VkDescriptorType type, const VkShaderStageFlags stages);
+    // capacities are upper bounds, lowered so a kind's tables fit the device's per-stage limits along with
+    // the reserved descriptors (the ones the pipeline has outside the registry)
+    bool                    Create(VkDevice device, VkPhysicalDevice physicalDevice, const uint32_t maxBuffers, const uint32_t maxTextures, const uint32_t reservedStorageBuffers);
+    void                    Destroy();
+
+    bool                    IsUpdateAfterBind() const;
+    uint32_t                GetCapacity(const Kind kind) const;
+    VkDescriptorSetLayout   GetLayout(const uint32_t table) const;
+    VkDescriptorSet         GetSet(const uint32_t table) const;
+
+    uint32_t                Allocate(const Kind kind);      // SlotAllocator::InvalidSlot when the kind is full
+    void                    Release(const Kind kind, const uint32_t slot, const uint64_t serial);
+    void                    Recycle(const uint64_t completedSerial);
+    const SlotAllocator&    GetSlots(const Kind kind) const;
+
+    void                    WriteBuffer(const uint32_t table, const uint32_t slot, const VkDescriptorBufferInfo& info);
+    void                    WriteImage(const uint32_t table, const uint32_t slot, const VkDescriptorImageInfo& info);
+
+private:
+    struct Table {
+        Kind                    kind;
+        VkDescriptorType        type;
+        VkShaderStageFlags      stages;
+        VkDescriptorSetLayout   layout;
+        VkDescriptorSet         set;
+    };
+
+    void                    Write(const uint32_t table, const uint32_t slot, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo);
+
+private:
+    VkDevice                mDevice;
+    VkDescriptorPool        mPool;
+    bool                    mUpdateAfterBind;
+    Array<Table>            mTables;
+    SlotAllocator           mSlots[static_cast<size_t>(Kind::Count)];
+};
@@ -0,0 +1,152 @@
+#include "camerapath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// finite differences over the neighbouring keys, one-sided at both ends of the path
+static void TangentAt(const std::vector<CameraPath::Key>& keys, const size_t i, const bool target, float tangent[3]) {
+    const size_t prev = (i > 0) ? (i - 1) : i;
+    const size_t next = (i + 1 < keys.size()) ? (i + 1) : i;
+    const float dt = keys[next].time - keys[prev].time;
+
+    const float* a = target ? keys[prev].target : keys[prev].position;
+    const float* b = target ? keys[next].target : keys[next].position;
+    for (int k = 0; k < 3; ++k) {
+        tangent[k] = (dt > 0.0f) ? ((b[k] - a[k]) / dt) : 0.0f;
+    }
+}
+
+static void Hermite(const float p0[3], const float m0[3], const float p1[3], const float m1[3], const float t, const float span, float out[3]) {
+    const float t2 = t * t;
+    const float t3 = t2 * t;
+    const float h00 = 2.0f * t3 - 3.0f * t2 + 1.0f;
+    const float h10 = t3 - 2.0f * t2 + t;
+    const float h01 = -2.0f * t3 + 3.0f * t2;
+    const float h11 = t3 - t2;
+    for (int k = 0; k < 3; ++k) {
+        out[k] = h00 * p0[k] + h10 * span * m0[k] + h01 * p1[k] + h11 * span * m1[k];
+    }
+}
+
+
+CameraPath::CameraPath() {
+}
+
+bool CameraPath::Load(const std::string& fileName) {
+    FILE* file = fopen(fileName.c_str(), "r");
+    if (!file) {
+        printf("Can't open camera path %s\n", fileName.c_str());
+        return false;
+    }
+
+    this->Clear();
+
+    char line[512];
+    uint32_t lineNumber = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), file)) {
+        ++lineNumber;
+        char* comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        Key key;
+        const int numRead = sscanf(line, "%f %f %f %f %f %f %f %f", &key.time,
+                                   &key.position[0], &key.position[1], &key.position[2],
+                                   &key.target[0], &key.target[1], &key.target[2],
+                                   &key.fovY);
+        if (numRead == EOF || numRead == 0) {
+            continue;   // empty line / comment
+        }
+        if (numRead != 8) {
+            printf("%s(%u): expected \"time px py pz tx ty tz fov\"\n", fileName.c_str(), lineNumber);
+            ok = false;
+            break;
+        }
+        this->AddKey(key);
+    }
+    fclose(file);
+
+    if (ok && mKeys.empty()) {
+        printf("%s: no keys\n", fileName.c_str());
+        ok = false;
+    }
+    return ok;
+}
+
+void CameraPath::Clear() {
+    mKeys.clear();
+}
+
+void CameraPath::AddKey(const Key& key) {
+    mKeys.insert(std::upper_bound(mKeys.begin(), mKeys.end(), key, [](const Key& a, const Key& b) {
+        return a.time < b.time;
+    }), key);
+}
+
+void CameraPath::Evaluate(const float time, Key& out) const {
+    if (mKeys.empty()) {
+        out = {};
+        return;
+    }
+    if (time <= mKeys.front().time || mKeys.size() == 1) {
+        out = mKeys.front();
+        out.time = time;
+        return;
+    }
+    if (time >= mKeys.back().time) {
+        out = mKeys.back();
+        out.time = time;
+        return;
+    }
+
+    // first key strictly after time, time is inside (i0, i1]
+    const size_t i1 = std::upper_bound(mKeys.begin(), mKeys.end(), time, [](const float t, const Key& key) {
+        return t < key.time;
+    }) - mKeys.begin();
+    const size_t i0 = i1 - 1;
+
+    const Key& k0 = mKeys[i0];
+    const Key& k1 = mKeys[i1];
+    const float span = k1.time - k0.time;
+    const float t = (span > 0.0f) ? ((time - k0.time) / span) : 1.0f;
+
+    float m0[3], m1[3];
+    TangentAt(mKeys, i0, false, m0);
+    TangentAt(mKeys, i1, false, m1);
+    Hermite(k0.position, m0, k1.position, m1, t, span, out.position);
+
+    TangentAt(mKeys, i0, true, m0);
+    TangentAt(mKeys, i1, true, m1);
+    Hermite(k0.target, m0, k1.target, m1, t, span, out.target);
+
+    out.fovY = k0.fovY + (k1.fovY - k0.fovY) * t;
+    out.time = time;
+}
+
+bool CameraPath::IsEmpty() const {
+    return mKeys.empty();
+}
+
+float CameraPath::GetStartTime() const {
+    return mKeys.empty() ? 0.0f : mKeys.front().time;
+}
+
+float CameraPath::GetEndTime() const {
+    return mKeys.empty() ? 0.0f : mKeys.back().time;
+}
+
+uint32_t CameraPath::GetNumFrames(const float frameRate) const {
+    if (mKeys.empty() || frameRate <= 0.0f) {
+        return 0;
+    }
+    // small epsilon so a path of exactly N / rate seconds gets its last frame
+    return static_cast<uint32_t>(std::floor((this->GetEndTime() - this->GetStartTime()) * frameRate + 1e-3f)) + 1;
+}
+
+const std::vector<CameraPath::Key>& CameraPath::GetKeys() const {
+    return mKeys;
+}
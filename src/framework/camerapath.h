@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Keyframed camera for batch renders.
+// Text file, one key per line: "time  pos.x pos.y pos.z  target.x target.y target.z  fovY", '#' starts a comment.
+// Position and target follow a Catmull-Rom like cubic (Hermite with tangents scaled by the key spacing, so
+// unevenly timed keys don't overshoot), the field of view is interpolated linearly.
+class CameraPath {
+public:
+    struct Key {
+        float   time;       // seconds
+        float   position[3];
+        float   target[3];
+        float   fovY;       // degrees
+    };
+
+    CameraPath();
+    ~CameraPath() = default;
+
+    bool        Load(const std::string& fileName);
+    void        Clear();
+    void        AddKey(const Key& key);     // keys are kept sorted by time
+
+    // clamps to the first / last key outside of the path
+    void        Evaluate(const float time, Key& out) const;
+
+    bool        IsEmpty() const;
+    float       GetStartTime() const;
+    float       GetEndTime() const;
+    // frames needed to cover [start, end] at the given rate, both ends included
+    uint32_t    GetNumFrames(const float frameRate) const;
+
+    const std::vector<Key>& GetKeys() const;
+
+private:
+    std::vector<Key>    mKeys;
+};
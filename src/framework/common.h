@@ -35,19 +35,23 @@ using vec3 = glm::highp_vec3;
 using ivec3 = glm::highp_ivec3;
 using ivec4 = glm::highp_ivec4;
 using vec4 = glm::highp_vec4;
+using uvec4 = glm::highp_uvec4;
 using mat4 = glm::highp_mat4;
 using quat = glm::highp_quat;
 using uint = glm::highp_uint32_t;
 struct Recti { int left, top, right, bottom; };
 
-static const float M_PI = 3.1415926536f;
+// glibc's <cmath> already defines it as a macro
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 
 inline float Rad2Deg(const float rad) {
-    return rad * (180.0f / M_PI);
+    return rad * (180.0f / static_cast<float>(M_PI));
 }
 
 inline float Deg2Rad(const float deg) {
-    return deg * (M_PI / 180.0f);
+    return deg * (static_cast<float>(M_PI) / 180.0f);
 }
 glm::vec3 inline getRandomVec3(float min, float max)
 {
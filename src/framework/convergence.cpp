@@ -0,0 +1,55 @@
+#include "convergence.h"
+
+#include <cmath>
+#include <cstring>
+
+ConvergenceEstimator::ConvergenceEstimator()
+    : mReferencePasses(0)
+    , mError(-1.0f)
+{
+}
+
+void ConvergenceEstimator::Reset() {
+    mReferencePasses = 0;
+    mError = -1.0f;
+}
+
+float ConvergenceEstimator::AddSnapshot(const uint8_t* texels, const size_t numPixels, const uint32_t numPasses) {
+    if (!numPixels) {
+        return mError;
+    }
+
+    if (mReferencePasses && numPasses > mReferencePasses && mReference.size() == numPixels * 4) {
+        double sumSq = 0.0, sum = 0.0;
+        for (size_t i = 0; i < numPixels * 4; i += 4) {
+            for (size_t c = 0; c < 3; ++c) {
+                const double value = static_cast<double>(texels[i + c]);
+                const double diff = value - static_cast<double>(mReference[i + c]);
+                sumSq += diff * diff;
+                sum += value;
+            }
+        }
+
+        const double q = static_cast<double>(mReferencePasses);
+        const double p = static_cast<double>(numPasses);
+        const double count = static_cast<double>(numPixels * 3);
+        // variance of A(p) = s^2 / p, s^2 = E|A(p) - A(q)|^2 / (1/q - 1/p)
+        const double variance = (sumSq / count) * q / (p - q);
+        // below one 8 bit step the readback can't tell anyway
+        const double mean = std::fmax(sum / count, 1.0);
+        mError = static_cast<float>(std::sqrt(variance) / mean);
+    }
+
+    // keep the two snapshots far enough apart for the difference to mean something
+    if (!mReferencePasses || numPasses >= 2 * mReferencePasses || mReference.size() != numPixels * 4) {
+        mReference.resize(numPixels * 4);
+        memcpy(mReference.data(), texels, numPixels * 4);
+        mReferencePasses = numPasses;
+    }
+
+    return mError;
+}
+
+float ConvergenceEstimator::GetError() const {
+    return mError;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Estimates how noisy a progressively accumulated image still is from the running mean read back at two pass counts.
+// For the mean A(n) of n independent passes with per pixel variance s^2, E|A(p) - A(q)|^2 = s^2 (1/q - 1/p),
+// so s^2 comes out of two snapshots and the standard error of A(p) is s / sqrt(p).
+// The result is relative to the average pixel value, a single number for the whole image.
+class ConvergenceEstimator {
+public:
+    ConvergenceEstimator();
+    ~ConvergenceEstimator() = default;
+
+    void        Reset();
+
+    // 4 bytes per texel (the alpha byte is ignored), accumulated over numPasses passes.
+    // Returns the updated estimate, negative while there's nothing to compare against yet
+    float       AddSnapshot(const uint8_t* texels, const size_t numPixels, const uint32_t numPasses);
+    float       GetError() const;
+
+private:
+    std::vector<uint8_t>    mReference;
+    uint32_t                mReferencePasses;
+    float                   mError;
+};
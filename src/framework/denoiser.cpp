@@ -0,0 +1,447 @@
+#include "denoiser.h"
+#include "threadpool.h"
+
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DENOISER_USE_SSE 1
+#include <emmintrin.h>
+#else
+#define DENOISER_USE_SSE 0
+#endif
+
+static const float sKernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+static const float sAlbedoEpsilon = 0.01f;  // keeps demodulation stable on black surfaces
+static const float sDepthEpsilon = 1e-3f;
+static const size_t sRowsPerJob = 8;
+
+// exp(x) for x <= 0, ~1e-5 relative error. Scalar and SSE versions are the same math,
+// so the tail pixels of a row match the vectorized ones exactly.
+static inline float FastExpNeg(float x) {
+    float t = x * 1.442695041f; // log2(e)
+    if (t < -126.0f) {
+        t = -126.0f;
+    }
+    const float fi = std::floor(t);
+    const float f = t - fi;
+    const float p = 1.0f + f * (0.6931472f + f * (0.2402265f + f * (0.05550411f + f * (0.009618129f + f * 0.0013333558f))));
+
+    const int32_t bits = (static_cast<int32_t>(fi) + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return scale * p;
+}
+
+#if DENOISER_USE_SSE
+static inline __m128 FastExpNeg(__m128 x) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 t = _mm_mul_ps(x, _mm_set1_ps(1.442695041f));
+    t = _mm_max_ps(t, _mm_set1_ps(-126.0f));
+
+    // floor (cvtt truncates toward zero)
+    __m128 fi = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+    fi = _mm_sub_ps(fi, _mm_and_ps(_mm_cmpgt_ps(fi, t), one));
+    const __m128 f = _mm_sub_ps(t, fi);
+
+    __m128 p = _mm_set1_ps(0.0013333558f);
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.009618129f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.05550411f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.2402265f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.6931472f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), one);
+
+    const __m128i bits = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fi), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(_mm_castsi128_ps(bits), p);
+}
+
+// 4 horizontal neighbours, clamped to edge if they cross the image border
+struct TapColumns {
+    bool    contiguous;
+    int     idx[4];
+
+    TapColumns(const int x, const int width) {
+        contiguous = (x >= 0 && x + 3 < width);
+        for (int i = 0; i < 4; ++i) {
+            const int xi = x + i;
+            idx[i] = (xi < 0) ? 0 : ((xi >= width) ? (width - 1) : xi);
+        }
+    }
+};
+
+static inline __m128 LoadPlane(const float* row, const TapColumns& cols) {
+    if (cols.contiguous) {
+        return _mm_loadu_ps(row + cols.idx[0]);
+    }
+    return _mm_setr_ps(row[cols.idx[0]], row[cols.idx[1]], row[cols.idx[2]], row[cols.idx[3]]);
+}
+
+static inline __m128i LoadPlane(const uint32_t* row, const TapColumns& cols) {
+    if (cols.contiguous) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + cols.idx[0]));
+    }
+    return _mm_setr_epi32(static_cast<int>(row[cols.idx[0]]), static_cast<int>(row[cols.idx[1]]),
+                          static_cast<int>(row[cols.idx[2]]), static_cast<int>(row[cols.idx[3]]));
+}
+#endif // DENOISER_USE_SSE
+
+static inline int ClampCoord(const int v, const int size) {
+    return (v < 0) ? 0 : ((v >= size) ? (size - 1) : v);
+}
+
+
+const uint32_t Denoiser::kInvalidMeshId;
+
+Denoiser::Denoiser()
+    : mWidth(0)
+    , mHeight(0)
+    , mPool(nullptr)
+    , mHistoryValid(false)
+    , mCurrentBuffer(0)
+    , mLastDenoiseTime(0.0f)
+    , mNumAccumulatedFrames(0)
+{
+    mSettings.numIterations = 5;
+    mSettings.colorPhi = 0.6f;
+    mSettings.normalPhi = 0.1f;
+    mSettings.depthPhi = 0.01f;
+    mSettings.temporal = true;
+    mSettings.maxHistory = 32;
+}
+Denoiser::~Denoiser() {
+    this->Destroy();
+}
+
+void Denoiser::Initialize(const uint32_t width, const uint32_t height, ThreadPool* pool) {
+    mWidth = width;
+    mHeight = height;
+    mPool = pool;
+
+    const size_t numPixels = static_cast<size_t>(width) * height;
+
+    std::vector<float>* floatPlanes[] = {
+        &mInput.colorR, &mInput.colorG, &mInput.colorB,
+        &mInput.albedoR, &mInput.albedoG, &mInput.albedoB,
+        &mInput.normalX, &mInput.normalY, &mInput.normalZ,
+        &mInput.depth,
+        &mHistoryR, &mHistoryG, &mHistoryB, &mHistoryDepth,
+        &mIrradiance[0][0], &mIrradiance[0][1], &mIrradiance[0][2],
+        &mIrradiance[1][0], &mIrradiance[1][1], &mIrradiance[1][2],
+        &mOutputR, &mOutputG, &mOutputB
+    };
+    for (std::vector<float>* plane : floatPlanes) {
+        plane->assign(numPixels, 0.0f);
+    }
+
+    mInput.meshId.assign(numPixels, kInvalidMeshId);
+    mHistoryMeshId.assign(numPixels, kInvalidMeshId);
+    mHistoryLength.assign(numPixels, 0u);
+
+    this->ResetHistory();
+}
+
+void Denoiser::Destroy() {
+    mInput = GBuffer();
+    mHistoryR.clear();
+    mHistoryG.clear();
+    mHistoryB.clear();
+    mHistoryDepth.clear();
+    mHistoryMeshId.clear();
+    mHistoryLength.clear();
+    for (std::vector<float>(&buffers)[3] : mIrradiance) {
+        for (std::vector<float>& plane : buffers) {
+            plane.clear();
+        }
+    }
+    mOutputR.clear();
+    mOutputG.clear();
+    mOutputB.clear();
+
+    mWidth = mHeight = 0;
+    mPool = nullptr;
+}
+
+void Denoiser::ResetHistory() {
+    mHistoryValid = false;
+    mNumAccumulatedFrames = 0;
+}
+
+Denoiser::Settings& Denoiser::GetSettings() {
+    return mSettings;
+}
+
+Denoiser::GBuffer& Denoiser::GetInput() {
+    return mInput;
+}
+
+void Denoiser::Denoise() {
+    if (!mWidth || !mHeight) {
+        return;
+    }
+
+    const auto startTime = std::chrono::high_resolution_clock::now();
+
+    auto runRows = [this](const ThreadPool::RangeJob& job) {
+        if (mPool) {
+            mPool->ParallelFor(mHeight, sRowsPerJob, job);
+        } else {
+            job(0, mHeight);
+        }
+    };
+
+    if (mSettings.temporal) {
+        runRows([this](const size_t begin, const size_t end) { this->TemporalPass(begin, end); });
+        mHistoryValid = true;
+        mNumAccumulatedFrames = (mNumAccumulatedFrames < mSettings.maxHistory) ? (mNumAccumulatedFrames + 1) : mSettings.maxHistory;
+    } else {
+        mHistoryValid = false;
+        mNumAccumulatedFrames = 1;
+    }
+
+    mCurrentBuffer = 0;
+    runRows([this](const size_t begin, const size_t end) { this->DemodulatePass(begin, end); });
+
+    for (uint32_t i = 0; i < mSettings.numIterations; ++i) {
+        runRows([this, i](const size_t begin, const size_t end) { this->ATrousPass(begin, end, i); });
+        mCurrentBuffer ^= 1;
+    }
+
+    runRows([this](const size_t begin, const size_t end) { this->RemodulatePass(begin, end); });
+
+    const auto endTime = std::chrono::high_resolution_clock::now();
+    mLastDenoiseTime = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+}
+
+const float* Denoiser::GetOutputR() const {
+    return mOutputR.data();
+}
+
+const float* Denoiser::GetOutputG() const {
+    return mOutputG.data();
+}
+
+const float* Denoiser::GetOutputB() const {
+    return mOutputB.data();
+}
+
+uint32_t Denoiser::GetWidth() const {
+    return mWidth;
+}
+
+uint32_t Denoiser::GetHeight() const {
+    return mHeight;
+}
+
+float Denoiser::GetLastDenoiseTime() const {
+    return mLastDenoiseTime;
+}
+
+uint32_t Denoiser::GetNumAccumulatedFrames() const {
+    return mNumAccumulatedFrames;
+}
+
+void Denoiser::TemporalPass(const size_t rowBegin, const size_t rowEnd) {
+    const uint32_t maxHistory = mSettings.maxHistory ? mSettings.maxHistory : 1;
+
+    for (size_t i = rowBegin * mWidth, end = rowEnd * mWidth; i < end; ++i) {
+        const uint32_t meshId = mInput.meshId[i];
+        const float depth = mInput.depth[i];
+
+        // reject history if another surface is visible now (camera/object moved)
+        bool valid = mHistoryValid && (meshId == mHistoryMeshId[i]);
+        if (valid && meshId != kInvalidMeshId) {
+            const float prevDepth = mHistoryDepth[i];
+            valid = std::fabs(depth - prevDepth) <= 0.05f * std::max(depth, prevDepth);
+        }
+
+        const uint32_t length = valid ? ((mHistoryLength[i] < maxHistory) ? (mHistoryLength[i] + 1) : maxHistory) : 1u;
+        const float alpha = 1.0f / static_cast<float>(length);
+
+        mHistoryR[i] = valid ? (mHistoryR[i] + (mInput.colorR[i] - mHistoryR[i]) * alpha) : mInput.colorR[i];
+        mHistoryG[i] = valid ? (mHistoryG[i] + (mInput.colorG[i] - mHistoryG[i]) * alpha) : mInput.colorG[i];
+        mHistoryB[i] = valid ? (mHistoryB[i] + (mInput.colorB[i] - mHistoryB[i]) * alpha) : mInput.colorB[i];
+        mHistoryDepth[i] = depth;
+        mHistoryMeshId[i] = meshId;
+        mHistoryLength[i] = length;
+    }
+}
+
+void Denoiser::DemodulatePass(const size_t rowBegin, const size_t rowEnd) {
+    const bool temporal = mSettings.temporal;
+    const float* srcR = temporal ? mHistoryR.data() : mInput.colorR.data();
+    const float* srcG = temporal ? mHistoryG.data() : mInput.colorG.data();
+    const float* srcB = temporal ? mHistoryB.data() : mInput.colorB.data();
+
+    std::vector<float>* dst = mIrradiance[mCurrentBuffer];
+
+    for (size_t i = rowBegin * mWidth, end = rowEnd * mWidth; i < end; ++i) {
+        dst[0][i] = srcR[i] / (mInput.albedoR[i] + sAlbedoEpsilon);
+        dst[1][i] = srcG[i] / (mInput.albedoG[i] + sAlbedoEpsilon);
+        dst[2][i] = srcB[i] / (mInput.albedoB[i] + sAlbedoEpsilon);
+    }
+}
+
+void Denoiser::ATrousPass(const size_t rowBegin, const size_t rowEnd, const uint32_t iteration) {
+    const int width = static_cast<int>(mWidth);
+    const int height = static_cast<int>(mHeight);
+    const int step = 1 << iteration;
+
+    // color sigma shrinks with every iteration, so the coarse levels don't blur lighting features
+    const float invColorPhi = static_cast<float>(step) / mSettings.colorPhi;
+    const float invNormalPhi = 1.0f / mSettings.normalPhi;
+    const float invDepthPhi = 1.0f / mSettings.depthPhi;
+
+    const std::vector<float>* src = mIrradiance[mCurrentBuffer];
+    std::vector<float>* dst = mIrradiance[mCurrentBuffer ^ 1];
+
+    const float* srcR = src[0].data();
+    const float* srcG = src[1].data();
+    const float* srcB = src[2].data();
+    const float* nX = mInput.normalX.data();
+    const float* nY = mInput.normalY.data();
+    const float* nZ = mInput.normalZ.data();
+    const float* depth = mInput.depth.data();
+    const uint32_t* meshId = mInput.meshId.data();
+
+    for (int y = static_cast<int>(rowBegin); y < static_cast<int>(rowEnd); ++y) {
+        const size_t rowOffset = static_cast<size_t>(y) * mWidth;
+        int x = 0;
+
+#if DENOISER_USE_SSE
+        const __m128 vInvColorPhi = _mm_set1_ps(invColorPhi);
+        const __m128 vInvNormalPhi = _mm_set1_ps(invNormalPhi);
+        const __m128 vInvDepthPhi = _mm_set1_ps(invDepthPhi);
+        const __m128 vDepthEps = _mm_set1_ps(sDepthEpsilon);
+
+        for (; x + 3 < width; x += 4) {
+            const size_t p = rowOffset + x;
+            const __m128 pR = _mm_loadu_ps(srcR + p);
+            const __m128 pG = _mm_loadu_ps(srcG + p);
+            const __m128 pB = _mm_loadu_ps(srcB + p);
+            const __m128 pNX = _mm_loadu_ps(nX + p);
+            const __m128 pNY = _mm_loadu_ps(nY + p);
+            const __m128 pNZ = _mm_loadu_ps(nZ + p);
+            const __m128 pD = _mm_loadu_ps(depth + p);
+            const __m128i pId = _mm_loadu_si128(reinterpret_cast<const __m128i*>(meshId + p));
+            const __m128 invPD = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(pD, vDepthEps));
+
+            __m128 sumR = _mm_setzero_ps(), sumG = _mm_setzero_ps(), sumB = _mm_setzero_ps(), sumW = _mm_setzero_ps();
+
+            for (int ky = -2; ky <= 2; ++ky) {
+                const size_t qRow = static_cast<size_t>(ClampCoord(y + ky * step, height)) * mWidth;
+                const float hy = sKernel[ky + 2];
+
+                for (int kx = -2; kx <= 2; ++kx) {
+                    const TapColumns cols(x + kx * step, width);
+                    const __m128 h = _mm_set1_ps(hy * sKernel[kx + 2]);
+
+                    const __m128 qR = LoadPlane(srcR + qRow, cols);
+                    const __m128 qG = LoadPlane(srcG + qRow, cols);
+                    const __m128 qB = LoadPlane(srcB + qRow, cols);
+                    const __m128 qNX = LoadPlane(nX + qRow, cols);
+                    const __m128 qNY = LoadPlane(nY + qRow, cols);
+                    const __m128 qNZ = LoadPlane(nZ + qRow, cols);
+                    const __m128 qD = LoadPlane(depth + qRow, cols);
+                    const __m128i qId = LoadPlane(meshId + qRow, cols);
+
+                    __m128 t = _mm_sub_ps(qR, pR);
+                    __m128 dc = _mm_mul_ps(t, t);
+                    t = _mm_sub_ps(qG, pG);
+                    dc = _mm_add_ps(dc, _mm_mul_ps(t, t));
+                    t = _mm_sub_ps(qB, pB);
+                    dc = _mm_add_ps(dc, _mm_mul_ps(t, t));
+
+                    t = _mm_sub_ps(qNX, pNX);
+                    __m128 dn = _mm_mul_ps(t, t);
+                    t = _mm_sub_ps(qNY, pNY);
+                    dn = _mm_add_ps(dn, _mm_mul_ps(t, t));
+                    t = _mm_sub_ps(qNZ, pNZ);
+                    dn = _mm_add_ps(dn, _mm_mul_ps(t, t));
+
+                    t = _mm_mul_ps(_mm_sub_ps(qD, pD), invPD);
+                    const __m128 dd = _mm_mul_ps(t, t);
+
+                    __m128 e = _mm_mul_ps(dc, vInvColorPhi);
+                    e = _mm_add_ps(e, _mm_mul_ps(dn, vInvNormalPhi));
+                    e = _mm_add_ps(e, _mm_mul_ps(dd, vInvDepthPhi));
+
+                    __m128 w = _mm_mul_ps(h, FastExpNeg(_mm_sub_ps(_mm_setzero_ps(), e)));
+                    w = _mm_and_ps(w, _mm_castsi128_ps(_mm_cmpeq_epi32(qId, pId))); // never mix different meshes
+
+                    sumR = _mm_add_ps(sumR, _mm_mul_ps(qR, w));
+                    sumG = _mm_add_ps(sumG, _mm_mul_ps(qG, w));
+                    sumB = _mm_add_ps(sumB, _mm_mul_ps(qB, w));
+                    sumW = _mm_add_ps(sumW, w);
+                }
+            }
+
+            // center tap always has weight > 0
+            const __m128 invW = _mm_div_ps(_mm_set1_ps(1.0f), sumW);
+            _mm_storeu_ps(dst[0].data() + p, _mm_mul_ps(sumR, invW));
+            _mm_storeu_ps(dst[1].data() + p, _mm_mul_ps(sumG, invW));
+            _mm_storeu_ps(dst[2].data() + p, _mm_mul_ps(sumB, invW));
+        }
+#endif // DENOISER_USE_SSE
+
+        for (; x < width; ++x) {
+            const size_t p = rowOffset + x;
+            const float invPD = 1.0f / std::max(depth[p], sDepthEpsilon);
+
+            float sumR = 0.0f, sumG = 0.0f, sumB = 0.0f, sumW = 0.0f;
+
+            for (int ky = -2; ky <= 2; ++ky) {
+                const size_t qRow = static_cast<size_t>(ClampCoord(y + ky * step, height)) * mWidth;
+                const float hy = sKernel[ky + 2];
+
+                for (int kx = -2; kx <= 2; ++kx) {
+                    const size_t q = qRow + ClampCoord(x + kx * step, width);
+                    if (meshId[q] != meshId[p]) {
+                        continue;
+                    }
+
+                    float t = srcR[q] - srcR[p];
+                    float dc = t * t;
+                    t = srcG[q] - srcG[p];
+                    dc += t * t;
+                    t = srcB[q] - srcB[p];
+                    dc += t * t;
+
+                    t = nX[q] - nX[p];
+                    float dn = t * t;
+                    t = nY[q] - nY[p];
+                    dn += t * t;
+                    t = nZ[q] - nZ[p];
+                    dn += t * t;
+
+                    t = (depth[q] - depth[p]) * invPD;
+                    const float dd = t * t;
+
+                    const float e = dc * invColorPhi + dn * invNormalPhi + dd * invDepthPhi;
+                    const float w = hy * sKernel[kx + 2] * FastExpNeg(-e);
+
+                    sumR += srcR[q] * w;
+                    sumG += srcG[q] * w;
+                    sumB += srcB[q] * w;
+                    sumW += w;
+                }
+            }
+
+            const float invW = 1.0f / sumW;
+            dst[0][p] = sumR * invW;
+            dst[1][p] = sumG * invW;
+            dst[2][p] = sumB * invW;
+        }
+    }
+}
+
+void Denoiser::RemodulatePass(const size_t rowBegin, const size_t rowEnd) {
+    const std::vector<float>* src = mIrradiance[mCurrentBuffer];
+
+    for (size_t i = rowBegin * mWidth, end = rowEnd * mWidth; i < end; ++i) {
+        mOutputR[i] = src[0][i] * (mInput.albedoR[i] + sAlbedoEpsilon);
+        mOutputG[i] = src[1][i] * (mInput.albedoG[i] + sAlbedoEpsilon);
+        mOutputB[i] = src[2][i] * (mInput.albedoB[i] + sAlbedoEpsilon);
+    }
+}
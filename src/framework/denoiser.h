@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class ThreadPool;
+
+// Edge-avoiding A-Trous wavelet filter ("Edge-Avoiding A-Trous Wavelet Transform for fast Global
+// Illumination Filtering", Dammertz et al. 2010) guided by albedo/normal/depth/mesh id AOVs.
+// Everything runs on the CPU: rows are split between the pool workers and processed 4 pixels at a time with SSE.
+// Lighting is filtered demodulated (color / albedo), so textures and material edges stay sharp.
+class Denoiser {
+public:
+    static const uint32_t kInvalidMeshId = ~0u;
+
+    struct Settings {
+        uint32_t    numIterations;  // every iteration doubles the kernel footprint (5 -> 5x5 .. 80x80 pixels)
+        float       colorPhi;       // edge-stopping "sigma^2" for the demodulated color
+        float       normalPhi;      // ... for the shading normal
+        float       depthPhi;       // ... for the relative hit distance
+        bool        temporal;       // accumulate frames over time before filtering
+        uint32_t    maxHistory;     // max number of frames blended together by the temporal pass
+    };
+
+    // planar so we can load 4 neighbours with a single instruction, all planes are width * height
+    struct GBuffer {
+        std::vector<float>      colorR, colorG, colorB;
+        std::vector<float>      albedoR, albedoG, albedoB;
+        std::vector<float>      normalX, normalY, normalZ;
+        std::vector<float>      depth;
+        std::vector<uint32_t>   meshId;
+    };
+
+    Denoiser();
+    ~Denoiser();
+
+    void            Initialize(const uint32_t width, const uint32_t height, ThreadPool* pool);
+    void            Destroy();
+    void            ResetHistory();
+
+    Settings&       GetSettings();
+    GBuffer&        GetInput();
+
+    // filters current input, the result is available through GetOutput*
+    void            Denoise();
+
+    const float*    GetOutputR() const;
+    const float*    GetOutputG() const;
+    const float*    GetOutputB() const;
+
+    uint32_t        GetWidth() const;
+    uint32_t        GetHeight() const;
+    float           GetLastDenoiseTime() const;     // in milliseconds
+    uint32_t        GetNumAccumulatedFrames() const;
+
+private:
+    void            TemporalPass(const size_t rowBegin, const size_t rowEnd);
+    void            DemodulatePass(const size_t rowBegin, const size_t rowEnd);
+    void            ATrousPass(const size_t rowBegin, const size_t rowEnd, const uint32_t iteration);
+    void            RemodulatePass(const size_t rowBegin, const size_t rowEnd);
+
+private:
+    uint32_t            mWidth;
+    uint32_t            mHeight;
+    ThreadPool*         mPool;
+    Settings            mSettings;
+    GBuffer             mInput;
+
+    // temporal history
+    std::vector<float>      mHistoryR, mHistoryG, mHistoryB;
+    std::vector<float>      mHistoryDepth;
+    std::vector<uint32_t>   mHistoryMeshId;
+    std::vector<uint32_t>   mHistoryLength;
+    bool                    mHistoryValid;
+
+    // ping-pong irradiance buffers
+    std::vector<float>      mIrradiance[2][3];
+    uint32_t                mCurrentBuffer;
+
+    std::vector<float>      mOutputR, mOutputG, mOutputB;
+    float                   mLastDenoiseTime;
+    uint32_t                mNumAccumulatedFrames;
+};
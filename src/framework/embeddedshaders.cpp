@@ -0,0 +1,25 @@
+#include "embeddedshaders.h"
+
+#include <cstring>
+
+#ifdef SWS_EMBEDDED_SHADERS
+// the build directory's embeddedshaders_data.cpp
+extern const EmbeddedShader gEmbeddedShaders[];
+extern const size_t gNumEmbeddedShaders;
+#else
+static const EmbeddedShader* gEmbeddedShaders = nullptr;
+static const size_t gNumEmbeddedShaders = 0;
+#endif
+
+const EmbeddedShader* FindEmbeddedShader(const char* name) {
+    for (size_t i = 0; i < gNumEmbeddedShaders; ++i) {
+        if (!strcmp(gEmbeddedShaders[i].name, name)) {
+            return &gEmbeddedShaders[i];
+        }
+    }
+    return nullptr;
+}
+
+size_t GetNumEmbeddedShaders() {
+    return gNumEmbeddedShaders;
+}
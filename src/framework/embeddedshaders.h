@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// SPIR-V compiled into the executable. With RTXON_EMBED_SHADERS the build compiles src/shaders/ and generates the
+// table (cmake/embedshaders.cmake), without it nothing is embedded and the shaders are loaded from loose files.
+struct EmbeddedShader {
+    const char*     name;       // the .bin's, as compile_shaders.cmd names it: "ray_gen.bin"
+    const uint32_t* code;
+    size_t          size;       // bytes
+};
+
+// nullptr if the build didn't embed it
+const EmbeddedShader*   FindEmbeddedShader(const char* name);
+size_t                  GetNumEmbeddedShaders();
@@ -0,0 +1,230 @@
+#include "exrwriter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static const uint32_t kExrMagic = 20000630;
+static const uint32_t kExrVersion = 2;      // single part scanline
+static const uint8_t  kNoCompression = 0;
+static const uint8_t  kIncreasingY = 0;
+
+static void PutBytes(std::vector<uint8_t>& out, const void* data, const size_t size) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+// EXR is little-endian, just like everything we run on
+template <typename T>
+static void Put(std::vector<uint8_t>& out, const T value) {
+    PutBytes(out, &value, sizeof(T));
+}
+
+static void PutString(std::vector<uint8_t>& out, const std::string& str) {
+    PutBytes(out, str.c_str(), str.size() + 1);
+}
+
+static void PutAttribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value) {
+    PutString(out, name);
+    PutString(out, type);
+    Put<int32_t>(out, static_cast<int32_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+static uint16_t FloatToHalf(const float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t absBits = bits & 0x7FFFFFFFu;
+
+    if (absBits >= 0x7F800000u) {
+        // inf / nan
+        return static_cast<uint16_t>(sign | 0x7C00u | (absBits > 0x7F800000u ? 0x200u : 0u));
+    }
+    if (absBits >= 0x477FF000u) {
+        // too big, rounds to inf
+        return static_cast<uint16_t>(sign | 0x7C00u);
+    }
+    if (absBits < 0x38800000u) {
+        // denormal or zero
+        if (absBits < 0x33000000u) {
+            return static_cast<uint16_t>(sign);
+        }
+        const uint32_t exponent = absBits >> 23;
+        const uint32_t mantissa = (absBits & 0x007FFFFFu) | 0x00800000u;
+        const uint32_t shift = 126u - exponent;
+        uint32_t result = mantissa >> shift;
+        // round to nearest even
+        const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        const uint32_t halfway = 1u << (shift - 1u);
+        if (remainder > halfway || (remainder == halfway && (result & 1u))) {
+            ++result;
+        }
+        return static_cast<uint16_t>(sign | result);
+    }
+
+    // normal, rebias exponent and round to nearest even
+    uint32_t result = ((absBits - 0x38000000u) >> 13);
+    const uint32_t remainder = absBits & 0x1FFFu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (result & 1u))) {
+        ++result;
+    }
+    return static_cast<uint16_t>(sign | result);
+}
+
+static size_t PixelTypeSize(const ExrWriter::PixelType type) {
+    return (type == ExrWriter::PixelType::Half) ? 2 : 4;
+}
+
+
+ExrWriter::ExrWriter()
+    : mWidth(0)
+    , mHeight(0)
+{
+}
+
+void ExrWriter::Initialize(const uint32_t width, const uint32_t height) {
+    mWidth = width;
+    mHeight = height;
+    mChannels.clear();
+}
+
+void ExrWriter::ClearChannels() {
+    mChannels.clear();
+}
+
+void ExrWriter::AddChannel(const std::string& name, const float* data, const PixelType type) {
+    Channel channel = { name, (type == PixelType::UInt) ? PixelType::Float : type, data };
+    mChannels.insert(std::upper_bound(mChannels.begin(), mChannels.end(), channel, [](const Channel& a, const Channel& b) {
+        return a.name < b.name;
+    }), channel);
+}
+
+void ExrWriter::AddChannel(const std::string& name, const uint32_t* data) {
+    Channel channel = { name, PixelType::UInt, data };
+    mChannels.insert(std::upper_bound(mChannels.begin(), mChannels.end(), channel, [](const Channel& a, const Channel& b) {
+        return a.name < b.name;
+    }), channel);
+}
+
+size_t ExrWriter::GetScanlineSize() const {
+    size_t size = 0;
+    for (const Channel& channel : mChannels) {
+        size += PixelTypeSize(channel.type) * mWidth;
+    }
+    return size;
+}
+
+void ExrWriter::WriteHeader(std::vector<uint8_t>& out) const {
+    Put<uint32_t>(out, kExrMagic);
+    Put<uint32_t>(out, kExrVersion);
+
+    std::vector<uint8_t> value;
+
+    for (const Channel& channel : mChannels) {
+        PutString(value, channel.name);
+        Put<int32_t>(value, static_cast<int32_t>(channel.type));
+        Put<uint8_t>(value, 0);     // pLinear
+        Put<uint8_t>(value, 0);     // reserved
+        Put<uint8_t>(value, 0);
+        Put<uint8_t>(value, 0);
+        Put<int32_t>(value, 1);     // xSampling
+        Put<int32_t>(value, 1);     // ySampling
+    }
+    Put<uint8_t>(value, 0);
+    PutAttribute(out, "channels", "chlist", value);
+
+    value.clear();
+    Put<uint8_t>(value, kNoCompression);
+    PutAttribute(out, "compression", "compression", value);
+
+    value.clear();
+    Put<int32_t>(value, 0);
+    Put<int32_t>(value, 0);
+    Put<int32_t>(value, static_cast<int32_t>(mWidth) - 1);
+    Put<int32_t>(value, static_cast<int32_t>(mHeight) - 1);
+    PutAttribute(out, "dataWindow", "box2i", value);
+    PutAttribute(out, "displayWindow", "box2i", value);
+
+    value.clear();
+    Put<uint8_t>(value, kIncreasingY);
+    PutAttribute(out, "lineOrder", "lineOrder", value);
+
+    value.clear();
+    Put<float>(value, 1.0f);
+    PutAttribute(out, "pixelAspectRatio", "float", value);
+
+    value.clear();
+    Put<float>(value, 0.0f);
+    Put<float>(value, 0.0f);
+    PutAttribute(out, "screenWindowCenter", "v2f", value);
+
+    value.clear();
+    Put<float>(value, 1.0f);
+    PutAttribute(out, "screenWindowWidth", "float", value);
+
+    Put<uint8_t>(out, 0);   // end of header
+}
+
+size_t ExrWriter::GetFileSize() const {
+    std::vector<uint8_t> header;
+    this->WriteHeader(header);
+    return header.size() + mHeight * sizeof(uint64_t) + mHeight * (2 * sizeof(int32_t) + this->GetScanlineSize());
+}
+
+bool ExrWriter::Save(const std::string& fileName) const {
+    if (!mWidth || !mHeight || mChannels.empty()) {
+        return false;
+    }
+
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    std::vector<uint8_t> buffer;
+    this->WriteHeader(buffer);
+
+    // offsets table, every scanline is its own chunk
+    const size_t scanlineSize = this->GetScanlineSize();
+    const size_t chunkSize = 2 * sizeof(int32_t) + scanlineSize;
+    const uint64_t firstChunk = buffer.size() + mHeight * sizeof(uint64_t);
+    for (uint32_t y = 0; y < mHeight; ++y) {
+        Put<uint64_t>(buffer, firstChunk + y * chunkSize);
+    }
+
+    bool ok = (fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size());
+
+    // within a scanline data is stored channel by channel
+    std::vector<uint8_t> chunk(chunkSize);
+    for (uint32_t y = 0; ok && y < mHeight; ++y) {
+        uint8_t* dst = chunk.data();
+
+        const int32_t lineY = static_cast<int32_t>(y);
+        const int32_t dataSize = static_cast<int32_t>(scanlineSize);
+        memcpy(dst, &lineY, sizeof(lineY));
+        memcpy(dst + sizeof(lineY), &dataSize, sizeof(dataSize));
+        dst += 2 * sizeof(int32_t);
+
+        const size_t rowOffset = static_cast<size_t>(y) * mWidth;
+        for (const Channel& channel : mChannels) {
+            if (channel.type == PixelType::Half) {
+                const float* src = reinterpret_cast<const float*>(channel.data) + rowOffset;
+                for (uint32_t x = 0; x < mWidth; ++x, dst += sizeof(uint16_t)) {
+                    const uint16_t h = FloatToHalf(src[x]);
+                    memcpy(dst, &h, sizeof(h));
+                }
+            } else {
+                const uint8_t* src = reinterpret_cast<const uint8_t*>(channel.data) + rowOffset * 4;
+                memcpy(dst, src, mWidth * 4);
+                dst += mWidth * 4;
+            }
+        }
+
+        ok = (fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size());
+    }
+
+    fclose(file);
+    return ok;
+}
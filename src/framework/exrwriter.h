@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Minimal OpenEXR writer: single part, scanline, no compression.
+// Enough to dump the beauty image together with all the AOVs as named channels of a single file,
+// which every compositing package (Nuke, Blender, OIIO, ...) understands.
+class ExrWriter {
+public:
+    enum class PixelType : uint32_t {
+        UInt = 0,
+        Half = 1,
+        Float = 2
+    };
+
+    ExrWriter();
+    ~ExrWriter() = default;
+
+    void        Initialize(const uint32_t width, const uint32_t height);
+    void        ClearChannels();
+
+    // data is width * height tightly packed values and must stay alive until Save()
+    // float channels can be stored as Half (converted on save) or Float
+    void        AddChannel(const std::string& name, const float* data, const PixelType type = PixelType::Half);
+    void        AddChannel(const std::string& name, const uint32_t* data);
+
+    bool        Save(const std::string& fileName) const;
+
+    // size of the file Save() will produce, in bytes
+    size_t      GetFileSize() const;
+
+private:
+    struct Channel {
+        std::string     name;
+        PixelType       type;
+        const void*     data;
+    };
+
+    size_t      GetScanlineSize() const;
+    void        WriteHeader(std::vector<uint8_t>& out) const;
+
+private:
+    uint32_t                mWidth;
+    uint32_t                mHeight;
+    std::vector<Channel>    mChannels;  // kept sorted by name, as EXR requires
+};
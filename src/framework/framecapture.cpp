@@ -0,0 +1,198 @@
+#include "framecapture.h"
+#include "batchrender.h"
+#include "profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// frames can be queued this deep before the render loop waits for the disk
+static const size_t sImageWriterThreads = 2;
+static const size_t sImageWriterQueueSize = 4;
+
+static void CreateFolder(const std::string& path) {
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+}
+
+FrameCapture::FrameCapture()
+    : mFormat(ImageWriter::Format::Exr)
+    , mWidth(0)
+    , mHeight(0)
+    , mBgra(false)
+    , mPool(nullptr)
+    , mInitialized(false)
+    , mNumCaptured(0)
+{
+}
+
+void FrameCapture::Initialize(const std::string& folder, const std::string& format, const uint32_t width,
+                              const uint32_t height, const bool bgra, ThreadPool* pool) {
+    mFolder = folder;
+    mWidth = width;
+    mHeight = height;
+    mBgra = bgra;
+    mPool = pool;
+    CreateFolder(folder);
+
+    bool ok;
+    mFormat = ImageWriter::ParseFormat(format, ok);
+    if (!ok) {
+        printf("Unknown output format \"%s\", writing exr\n", format.c_str());
+    }
+
+    if (!mInitialized) {
+        mImageWriter.Initialize(sImageWriterThreads, sImageWriterQueueSize);
+        mInitialized = true;
+    }
+}
+
+void FrameCapture::Shutdown() {
+    mImageWriter.Shutdown();
+    mInitialized = false;
+}
+
+void FrameCapture::WaitIdle() {
+    if (mInitialized) {
+        mImageWriter.WaitIdle();
+        this->PrintStats();
+    }
+}
+
+bool FrameCapture::IsInitialized() const {
+    return mInitialized;
+}
+
+ImageWriter::Format FrameCapture::GetFormat() const {
+    return mFormat;
+}
+
+uint32_t FrameCapture::GetNumCaptured() const {
+    return mNumCaptured;
+}
+
+ImageWriter::Frame* FrameCapture::Capture(const FrameReadback::Frame& frame, const uint32_t outputIndex, const bool denoised) {
+    PROFILE_ZONE("CaptureFrame");
+    const size_t width = mWidth;
+    const size_t numPixels = width * mHeight;
+
+    ImageWriter::Frame* out = mImageWriter.AcquireFrame();
+    out->format = mFormat;
+    out->width = mWidth;
+    out->height = mHeight;
+    out->bgra = mBgra;
+    out->fileName = mFolder + BatchRender::GetFrameFileName(outputIndex, ImageWriter::GetExtension(mFormat));
+    ++mNumCaptured;
+
+    const bool ldr = (mFormat != ImageWriter::Format::Exr);
+    out->color.resize(numPixels * 4);
+    if (!ldr || !denoised) {
+        memcpy(out->color.data(), frame.color.Map(), out->color.size());
+        frame.color.Unmap();
+    }
+
+    if (!ldr) {
+        // AOVs are decoded straight from the readback mapping into the pooled frame's channels
+        const void* aovs[SWS_NUM_AOVS] = {};
+        for (uint32_t i = 0; i < SWS_NUM_AOVS; ++i) {
+            if (frame.aovMask & (1u << i)) {
+                aovs[i] = frame.aovs[i].Map();
+            }
+        }
+        const uint8_t* albedo = reinterpret_cast<const uint8_t*>(aovs[SWS_AOV_ALBEDO_BINDING - SWS_AOV_FIRST_BINDING]);
+        const float* depth = reinterpret_cast<const float*>(aovs[SWS_AOV_DEPTH_BINDING - SWS_AOV_FIRST_BINDING]);
+        const int16_t* normal = reinterpret_cast<const int16_t*>(aovs[SWS_AOV_NORMAL_BINDING - SWS_AOV_FIRST_BINDING]);
+        const uint32_t* instanceId = reinterpret_cast<const uint32_t*>(aovs[SWS_AOV_INSTANCE_ID_BINDING - SWS_AOV_FIRST_BINDING]);
+        const uint32_t* primitiveId = reinterpret_cast<const uint32_t*>(aovs[SWS_AOV_PRIMITIVE_ID_BINDING - SWS_AOV_FIRST_BINDING]);
+
+        float* planes[7] = {};
+        if (albedo) {
+            planes[0] = out->AddFloatChannel("albedo.R").data.data();
+            planes[1] = out->AddFloatChannel("albedo.G").data.data();
+            planes[2] = out->AddFloatChannel("albedo.B").data.data();
+        }
+        if (normal) {
+            planes[3] = out->AddFloatChannel("N.X").data.data();
+            planes[4] = out->AddFloatChannel("N.Y").data.data();
+            planes[5] = out->AddFloatChannel("N.Z").data.data();
+        }
+        if (depth) {
+            planes[6] = out->AddFloatChannel("Z", ExrWriter::PixelType::Float).data.data();
+        }
+
+        mPool->ParallelFor(mHeight, 16, [&](const size_t rowBegin, const size_t rowEnd) {
+            const float toFloat = 1.0f / 255.0f;
+            for (size_t i = rowBegin * width, end = rowEnd * width; i < end; ++i) {
+                if (albedo) {
+                    const uint8_t* a = albedo + i * 4;
+                    planes[0][i] = static_cast<float>(a[0]) * toFloat;
+                    planes[1][i] = static_cast<float>(a[1]) * toFloat;
+                    planes[2][i] = static_cast<float>(a[2]) * toFloat;
+                }
+                if (normal) {
+                    const vec3 n = FrameReadback::OctDecode(normal + i * 2);
+                    planes[3][i] = n.x;
+                    planes[4][i] = n.y;
+                    planes[5][i] = n.z;
+                }
+                if (depth) {
+                    planes[6][i] = depth[i];
+                }
+            }
+        });
+
+        if (instanceId) {
+            std::vector<uint32_t>& data = out->AddUIntChannel("instanceId").data;
+            memcpy(data.data(), instanceId, numPixels * sizeof(uint32_t));
+        }
+        if (primitiveId) {
+            std::vector<uint32_t>& data = out->AddUIntChannel("primitiveId").data;
+            memcpy(data.data(), primitiveId, numPixels * sizeof(uint32_t));
+        }
+
+        for (uint32_t i = 0; i < SWS_NUM_AOVS; ++i) {
+            if (aovs[i]) {
+                frame.aovs[i].Unmap();
+            }
+        }
+    }
+
+    if ((mNumCaptured % 60) == 0) {
+        this->PrintStats();
+    }
+    return out;
+}
+
+void FrameCapture::AddDenoised(ImageWriter::Frame* capture, const Denoiser& denoiser, const FrameReadback& readback) {
+    if (capture->format == ImageWriter::Format::Exr) {
+        const size_t numPixels = static_cast<size_t>(mWidth) * mHeight;
+        memcpy(capture->AddFloatChannel("denoised.R").data.data(), denoiser.GetOutputR(), numPixels * sizeof(float));
+        memcpy(capture->AddFloatChannel("denoised.G").data.data(), denoiser.GetOutputG(), numPixels * sizeof(float));
+        memcpy(capture->AddFloatChannel("denoised.B").data.data(), denoiser.GetOutputB(), numPixels * sizeof(float));
+    } else {
+        // 8 bit formats only have room for one image, make it the denoised one
+        readback.DenoisedToTexels(denoiser, capture->color.data());
+    }
+}
+
+void FrameCapture::Submit(ImageWriter::Frame* capture) {
+    mImageWriter.Submit(capture);
+}
+
+void FrameCapture::PrintStats() const {
+    const ImageWriter::Stats stats = mImageWriter.GetStats();
+    printf("Capture: %llu frames written (%llu failed), %.2f frames/s, %.1f MB/s, stalled %llu times for %.2f s\n",
+           static_cast<unsigned long long>(stats.numFrames),
+           static_cast<unsigned long long>(stats.numFailed),
+           stats.framesPerSecond,
+           stats.megabytesPerSecond,
+           static_cast<unsigned long long>(stats.numStalls),
+           stats.stallSeconds);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "framereadback.h"
+#include "imagewriter.h"
+
+#include <string>
+#include <cstdint>
+
+// Dumps read back frames to disk through the ImageWriter: a multi-channel EXR (beauty, the AOVs read back and the
+// denoised color) or an sRGB PNG/PPM, which only has room for one image - the denoised one when the denoiser is on.
+// The render thread starts a capture from a frame's readback, the denoiser's thread may add its output to it,
+// whoever finishes it submits it to the writer.
+class FrameCapture {
+public:
+    FrameCapture();
+    ~FrameCapture() = default;
+
+    // creates the folder, the writer starts the first time. An unknown format writes exr
+    void                Initialize(const std::string& folder, const std::string& format, const uint32_t width,
+                                   const uint32_t height, const bool bgra, ThreadPool* pool);
+    void                Shutdown();     // writes whatever is queued first
+    void                WaitIdle();     // and prints the stats
+    bool                IsInitialized() const;
+    ImageWriter::Format GetFormat() const;
+    uint32_t            GetNumCaptured() const;
+
+    // a frame to write the readback into, named after outputIndex. denoised - an 8 bit format gets its color
+    // from AddDenoised() instead. Blocks only when every pooled frame is still waiting for the disk
+    ImageWriter::Frame* Capture(const FrameReadback::Frame& frame, const uint32_t outputIndex, const bool denoised);
+    // on the denoiser's thread
+    void                AddDenoised(ImageWriter::Frame* capture, const Denoiser& denoiser, const FrameReadback& readback);
+    // encoding and file IO happen on the writer's threads
+    void                Submit(ImageWriter::Frame* capture);
+    void                PrintStats() const;
+
+private:
+    ImageWriter         mImageWriter;
+    ImageWriter::Format mFormat;
+    std::string         mFolder;
+    uint32_t            mWidth;
+    uint32_t            mHeight;
+    bool                mBgra;
+    ThreadPool*         mPool;
+    bool                mInitialized;
+    uint32_t            mNumCaptured;
+};
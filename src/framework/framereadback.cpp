@@ -0,0 +1,249 @@
+#include "framereadback.h"
+#include "memorytracker.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <cstring>
+#include <string>
+
+FrameReadback::FrameReadback()
+    : mWidth(0)
+    , mHeight(0)
+    , mBgra(false)
+    , mPool(nullptr)
+    , mDenoisedVersion(0)
+{
+}
+
+void FrameReadback::Initialize(const uint32_t width, const uint32_t height, const bool bgra, ThreadPool* pool) {
+    mWidth = width;
+    mHeight = height;
+    mBgra = bgra;
+    mPool = pool;
+}
+
+void FrameReadback::Create(const size_t numFrames) {
+    // every AOV format we use is 4 bytes per texel, same as the beauty image
+    const VkDeviceSize imageSize = static_cast<VkDeviceSize>(mWidth) * mHeight * 4;
+    const VkDeviceSize radianceSize = imageSize * sizeof(float);
+    const VkMemoryPropertyFlags hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    mFrames.resize(numFrames);
+    for (size_t i = 0; i < mFrames.size(); ++i) {
+        Frame& frame = mFrames[i];
+        MemoryTracker::Scope memoryScope(MemoryCategory::Readback, "frame in flight " + std::to_string(i));
+
+        VkResult error = frame.color.Create(imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostMemory);
+        CHECK_VK_ERROR(error, "frame.color.Create");
+        for (vulkanhelpers::Buffer& aov : frame.aovs) {
+            error = aov.Create(imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostMemory);
+            CHECK_VK_ERROR(error, "frame.aov.Create");
+        }
+        error = frame.radiance.Create(radianceSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostMemory);
+        CHECK_VK_ERROR(error, "frame.radiance.Create");
+        error = frame.upload.Create(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, hostMemory);
+        CHECK_VK_ERROR(error, "frame.upload.Create");
+
+        // until the first denoised frame is ready we show black
+        void* mem = frame.upload.Map();
+        memset(mem, 0, static_cast<size_t>(frame.upload.GetSize()));
+        frame.upload.Unmap();
+
+        frame.aovMask = 0;
+        frame.hasData = false;
+        frame.isFinalSample = false;
+        frame.frameIndex = 0;
+        frame.passIndex = 0;
+        frame.uploadVersion = 0;
+    }
+}
+
+void FrameReadback::Destroy() {
+    mFrames.clear();
+}
+
+bool FrameReadback::IsEmpty() const {
+    return mFrames.empty();
+}
+
+size_t FrameReadback::GetNumFrames() const {
+    return mFrames.size();
+}
+
+FrameReadback::Frame& FrameReadback::GetFrame(const size_t index) {
+    return mFrames[index];
+}
+
+void FrameReadback::RecordCopies(VkCommandBuffer commandBuffer, const size_t index, const vulkanhelpers::Image& offscreen,
+                                 const vulkanhelpers::Image& radiance, const vulkanhelpers::Image* aovs,
+                                 const uint32_t aovMask, const bool denoise) {
+    Frame& frame = mFrames[index];
+    frame.aovMask = aovMask;
+
+    VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    copyRegion.imageExtent = { mWidth, mHeight, 1 };
+
+    // read back the raw frame and its AOVs
+    vulkanhelpers::ImageBarrier(commandBuffer,
+                                offscreen.GetImage(),
+                                subresourceRange,
+                                VK_ACCESS_SHADER_WRITE_BIT,
+                                VK_ACCESS_TRANSFER_READ_BIT,
+                                VK_IMAGE_LAYOUT_GENERAL,
+                                VK_IMAGE_LAYOUT_GENERAL);
+    vkCmdCopyImageToBuffer(commandBuffer, offscreen.GetImage(), VK_IMAGE_LAYOUT_GENERAL, frame.color.GetBuffer(), 1, &copyRegion);
+
+    for (uint32_t i = 0; i < SWS_NUM_AOVS; ++i) {
+        if (!(aovMask & (1u << i))) {
+            continue;
+        }
+
+        vulkanhelpers::ImageBarrier(commandBuffer,
+                                    aovs[i].GetImage(),
+                                    subresourceRange,
+                                    VK_ACCESS_SHADER_WRITE_BIT,
+                                    VK_ACCESS_TRANSFER_READ_BIT,
+                                    VK_IMAGE_LAYOUT_GENERAL,
+                                    VK_IMAGE_LAYOUT_GENERAL);
+        vkCmdCopyImageToBuffer(commandBuffer, aovs[i].GetImage(), VK_IMAGE_LAYOUT_GENERAL, frame.aovs[i].GetBuffer(), 1, &copyRegion);
+    }
+
+    if (denoise) {
+        // the denoiser filters the float radiance, the 8 bit frame is clamped
+        vulkanhelpers::ImageBarrier(commandBuffer,
+                                    radiance.GetImage(),
+                                    subresourceRange,
+                                    VK_ACCESS_SHADER_WRITE_BIT,
+                                    VK_ACCESS_TRANSFER_READ_BIT,
+                                    VK_IMAGE_LAYOUT_GENERAL,
+                                    VK_IMAGE_LAYOUT_GENERAL);
+        vkCmdCopyImageToBuffer(commandBuffer, radiance.GetImage(), VK_IMAGE_LAYOUT_GENERAL, frame.radiance.GetBuffer(), 1, &copyRegion);
+
+        // and replace it with the latest denoised one
+        vulkanhelpers::ImageBarrier(commandBuffer,
+                                    offscreen.GetImage(),
+                                    subresourceRange,
+                                    VK_ACCESS_TRANSFER_READ_BIT,
+                                    VK_ACCESS_TRANSFER_WRITE_BIT,
+                                    VK_IMAGE_LAYOUT_GENERAL,
+                                    VK_IMAGE_LAYOUT_GENERAL);
+        vkCmdCopyBufferToImage(commandBuffer, frame.upload.GetBuffer(), offscreen.GetImage(), VK_IMAGE_LAYOUT_GENERAL, 1, &copyRegion);
+    }
+
+    vulkanhelpers::ImageBarrier(commandBuffer,
+                                offscreen.GetImage(),
+                                subresourceRange,
+                                VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                                VK_ACCESS_TRANSFER_READ_BIT,
+                                VK_IMAGE_LAYOUT_GENERAL,
+                                VK_IMAGE_LAYOUT_GENERAL);
+
+    VkMemoryBarrier hostBarrier = {};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+}
+
+void FrameReadback::Prepare(const size_t index, const bool isFinalSample, const uint32_t frameIndex, const uint32_t passIndex) {
+    Frame& frame = mFrames[index];
+    frame.hasData = true;
+    frame.isFinalSample = isFinalSample;
+    frame.frameIndex = frameIndex;
+    frame.passIndex = passIndex;
+}
+
+void FrameReadback::FillDenoiserInput(const Frame& frame, Denoiser::GBuffer& input) const {
+    PROFILE_ZONE("FillDenoiserInput");
+    const size_t width = mWidth;
+    const float* radiance = reinterpret_cast<const float*>(frame.radiance.Map());
+    const uint8_t* albedo = reinterpret_cast<const uint8_t*>(frame.aovs[SWS_AOV_ALBEDO_BINDING - SWS_AOV_FIRST_BINDING].Map());
+    const float* depth = reinterpret_cast<const float*>(frame.aovs[SWS_AOV_DEPTH_BINDING - SWS_AOV_FIRST_BINDING].Map());
+    const int16_t* normal = reinterpret_cast<const int16_t*>(frame.aovs[SWS_AOV_NORMAL_BINDING - SWS_AOV_FIRST_BINDING].Map());
+    const uint32_t* meshId = reinterpret_cast<const uint32_t*>(frame.aovs[SWS_AOV_INSTANCE_ID_BINDING - SWS_AOV_FIRST_BINDING].Map());
+
+    mPool->ParallelFor(mHeight, 16, [&](const size_t rowBegin, const size_t rowEnd) {
+        const float toFloat = 1.0f / 255.0f;
+        for (size_t i = rowBegin * width, end = rowEnd * width; i < end; ++i) {
+            // rgba32f, unlike the result image it's not in the surface's channel order
+            const float* c = radiance + i * 4;
+            input.colorR[i] = c[0];
+            input.colorG[i] = c[1];
+            input.colorB[i] = c[2];
+
+            const uint8_t* a = albedo + i * 4;
+            input.albedoR[i] = static_cast<float>(a[0]) * toFloat;
+            input.albedoG[i] = static_cast<float>(a[1]) * toFloat;
+            input.albedoB[i] = static_cast<float>(a[2]) * toFloat;
+
+            const vec3 n = OctDecode(normal + i * 2);
+            input.normalX[i] = n.x;
+            input.normalY[i] = n.y;
+            input.normalZ[i] = n.z;
+            input.depth[i] = depth[i];
+            input.meshId[i] = meshId[i];
+        }
+    });
+
+    frame.aovs[SWS_AOV_INSTANCE_ID_BINDING - SWS_AOV_FIRST_BINDING].Unmap();
+    frame.aovs[SWS_AOV_NORMAL_BINDING - SWS_AOV_FIRST_BINDING].Unmap();
+    frame.aovs[SWS_AOV_DEPTH_BINDING - SWS_AOV_FIRST_BINDING].Unmap();
+    frame.aovs[SWS_AOV_ALBEDO_BINDING - SWS_AOV_FIRST_BINDING].Unmap();
+    frame.radiance.Unmap();
+}
+
+void FrameReadback::PublishDenoised(const Denoiser& denoiser) {
+    PROFILE_ZONE("PublishDenoised");
+    std::lock_guard<std::mutex> lock(mDenoisedMutex);
+    mDenoisedImage.resize(static_cast<size_t>(mWidth) * mHeight * 4);
+    this->DenoisedToTexels(denoiser, mDenoisedImage.data());
+    ++mDenoisedVersion;
+}
+
+void FrameReadback::DenoisedToTexels(const Denoiser& denoiser, uint8_t* dst) const {
+    const size_t width = mWidth;
+    const size_t rIdx = mBgra ? 2 : 0;
+    const size_t bIdx = mBgra ? 0 : 2;
+    const float* outR = denoiser.GetOutputR();
+    const float* outG = denoiser.GetOutputG();
+    const float* outB = denoiser.GetOutputB();
+
+    mPool->ParallelFor(mHeight, 16, [&](const size_t rowBegin, const size_t rowEnd) {
+        for (size_t i = rowBegin * width, end = rowEnd * width; i < end; ++i) {
+            uint8_t* c = dst + i * 4;
+            c[rIdx] = static_cast<uint8_t>(Clamp(outR[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+            c[1] = static_cast<uint8_t>(Clamp(outG[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+            c[bIdx] = static_cast<uint8_t>(Clamp(outB[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+            c[3] = 255;
+        }
+    });
+}
+
+void FrameReadback::UploadDenoised(Frame& frame) {
+    PROFILE_ZONE("UploadDenoised");
+    std::lock_guard<std::mutex> lock(mDenoisedMutex);
+    if (frame.uploadVersion == mDenoisedVersion) {
+        return;
+    }
+    memcpy(frame.upload.Map(), mDenoisedImage.data(), mDenoisedImage.size());
+    frame.upload.Unmap();
+    frame.uploadVersion = mDenoisedVersion;
+}
+
+vec3 FrameReadback::OctDecode(const int16_t* e) {
+    vec3 n(Max(static_cast<float>(e[0]) / 32767.0f, -1.0f), Max(static_cast<float>(e[1]) / 32767.0f, -1.0f), 0.0f);
+    n.z = 1.0f - std::abs(n.x) - std::abs(n.y);
+    if (n.z < 0.0f) {
+        const float x = n.x;
+        n.x = (1.0f - std::abs(n.y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        n.y = (1.0f - std::abs(x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    const float len = Length(n);
+    return (len > 0.0f) ? n / len : n;
+}
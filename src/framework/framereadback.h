@@ -0,0 +1,75 @@
+#pragma once
+
+#include "vulkanhelpers.h"
+#include "denoiser.h"
+#include "threadpool.h"
+#include "common.h"
+#include "shared.h"
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+// Host copies of what the frames in flight rendered, one set of buffers per frame in flight: the beauty image and
+// the AOVs asked for are copied back after the trace (and the float radiance for the denoiser), the latest denoised
+// result goes back into the offscreen image before it's copied to the swapchain.
+// The render thread records the copies and reads a frame's buffers once its slot comes around again. The denoised
+// image is published from the denoiser's thread and outlives Destroy(), so toggling the readback keeps showing it.
+class FrameReadback {
+public:
+    struct Frame {
+        vulkanhelpers::Buffer   color;
+        vulkanhelpers::Buffer   radiance;       // float rgba, what the denoiser filters (denoiser on only)
+        vulkanhelpers::Buffer   aovs[SWS_NUM_AOVS];
+        vulkanhelpers::Buffer   upload;
+        uint64_t                uploadVersion;  // the denoised image upload holds
+        uint32_t                aovMask;        // AOVs the command buffer copies
+        bool                    hasData;
+        bool                    isFinalSample;  // last accumulated pass of a headless frame, always true when presenting
+        uint32_t                frameIndex;     // headless output frame the readback belongs to
+        uint32_t                passIndex;      // and how many passes it had accumulated before this one
+    };
+
+    FrameReadback();
+    ~FrameReadback() = default;
+
+    // bgra - the offscreen image's channel order, pool splits the per pixel work
+    void            Initialize(const uint32_t width, const uint32_t height, const bool bgra, ThreadPool* pool);
+    void            Create(const size_t numFrames);
+    void            Destroy();          // the frames only, the GPU has to be done with them
+    bool            IsEmpty() const;
+    size_t          GetNumFrames() const;
+    Frame&          GetFrame(const size_t index);
+
+    // the copies after the trace into frame index's buffers: the offscreen image and aovMask's AOVs, with denoise
+    // the radiance too, then the denoised image the frame got last into the offscreen image
+    void            RecordCopies(VkCommandBuffer commandBuffer, const size_t index, const vulkanhelpers::Image& offscreen,
+                                 const vulkanhelpers::Image& radiance, const vulkanhelpers::Image* aovs,
+                                 const uint32_t aovMask, const bool denoise);
+    // the frame's command buffer is about to fill its buffers, what they held has been consumed
+    void            Prepare(const size_t index, const bool isFinalSample, const uint32_t frameIndex, const uint32_t passIndex);
+
+    // the denoiser's input from a frame's radiance & AOVs
+    void            FillDenoiserInput(const Frame& frame, Denoiser::GBuffer& input) const;
+    // on the denoiser's thread: its output as the offscreen image's texels, for the frames' upload buffers
+    void            PublishDenoised(const Denoiser& denoiser);
+    // the denoiser's output as 8 bit texels in the offscreen image's channel order
+    void            DenoisedToTexels(const Denoiser& denoiser, uint8_t* dst) const;
+    // into the frame's upload buffer, when it doesn't hold the latest already
+    void            UploadDenoised(Frame& frame);
+
+    // inverse of OctEncode in ray_gen.glsl, e points to two snorm16 values
+    static vec3     OctDecode(const int16_t* e);
+
+private:
+    uint32_t            mWidth;
+    uint32_t            mHeight;
+    bool                mBgra;
+    ThreadPool*         mPool;
+    std::vector<Frame>  mFrames;
+
+    std::mutex          mDenoisedMutex;
+    std::vector<uint8_t> mDenoisedImage;    // guarded, the latest result as the offscreen image's texels
+    uint64_t            mDenoisedVersion;   // guarded, 0 until the first one
+};
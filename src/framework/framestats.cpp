@@ -0,0 +1,77 @@
+#include "framestats.h"
+
+#include <algorithm>
+#include <cmath>
+
+const size_t FrameStats::kCapacity;
+
+FrameStats::FrameStats()
+    : mHead(0) {
+}
+
+void FrameStats::Reset() {
+    mHead.store(0, std::memory_order_release);
+}
+
+void FrameStats::AddFrame(const Sample& sample) {
+    const uint64_t head = mHead.load(std::memory_order_relaxed);
+    mSamples[head & (kCapacity - 1)] = sample;
+    mHead.store(head + 1, std::memory_order_release);
+}
+
+void FrameStats::Summarize(Summary& out, const size_t window) const {
+    const uint64_t head = mHead.load(std::memory_order_acquire);
+    const uint64_t count = std::min<uint64_t>(head, (window < kCapacity) ? window : kCapacity);
+    const uint64_t first = head - count;
+
+    std::vector<Sample> samples;
+    samples.reserve(static_cast<size_t>(count));
+    for (uint64_t i = first; i < head; ++i) {
+        samples.push_back(mSamples[i & (kCapacity - 1)]);
+    }
+
+    // whatever the producer got to meanwhile (or is writing right now) can't be trusted
+    const uint64_t newHead = mHead.load(std::memory_order_acquire);
+    const uint64_t valid = (newHead + 1 > kCapacity) ? (newHead + 1 - kCapacity) : 0;
+    if (valid > first) {
+        const size_t numDropped = static_cast<size_t>(std::min<uint64_t>(valid - first, samples.size()));
+        samples.erase(samples.begin(), samples.begin() + numDropped);
+    }
+
+    std::vector<float> frame, cpu, gpu;
+    frame.reserve(samples.size());
+    cpu.reserve(samples.size());
+    gpu.reserve(samples.size());
+    for (const Sample& sample : samples) {
+        frame.push_back(sample.frameMs);
+        cpu.push_back(sample.cpuMs);
+        if (sample.gpuMs >= 0.0f) {
+            gpu.push_back(sample.gpuMs);
+        }
+    }
+
+    out.frame = ComputePercentiles(frame);
+    out.cpu = ComputePercentiles(cpu);
+    out.gpu = ComputePercentiles(gpu);
+}
+
+FrameStats::Percentiles FrameStats::ComputePercentiles(std::vector<float>& values) {
+    Percentiles result = { 0.0f, 0.0f, 0.0f, values.size() };
+    if (values.empty()) {
+        return result;
+    }
+
+    // increasing ranks, every nth_element only has to look at what's past the previous one
+    const double fractions[3] = { 0.50, 0.95, 0.99 };
+    float* outputs[3] = { &result.p50, &result.p95, &result.p99 };
+    std::vector<float>::iterator begin = values.begin();
+    for (int i = 0; i < 3; ++i) {
+        const double rank = std::ceil(fractions[i] * static_cast<double>(values.size()));
+        const size_t index = std::min(values.size() - 1, static_cast<size_t>(std::max(rank, 1.0)) - 1);
+        std::vector<float>::iterator nth = values.begin() + index;
+        std::nth_element(begin, nth, values.end());
+        *outputs[i] = *nth;
+        begin = nth;
+    }
+    return result;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Rolling frame times for the performance overlay: the last frames in a ring of kCapacity, percentiles on demand.
+// One thread adds frames, any thread may summarize meanwhile - no locks, a summary simply skips the samples
+// overwritten while it was copying them (and the oldest one, which the producer may be overwriting).
+// The app only feeds it while the overlay is shown.
+class FrameStats {
+public:
+    static const size_t kCapacity = 512;    // frames, power of two
+
+    struct Sample {
+        float   frameMs;    // wall time since the previous frame
+        float   cpuMs;      // CPU time spent setting the frame up and submitting it
+        float   gpuMs;      // GPU time of the frame's command buffers, < 0 if unknown
+    };
+
+    struct Percentiles {
+        float   p50;
+        float   p95;
+        float   p99;
+        size_t  count;      // samples they were computed from, all zeros when 0
+    };
+
+    struct Summary {
+        Percentiles frame;
+        Percentiles cpu;
+        Percentiles gpu;
+    };
+
+    FrameStats();
+    ~FrameStats() = default;
+
+    void    Reset();
+    void    AddFrame(const Sample& sample);
+    // over the last window frames at most
+    void    Summarize(Summary& out, const size_t window = kCapacity) const;
+
+    // nearest rank, reorders values
+    static Percentiles ComputePercentiles(std::vector<float>& values);
+
+private:
+    Sample                  mSamples[kCapacity];
+    std::atomic<uint64_t>   mHead;      // samples ever added
+};
@@ -0,0 +1,191 @@
+#include "gpuprofiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+static const uint32_t kInvalidZone = ~0u;
+
+GpuProfiler::GpuProfiler()
+    : mDevice(VK_NULL_HANDLE)
+    , mQueryPool(VK_NULL_HANDLE)
+    , mMaxZonesPerSlot(0)
+    , mTimestampPeriod(1.0)
+    , mTimestampMask(0)
+    , mLastEndTicks(0)
+    , mTrack(nullptr) {
+}
+
+GpuProfiler::~GpuProfiler() {
+    this->Destroy();
+}
+
+bool GpuProfiler::Initialize(VkPhysicalDevice physicalDevice, VkDevice device, const uint32_t queueFamilyIndex,
+                             const size_t numSlots, const uint32_t maxZonesPerSlot) {
+    this->Destroy();
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+
+    uint32_t numQueueFamilies = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &numQueueFamilies, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(numQueueFamilies);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &numQueueFamilies, queueFamilies.data());
+
+    const uint32_t validBits = (queueFamilyIndex < numQueueFamilies) ? queueFamilies[queueFamilyIndex].timestampValidBits : 0;
+    if (!validBits || props.limits.timestampPeriod <= 0.0f) {
+        printf("GPU profiler: queue family %u has no timestamps, GPU zones disabled\n", queueFamilyIndex);
+        return false;
+    }
+
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = static_cast<uint32_t>(numSlots) * maxZonesPerSlot * 2;
+
+    const VkResult error = vkCreateQueryPool(device, &queryPoolInfo, nullptr, &mQueryPool);
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "vkCreateQueryPool");
+        mQueryPool = VK_NULL_HANDLE;
+        return false;
+    }
+
+    mDevice = device;
+    mMaxZonesPerSlot = maxZonesPerSlot;
+    mTimestampPeriod = static_cast<double>(props.limits.timestampPeriod);
+    mTimestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+    mSlots.assign(numSlots, Slot());
+    mResults.resize(maxZonesPerSlot * 2);
+    mLastEndTicks = 0;
+    if (!mTrack) {
+        mTrack = profiler::CreateTrack("GPU");
+    }
+    return true;
+}
+
+void GpuProfiler::Destroy() {
+    if (mQueryPool) {
+        vkDestroyQueryPool(mDevice, mQueryPool, nullptr);
+        mQueryPool = VK_NULL_HANDLE;
+    }
+    mSlots.clear();
+}
+
+bool GpuProfiler::IsEnabled() const {
+    return mQueryPool != VK_NULL_HANDLE;
+}
+
+void GpuProfiler::BeginCommandBuffer(VkCommandBuffer commandBuffer, const size_t slot) {
+    if (!mQueryPool || slot >= mSlots.size()) {
+        return;
+    }
+
+    Slot& s = mSlots[slot];
+    s.zones.clear();
+    s.depth = 0;
+    s.submitted = false;
+    vkCmdResetQueryPool(commandBuffer, mQueryPool, static_cast<uint32_t>(slot) * mMaxZonesPerSlot * 2, mMaxZonesPerSlot * 2);
+}
+
+uint32_t GpuProfiler::BeginZone(VkCommandBuffer commandBuffer, const size_t slot, const char* name) {
+    if (!mQueryPool || slot >= mSlots.size() || mSlots[slot].zones.size() >= mMaxZonesPerSlot) {
+        return kInvalidZone;
+    }
+
+    Slot& s = mSlots[slot];
+    const uint32_t zone = static_cast<uint32_t>(s.zones.size());
+    SlotZone slotZone = { name, s.depth++, false };
+    s.zones.push_back(slotZone);
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool,
+                        (static_cast<uint32_t>(slot) * mMaxZonesPerSlot + zone) * 2);
+    return zone;
+}
+
+void GpuProfiler::EndZone(VkCommandBuffer commandBuffer, const size_t slot, const uint32_t zone) {
+    if (kInvalidZone == zone) {
+        return;
+    }
+
+    Slot& s = mSlots[slot];
+    s.zones[zone].closed = true;
+    --s.depth;
+
+    // bottom of pipe: after everything recorded before has finished
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool,
+                        (static_cast<uint32_t>(slot) * mMaxZonesPerSlot + zone) * 2 + 1);
+}
+
+void GpuProfiler::MarkSubmit(const size_t slot) {
+    if (!mQueryPool || slot >= mSlots.size()) {
+        return;
+    }
+    mSlots[slot].submitTicks = profiler::Ticks();
+    mSlots[slot].submitted = true;
+}
+
+double GpuProfiler::Resolve(const size_t slot) {
+    if (!mQueryPool || slot >= mSlots.size() || !mSlots[slot].submitted) {
+        return -1.0;
+    }
+
+    Slot& s = mSlots[slot];
+    s.submitted = false;
+
+    const uint32_t numQueries = static_cast<uint32_t>(s.zones.size()) * 2;
+    if (!numQueries) {
+        return -1.0;
+    }
+
+    // the fence is signalled, no need to wait - not ready means the queries were never written
+    const VkResult error = vkGetQueryPoolResults(mDevice, mQueryPool, static_cast<uint32_t>(slot) * mMaxZonesPerSlot * 2, numQueries,
+                                                 numQueries * sizeof(uint64_t), mResults.data(), sizeof(uint64_t),
+                                                 VK_QUERY_RESULT_64_BIT);
+    if (VK_SUCCESS != error) {
+        return -1.0;
+    }
+
+    uint64_t gpuBase = ~0ull;
+    for (size_t i = 0; i < s.zones.size(); ++i) {
+        if (s.zones[i].closed) {
+            gpuBase = std::min(gpuBase, mResults[i * 2] & mTimestampMask);
+        }
+    }
+    if (~0ull == gpuBase) {
+        return -1.0;
+    }
+
+    // the work can't start before it was submitted nor before the previous slot's work was done
+    const double hostBaseNs = std::max(profiler::TicksToNs(s.submitTicks), profiler::TicksToNs(mLastEndTicks));
+    uint64_t gpuEnd = 0;
+    for (size_t i = 0; i < s.zones.size(); ++i) {
+        const SlotZone& zone = s.zones[i];
+        if (!zone.closed) {
+            continue;
+        }
+
+        const uint64_t begin = (mResults[i * 2] & mTimestampMask) - gpuBase;
+        const uint64_t end = std::max(mResults[i * 2 + 1] & mTimestampMask, mResults[i * 2] & mTimestampMask) - gpuBase;
+        gpuEnd = std::max(gpuEnd, end);
+        const uint64_t beginTicks = profiler::NsToTicks(hostBaseNs + begin * mTimestampPeriod);
+        const uint64_t endTicks = profiler::NsToTicks(hostBaseNs + end * mTimestampPeriod);
+        profiler::Record(mTrack, zone.name, beginTicks, endTicks, zone.depth);
+        mLastEndTicks = std::max(mLastEndTicks, endTicks);
+    }
+    return gpuEnd * mTimestampPeriod * 1e-6;
+}
+
+void GpuProfiler::ResolveAll() {
+    // in submission order, each slot is placed after the previous one
+    std::vector<size_t> order;
+    for (size_t i = 0; i < mSlots.size(); ++i) {
+        if (mSlots[i].submitted) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](const size_t a, const size_t b) {
+        return mSlots[a].submitTicks < mSlots[b].submitTicks;
+    });
+    for (const size_t slot : order) {
+        this->Resolve(slot);
+    }
+}
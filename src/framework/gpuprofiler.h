@@ -0,0 +1,89 @@
+#pragma once
+
+#include "vulkanhelpers.h"
+#include "profiler.h"
+
+#include <vector>
+
+// GPU zones from timestamp queries, fed into the profiler's "GPU" track.
+// Every command buffer the app records gets a slot with its own range of queries: BeginCommandBuffer() resets
+// them, zones write a timestamp on both sides of the commands they wrap. Once the slot's fence has signalled,
+// Resolve() reads them back. Durations are exact, the placement on the CPU timeline isn't: a slot is anchored
+// at its submission (or right after the previous slot's work, whichever is later), the device clock isn't
+// calibrated against the host one.
+class GpuProfiler {
+public:
+    class Zone {
+    public:
+        Zone(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const size_t slot, const char* name)
+            : mProfiler(profiler)
+            , mCommandBuffer(commandBuffer)
+            , mSlot(slot)
+            , mZone(profiler.BeginZone(commandBuffer, slot, name)) {
+        }
+        ~Zone() {
+            mProfiler.EndZone(mCommandBuffer, mSlot, mZone);
+        }
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+    private:
+        GpuProfiler&    mProfiler;
+        VkCommandBuffer mCommandBuffer;
+        size_t          mSlot;
+        uint32_t        mZone;
+    };
+
+    GpuProfiler();
+    ~GpuProfiler();
+
+    // false if the queue can't write timestamps, every call is a no-op then.
+    // Zones past maxZonesPerSlot in a command buffer are dropped
+    bool        Initialize(VkPhysicalDevice physicalDevice, VkDevice device, const uint32_t queueFamilyIndex,
+                           const size_t numSlots, const uint32_t maxZonesPerSlot = 256);
+    void        Destroy();
+    bool        IsEnabled() const;
+
+    // records a reset of the slot's queries and forgets the zones it had
+    void        BeginCommandBuffer(VkCommandBuffer commandBuffer, const size_t slot);
+    uint32_t    BeginZone(VkCommandBuffer commandBuffer, const size_t slot, const char* name);
+    void        EndZone(VkCommandBuffer commandBuffer, const size_t slot, const uint32_t zone);
+
+    void        MarkSubmit(const size_t slot);
+    // after the slot's fence (or a wait idle), does nothing if it wasn't submitted since the last call.
+    // Returns the milliseconds from the slot's first zone begin to its last zone end, < 0 when there's nothing
+    double      Resolve(const size_t slot);
+    void        ResolveAll();
+
+private:
+    struct SlotZone {
+        const char* name;
+        uint32_t    depth;
+        bool        closed;
+    };
+
+    struct Slot {
+        std::vector<SlotZone>   zones;
+        uint32_t                depth;
+        uint64_t                submitTicks;
+        bool                    submitted;
+    };
+
+    VkDevice                mDevice;
+    VkQueryPool             mQueryPool;
+    uint32_t                mMaxZonesPerSlot;
+    double                  mTimestampPeriod;   // ns per device tick
+    uint64_t                mTimestampMask;
+    std::vector<Slot>       mSlots;             // value initialized, no zones & nothing submitted
+    std::vector<uint64_t>   mResults;
+    uint64_t                mLastEndTicks;      // host ticks the last resolved zone ended at
+    profiler::Track*        mTrack;
+};
+
+#if SWS_PROFILER
+#define PROFILE_GPU_ZONE(gpuProfiler, commandBuffer, slot, name) \
+    GpuProfiler::Zone SWS_PROFILER_CONCAT(gpuProfilerZone, __LINE__)(gpuProfiler, commandBuffer, slot, name)
+#else
+#define PROFILE_GPU_ZONE(gpuProfiler, commandBuffer, slot, name) ((void)0)
+#endif
@@ -0,0 +1,340 @@
+#include "imagewriter.h"
+#include "profiler.h"
+
+#include "shared.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const uint8_t kPngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+static const size_t kMaxStoredBlock = 65535;
+
+static void PutBE32(std::vector<uint8_t>& out, const uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static uint32_t Crc32(const uint8_t* data, const size_t size, uint32_t crc) {
+    struct Table {
+        uint32_t values[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1u) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+                }
+                values[i] = c;
+            }
+        }
+    };
+    static const Table sTable;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = sTable.values[(crc ^ data[i]) & 0xFFu] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void PutPngChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, const size_t size) {
+    PutBE32(out, static_cast<uint32_t>(size));
+    const size_t typeOffset = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    PutBE32(out, Crc32(out.data() + typeOffset, size + 4, 0));
+}
+
+// hands the frame to rowFunc one sRGB rgb8 row at a time
+template <typename F>
+static void ForEachSrgbRow(const ImageWriter::Frame& frame, F rowFunc) {
+    const size_t rIdx = frame.bgra ? 2 : 0;
+    const size_t bIdx = frame.bgra ? 0 : 2;
+
+    std::vector<uint8_t> row(static_cast<size_t>(frame.width) * 3);
+    for (uint32_t y = 0; y < frame.height; ++y) {
+        const uint8_t* src = frame.color.data() + static_cast<size_t>(y) * frame.width * 4;
+        for (uint32_t x = 0; x < frame.width; ++x, src += 4) {
+            row[x * 3 + 0] = ImageWriter::LinearToSrgb8(src[rIdx]);
+            row[x * 3 + 1] = ImageWriter::LinearToSrgb8(src[1]);
+            row[x * 3 + 2] = ImageWriter::LinearToSrgb8(src[bIdx]);
+        }
+        rowFunc(row);
+    }
+}
+
+
+ImageWriter::FloatChannel& ImageWriter::Frame::AddFloatChannel(const std::string& name, const ExrWriter::PixelType type) {
+    if (numFloatChannels == floatChannels.size()) {
+        floatChannels.push_back(FloatChannel());
+    }
+    FloatChannel& channel = floatChannels[numFloatChannels++];
+    channel.name = name;
+    channel.type = type;
+    channel.data.resize(static_cast<size_t>(width) * height);
+    return channel;
+}
+
+ImageWriter::UIntChannel& ImageWriter::Frame::AddUIntChannel(const std::string& name) {
+    if (numUIntChannels == uintChannels.size()) {
+        uintChannels.push_back(UIntChannel());
+    }
+    UIntChannel& channel = uintChannels[numUIntChannels++];
+    channel.name = name;
+    channel.data.resize(static_cast<size_t>(width) * height);
+    return channel;
+}
+
+
+ImageWriter::ImageWriter()
+    : mStats({})
+{
+}
+ImageWriter::~ImageWriter() {
+    this->Shutdown();
+}
+
+void ImageWriter::Initialize(const size_t numThreads, const size_t numFrames) {
+    this->Shutdown();
+
+    mFrames.clear();
+    mFreeFrames.clear();
+    for (size_t i = 0, count = numFrames ? numFrames : 1; i < count; ++i) {
+        Frame* frame = new Frame();
+        frame->format = Format::Exr;
+        frame->width = frame->height = 0;
+        frame->bgra = false;
+        frame->numFloatChannels = frame->numUIntChannels = 0;
+        mFrames.push_back(std::unique_ptr<Frame>(frame));
+        mFreeFrames.push_back(frame);
+    }
+
+    mStats = {};
+    mStartTime = Clock::now();
+    mWorkers.Initialize(numThreads ? numThreads : 1);
+}
+
+void ImageWriter::Shutdown() {
+    // the pool drains its queue before the workers quit
+    mWorkers.Shutdown();
+}
+
+void ImageWriter::WaitIdle() {
+    mWorkers.WaitIdle();
+}
+
+ImageWriter::Frame* ImageWriter::AcquireFrame() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (mFreeFrames.empty()) {
+        // everything is queued, the disk is behind the renderer
+        const Clock::time_point stallStart = Clock::now();
+        mFrameFreed.wait(lock, [this]() { return !mFreeFrames.empty(); });
+        ++mStats.numStalls;
+        mStats.stallSeconds += std::chrono::duration<double>(Clock::now() - stallStart).count();
+    }
+
+    Frame* frame = mFreeFrames.back();
+    mFreeFrames.pop_back();
+    frame->numFloatChannels = 0;
+    frame->numUIntChannels = 0;
+    return frame;
+}
+
+void ImageWriter::Submit(Frame* frame) {
+    mWorkers.Enqueue([this, frame]() {
+        this->WriteFrame(frame);
+        this->ReleaseFrame(frame);
+    });
+}
+
+ImageWriter::Stats ImageWriter::GetStats() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Stats stats = mStats;
+    stats.seconds = std::chrono::duration<double>(Clock::now() - mStartTime).count();
+    if (stats.seconds > 0.0) {
+        stats.framesPerSecond = static_cast<double>(stats.numFrames) / stats.seconds;
+        stats.megabytesPerSecond = static_cast<double>(stats.numBytes) / (1024.0 * 1024.0) / stats.seconds;
+    }
+    return stats;
+}
+
+ImageWriter::Format ImageWriter::ParseFormat(const std::string& name, bool& ok) {
+    ok = true;
+    if (name == "png") {
+        return Format::Png;
+    } else if (name == "ppm") {
+        return Format::Ppm;
+    }
+    ok = (name == "exr");
+    return Format::Exr;
+}
+
+const char* ImageWriter::GetExtension(const Format format) {
+    switch (format) {
+        case Format::Png: return "png";
+        case Format::Ppm: return "ppm";
+        default:          return "exr";
+    }
+}
+
+void ImageWriter::EncodePng(const Frame& frame, std::vector<uint8_t>& out) {
+    out.clear();
+    out.insert(out.end(), kPngSignature, kPngSignature + sizeof(kPngSignature));
+
+    uint8_t header[13];
+    std::vector<uint8_t> tmp;
+    PutBE32(tmp, frame.width);
+    PutBE32(tmp, frame.height);
+    memcpy(header, tmp.data(), 8);
+    header[8] = 8;      // bit depth
+    header[9] = 2;      // truecolor rgb
+    header[10] = 0;     // deflate
+    header[11] = 0;     // adaptive filtering (we only use "none")
+    header[12] = 0;     // no interlace
+    PutPngChunk(out, "IHDR", header, sizeof(header));
+
+    // zlib stream made of stored blocks: no compression, but no dependency and next to no cpu either
+    const size_t rowSize = static_cast<size_t>(frame.width) * 3 + 1;
+    const size_t rawSize = rowSize * frame.height;
+    const size_t numBlocks = (rawSize + kMaxStoredBlock - 1) / kMaxStoredBlock;
+
+    std::vector<uint8_t> idat;
+    idat.reserve(2 + rawSize + numBlocks * 5 + 4);
+    idat.push_back(0x78);
+    idat.push_back(0x01);
+
+    uint32_t adlerA = 1, adlerB = 0;
+    size_t blockLeft = 0, rawLeft = rawSize;
+    auto putByte = [&](const uint8_t value) {
+        if (!blockLeft) {
+            blockLeft = (rawLeft < kMaxStoredBlock) ? rawLeft : kMaxStoredBlock;
+            rawLeft -= blockLeft;
+            idat.push_back(rawLeft ? 0x00 : 0x01);  // BFINAL on the last one, BTYPE = stored
+            idat.push_back(static_cast<uint8_t>(blockLeft));
+            idat.push_back(static_cast<uint8_t>(blockLeft >> 8));
+            idat.push_back(static_cast<uint8_t>(~blockLeft));
+            idat.push_back(static_cast<uint8_t>(~blockLeft >> 8));
+        }
+        idat.push_back(value);
+        --blockLeft;
+        adlerA = (adlerA + value) % 65521u;
+        adlerB = (adlerB + adlerA) % 65521u;
+    };
+
+    ForEachSrgbRow(frame, [&](const std::vector<uint8_t>& row) {
+        putByte(0);     // filter: none
+        for (const uint8_t value : row) {
+            putByte(value);
+        }
+    });
+    PutBE32(idat, (adlerB << 16) | adlerA);
+
+    PutPngChunk(out, "IDAT", idat.data(), idat.size());
+    PutPngChunk(out, "IEND", nullptr, 0);
+}
+
+void ImageWriter::EncodePpm(const Frame& frame, std::vector<uint8_t>& out) {
+    char header[64];
+    const int headerSize = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", frame.width, frame.height);
+
+    out.clear();
+    out.reserve(headerSize + static_cast<size_t>(frame.width) * frame.height * 3);
+    out.insert(out.end(), header, header + headerSize);
+    ForEachSrgbRow(frame, [&out](const std::vector<uint8_t>& row) {
+        out.insert(out.end(), row.begin(), row.end());
+    });
+}
+
+uint8_t ImageWriter::LinearToSrgb8(const uint8_t linear) {
+    struct Table {
+        uint8_t values[256];
+        Table() {
+            for (int i = 0; i < 256; ++i) {
+                values[i] = static_cast<uint8_t>(Clamp(LinearToSrgb(static_cast<float>(i) / 255.0f), 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+        }
+    };
+    static const Table sTable;
+    return sTable.values[linear];
+}
+
+void ImageWriter::WriteFrame(Frame* frame) {
+    PROFILE_ZONE("WriteFrame");
+
+    bool ok = false;
+    size_t numBytes = 0;
+
+    // written under a temporary name and renamed once complete, so a crash never leaves a truncated
+    // frame behind under its final name (batch renders resume from the first missing one)
+    const std::string tmpName = frame->fileName + ".tmp";
+
+    if (frame->format == Format::Exr) {
+        const size_t numPixels = static_cast<size_t>(frame->width) * frame->height;
+        const size_t rIdx = frame->bgra ? 2 : 0;
+        const size_t bIdx = frame->bgra ? 0 : 2;
+        const float toFloat = 1.0f / 255.0f;
+
+        FloatChannel& r = frame->AddFloatChannel("R");
+        FloatChannel& g = frame->AddFloatChannel("G");
+        FloatChannel& b = frame->AddFloatChannel("B");
+        for (size_t i = 0; i < numPixels; ++i) {
+            const uint8_t* c = frame->color.data() + i * 4;
+            r.data[i] = static_cast<float>(c[rIdx]) * toFloat;
+            g.data[i] = static_cast<float>(c[1]) * toFloat;
+            b.data[i] = static_cast<float>(c[bIdx]) * toFloat;
+        }
+
+        ExrWriter exr;
+        exr.Initialize(frame->width, frame->height);
+        for (size_t i = 0; i < frame->numFloatChannels; ++i) {
+            exr.AddChannel(frame->floatChannels[i].name, frame->floatChannels[i].data.data(), frame->floatChannels[i].type);
+        }
+        for (size_t i = 0; i < frame->numUIntChannels; ++i) {
+            exr.AddChannel(frame->uintChannels[i].name, frame->uintChannels[i].data.data());
+        }
+
+        ok = exr.Save(tmpName);
+        numBytes = exr.GetFileSize();
+    } else {
+        std::vector<uint8_t>& encoded = frame->encoded;
+        if (frame->format == Format::Png) {
+            EncodePng(*frame, encoded);
+        } else {
+            EncodePpm(*frame, encoded);
+        }
+
+        FILE* file = fopen(tmpName.c_str(), "wb");
+        if (file) {
+            ok = (fwrite(encoded.data(), 1, encoded.size(), file) == encoded.size());
+            ok = (fclose(file) == 0) && ok;
+        }
+        numBytes = encoded.size();
+    }
+
+    if (ok) {
+        // rename() doesn't replace an existing file on Windows
+        remove(frame->fileName.c_str());
+        ok = (rename(tmpName.c_str(), frame->fileName.c_str()) == 0);
+    }
+    if (!ok) {
+        remove(tmpName.c_str());
+        printf("Failed to write %s\n", frame->fileName.c_str());
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (ok) {
+        ++mStats.numFrames;
+        mStats.numBytes += numBytes;
+    } else {
+        ++mStats.numFailed;
+    }
+}
+
+void ImageWriter::ReleaseFrame(Frame* frame) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFreeFrames.push_back(frame);
+    }
+    mFrameFreed.notify_one();
+}
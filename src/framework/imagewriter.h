@@ -0,0 +1,102 @@
+#pragma once
+
+#include "threadpool.h"
+#include "exrwriter.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Writes rendered frames to disk on its own workers, so encoding and file IO never run on the render loop.
+// Frames come from a fixed pool: AcquireFrame() hands out a free one (blocking while all of them are queued,
+// which is the back-pressure when the disk can't keep up), the caller fills it straight from the readback
+// mapping and gives it back with Submit(). Buffers are reused frame after frame and only ever moved around.
+class ImageWriter {
+public:
+    enum class Format : uint32_t {
+        Exr,        // linear, color as half + any extra channels
+        Png,        // sRGB, 8 bit, stored (uncompressed) deflate blocks
+        Ppm         // sRGB, 8 bit binary P6
+    };
+
+    struct FloatChannel {
+        std::string             name;
+        std::vector<float>      data;
+        ExrWriter::PixelType    type;
+    };
+
+    struct UIntChannel {
+        std::string             name;
+        std::vector<uint32_t>   data;
+    };
+
+    struct Frame {
+        std::string                 fileName;
+        Format                      format;
+        uint32_t                    width;
+        uint32_t                    height;
+        std::vector<uint8_t>        color;          // linear, 4 bytes per texel
+        bool                        bgra;
+        // extra channels, written by Format::Exr only. Resize rather than clear them, the storage is reused
+        std::vector<FloatChannel>   floatChannels;
+        std::vector<UIntChannel>    uintChannels;
+        size_t                      numFloatChannels;
+        size_t                      numUIntChannels;
+        std::vector<uint8_t>        encoded;        // scratch for the png/ppm encoders
+
+        FloatChannel&   AddFloatChannel(const std::string& name, const ExrWriter::PixelType type = ExrWriter::PixelType::Half);
+        UIntChannel&    AddUIntChannel(const std::string& name);
+    };
+
+    struct Stats {
+        uint64_t    numFrames;
+        uint64_t    numBytes;
+        uint64_t    numFailed;
+        uint64_t    numStalls;          // AcquireFrame() calls that had to wait for a free frame
+        double      stallSeconds;
+        double      seconds;            // since Initialize()
+        double      framesPerSecond;
+        double      megabytesPerSecond;
+    };
+
+    ImageWriter();
+    ~ImageWriter();
+
+    // numFrames - how many frames can be queued before AcquireFrame() blocks
+    void            Initialize(const size_t numThreads = 2, const size_t numFrames = 4);
+    void            Shutdown();     // writes whatever is queued first
+    void            WaitIdle();
+
+    Frame*          AcquireFrame();
+    void            Submit(Frame* frame);
+
+    Stats           GetStats() const;
+
+    static Format   ParseFormat(const std::string& name, bool& ok);
+    static const char* GetExtension(const Format format);
+
+    // exposed so the encoders can be checked without touching the disk
+    static void     EncodePng(const Frame& frame, std::vector<uint8_t>& out);
+    static void     EncodePpm(const Frame& frame, std::vector<uint8_t>& out);
+    static uint8_t  LinearToSrgb8(const uint8_t linear);
+
+private:
+    void            WriteFrame(Frame* frame);
+    void            ReleaseFrame(Frame* frame);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    ThreadPool                          mWorkers;
+    std::vector<std::unique_ptr<Frame>> mFrames;
+    std::vector<Frame*>                 mFreeFrames;
+    mutable std::mutex                  mMutex;
+    std::condition_variable             mFrameFreed;
+    Clock::time_point                   mStartTime;
+    Stats                               mStats;
+};
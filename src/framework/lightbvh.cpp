@@ -0,0 +1,494 @@
+#include "lightbvh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+static const float kPi = 3.14159265358979f;
+static const uint32_t kNumBins = 12;
+
+static float Dot3(const float a[3], const float b[3]) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void Cross3(const float a[3], const float b[3], float out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static bool Normalize3(float v[3]) {
+    const float len = std::sqrt(Dot3(v, v));
+    if (len <= 0.0f) {
+        return false;
+    }
+    v[0] /= len; v[1] /= len; v[2] /= len;
+    return true;
+}
+
+static float SafeSqrt(const float x) {
+    return std::sqrt(std::max(x, 0.0f));
+}
+
+static float SafeAcos(const float x) {
+    return std::acos(std::min(std::max(x, -1.0f), 1.0f));
+}
+
+// cos(max(0, a - b)) and sin(max(0, a - b)) from the sines & cosines of a and b, both in [0, pi]
+static float CosSubClamped(const float sinA, const float cosA, const float sinB, const float cosB) {
+    return (cosA > cosB) ? 1.0f : (cosA * cosB + sinA * sinB);
+}
+
+static float SinSubClamped(const float sinA, const float cosA, const float sinB, const float cosB) {
+    return (cosA > cosB) ? 0.0f : (sinA * cosB - cosA * sinB);
+}
+
+static float SurfaceArea(const LightBVH::Node& node) {
+    const float dx = node.boundsMax[0] - node.boundsMin[0];
+    const float dy = node.boundsMax[1] - node.boundsMin[1];
+    const float dz = node.boundsMax[2] - node.boundsMin[2];
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+
+LightBVH::LightBVH()
+    : mDepth(0)
+    , mNumBuiltLeaves(0)
+    , mNumAppends(0)
+{
+}
+
+bool LightBVH::Build(const std::vector<Emitter>& emitters) {
+    this->Clear();
+
+    std::vector<BuildItem> items;
+    items.reserve(emitters.size());
+    for (size_t i = 0; i < emitters.size(); ++i) {
+        if (emitters[i].power > 0.0f) {
+            items.push_back(LightBVH::MakeItem(emitters[i], static_cast<uint32_t>(i)));
+        }
+    }
+    if (items.empty()) {
+        return false;
+    }
+
+    mBitTrails.assign(emitters.size(), 0);
+    mNodes.reserve(2 * items.size() - 1);
+    this->BuildRecursive(items, 0, items.size(), 0, 0);
+    mNumBuiltLeaves = items.size();
+
+    return true;
+}
+
+bool LightBVH::Append(const std::vector<Emitter>& emitters, const size_t firstNew) {
+    if (mNodes.empty()) {
+        return this->Build(emitters);
+    }
+    assert(firstNew == mBitTrails.size() && firstNew <= emitters.size());
+
+    std::vector<BuildItem> items;
+    for (size_t i = firstNew; i < emitters.size(); ++i) {
+        if (emitters[i].power > 0.0f) {
+            items.push_back(LightBVH::MakeItem(emitters[i], static_cast<uint32_t>(i)));
+        }
+    }
+    mBitTrails.resize(emitters.size(), 0);
+    if (items.empty()) {
+        return true;
+    }
+
+    // a tree of n leaves has 2n - 1 nodes
+    const size_t numLeaves = (mNodes.size() + 1) / 2;
+    if (numLeaves + items.size() > 2 * mNumBuiltLeaves || mNumAppends >= kMaxAppends || mDepth + 1 > kMaxDepth) {
+        return this->Build(emitters);
+    }
+
+    // the old root moves to the end, node 0 becomes the one over it (the first child, so the trails of its emitters
+    // get a 0 in front) and the new emitters' subtree (the second one)
+    const Node oldRoot = mNodes[0];
+    const uint32_t oldRootIndex = static_cast<uint32_t>(mNodes.size());
+    mNodes.push_back(oldRoot);
+    for (size_t i = 0; i < firstNew; ++i) {
+        mBitTrails[i] <<= 1;
+    }
+    ++mDepth;
+    const uint32_t newRootIndex = this->BuildRecursive(items, 0, items.size(), 1, 1u);
+
+    Node root = oldRoot;
+    LightBVH::Merge(root, mNodes[newRootIndex]);
+    root.child0 = oldRootIndex;
+    root.child1 = newRootIndex;
+    root.isLeaf = 0;
+    mNodes[0] = root;
+    ++mNumAppends;
+
+    return true;
+}
+
+void LightBVH::Clear() {
+    mNodes.clear();
+    mBitTrails.clear();
+    mDepth = 0;
+    mNumBuiltLeaves = 0;
+    mNumAppends = 0;
+}
+
+uint32_t LightBVH::Sample(const float p[3], const float n[3], const float u, float& pmf) const {
+    pmf = 0.0f;
+    if (mNodes.empty() || LightBVH::Importance(mNodes[0], p, n) <= 0.0f) {
+        return kInvalidIndex;
+    }
+
+    float x = u;
+    float prob = 1.0f;
+    uint32_t nodeIndex = 0;
+    while (!mNodes[nodeIndex].isLeaf) {
+        const Node& node = mNodes[nodeIndex];
+        const float ci0 = LightBVH::Importance(mNodes[node.child0], p, n);
+        const float ci1 = LightBVH::Importance(mNodes[node.child1], p, n);
+        if (ci0 <= 0.0f && ci1 <= 0.0f) {
+            return kInvalidIndex;
+        }
+
+        // reuse the random number all the way down
+        const float p0 = ci0 / (ci0 + ci1);
+        if (x < p0) {
+            x = std::min(x / p0, 0.99999994f);
+            prob *= p0;
+            nodeIndex = node.child0;
+        } else {
+            x = std::min((x - p0) / (1.0f - p0), 0.99999994f);
+            prob *= 1.0f - p0;
+            nodeIndex = node.child1;
+        }
+    }
+
+    pmf = prob;
+    return mNodes[nodeIndex].child0;
+}
+
+float LightBVH::GetPmf(const float p[3], const float n[3], const uint32_t emitter) const {
+    if (mNodes.empty() || emitter >= mBitTrails.size() || LightBVH::Importance(mNodes[0], p, n) <= 0.0f) {
+        return 0.0f;
+    }
+
+    uint32_t bitTrail = mBitTrails[emitter];
+    float prob = 1.0f;
+    uint32_t nodeIndex = 0;
+    while (!mNodes[nodeIndex].isLeaf) {
+        const Node& node = mNodes[nodeIndex];
+        const float ci0 = LightBVH::Importance(mNodes[node.child0], p, n);
+        const float ci1 = LightBVH::Importance(mNodes[node.child1], p, n);
+        if (ci0 <= 0.0f && ci1 <= 0.0f) {
+            return 0.0f;
+        }
+
+        const bool second = (bitTrail & 1u) != 0;
+        prob *= (second ? ci1 : ci0) / (ci0 + ci1);
+        nodeIndex = second ? node.child1 : node.child0;
+        bitTrail >>= 1;
+    }
+
+    return (mNodes[nodeIndex].child0 == emitter) ? prob : 0.0f;
+}
+
+float LightBVH::Importance(const Node& node, const float p[3], const float n[3]) {
+    if (node.power <= 0.0f) {
+        return 0.0f;
+    }
+
+    float pc[3], diag[3], wi[3];
+    for (int k = 0; k < 3; ++k) {
+        pc[k] = 0.5f * (node.boundsMin[k] + node.boundsMax[k]);
+        diag[k] = node.boundsMax[k] - node.boundsMin[k];
+        wi[k] = p[k] - pc[k];
+    }
+
+    const float distSq = Dot3(wi, wi);
+    const float radiusSq = 0.25f * Dot3(diag, diag);
+    // don't let the 1/d^2 falloff explode for points close to (or inside) the cluster
+    const float d2 = std::max(std::max(distSq, 0.5f * std::sqrt(Dot3(diag, diag))), 1e-12f);
+    if (!Normalize3(wi)) {
+        wi[0] = 0.0f; wi[1] = 0.0f; wi[2] = 1.0f;
+    }
+
+    // angle between the cone axis and the direction to the shading point, double-sided emitters
+    const float cosThetaW = std::fabs(Dot3(node.axis, wi));
+    const float sinThetaW = SafeSqrt(1.0f - cosThetaW * cosThetaW);
+
+    // angle subtended by the bounds as seen from the shading point
+    const float cosThetaB = (distSq < radiusSq) ? -1.0f : SafeSqrt(1.0f - radiusSq / distSq);
+    const float sinThetaB = SafeSqrt(1.0f - cosThetaB * cosThetaB);
+
+    // minimal angle between the emitter normals and the shading point, over the whole node
+    const float cosThetaO = node.cosThetaO;
+    const float sinThetaO = SafeSqrt(1.0f - cosThetaO * cosThetaO);
+    const float cosThetaX = CosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    const float sinThetaX = SinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    const float cosThetaP = CosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+    if (cosThetaP <= node.cosThetaE) {
+        return 0.0f;
+    }
+
+    float importance = node.power * cosThetaP / d2;
+
+    // the receiver only sees the hemisphere around its normal
+    if (n) {
+        const float cosThetaI = -Dot3(wi, n);
+        const float sinThetaI = SafeSqrt(1.0f - cosThetaI * cosThetaI);
+        const float cosThetaPI = CosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+        importance *= std::max(cosThetaPI, 0.0f);
+    }
+
+    return importance;
+}
+
+const std::vector<LightBVH::Node>& LightBVH::GetNodes() const {
+    return mNodes;
+}
+
+const std::vector<uint32_t>& LightBVH::GetBitTrails() const {
+    return mBitTrails;
+}
+
+uint32_t LightBVH::GetDepth() const {
+    return mDepth;
+}
+
+uint32_t LightBVH::BuildRecursive(std::vector<BuildItem>& items, const size_t begin, const size_t end, const uint32_t depth, const uint32_t bitTrail) {
+    const uint32_t nodeIndex = static_cast<uint32_t>(mNodes.size());
+
+    if (end - begin == 1) {
+        mNodes.push_back(items[begin].bounds);
+        mBitTrails[items[begin].emitter] = bitTrail;
+        mDepth = std::max(mDepth, depth);
+        return nodeIndex;
+    }
+
+    Node node = items[begin].bounds;
+    float centroidMin[3], centroidMax[3];
+    for (int k = 0; k < 3; ++k) {
+        centroidMin[k] = centroidMax[k] = items[begin].centroid[k];
+    }
+    for (size_t i = begin + 1; i < end; ++i) {
+        LightBVH::Merge(node, items[i].bounds);
+        for (int k = 0; k < 3; ++k) {
+            centroidMin[k] = std::min(centroidMin[k], items[i].centroid[k]);
+            centroidMax[k] = std::max(centroidMax[k], items[i].centroid[k]);
+        }
+    }
+    node.isLeaf = 0;
+
+    // binned SAOH (surface area orientation heuristic)
+    float extent[3];
+    for (int k = 0; k < 3; ++k) {
+        extent[k] = node.boundsMax[k] - node.boundsMin[k];
+    }
+    const float maxExtent = std::max(extent[0], std::max(extent[1], extent[2]));
+
+    float bestCost = INFINITY;
+    int bestDim = -1;
+    uint32_t bestSplit = 0;
+    for (int dim = 0; dim < 3; ++dim) {
+        const float centroidExtent = centroidMax[dim] - centroidMin[dim];
+        if (centroidExtent <= 0.0f) {
+            continue;
+        }
+
+        Node bins[kNumBins];
+        size_t counts[kNumBins] = {};
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t b = std::min(static_cast<uint32_t>(kNumBins * (items[i].centroid[dim] - centroidMin[dim]) / centroidExtent), kNumBins - 1);
+            if (counts[b]++) {
+                LightBVH::Merge(bins[b], items[i].bounds);
+            } else {
+                bins[b] = items[i].bounds;
+            }
+        }
+
+        // cost of everything above each split plane, then sweep the planes from the left
+        float aboveCosts[kNumBins] = {};
+        Node above;
+        size_t aboveCount = 0;
+        for (uint32_t b = kNumBins - 1; b > 0; --b) {
+            if (counts[b]) {
+                if (aboveCount) {
+                    LightBVH::Merge(above, bins[b]);
+                } else {
+                    above = bins[b];
+                }
+                aboveCount += counts[b];
+            }
+            aboveCosts[b] = aboveCount ? (above.power * LightBVH::OrientationCost(above.cosThetaO, above.cosThetaE) * SurfaceArea(above)) : -1.0f;
+        }
+
+        const float kr = (extent[dim] > 0.0f) ? (maxExtent / extent[dim]) : 1.0f;
+        Node below;
+        size_t belowCount = 0;
+        for (uint32_t split = 1; split < kNumBins; ++split) {
+            if (counts[split - 1]) {
+                if (belowCount) {
+                    LightBVH::Merge(below, bins[split - 1]);
+                } else {
+                    below = bins[split - 1];
+                }
+                belowCount += counts[split - 1];
+            }
+            if (!belowCount || aboveCosts[split] < 0.0f) {
+                continue;
+            }
+
+            const float belowCost = below.power * LightBVH::OrientationCost(below.cosThetaO, below.cosThetaE) * SurfaceArea(below);
+            const float cost = kr * (belowCost + aboveCosts[split]);
+
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestDim = dim;
+                bestSplit = split;
+            }
+        }
+    }
+
+    // a child at depth + 1 can't hold more emitters than its remaining bit trail can address
+    const size_t childCapacity = static_cast<size_t>(1) << (kMaxDepth - 1 - depth);
+
+    size_t mid = begin;
+    if (bestDim >= 0) {
+        const float centroidExtent = centroidMax[bestDim] - centroidMin[bestDim];
+        const float cmin = centroidMin[bestDim];
+        const int dim = bestDim;
+        const uint32_t split = bestSplit;
+        mid = static_cast<size_t>(std::partition(items.begin() + begin, items.begin() + end, [=](const BuildItem& item) {
+            const uint32_t b = std::min(static_cast<uint32_t>(kNumBins * (item.centroid[dim] - cmin) / centroidExtent), kNumBins - 1);
+            return b < split;
+        }) - items.begin());
+    }
+
+    if (mid == begin || mid == end || (mid - begin) > childCapacity || (end - mid) > childCapacity) {
+        // all the centroids are the same, or the tree got too deep: split in halves along the widest axis
+        int dim = 0;
+        for (int k = 1; k < 3; ++k) {
+            if (centroidMax[k] - centroidMin[k] > centroidMax[dim] - centroidMin[dim]) {
+                dim = k;
+            }
+        }
+        mid = begin + (end - begin) / 2;
+        std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end, [dim](const BuildItem& a, const BuildItem& b) {
+            return a.centroid[dim] < b.centroid[dim];
+        });
+    }
+
+    mNodes.push_back(node);
+    const uint32_t child0 = this->BuildRecursive(items, begin, mid, depth + 1, bitTrail);
+    const uint32_t child1 = this->BuildRecursive(items, mid, end, depth + 1, bitTrail | (1u << depth));
+    mNodes[nodeIndex].child0 = child0;
+    mNodes[nodeIndex].child1 = child1;
+
+    return nodeIndex;
+}
+
+LightBVH::BuildItem LightBVH::MakeItem(const Emitter& emitter, const uint32_t index) {
+    BuildItem item;
+    item.bounds = LightBVH::MakeLeaf(emitter, index);
+    for (int k = 0; k < 3; ++k) {
+        item.centroid[k] = 0.5f * (item.bounds.boundsMin[k] + item.bounds.boundsMax[k]);
+    }
+    item.emitter = index;
+    return item;
+}
+
+LightBVH::Node LightBVH::MakeLeaf(const Emitter& emitter, const uint32_t index) {
+    Node node;
+    float e1[3], e2[3];
+    for (int k = 0; k < 3; ++k) {
+        node.boundsMin[k] = std::min(emitter.v0[k], std::min(emitter.v1[k], emitter.v2[k]));
+        node.boundsMax[k] = std::max(emitter.v0[k], std::max(emitter.v1[k], emitter.v2[k]));
+        e1[k] = emitter.v1[k] - emitter.v0[k];
+        e2[k] = emitter.v2[k] - emitter.v0[k];
+    }
+    Cross3(e1, e2, node.axis);
+    if (!Normalize3(node.axis)) {
+        // degenerate triangle with some power, let it face everywhere
+        node.axis[0] = 0.0f; node.axis[1] = 0.0f; node.axis[2] = 1.0f;
+        node.cosThetaO = -1.0f;
+    } else {
+        node.cosThetaO = 1.0f;
+    }
+    node.power = emitter.power;
+    node.cosThetaE = 0.0f; // diffuse, cos(pi / 2)
+    node.child0 = index;
+    node.child1 = kInvalidIndex;
+    node.isLeaf = 1;
+    node.padding = 0;
+    return node;
+}
+
+void LightBVH::Merge(Node& dst, const Node& src) {
+    for (int k = 0; k < 3; ++k) {
+        dst.boundsMin[k] = std::min(dst.boundsMin[k], src.boundsMin[k]);
+        dst.boundsMax[k] = std::max(dst.boundsMax[k], src.boundsMax[k]);
+    }
+    dst.power += src.power;
+
+    Cone a, b;
+    std::copy(dst.axis, dst.axis + 3, a.axis);
+    a.cosTheta = dst.cosThetaO;
+    std::copy(src.axis, src.axis + 3, b.axis);
+    b.cosTheta = src.cosThetaO;
+    const Cone merged = LightBVH::Union(a, b);
+    std::copy(merged.axis, merged.axis + 3, dst.axis);
+    dst.cosThetaO = merged.cosTheta;
+
+    dst.cosThetaE = std::min(dst.cosThetaE, src.cosThetaE);
+}
+
+// smallest cone containing both, see pbrt-v4 DirectionCone Union()
+LightBVH::Cone LightBVH::Union(const Cone& a, const Cone& b) {
+    const float thetaA = SafeAcos(a.cosTheta);
+    const float thetaB = SafeAcos(b.cosTheta);
+    const float thetaD = SafeAcos(Dot3(a.axis, b.axis));
+    if (std::min(thetaD + thetaB, kPi) <= thetaA) {
+        return a;
+    }
+    if (std::min(thetaD + thetaA, kPi) <= thetaB) {
+        return b;
+    }
+
+    Cone result = a;
+    result.cosTheta = -1.0f; // whole sphere
+
+    const float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+    if (thetaO >= kPi) {
+        return result;
+    }
+
+    // rotate a's axis towards b's one
+    const float thetaR = thetaO - thetaA;
+    float k[3];
+    Cross3(a.axis, b.axis, k);
+    if (!Normalize3(k)) {
+        return result;
+    }
+
+    const float cosR = std::cos(thetaR);
+    const float sinR = std::sin(thetaR);
+    float kxv[3];
+    Cross3(k, a.axis, kxv);
+    const float kdv = Dot3(k, a.axis);
+    for (int i = 0; i < 3; ++i) {
+        result.axis[i] = a.axis[i] * cosR + kxv[i] * sinR + k[i] * kdv * (1.0f - cosR);
+    }
+    Normalize3(result.axis);
+    result.cosTheta = std::cos(thetaO);
+    return result;
+}
+
+// solid angle measure of the cone of directions lit by a node
+float LightBVH::OrientationCost(const float cosThetaO, const float cosThetaE) {
+    const float thetaO = SafeAcos(cosThetaO);
+    const float thetaE = SafeAcos(cosThetaE);
+    const float thetaW = std::min(thetaO + thetaE, kPi);
+    const float sinThetaO = SafeSqrt(1.0f - cosThetaO * cosThetaO);
+    return 2.0f * kPi * (1.0f - cosThetaO) +
+           0.5f * kPi * (2.0f * thetaW * sinThetaO - std::cos(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinThetaO + cosThetaO);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Light hierarchy over the emissive triangles ("Importance Sampling of Many Lights with Adaptive Tree Splitting",
+// Conty Estevez & Kulla 2018). Every node stores the bounds, total power and a bounding cone of the emitter normals
+// below it, so a shading point can walk down the tree picking children proportionally to their estimated contribution.
+// Sample() / GetPmf() are mirrored by sampleLightBVH() / lightBVHPmf() in shaders/lights.glsl.
+class LightBVH {
+public:
+    static const uint32_t kInvalidIndex = ~0u;
+    static const uint32_t kMaxDepth = 32;       // emitters are addressed by a 32 bit trail of left/right turns
+    static const uint32_t kMaxAppends = 4;      // every one puts the emitters before it a level deeper
+
+    struct Emitter {
+        float       v0[3];
+        float       v1[3];
+        float       v2[3];
+        float       power;                  // area * luminance, zero power emitters are left out of the tree
+    };
+
+    // same layout as LightBVHNode in shared.h (std430)
+    struct Node {
+        float       boundsMin[3];
+        float       power;
+        float       boundsMax[3];
+        float       cosThetaO;              // normals spread around the axis
+        float       axis[3];
+        float       cosThetaE;              // emission spread around every normal (pi/2 for diffuse emitters)
+        uint32_t    child0;                 // first child, or emitter index for leaves
+        uint32_t    child1;
+        uint32_t    isLeaf;
+        uint32_t    padding;
+    };
+
+    LightBVH();
+    ~LightBVH() = default;
+
+    // returns false if there's nothing to sample (empty or all zero power)
+    bool                            Build(const std::vector<Emitter>& emitters);
+    // the emitters from firstNew on are new, the ones before keep their indices & leaves: the new ones get a subtree
+    // of their own next to the current root. The whole tree is rebuilt instead once they double what the last Build()
+    // had, after kMaxAppends appends or when the tree would get deeper than kMaxDepth
+    bool                            Append(const std::vector<Emitter>& emitters, const size_t firstNew);
+    void                            Clear();
+
+    // picks an emitter for a shading point (p, n), u in [0, 1), returns kInvalidIndex if nothing can contribute
+    uint32_t                        Sample(const float p[3], const float n[3], const float u, float& pmf) const;
+    // probability of Sample() returning emitter
+    float                           GetPmf(const float p[3], const float n[3], const uint32_t emitter) const;
+
+    // conservative estimate of what a node may contribute to a shading point, emitters are double-sided
+    static float                    Importance(const Node& node, const float p[3], const float n[3]);
+
+    const std::vector<Node>&        GetNodes() const;
+    const std::vector<uint32_t>&    GetBitTrails() const;   // per emitter, bit i set = second child at depth i
+    uint32_t                        GetDepth() const;
+
+private:
+    struct Cone {
+        float       axis[3];
+        float       cosTheta;
+    };
+    struct BuildItem {
+        Node        bounds;                 // leaf node for the emitter
+        float       centroid[3];
+        uint32_t    emitter;
+    };
+
+    static BuildItem                MakeItem(const Emitter& emitter, const uint32_t index);
+    uint32_t                        BuildRecursive(std::vector<BuildItem>& items, const size_t begin, const size_t end, const uint32_t depth, const uint32_t bitTrail);
+
+    static Node                     MakeLeaf(const Emitter& emitter, const uint32_t index);
+    static void                     Merge(Node& dst, const Node& src);
+    static Cone                     Union(const Cone& a, const Cone& b);
+    static float                    OrientationCost(const float cosThetaO, const float cosThetaE);
+
+private:
+    std::vector<Node>               mNodes;
+    std::vector<uint32_t>           mBitTrails;
+    uint32_t                        mDepth;
+    size_t                          mNumBuiltLeaves;        // by the last Build()
+    uint32_t                        mNumAppends;            // since
+};
@@ -0,0 +1,112 @@
+#include "materialtable.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+// the shading's diffuse term on top of the color, .mtl files have nothing like it
+static const float sMtlKd = 0.2f;
+// made up materials, the ranges the scenes always had
+static const float sDefaultMinColor = 0.5f;
+static const float sDefaultMaxColor = 1.0f;
+static const float sDefaultMinK = 0.1f;
+static const float sDefaultMaxK = 0.3f;
+static const float sDefaultShininess = 100.0f;
+
+// splitmix64, same sequence on every platform (unlike rand() or the std distributions)
+static uint64_t NextRandom(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// [min, max), 24 bits are all a float holds
+static float NextRandomFloat(uint64_t& state, const float min, const float max) {
+    const float u = static_cast<float>(NextRandom(state) >> 40) * (1.0f / 16777216.0f);
+    return min + (max - min) * u;
+}
+
+MaterialTable::MaterialTable() {
+}
+
+void MaterialTable::Clear() {
+    mMaterials.clear();
+    mIndices.clear();
+}
+
+uint32_t MaterialTable::Add(const Material& material) {
+    static_assert(sizeof(Material) == sizeof(Key), "Key has to cover every member of a material");
+    Key key;
+    memcpy(key.data(), &material, sizeof(Material));
+
+    auto it = mIndices.find(key);
+    if (it != mIndices.end()) {
+        return it->second;
+    }
+
+    const uint32_t index = static_cast<uint32_t>(mMaterials.size());
+    mMaterials.push_back(material);
+    mIndices.insert(std::make_pair(key, index));
+    return index;
+}
+
+MaterialTable::Material MaterialTable::FromMtl(const tinyobj::material_t& mtl, const uint32_t diffuseTexture) {
+    Material material = {};
+    material.color[0] = mtl.diffuse[0];
+    material.color[1] = mtl.diffuse[1];
+    material.color[2] = mtl.diffuse[2];
+    material.color[3] = std::min(std::max(mtl.dissolve, 0.0f), 1.0f);
+
+    material.params[0] = sMtlKd;
+    material.params[1] = std::max(mtl.specular[0], std::max(mtl.specular[1], mtl.specular[2]));
+    material.params[2] = static_cast<float>((mtl.illum == 3 || mtl.illum == 5 || mtl.illum == 7) ? MirrorType : DiffuseType);
+    material.params[3] = std::max(mtl.shininess, 1.0f);     // pow(x, 0) is undefined in the shaders
+
+    material.emission[0] = mtl.emission[0];
+    material.emission[1] = mtl.emission[1];
+    material.emission[2] = mtl.emission[2];
+
+    material.textures[0] = diffuseTexture;
+    material.textures[1] = material.textures[2] = material.textures[3] = NoTexture;
+    return material;
+}
+
+MaterialTable::Material MaterialTable::MakeDefault(const uint32_t seed, const uint32_t shapeIdx) {
+    uint64_t state = (static_cast<uint64_t>(seed) << 32) | shapeIdx;
+
+    Material material = {};
+    material.color[0] = NextRandomFloat(state, sDefaultMinColor, sDefaultMaxColor);
+    material.color[1] = NextRandomFloat(state, sDefaultMinColor, sDefaultMaxColor);
+    material.color[2] = NextRandomFloat(state, sDefaultMinColor, sDefaultMaxColor);
+    material.color[3] = 1.0f;
+
+    material.params[0] = NextRandomFloat(state, sDefaultMinK, sDefaultMaxK);
+    material.params[1] = NextRandomFloat(state, sDefaultMinK, sDefaultMaxK);
+    material.params[2] = static_cast<float>(DiffuseType);
+    material.params[3] = sDefaultShininess;
+
+    material.textures[0] = material.textures[1] = material.textures[2] = material.textures[3] = NoTexture;
+    return material;
+}
+
+bool MaterialTable::IsOpaque(const Material& material) {
+    return material.color[3] >= 1.0f;
+}
+
+bool MaterialTable::IsEmissive(const Material& material) {
+    return material.emission[0] > 0.0f || material.emission[1] > 0.0f || material.emission[2] > 0.0f;
+}
+
+size_t MaterialTable::GetNumMaterials() const {
+    return mMaterials.size();
+}
+
+const MaterialTable::Material& MaterialTable::GetMaterial(const uint32_t index) const {
+    assert(index < mMaterials.size());
+    return mMaterials[index];
+}
+
+const std::vector<MaterialTable::Material>& MaterialTable::GetMaterials() const {
+    return mMaterials;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "tiny_obj_loader.h"
+
+#include <vector>
+#include <map>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// The scene's distinct materials, what the shaders index per triangle (faces.w). A material is stored once however
+// many times it's added: two .mtl entries with the same parameters, shapes sharing a made up one...
+// Shapes without a material get one made up from a seed and their index only, so a scene renders the same every
+// run and whatever order its shapes are loaded in.
+class MaterialTable {
+public:
+    // same layout as MaterialData in shared.h
+    struct Material {
+        float   color[4];       // rgb - diffuse color (Kd), a - opacity (d)
+        float   params[4];      // x - kd, y - ks, z - type (SWS_MAT_*), w - shininess (Ns)
+        float   emission[4];    // rgb - radiance (Ke)
+        uint32_t textures[4];   // x - diffuse map (map_Kd), a TextureCache id
+    };
+
+    static const uint32_t NoTexture = ~0u;      // SWS_INVALID_ID
+
+    static const uint32_t DiffuseType = 0;     // SWS_MAT_DIFFUSE
+    static const uint32_t MirrorType = 3;      // SWS_MAT_MIRROR
+
+    MaterialTable();
+    ~MaterialTable() = default;
+
+    void                            Clear();
+    // index of the identical material if there's one already
+    uint32_t                        Add(const Material& material);
+
+    // Kd, Ks (the strongest channel), Ns, d & Ke as they are, illum 3, 5 & 7 (ray traced reflections) make mirrors.
+    // diffuseTexture - what map_Kd was registered as, NoTexture without one
+    static Material                 FromMtl(const tinyobj::material_t& mtl, const uint32_t diffuseTexture);
+    // a random diffuse material, the same for the same seed & shape
+    static Material                 MakeDefault(const uint32_t seed, const uint32_t shapeIdx);
+
+    static bool                     IsOpaque(const Material& material);
+    static bool                     IsEmissive(const Material& material);
+
+    size_t                          GetNumMaterials() const;
+    const Material&                 GetMaterial(const uint32_t index) const;
+    const std::vector<Material>&    GetMaterials() const;
+
+private:
+    typedef std::array<uint32_t, 16> Key;   // the bits of every member
+
+    std::vector<Material>           mMaterials;
+    std::map<Key, uint32_t>         mIndices;
+};
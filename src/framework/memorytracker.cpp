@@ -0,0 +1,225 @@
+#include "memorytracker.h"
+
+#include <algorithm>
+
+static const char* sCategoryNames[static_cast<size_t>(MemoryCategory::Count)] = {
+    "other",
+    "geometry",
+    "acceleration structures",
+    "AS build scratch",
+    "shader binding table",
+    "images",
+    "textures",
+    "readback",
+    "uniforms",
+    "overlay"
+};
+
+static thread_local const MemoryTracker::Scope* sCurrentScope = nullptr;
+
+static double ToMB(const uint64_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+
+MemoryTracker::Scope::Scope(const MemoryCategory category, const char* owner)
+    : mParent(sCurrentScope)
+    , mCategory(category)
+    , mOwner(owner ? owner : "") {
+    sCurrentScope = this;
+}
+
+MemoryTracker::Scope::Scope(const MemoryCategory category, const std::string& owner)
+    : mParent(sCurrentScope)
+    , mCategory(category)
+    , mOwner(owner) {
+    sCurrentScope = this;
+}
+
+MemoryTracker::Scope::~Scope() {
+    sCurrentScope = mParent;
+}
+
+
+MemoryTracker::MemoryTracker() {
+    this->Reset();
+}
+
+void MemoryTracker::OnAllocate(const uint64_t id, const uint64_t bytes) {
+    if (sCurrentScope) {
+        this->OnAllocate(id, bytes, sCurrentScope->mCategory, sCurrentScope->mOwner);
+    } else {
+        this->OnAllocate(id, bytes, MemoryCategory::Other, std::string());
+    }
+}
+
+void MemoryTracker::OnAllocate(const uint64_t id, const uint64_t bytes, const MemoryCategory category, const std::string& owner) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    // the driver handed the id out again, we missed its free
+    this->FreeLocked(id);
+
+    const size_t ownerIndex = this->GetOwnerLocked(category, owner);
+    mAllocations[id] = Allocation{ bytes, ownerIndex };
+
+    Add(mTotal, bytes);
+    Add(mCategories[static_cast<size_t>(category)], bytes);
+    Add(mOwners[ownerIndex].usage, bytes);
+}
+
+void MemoryTracker::OnFree(const uint64_t id) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    this->FreeLocked(id);
+}
+
+void MemoryTracker::Reset() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mAllocations.clear();
+    mOwners.clear();
+    mOwnerIndices.clear();
+    mTotal = Usage{};
+    for (Usage& usage : mCategories) {
+        usage = Usage{};
+    }
+}
+
+void MemoryTracker::ResetPeaks() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto reset = [](Usage& usage) {
+        usage.peakBytes = usage.bytes;
+        usage.peakAllocations = usage.allocations;
+    };
+    reset(mTotal);
+    for (Usage& usage : mCategories) {
+        reset(usage);
+    }
+    for (Owner& owner : mOwners) {
+        reset(owner.usage);
+    }
+}
+
+uint64_t MemoryTracker::GetAllocatedBytes() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mTotal.bytes;
+}
+
+uint64_t MemoryTracker::GetPeakBytes() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mTotal.peakBytes;
+}
+
+MemoryTracker::Usage MemoryTracker::GetUsage(const MemoryCategory category) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mCategories[static_cast<size_t>(category)];
+}
+
+void MemoryTracker::GetReport(Report& out) const {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        out.total = mTotal;
+        std::copy(mCategories, mCategories + static_cast<size_t>(MemoryCategory::Count), out.categories);
+
+        out.owners.clear();
+        for (const Owner& owner : mOwners) {
+            if (!owner.name.empty()) {
+                out.owners.push_back(OwnerUsage{ owner.name, owner.category, owner.usage });
+            }
+        }
+    }
+
+    std::stable_sort(out.owners.begin(), out.owners.end(), [](const OwnerUsage& a, const OwnerUsage& b) {
+        if (a.usage.bytes != b.usage.bytes) {
+            return a.usage.bytes > b.usage.bytes;
+        }
+        return a.usage.peakBytes > b.usage.peakBytes;
+    });
+}
+
+void MemoryTracker::PrintReport(FILE* file, const size_t maxOwners) const {
+    Report report;
+    this->GetReport(report);
+
+    size_t order[static_cast<size_t>(MemoryCategory::Count)];
+    for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order, order + static_cast<size_t>(MemoryCategory::Count), [&report](const size_t a, const size_t b) {
+        if (report.categories[a].bytes != report.categories[b].bytes) {
+            return report.categories[a].bytes > report.categories[b].bytes;
+        }
+        return report.categories[a].peakBytes > report.categories[b].peakBytes;
+    });
+
+    fprintf(file, "Device memory: %.2f MB in %u allocations, peak %.2f MB\n",
+            ToMB(report.total.bytes), report.total.allocations, ToMB(report.total.peakBytes));
+    fprintf(file, "  %-32s %10s %10s %7s\n", "category", "MB", "peak MB", "count");
+    for (const size_t i : order) {
+        const Usage& usage = report.categories[i];
+        if (!usage.peakBytes) {
+            continue;
+        }
+        fprintf(file, "  %-32s %10.2f %10.2f %7u\n", sCategoryNames[i], ToMB(usage.bytes), ToMB(usage.peakBytes), usage.allocations);
+    }
+
+    if (!report.owners.empty() && maxOwners) {
+        fprintf(file, "  %-32s %10s %10s %7s\n", "owner", "MB", "peak MB", "count");
+        const size_t numShown = std::min(maxOwners, report.owners.size());
+        for (size_t i = 0; i < numShown; ++i) {
+            const OwnerUsage& owner = report.owners[i];
+            const std::string name = owner.owner + " (" + GetCategoryName(owner.category) + ")";
+            fprintf(file, "  %-32s %10.2f %10.2f %7u\n", name.c_str(), ToMB(owner.usage.bytes), ToMB(owner.usage.peakBytes), owner.usage.allocations);
+        }
+        if (numShown < report.owners.size()) {
+            fprintf(file, "  ... %u more\n", static_cast<uint32_t>(report.owners.size() - numShown));
+        }
+    }
+}
+
+const char* MemoryTracker::GetCategoryName(const MemoryCategory category) {
+    const size_t index = static_cast<size_t>(category);
+    return (index < static_cast<size_t>(MemoryCategory::Count)) ? sCategoryNames[index] : "?";
+}
+
+void MemoryTracker::Add(Usage& usage, const uint64_t bytes) {
+    usage.bytes += bytes;
+    ++usage.allocations;
+    usage.peakBytes = std::max(usage.peakBytes, usage.bytes);
+    usage.peakAllocations = std::max(usage.peakAllocations, usage.allocations);
+}
+
+void MemoryTracker::Remove(Usage& usage, const uint64_t bytes) {
+    usage.bytes -= bytes;
+    --usage.allocations;
+}
+
+size_t MemoryTracker::GetOwnerLocked(const MemoryCategory category, const std::string& name) {
+    const std::string key = static_cast<char>(category) + name;
+    auto it = mOwnerIndices.find(key);
+    if (it != mOwnerIndices.end()) {
+        return it->second;
+    }
+
+    mOwners.push_back(Owner{ name, category, Usage{} });
+    mOwnerIndices[key] = mOwners.size() - 1;
+    return mOwners.size() - 1;
+}
+
+void MemoryTracker::FreeLocked(const uint64_t id) {
+    auto it = mAllocations.find(id);
+    if (it == mAllocations.end()) {
+        return;
+    }
+
+    const uint64_t bytes = it->second.bytes;
+    Owner& owner = mOwners[it->second.owner];
+    Remove(mTotal, bytes);
+    Remove(mCategories[static_cast<size_t>(owner.category)], bytes);
+    Remove(owner.usage, bytes);
+    mAllocations.erase(it);
+}
+
+
+MemoryTracker& GetMemoryTracker() {
+    static MemoryTracker tracker;
+    return tracker;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdio>
+
+// Device memory bookkeeping: every allocation is attributed to a category and an owner (a mesh, a frame in
+// flight...), current bytes and high-water marks are kept per category, per owner and overall.
+// It knows nothing about Vulkan, allocations are opaque ids and sizes. vulkanhelpers' Buffer and Image and the
+// acceleration structures report into the global instance; anything else that hands out ids can drive one of
+// its own (that's how it's tested).
+// Allocations are tagged with the innermost MemoryTracker::Scope of the calling thread at the time they're made,
+// so call sites don't have to pass anything down to Buffer::Create.
+enum class MemoryCategory : uint32_t {
+    Other = 0,
+    Geometry,               // vertex, index & per mesh buffers, light tables
+    AccelerationStructure,
+    Scratch,                // AS build scratch, freed once the build is done
+    ShaderBindingTable,
+    Image,                  // render targets & AOVs
+    Texture,                // streamed textures, their staging buffers & tables
+    Readback,               // host copies of the frame, for the denoiser & captures
+    Uniform,
+    Overlay,
+    Count
+};
+
+class MemoryTracker {
+public:
+    struct Usage {
+        uint64_t    bytes;
+        uint64_t    peakBytes;
+        uint32_t    allocations;
+        uint32_t    peakAllocations;
+    };
+
+    struct OwnerUsage {
+        std::string     owner;
+        MemoryCategory  category;
+        Usage           usage;
+    };
+
+    struct Report {
+        Usage                   total;
+        Usage                   categories[static_cast<size_t>(MemoryCategory::Count)];
+        std::vector<OwnerUsage> owners;     // attributed ones, largest first, then by peak
+    };
+
+    // tags the allocations the current thread makes while it's alive, scopes nest.
+    // owner is copied, nullptr or "" leaves the allocations unattributed
+    class Scope {
+    public:
+        Scope(const MemoryCategory category, const char* owner = nullptr);
+        Scope(const MemoryCategory category, const std::string& owner);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const Scope*    mParent;
+        MemoryCategory  mCategory;
+        std::string     mOwner;
+
+        friend class MemoryTracker;
+    };
+
+    MemoryTracker();
+    ~MemoryTracker() = default;
+
+    // with the calling thread's scope, or explicitly. An id already live is released first
+    void            OnAllocate(const uint64_t id, const uint64_t bytes);
+    void            OnAllocate(const uint64_t id, const uint64_t bytes, const MemoryCategory category, const std::string& owner);
+    // unknown ids are ignored (allocations made before tracking or with the tracker off)
+    void            OnFree(const uint64_t id);
+
+    void            Reset();
+    // high-water marks start over from what's allocated now
+    void            ResetPeaks();
+
+    uint64_t        GetAllocatedBytes() const;
+    uint64_t        GetPeakBytes() const;
+    Usage           GetUsage(const MemoryCategory category) const;
+    void            GetReport(Report& out) const;
+    // categories and the top maxOwners owners, largest first
+    void            PrintReport(FILE* file = stdout, const size_t maxOwners = 16) const;
+
+    static const char* GetCategoryName(const MemoryCategory category);
+
+private:
+    struct Allocation {
+        uint64_t    bytes;
+        size_t      owner;      // into mOwners
+    };
+
+    struct Owner {
+        std::string     name;
+        MemoryCategory  category;
+        Usage           usage;
+    };
+
+    static void     Add(Usage& usage, const uint64_t bytes);
+    static void     Remove(Usage& usage, const uint64_t bytes);
+    size_t          GetOwnerLocked(const MemoryCategory category, const std::string& name);
+    void            FreeLocked(const uint64_t id);
+
+private:
+    mutable std::mutex                          mMutex;
+    std::unordered_map<uint64_t, Allocation>    mAllocations;
+    std::vector<Owner>                          mOwners;        // (category, name) pairs ever seen
+    std::unordered_map<std::string, size_t>     mOwnerIndices;  // category byte + name
+    Usage                                       mTotal;
+    Usage                                       mCategories[static_cast<size_t>(MemoryCategory::Count)];
+};
+
+// the one vulkanhelpers and the app report into
+MemoryTracker& GetMemoryTracker();
@@ -0,0 +1,65 @@
+#include "objmesh.h"
+#include "shared.h"
+
+#include <cassert>
+
+void FillObjMeshBuffers(const tinyobj::attrib_t& attrib, const tinyobj::shape_t& shape, const std::vector<uint32_t>& materialIndices,
+                        const uint32_t defaultMaterial, const ObjMeshBuffers& out) {
+    const size_t numFaces = shape.mesh.num_face_vertices.size();
+
+    size_t vIdx = 0;
+    for (size_t f = 0; f < numFaces; ++f) {
+        assert(shape.mesh.num_face_vertices[f] == 3);
+        vec3 corners[3];
+        vec2 cornerUVs[3];
+        for (size_t j = 0; j < 3; ++j, ++vIdx) {
+            const tinyobj::index_t& i = shape.mesh.indices[vIdx];
+
+            float* pos = out.positions + 3 * vIdx;
+            float* normal = out.attribs + 8 * vIdx;
+            float* uv = normal + 4;
+
+            // kept around for the face's LOD constant, the buffers may be uncached device memory
+            corners[j] = vec3(attrib.vertices[3 * i.vertex_index + 0], attrib.vertices[3 * i.vertex_index + 1], attrib.vertices[3 * i.vertex_index + 2]);
+            pos[0] = corners[j].x;
+            pos[1] = corners[j].y;
+            pos[2] = corners[j].z;
+            if (i.normal_index >= 0) {
+                normal[0] = attrib.normals[3 * i.normal_index + 0];
+                normal[1] = attrib.normals[3 * i.normal_index + 1];
+                normal[2] = attrib.normals[3 * i.normal_index + 2];
+            } else {
+                normal[0] = normal[1] = normal[2] = 0.0f;
+            }
+            normal[3] = 0.0f;
+            if (i.texcoord_index >= 0) {
+                // .obj's v goes up from the bottom row, the textures' rows start at the top
+                cornerUVs[j] = vec2(attrib.texcoords[2 * i.texcoord_index + 0], 1.0f - attrib.texcoords[2 * i.texcoord_index + 1]);
+            } else {
+                cornerUVs[j] = vec2(0.0f, 0.0f);
+            }
+            uv[0] = cornerUVs[j].x;
+            uv[1] = cornerUVs[j].y;
+            uv[3] = 0.0f;
+        }
+
+        // the ray cones' texel density of the face, on each of its vertices
+        const float lodConstant = TriangleLodConstant(corners[0], corners[1], corners[2], cornerUVs[0], cornerUVs[1], cornerUVs[2]);
+        for (size_t j = 0; j < 3; ++j) {
+            out.attribs[8 * (vIdx - 3 + j) + 6] = lodConstant;
+        }
+
+        const uint32_t a = static_cast<uint32_t>(3 * f + 0);
+        const uint32_t b = static_cast<uint32_t>(3 * f + 1);
+        const uint32_t c = static_cast<uint32_t>(3 * f + 2);
+        out.indices[a] = a;
+        out.indices[b] = b;
+        out.indices[c] = c;
+
+        out.faces[4 * f + 0] = a;
+        out.faces[4 * f + 1] = b;
+        out.faces[4 * f + 2] = c;
+        const int materialId = (f < shape.mesh.material_ids.size()) ? shape.mesh.material_ids[f] : -1;
+        out.faces[4 * f + 3] = (materialId >= 0 && static_cast<size_t>(materialId) < materialIndices.size()) ? materialIndices[materialId] : defaultMaterial;
+    }
+}
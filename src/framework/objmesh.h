@@ -0,0 +1,26 @@
+#pragma once
+
+#include "tiny_obj_loader.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Where a triangulated tinyobj shape is unpacked to, laid out the way the shaders read it:
+// positions - 3 floats per vertex (vec3), attribs - VertexAttribute (normal.xyz0, uv.xy, its face's TriangleLodConstant, 0) per vertex,
+// indices - 3 per face, faces - 4 per face (the 3 vertex indices + its material).
+// Vertices are de-indexed, face f owns vertices 3f .. 3f+2.
+struct ObjMeshBuffers {
+    float*      positions;
+    float*      attribs;
+    uint32_t*   indices;
+    uint32_t*   faces;
+};
+
+static const size_t kObjPositionSize = 3 * sizeof(float);
+static const size_t kObjAttribSize = 8 * sizeof(float);
+
+// shape has to be triangulated, missing normals / uvs come out as zeros. A face's material is materialIndices[its
+// tinyobj material id] (MaterialTable indices), defaultMaterial for faces without one
+void FillObjMeshBuffers(const tinyobj::attrib_t& attrib, const tinyobj::shape_t& shape, const std::vector<uint32_t>& materialIndices,
+                        const uint32_t defaultMaterial, const ObjMeshBuffers& out);
@@ -0,0 +1,70 @@
+#include "objprimitives.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+bool LoadObjPrimitives(const std::string& fileName, const std::vector<std::string>& materialNames, std::vector<ObjPrimitive>& primitives) {
+    primitives.clear();
+
+    std::ifstream file(fileName);
+    if (!file) {
+        return false;
+    }
+
+    uint32_t material = kObjNoMaterial;
+    std::string line, keyword;
+    size_t lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+
+        // most lines are vertices & faces, those are tinyobj's
+        const size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || (line[first] != 's' && line[first] != 'c' && line[first] != 'u')) {
+            continue;
+        }
+
+        std::istringstream tokens(line);
+        tokens >> keyword;
+        if (keyword == "usemtl") {
+            // the first name only, as tinyobj reads it. Unknown names leave what follows without a material, same as its faces
+            std::string name;
+            tokens >> name;
+            const std::vector<std::string>::const_iterator it = std::find(materialNames.begin(), materialNames.end(), name);
+            material = (it != materialNames.end()) ? static_cast<uint32_t>(it - materialNames.begin()) : kObjNoMaterial;
+            continue;
+        }
+        if (keyword != "sphere" && keyword != "capsule") {
+            continue;
+        }
+
+        ObjPrimitive primitive = {};
+        primitive.info[0] = (keyword == "sphere") ? kObjSphere : kObjCapsule;
+        primitive.info[1] = material;
+        bool ok;
+        if (primitive.info[0] == kObjSphere) {
+            ok = static_cast<bool>(tokens >> primitive.p0[0] >> primitive.p0[1] >> primitive.p0[2] >> primitive.p0[3]);
+            std::copy(primitive.p0, primitive.p0 + 3, primitive.p1);
+        } else {
+            ok = static_cast<bool>(tokens >> primitive.p0[0] >> primitive.p0[1] >> primitive.p0[2]
+                                          >> primitive.p1[0] >> primitive.p1[1] >> primitive.p1[2] >> primitive.p0[3]);
+        }
+        if (!ok || !(primitive.p0[3] > 0.0f)) {
+            printf("%s:%u: skipping \"%s\", expected %s\n", fileName.c_str(), static_cast<uint32_t>(lineNumber), line.c_str(),
+                   (primitive.info[0] == kObjSphere) ? "sphere x y z radius" : "capsule x0 y0 z0 x1 y1 z1 radius");
+            continue;
+        }
+        primitives.push_back(primitive);
+    }
+    return true;
+}
+
+void GetObjPrimitiveBounds(const ObjPrimitive& primitive, float bounds[6]) {
+    // both ends' spheres, the capsule's cylinder stays between them
+    const float radius = primitive.p0[3];
+    for (int k = 0; k < 3; ++k) {
+        bounds[k] = std::min(primitive.p0[k], primitive.p1[k]) - radius;
+        bounds[3 + k] = std::max(primitive.p0[k], primitive.p1[k]) + radius;
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Spheres & capsules of a scene, traced as what they are instead of as triangles: an AABB each in a procedural
+// BLAS, the intersection shader (analytic_ray_rint.glsl) finds the surface inside. The .obj describes them along
+// with its polygons, in statements tinyobj skips:
+//   sphere  x y z radius
+//   capsule x0 y0 z0 x1 y1 z1 radius
+// each one gets the material of the usemtl before it, the way faces do.
+
+// same layout as AnalyticPrimitive in shared.h
+struct ObjPrimitive {
+    float       p0[4];          // xyz - sphere center / capsule first end, w - radius
+    float       p1[4];          // xyz - capsule second end, the center again for spheres
+    uint32_t    info[4];        // x - type, y - material: its .mtl index (tinyobj's order) as loaded, kObjNoMaterial without one
+};
+
+static const uint32_t kObjSphere = 0;           // SWS_ANALYTIC_SPHERE
+static const uint32_t kObjCapsule = 1;          // SWS_ANALYTIC_CAPSULE
+static const uint32_t kObjNoMaterial = ~0u;
+
+// materialNames - of the materials tinyobj loaded, in its order. False when the file can't be read, statements that
+// don't parse (or have no radius) are skipped with a message
+bool    LoadObjPrimitives(const std::string& fileName, const std::vector<std::string>& materialNames, std::vector<ObjPrimitive>& primitives);
+
+// min xyz, then max xyz (VkAabbPositionsKHR)
+void    GetObjPrimitiveBounds(const ObjPrimitive& primitive, float bounds[6]);
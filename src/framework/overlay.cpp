@@ -0,0 +1,609 @@
+#include "overlay.h"
+#include "memorytracker.h"
+
+#include "imgui.h"
+#include "imgui_impl_glfw.h"
+#include "GLFW/glfw3.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// overlay_vert.glsl: ImGui's display coordinates to clip space
+struct OverlayPushConstants {
+    float scale[2];
+    float translate[2];
+};
+
+static const VkDeviceSize kMinBufferSize = 64 * 1024;
+
+Overlay::Overlay()
+    : mDevice(VK_NULL_HANDLE)
+    , mQueue(VK_NULL_HANDLE)
+    , mExtent({ 0, 0 })
+    , mCommandPool(VK_NULL_HANDLE)
+    , mRenderPass(VK_NULL_HANDLE)
+    , mDescriptorSetLayout(VK_NULL_HANDLE)
+    , mDescriptorPool(VK_NULL_HANDLE)
+    , mDescriptorSet(VK_NULL_HANDLE)
+    , mPipelineLayout(VK_NULL_HANDLE)
+    , mPipeline(VK_NULL_HANDLE)
+    , mImGuiInitialized(false)
+    , mVisible(false) {
+}
+
+Overlay::~Overlay() {
+    this->Destroy();
+}
+
+bool Overlay::Initialize(GLFWwindow* window, VkDevice device, VkQueue queue, const uint32_t queueFamilyIndex,
+                         VkFormat colorFormat, VkExtent2D extent, const Array<VkImageView>& imageViews) {
+    this->Destroy();
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;   // windows start where the code puts them, no imgui.ini next to the executable
+    io.BackendRendererName = "rtxON_vulkan";
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+    ImGui::StyleColorsDark();
+    ImGui_ImplGlfw_InitForVulkan(window, true);
+    mImGuiInitialized = true;
+
+    mDevice = device;
+    mQueue = queue;
+    mExtent = extent;
+
+    // its own pool: the overlay's command buffers are reset every frame
+    VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+
+    VkResult error = vkCreateCommandPool(mDevice, &commandPoolCreateInfo, nullptr, &mCommandPool);
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "vkCreateCommandPool");
+        this->Destroy();
+        return false;
+    }
+
+    if (!this->CreateRenderPass(colorFormat) || !this->CreatePipeline() || !this->CreateFontTexture()) {
+        this->Destroy();
+        return false;
+    }
+
+    mFrames.resize(imageViews.size());
+    Array<VkCommandBuffer> commandBuffers(mFrames.size());
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.commandPool = mCommandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+    error = vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, commandBuffers.data());
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "vkAllocateCommandBuffers");
+        this->Destroy();
+        return false;
+    }
+
+    for (size_t i = 0; i < mFrames.size(); ++i) {
+        FrameResources& frame = mFrames[i];
+        frame.commandBuffer = commandBuffers[i];
+
+        VkFramebufferCreateInfo framebufferCreateInfo = {};
+        framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferCreateInfo.renderPass = mRenderPass;
+        framebufferCreateInfo.attachmentCount = 1;
+        framebufferCreateInfo.pAttachments = &imageViews[i];
+        framebufferCreateInfo.width = mExtent.width;
+        framebufferCreateInfo.height = mExtent.height;
+        framebufferCreateInfo.layers = 1;
+
+        frame.framebuffer = VK_NULL_HANDLE;
+        error = vkCreateFramebuffer(mDevice, &framebufferCreateInfo, nullptr, &frame.framebuffer);
+        if (VK_SUCCESS != error) {
+            CHECK_VK_ERROR(error, "vkCreateFramebuffer");
+            this->Destroy();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Overlay::Destroy() {
+    if (mImGuiInitialized) {
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+        mImGuiInitialized = false;
+    }
+    mVisible = false;
+
+    if (!mDevice) {
+        return;
+    }
+
+    for (FrameResources& frame : mFrames) {
+        if (frame.framebuffer) {
+            vkDestroyFramebuffer(mDevice, frame.framebuffer, nullptr);
+        }
+        if (frame.commandBuffer) {
+            vkFreeCommandBuffers(mDevice, mCommandPool, 1, &frame.commandBuffer);
+        }
+        frame.vertices.Destroy();
+        frame.indices.Destroy();
+    }
+    mFrames.clear();
+
+    mFontImage.Destroy();
+
+    if (mPipeline) {
+        vkDestroyPipeline(mDevice, mPipeline, nullptr);
+        mPipeline = VK_NULL_HANDLE;
+    }
+    if (mPipelineLayout) {
+        vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+        mPipelineLayout = VK_NULL_HANDLE;
+    }
+    if (mDescriptorPool) {
+        vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
+        mDescriptorPool = VK_NULL_HANDLE;
+        mDescriptorSet = VK_NULL_HANDLE;
+    }
+    if (mDescriptorSetLayout) {
+        vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout, nullptr);
+        mDescriptorSetLayout = VK_NULL_HANDLE;
+    }
+    if (mRenderPass) {
+        vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
+        mRenderPass = VK_NULL_HANDLE;
+    }
+    if (mCommandPool) {
+        vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
+        mCommandPool = VK_NULL_HANDLE;
+    }
+
+    mDevice = VK_NULL_HANDLE;
+}
+
+bool Overlay::IsInitialized() const {
+    return mPipeline != VK_NULL_HANDLE && !mFrames.empty();
+}
+
+bool Overlay::IsVisible() const {
+    return mVisible;
+}
+
+void Overlay::SetVisible(const bool visible) {
+    mVisible = visible && this->IsInitialized();
+}
+
+bool Overlay::WantsMouse() const {
+    // ImGui keeps the flags of the last frame it ran, stale once hidden
+    return mVisible && ImGui::GetIO().WantCaptureMouse;
+}
+
+bool Overlay::WantsKeyboard() const {
+    return mVisible && ImGui::GetIO().WantCaptureKeyboard;
+}
+
+void Overlay::BeginFrame() {
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+}
+
+VkCommandBuffer Overlay::EndFrame(const size_t imageIndex) {
+    ImGui::Render();
+
+    FrameResources& frame = mFrames[imageIndex];
+    this->RecordDrawData(frame);
+    return frame.commandBuffer;
+}
+
+bool Overlay::CreateRenderPass(VkFormat colorFormat) {
+    // draws on top of what the frame's command buffer copied into the swapchain image, which is
+    // already in PRESENT_SRC by then - and has to stay there
+    VkAttachmentDescription attachment = {};
+    attachment.format = colorFormat;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorReference;
+
+    // after the copy into the swapchain image
+    VkSubpassDependency dependency = {};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    VkRenderPassCreateInfo renderPassCreateInfo = {};
+    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassCreateInfo.attachmentCount = 1;
+    renderPassCreateInfo.pAttachments = &attachment;
+    renderPassCreateInfo.subpassCount = 1;
+    renderPassCreateInfo.pSubpasses = &subpass;
+    renderPassCreateInfo.dependencyCount = 1;
+    renderPassCreateInfo.pDependencies = &dependency;
+
+    const VkResult error = vkCreateRenderPass(mDevice, &renderPassCreateInfo, nullptr, &mRenderPass);
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "vkCreateRenderPass");
+        return false;
+    }
+    return true;
+}
+
+bool Overlay::CreatePipeline() {
+    vulkanhelpers::Shader vertexShader, fragmentShader;
+    if (!vertexShader.Load("overlay_vert.bin") || !fragmentShader.Load("overlay_frag.bin")) {
+        printf("Overlay: can't load overlay_vert.bin / overlay_frag.bin, overlay disabled\n");
+        return false;
+    }
+
+    VkDescriptorSetLayoutBinding fontBinding = {};
+    fontBinding.binding = 0;
+    fontBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    fontBinding.descriptorCount = 1;
+    fontBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {};
+    setLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutCreateInfo.bindingCount = 1;
+    setLayoutCreateInfo.pBindings = &fontBinding;
+
+    VkResult error = vkCreateDescriptorSetLayout(mDevice, &setLayoutCreateInfo, nullptr, &mDescriptorSetLayout);
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "vkCreateDescriptorSetLayout");
+        return false;
+    }
+
+    VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(OverlayPushConstants) };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &mDescriptorSetLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    error = vkCreatePipelineLayout(mDevice, &pipelineLayoutCreateInfo, nullptr, &mPipelineLayout);
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "vkCreatePipelineLayout");
+        return false;
+    }
+
+    const VkPipelineShaderStageCreateInfo stages[2] = {
+        vertexShader.GetShaderStage(VK_SHADER_STAGE_VERTEX_BIT),
+        fragmentShader.GetShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT)
+    };
+
+    VkVertexInputBindingDescription vertexBinding = { 0, sizeof(ImDrawVert), VK_VERTEX_INPUT_RATE_VERTEX };
+    const VkVertexInputAttributeDescription vertexAttributes[3] = {
+        { 0, 0, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(IM_OFFSETOF(ImDrawVert, pos)) },
+        { 1, 0, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(IM_OFFSETOF(ImDrawVert, uv)) },
+        { 2, 0, VK_FORMAT_R8G8B8A8_UNORM, static_cast<uint32_t>(IM_OFFSETOF(ImDrawVert, col)) },
+    };
+
+    VkPipelineVertexInputStateCreateInfo vertexInputState = {};
+    vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputState.vertexBindingDescriptionCount = 1;
+    vertexInputState.pVertexBindingDescriptions = &vertexBinding;
+    vertexInputState.vertexAttributeDescriptionCount = 3;
+    vertexInputState.pVertexAttributeDescriptions = vertexAttributes;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {};
+    inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationState = {};
+    rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationState.cullMode = VK_CULL_MODE_NONE;
+    rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizationState.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampleState = {};
+    multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // straight alpha, as ImGui outputs it
+    VkPipelineColorBlendAttachmentState blendAttachment = {};
+    blendAttachment.blendEnable = VK_TRUE;
+    blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendState = {};
+    colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendState.attachmentCount = 1;
+    colorBlendState.pAttachments = &blendAttachment;
+
+    const VkDynamicState dynamicStates[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.stageCount = 2;
+    pipelineCreateInfo.pStages = stages;
+    pipelineCreateInfo.pVertexInputState = &vertexInputState;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+    pipelineCreateInfo.pViewportState = &viewportState;
+    pipelineCreateInfo.pRasterizationState = &rasterizationState;
+    pipelineCreateInfo.pMultisampleState = &multisampleState;
+    pipelineCreateInfo.pColorBlendState = &colorBlendState;
+    pipelineCreateInfo.pDynamicState = &dynamicState;
+    pipelineCreateInfo.layout = mPipelineLayout;
+    pipelineCreateInfo.renderPass = mRenderPass;
+    pipelineCreateInfo.subpass = 0;
+
+    error = vkCreateGraphicsPipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &mPipeline);
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "vkCreateGraphicsPipelines");
+        mPipeline = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+bool Overlay::CreateFontTexture() {
+    ImGuiIO& io = ImGui::GetIO();
+
+    unsigned char* pixels = nullptr;
+    int width = 0, height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    const VkDeviceSize size = static_cast<VkDeviceSize>(width) * height * 4;
+
+    MemoryTracker::Scope memoryScope(MemoryCategory::Overlay, "font");
+    vulkanhelpers::Buffer staging;
+    VkResult error = staging.Create(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (VK_SUCCESS != error || !staging.UploadData(pixels, size)) {
+        CHECK_VK_ERROR(error, "staging.Create");
+        return false;
+    }
+
+    const VkExtent3D extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
+    VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    error = mFontImage.Create(VK_IMAGE_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, extent, VK_IMAGE_TILING_OPTIMAL,
+                              VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (VK_SUCCESS == error) {
+        error = mFontImage.CreateImageView(VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, range);
+    }
+    if (VK_SUCCESS == error) {
+        error = mFontImage.CreateSampler(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+    }
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "font image");
+        return false;
+    }
+
+    // one-off upload, the app isn't rendering yet
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.commandPool = mCommandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    error = vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &commandBuffer);
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "vkAllocateCommandBuffers");
+        return false;
+    }
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    copyRegion.imageExtent = extent;
+
+    vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+    vulkanhelpers::ImageBarrier(commandBuffer, mFontImage.GetImage(), range,
+                                0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    vkCmdCopyBufferToImage(commandBuffer, staging.GetBuffer(), mFontImage.GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+    vulkanhelpers::ImageBarrier(commandBuffer, mFontImage.GetImage(), range,
+                                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    error = vkQueueSubmit(mQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    if (VK_SUCCESS == error) {
+        error = vkQueueWaitIdle(mQueue);
+    }
+    vkFreeCommandBuffers(mDevice, mCommandPool, 1, &commandBuffer);
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "font upload");
+        return false;
+    }
+    // the atlas lives on the GPU now
+    io.Fonts->ClearTexData();
+
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 };
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
+    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolCreateInfo.maxSets = 1;
+    descriptorPoolCreateInfo.poolSizeCount = 1;
+    descriptorPoolCreateInfo.pPoolSizes = &poolSize;
+
+    error = vkCreateDescriptorPool(mDevice, &descriptorPoolCreateInfo, nullptr, &mDescriptorPool);
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "vkCreateDescriptorPool");
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.descriptorPool = mDescriptorPool;
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &mDescriptorSetLayout;
+
+    error = vkAllocateDescriptorSets(mDevice, &descriptorSetAllocateInfo, &mDescriptorSet);
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "vkAllocateDescriptorSets");
+        return false;
+    }
+
+    VkDescriptorImageInfo fontInfo = { mFontImage.GetSampler(), mFontImage.GetImageView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+    VkWriteDescriptorSet fontWrite = {};
+    fontWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    fontWrite.dstSet = mDescriptorSet;
+    fontWrite.dstBinding = 0;
+    fontWrite.descriptorCount = 1;
+    fontWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    fontWrite.pImageInfo = &fontInfo;
+
+    vkUpdateDescriptorSets(mDevice, 1, &fontWrite, 0, nullptr);
+    return true;
+}
+
+bool Overlay::EnsureBufferSize(vulkanhelpers::Buffer& buffer, const VkDeviceSize size, VkBufferUsageFlags usage) {
+    if (buffer.GetBuffer() && buffer.GetSize() >= size) {
+        return true;
+    }
+
+    // grows in powers of two, so a few frames in the buffers stop changing
+    VkDeviceSize capacity = kMinBufferSize;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+
+    MemoryTracker::Scope memoryScope(MemoryCategory::Overlay);
+    buffer.Destroy();
+    const VkResult error = buffer.Create(capacity, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "overlay buffer Create");
+        return false;
+    }
+    return true;
+}
+
+void Overlay::RecordDrawData(FrameResources& frame) {
+    const ImDrawData* drawData = ImGui::GetDrawData();
+    const VkCommandBuffer commandBuffer = frame.commandBuffer;
+
+    const bool hasGeometry = drawData && drawData->TotalVtxCount > 0 &&
+        this->EnsureBufferSize(frame.vertices, drawData->TotalVtxCount * sizeof(ImDrawVert), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) &&
+        this->EnsureBufferSize(frame.indices, drawData->TotalIdxCount * sizeof(ImDrawIdx), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+    if (hasGeometry) {
+        ImDrawVert* vertices = reinterpret_cast<ImDrawVert*>(frame.vertices.Map());
+        ImDrawIdx* indices = reinterpret_cast<ImDrawIdx*>(frame.indices.Map());
+        for (int i = 0; i < drawData->CmdListsCount; ++i) {
+            const ImDrawList* cmdList = drawData->CmdLists[i];
+            memcpy(vertices, cmdList->VtxBuffer.Data, cmdList->VtxBuffer.Size * sizeof(ImDrawVert));
+            memcpy(indices, cmdList->IdxBuffer.Data, cmdList->IdxBuffer.Size * sizeof(ImDrawIdx));
+            vertices += cmdList->VtxBuffer.Size;
+            indices += cmdList->IdxBuffer.Size;
+        }
+        frame.vertices.Unmap();
+        frame.indices.Unmap();
+    }
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VkResult error = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+    CHECK_VK_ERROR(error, "vkBeginCommandBuffer");
+
+    VkRenderPassBeginInfo renderPassBeginInfo = {};
+    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassBeginInfo.renderPass = mRenderPass;
+    renderPassBeginInfo.framebuffer = frame.framebuffer;
+    renderPassBeginInfo.renderArea.extent = mExtent;
+    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    if (hasGeometry) {
+        const VkDeviceSize vertexOffset = 0;
+        const VkBuffer vertexBuffer = frame.vertices.GetBuffer();
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &mDescriptorSet, 0, nullptr);
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &vertexOffset);
+        vkCmdBindIndexBuffer(commandBuffer, frame.indices.GetBuffer(), 0, sizeof(ImDrawIdx) == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
+        const VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(mExtent.width), static_cast<float>(mExtent.height), 0.0f, 1.0f };
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        OverlayPushConstants pushConstants;
+        pushConstants.scale[0] = 2.0f / drawData->DisplaySize.x;
+        pushConstants.scale[1] = 2.0f / drawData->DisplaySize.y;
+        pushConstants.translate[0] = -1.0f - drawData->DisplayPos.x * pushConstants.scale[0];
+        pushConstants.translate[1] = -1.0f - drawData->DisplayPos.y * pushConstants.scale[1];
+        vkCmdPushConstants(commandBuffer, mPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+        // clip rects are in display coordinates, scissors in framebuffer pixels
+        const ImVec2 clipOffset = drawData->DisplayPos;
+        const ImVec2 clipScale = drawData->FramebufferScale;
+
+        uint32_t globalVertexOffset = 0, globalIndexOffset = 0;
+        for (int i = 0; i < drawData->CmdListsCount; ++i) {
+            const ImDrawList* cmdList = drawData->CmdLists[i];
+            for (int j = 0; j < cmdList->CmdBuffer.Size; ++j) {
+                const ImDrawCmd& cmd = cmdList->CmdBuffer[j];
+                if (cmd.UserCallback) {
+                    cmd.UserCallback(cmdList, &cmd);
+                    continue;
+                }
+
+                const float x0 = std::max((cmd.ClipRect.x - clipOffset.x) * clipScale.x, 0.0f);
+                const float y0 = std::max((cmd.ClipRect.y - clipOffset.y) * clipScale.y, 0.0f);
+                const float x1 = std::min((cmd.ClipRect.z - clipOffset.x) * clipScale.x, static_cast<float>(mExtent.width));
+                const float y1 = std::min((cmd.ClipRect.w - clipOffset.y) * clipScale.y, static_cast<float>(mExtent.height));
+                if (x1 <= x0 || y1 <= y0) {
+                    continue;
+                }
+
+                VkRect2D scissor;
+                scissor.offset = { static_cast<int32_t>(x0), static_cast<int32_t>(y0) };
+                scissor.extent = { static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(y1 - y0) };
+                vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+                vkCmdDrawIndexed(commandBuffer, cmd.ElemCount, 1,
+                                 globalIndexOffset + cmd.IdxOffset,
+                                 static_cast<int32_t>(globalVertexOffset + cmd.VtxOffset), 0);
+            }
+            globalVertexOffset += static_cast<uint32_t>(cmdList->VtxBuffer.Size);
+            globalIndexOffset += static_cast<uint32_t>(cmdList->IdxBuffer.Size);
+        }
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+
+    error = vkEndCommandBuffer(commandBuffer);
+    CHECK_VK_ERROR(error, "vkEndCommandBuffer");
+}
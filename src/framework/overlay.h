@@ -0,0 +1,67 @@
+#pragma once
+
+#include "vulkanhelpers.h"
+#include "common.h"
+
+struct GLFWwindow;
+
+// ImGui drawn over the swapchain images, for the performance panel and the runtime controls.
+// The bundled imgui_impl_vk backend calls Vulkan prototypes (we go through volk) and shares one vertex buffer
+// between all the frames in flight, so this is a small renderer of its own: one render pass that loads what the
+// frame's command buffer presented, one pipeline, and per swapchain image a command buffer with its vertex and
+// index buffers, re-recorded every frame the overlay is shown and submitted right after the frame's one.
+// Hidden, it costs nothing - no ImGui frame, no recording, no extra submit.
+class Overlay {
+public:
+    Overlay();
+    ~Overlay();
+
+    // false (and the overlay stays off) if its shaders or any Vulkan object couldn't be created.
+    // Call after the app installed its GLFW callbacks, ImGui chains them
+    bool            Initialize(GLFWwindow* window, VkDevice device, VkQueue queue, const uint32_t queueFamilyIndex,
+                               VkFormat colorFormat, VkExtent2D extent, const Array<VkImageView>& imageViews);
+    void            Destroy();   // device idle
+
+    bool            IsInitialized() const;
+    bool            IsVisible() const;
+    void            SetVisible(const bool visible);
+
+    // input ImGui is using this frame, the app shouldn't act on it
+    bool            WantsMouse() const;
+    bool            WantsKeyboard() const;
+
+    // ImGui calls go between the two. Both only when visible
+    void            BeginFrame();
+    // after the image's fence: it's free to be re-recorded
+    VkCommandBuffer EndFrame(const size_t imageIndex);
+
+private:
+    struct FrameResources {
+        VkCommandBuffer         commandBuffer;
+        VkFramebuffer           framebuffer;
+        vulkanhelpers::Buffer   vertices;
+        vulkanhelpers::Buffer   indices;
+    };
+
+    bool            CreateRenderPass(VkFormat colorFormat);
+    bool            CreatePipeline();
+    bool            CreateFontTexture();
+    bool            EnsureBufferSize(vulkanhelpers::Buffer& buffer, const VkDeviceSize size, VkBufferUsageFlags usage);
+    void            RecordDrawData(FrameResources& frame);
+
+private:
+    VkDevice                mDevice;
+    VkQueue                 mQueue;
+    VkExtent2D              mExtent;
+    VkCommandPool           mCommandPool;
+    VkRenderPass            mRenderPass;
+    VkDescriptorSetLayout   mDescriptorSetLayout;
+    VkDescriptorPool        mDescriptorPool;
+    VkDescriptorSet         mDescriptorSet;
+    VkPipelineLayout        mPipelineLayout;
+    VkPipeline              mPipeline;
+    vulkanhelpers::Image    mFontImage;
+    Array<FrameResources>   mFrames;            // per swapchain image
+    bool                    mImGuiInitialized;
+    bool                    mVisible;
+};
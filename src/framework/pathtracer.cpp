@@ -0,0 +1,53 @@
+#include "pathtracer.h"
+
+#include <algorithm>
+
+PathTracer::PathTracer() {
+    mSettings.maxDepth = 8;
+    mSettings.rouletteMinDepth = 3;
+    mSettings.maxSurvival = 0.95f;
+    mSettings.russianRoulette = true;
+}
+
+PathTracer::Settings& PathTracer::GetSettings() {
+    return mSettings;
+}
+
+uint32_t PathTracer::Trace(const VertexFunc& vertexFunc, const RandomFunc& randomFunc, float radiance[3]) const {
+    float throughput[3] = { 1.0f, 1.0f, 1.0f };
+    radiance[0] = radiance[1] = radiance[2] = 0.0f;
+
+    uint32_t depth = 0;
+    while (depth < mSettings.maxDepth) {
+        Vertex vertex = {};
+        vertexFunc(depth, vertex);
+        ++depth;
+
+        for (int k = 0; k < 3; ++k) {
+            radiance[k] += throughput[k] * vertex.radiance[k];
+        }
+        if (vertex.terminate) {
+            break;
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            throughput[k] *= vertex.weight[k];
+        }
+
+        if (mSettings.russianRoulette && depth >= mSettings.rouletteMinDepth) {
+            const float survival = PathTracer::SurvivalProbability(throughput, mSettings.maxSurvival);
+            if (randomFunc() >= survival) {
+                break;
+            }
+            for (int k = 0; k < 3; ++k) {
+                throughput[k] /= survival;
+            }
+        }
+    }
+
+    return depth;
+}
+
+float PathTracer::SurvivalProbability(const float throughput[3], const float maxSurvival) {
+    return std::min(std::max(throughput[0], std::max(throughput[1], throughput[2])), maxSurvival);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// CPU port of the bounce loop in shaders/ray_gen.glsl (pathtracerLoop): throughput bookkeeping, depth limit and
+// russian roulette. What happens at a vertex (hit, emission, light sampling, next direction) is left to the caller,
+// so the same loop can run against a closed-form scene and be compared with a fixed depth reference.
+class PathTracer {
+public:
+    struct Settings {
+        uint32_t    maxDepth;               // MAX_PATH_DEPTH
+        uint32_t    rouletteMinDepth;       // SWS_RR_MIN_DEPTH, bounces before russian roulette kicks in
+        float       maxSurvival;            // SWS_RR_MAX_SURVIVAL
+        bool        russianRoulette;        // off = fixed depth
+    };
+
+    // what the caller reports for one vertex of the path
+    struct Vertex {
+        float       radiance[3];            // light leaving towards the previous vertex (emission, light samples)
+        float       weight[3];              // BSDF * cos / pdf of the next direction
+        bool        terminate;              // miss or emitter hit
+    };
+
+    using VertexFunc = std::function<void(const uint32_t depth, Vertex& vertex)>;
+    using RandomFunc = std::function<float()>;
+
+    PathTracer();
+    ~PathTracer() = default;
+
+    Settings&       GetSettings();
+
+    // returns the number of vertices visited
+    uint32_t        Trace(const VertexFunc& vertexFunc, const RandomFunc& randomFunc, float radiance[3]) const;
+
+    // probability for a path to keep going, mirrors russianRouletteSurvival() in shaders/ray_gen.glsl
+    static float    SurvivalProbability(const float throughput[3], const float maxSurvival);
+
+private:
+    Settings        mSettings;
+};
@@ -0,0 +1,80 @@
+#include "pipelinevariants.h"
+#include "profiler.h"
+
+#include <chrono>
+#include <cstdio>
+
+PipelineVariantCache::PipelineVariantCache()
+    : mDevice(VK_NULL_HANDLE) {
+}
+
+PipelineVariantCache::~PipelineVariantCache() {
+    this->Destroy();
+}
+
+void PipelineVariantCache::Initialize(VkDevice device, const CreateFunc& createFunc) {
+    mDevice = device;
+    mCreateFunc = createFunc;
+}
+
+void PipelineVariantCache::Destroy() {
+    for (auto& it : mVariants) {
+        this->DestroyVariant(*it.second);
+    }
+    mVariants.clear();
+}
+
+const PipelineVariantCache::Variant* PipelineVariantCache::Get(const Array<uint32_t>& values) {
+    auto it = mVariants.find(values);
+    if (it != mVariants.end()) {
+        return it->second.get();
+    }
+
+    PROFILE_ZONE("Create pipeline variant");
+    const auto startTime = std::chrono::steady_clock::now();
+
+    Array<VkSpecializationMapEntry> entries(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        entries[i].constantID = static_cast<uint32_t>(i);
+        entries[i].offset = static_cast<uint32_t>(i * sizeof(uint32_t));
+        entries[i].size = sizeof(uint32_t);
+    }
+
+    VkSpecializationInfo specialization;
+    specialization.mapEntryCount = static_cast<uint32_t>(entries.size());
+    specialization.pMapEntries = entries.data();
+    specialization.dataSize = values.size() * sizeof(uint32_t);
+    specialization.pData = values.data();
+
+    std::unique_ptr<Variant> variant(new Variant());
+    variant->pipeline = VK_NULL_HANDLE;
+    if (!mCreateFunc || !mCreateFunc(specialization, *variant)) {
+        this->DestroyVariant(*variant);
+        return nullptr;
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    printf("Pipeline variant %u created in %.1f ms\n", static_cast<uint32_t>(mVariants.size()), ms);
+
+    const Variant* result = variant.get();
+    mVariants[values] = std::move(variant);
+    return result;
+}
+
+size_t PipelineVariantCache::GetNumVariants() const {
+    return mVariants.size();
+}
+
+void PipelineVariantCache::ForEach(const std::function<void(Variant& variant)>& func) {
+    for (auto& it : mVariants) {
+        func(*it.second);
+    }
+}
+
+void PipelineVariantCache::DestroyVariant(Variant& variant) {
+    if (variant.pipeline) {
+        vkDestroyPipeline(mDevice, variant.pipeline, nullptr);
+        variant.pipeline = VK_NULL_HANDLE;
+    }
+    variant.sbt.Destroy();
+}
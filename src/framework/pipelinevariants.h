@@ -0,0 +1,43 @@
+#pragma once
+
+#include "vulkanhelpers.h"
+#include "common.h"
+
+#include <map>
+#include <memory>
+#include <functional>
+
+// Pipelines that only differ in the values of their specialization constants, built the first time a set of
+// values is asked for and kept until Destroy(), so going back to a variant seen before costs nothing.
+// Constants are 32 bit, constant_id i takes values[i]. A variant is a pipeline plus whatever else is tied to it,
+// for ray tracing pipelines the shader binding table (the group handles differ from one pipeline to the next).
+class PipelineVariantCache {
+public:
+    struct Variant {
+        VkPipeline              pipeline;
+        vulkanhelpers::Buffer   sbt;
+    };
+
+    // fills the variant with the specialization applied to all its stages, false if it couldn't
+    using CreateFunc = std::function<bool(const VkSpecializationInfo& specialization, Variant& variant)>;
+
+    PipelineVariantCache();
+    ~PipelineVariantCache();
+
+    void            Initialize(VkDevice device, const CreateFunc& createFunc);
+    void            Destroy();      // device idle
+
+    // nullptr if the variant had to be built and that failed, it's tried again next time
+    const Variant*  Get(const Array<uint32_t>& values);
+    size_t          GetNumVariants() const;
+    // every variant built so far, to update what's tied to them (SBT records...)
+    void            ForEach(const std::function<void(Variant& variant)>& func);
+
+private:
+    void            DestroyVariant(Variant& variant);
+
+private:
+    VkDevice                                                mDevice;
+    CreateFunc                                              mCreateFunc;
+    std::map<Array<uint32_t>, std::unique_ptr<Variant>>     mVariants;
+};
@@ -0,0 +1,164 @@
+#include "profiler.h"
+
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+
+namespace profiler {
+
+    using Clock = std::chrono::steady_clock;
+
+    static const Clock::time_point              sStartTime = Clock::now();
+    static const uint64_t                       sStartTicks = Ticks();
+    static std::mutex                           sTracksMutex;       // registration & export only
+    static std::vector<std::unique_ptr<Track>>  sTracks;            // kept to the end, threads may be gone by export time
+    static thread_local Track*                  sThreadTrack = nullptr;
+
+    static Track* NewTrack(const char* name) {
+        std::unique_ptr<Track> track(new Track());
+        track->depth = 0;
+        track->head.store(0, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(sTracksMutex);
+        track->id = static_cast<uint32_t>(sTracks.size());
+        track->name = name ? name : ("thread " + std::to_string(track->id));
+        sTracks.push_back(std::move(track));
+        return sTracks.back().get();
+    }
+
+    // names go into the json as is, keep them printable
+    static void WriteJsonString(FILE* file, const char* str) {
+        fputc('"', file);
+        for (; *str; ++str) {
+            const char c = *str;
+            if (c == '"' || c == '\\') {
+                fputc('\\', file);
+                fputc(c, file);
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                fprintf(file, "\\u%04x", static_cast<unsigned>(c));
+            } else {
+                fputc(c, file);
+            }
+        }
+        fputc('"', file);
+    }
+
+
+    double GetTicksPerSecond() {
+#if SWS_PROFILER_TSC
+        const uint64_t ticks = Ticks();
+        const double seconds = std::chrono::duration<double>(Clock::now() - sStartTime).count();
+        // too early to tell, the first milliseconds are all clock read jitter
+        if (seconds < 1e-3) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            return GetTicksPerSecond();
+        }
+        return static_cast<double>(ticks - sStartTicks) / seconds;
+#else
+        return 1e9;
+#endif
+    }
+
+    double TicksToNs(const uint64_t ticks) {
+        return static_cast<double>(static_cast<int64_t>(ticks - sStartTicks)) * 1e9 / GetTicksPerSecond();
+    }
+
+    uint64_t NsToTicks(const double ns) {
+        return sStartTicks + static_cast<uint64_t>(ns * GetTicksPerSecond() * 1e-9);
+    }
+
+    Track* GetThreadTrack() {
+        if (!sThreadTrack) {
+            sThreadTrack = NewTrack(nullptr);
+        }
+        return sThreadTrack;
+    }
+
+    void SetThreadName(const char* name) {
+        Track* track = GetThreadTrack();
+        std::lock_guard<std::mutex> lock(sTracksMutex);
+        track->name = name;
+    }
+
+    Track* CreateTrack(const char* name) {
+        return NewTrack(name);
+    }
+
+    void Collect(const Track* track, std::vector<Event>& out) {
+        out.clear();
+
+        const uint64_t head = track->head.load(std::memory_order_acquire);
+        const uint64_t first = (head > kTrackCapacity) ? (head - kTrackCapacity) : 0;
+        out.reserve(static_cast<size_t>(head - first));
+        for (uint64_t i = first; i < head; ++i) {
+            out.push_back(track->events[i & (kTrackCapacity - 1)]);
+        }
+
+        // the owner kept writing meanwhile: whatever it has overwritten (or is overwriting right now) is garbage
+        const uint64_t newHead = track->head.load(std::memory_order_acquire);
+        const uint64_t valid = (newHead + 1 > kTrackCapacity) ? (newHead + 1 - kTrackCapacity) : 0;
+        if (valid > first) {
+            const size_t numDropped = static_cast<size_t>(std::min(valid - first, static_cast<uint64_t>(out.size())));
+            out.erase(out.begin(), out.begin() + numDropped);
+        }
+    }
+
+    void GetTracks(std::vector<const Track*>& out) {
+        std::lock_guard<std::mutex> lock(sTracksMutex);
+        out.clear();
+        for (const std::unique_ptr<Track>& track : sTracks) {
+            out.push_back(track.get());
+        }
+    }
+
+    bool SaveChromeTrace(const std::string& fileName) {
+        FILE* file = fopen(fileName.c_str(), "w");
+        if (!file) {
+            printf("Can't write trace %s\n", fileName.c_str());
+            return false;
+        }
+
+        std::vector<const Track*> tracks;
+        GetTracks(tracks);
+
+        const double ticksPerUs = GetTicksPerSecond() * 1e-6;
+
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        size_t numEvents = 0;
+        std::vector<Event> events;
+        for (const Track* track : tracks) {
+            {
+                std::lock_guard<std::mutex> lock(sTracksMutex);
+                fprintf(file, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", first ? "" : ",\n", track->id);
+                WriteJsonString(file, track->name.c_str());
+                fprintf(file, "}}");
+            }
+            first = false;
+            fprintf(file, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":%u}}", track->id, track->id);
+
+            Collect(track, events);
+            for (const Event& event : events) {
+                // complete events, the viewer nests them by time
+                fprintf(file, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":", track->id);
+                WriteJsonString(file, event.name);
+                fprintf(file, ",\"ts\":%.3f,\"dur\":%.3f}", static_cast<int64_t>(event.begin - sStartTicks) / ticksPerUs, (event.end - event.begin) / ticksPerUs);
+            }
+            numEvents += events.size();
+        }
+        fprintf(file, "\n]}\n");
+
+        const bool ok = !ferror(file);
+        fclose(file);
+        if (ok) {
+            printf("Trace: %zu events on %zu tracks written to %s\n", numEvents, tracks.size(), fileName.c_str());
+        } else {
+            printf("Failed writing trace %s\n", fileName.c_str());
+        }
+        return ok;
+    }
+
+} // namespace profiler
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define SWS_PROFILER_TSC 1
+#elif (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>
+#define SWS_PROFILER_TSC 1
+#else
+#include <chrono>
+#define SWS_PROFILER_TSC 0
+#endif
+
+// Instrumentation zones, exported as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+// PROFILE_ZONE("name") times the enclosing scope. Every thread writes its zones into its own ring of
+// kTrackCapacity events, single producer, no locks, the oldest events get overwritten. Tracks can also be
+// fed by hand (the GPU zones come in that way, always from the same thread).
+// Zone names are kept by pointer, they must outlive the profiler - string literals.
+// Timestamps are raw ticks, the time stamp counter on x86 (a fraction of what a clock call costs), converted
+// to time against steady_clock only when exporting.
+//
+// Compiled out of release builds: SWS_PROFILER defaults to 0 when NDEBUG is defined, the zone macros are
+// empty then. Configure with -DRTXON_PROFILER=ON to keep them.
+#ifndef SWS_PROFILER
+#ifdef NDEBUG
+#define SWS_PROFILER 0
+#else
+#define SWS_PROFILER 1
+#endif
+#endif
+
+namespace profiler {
+
+    static const size_t kTrackCapacity = 1u << 16;    // events, power of two
+
+    struct Event {
+        const char* name;
+        uint64_t    begin;      // ticks
+        uint64_t    end;
+        uint32_t    depth;      // nesting level on its track
+    };
+
+    struct Track {
+        std::string             name;
+        uint32_t                id;
+        uint32_t                depth;      // open zones, owner thread only
+        std::atomic<uint64_t>   head;       // events ever written
+        Event                   events[kTrackCapacity];
+    };
+
+    inline uint64_t Ticks() {
+#if SWS_PROFILER_TSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    // measured against steady_clock over the profiler's lifetime so far, more precise the later it's asked
+    double      GetTicksPerSecond();
+    // ns since the profiler started
+    double      TicksToNs(const uint64_t ticks);
+    uint64_t    NsToTicks(const double ns);
+
+    // the calling thread's track, created on first use
+    Track*      GetThreadTrack();
+    void        SetThreadName(const char* name);
+    // tracks not tied to a thread, only one thread may record into each of them
+    Track*      CreateTrack(const char* name);
+
+    inline void Record(Track* track, const char* name, const uint64_t begin, const uint64_t end, const uint32_t depth) {
+        const uint64_t head = track->head.load(std::memory_order_relaxed);
+        Event& event = track->events[head & (kTrackCapacity - 1)];
+        event.name = name;
+        event.begin = begin;
+        event.end = end;
+        event.depth = depth;
+        track->head.store(head + 1, std::memory_order_release);
+    }
+
+    // copies what the track still holds, oldest first. Safe while its owner keeps recording,
+    // events overwritten during the copy are dropped
+    void        Collect(const Track* track, std::vector<Event>& out);
+    void        GetTracks(std::vector<const Track*>& out);
+
+    bool        SaveChromeTrace(const std::string& fileName);
+
+    class Zone {
+    public:
+        explicit Zone(const char* name)
+            : mTrack(GetThreadTrack())
+            , mName(name)
+            , mDepth(mTrack->depth++)
+            , mBegin(Ticks()) {
+        }
+        ~Zone() {
+            const uint64_t end = Ticks();
+            --mTrack->depth;
+            Record(mTrack, mName, mBegin, end, mDepth);
+        }
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+    private:
+        Track*      mTrack;
+        const char* mName;
+        uint32_t    mDepth;
+        uint64_t    mBegin;
+    };
+
+} // namespace profiler
+
+#define SWS_PROFILER_CONCAT_IMPL(a, b)  a##b
+#define SWS_PROFILER_CONCAT(a, b)       SWS_PROFILER_CONCAT_IMPL(a, b)
+
+#if SWS_PROFILER
+#define PROFILE_ZONE(name)              profiler::Zone SWS_PROFILER_CONCAT(profilerZone, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name)       profiler::SetThreadName(name)
+#else
+#define PROFILE_ZONE(name)              ((void)0)
+#define PROFILE_THREAD_NAME(name)       ((void)0)
+#endif
@@ -0,0 +1,134 @@
+#include "sbtlayout.h"
+
+#include <cassert>
+#include <cstring>
+
+static uint32_t AlignUp(const uint32_t value, const uint32_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+SBTLayout::SBTLayout()
+    : mShaderHandleSize(0u)
+    , mShaderGroupAlignment(0u)
+    , mNumHitRecords(0u)
+    , mNumProceduralRecords(0u)
+    , mHitRecordDataSize(0u)
+    , mNumHitGroups(0u)
+    , mNumMissGroups(0u) {
+}
+
+void SBTLayout::Initialize(const uint32_t numHitGroups, const uint32_t numMissGroups, const uint32_t shaderHandleSize, const uint32_t shaderGroupAlignment,
+                           const uint32_t numHitRecords, const uint32_t hitRecordDataSize, const uint32_t numProceduralRecords) {
+    assert(numHitRecords > 0);
+    mShaderHandleSize = shaderHandleSize;
+    mShaderGroupAlignment = shaderGroupAlignment;
+    mNumHitRecords = numHitRecords;
+    mNumProceduralRecords = numProceduralRecords;
+    mHitRecordDataSize = hitRecordDataSize;
+    mNumHitGroups = numHitGroups;
+    mNumMissGroups = numMissGroups;
+}
+
+uint32_t SBTLayout::GetGroupsStride() const {
+    return mShaderGroupAlignment;
+}
+
+uint32_t SBTLayout::GetHitGroupsStride() const {
+    // the data goes right after the handle
+    return AlignUp(mShaderHandleSize + mHitRecordDataSize, mShaderHandleSize);
+}
+
+uint32_t SBTLayout::GetNumHitRecords() const {
+    return mNumHitRecords + mNumProceduralRecords;
+}
+
+uint32_t SBTLayout::GetProceduralRecord(const uint32_t index) const {
+    assert(index < mNumProceduralRecords);
+    return mNumHitRecords + index;
+}
+
+uint32_t SBTLayout::GetHitRecordIndex(const uint32_t record) const {
+    return record * mNumHitGroups;
+}
+
+uint32_t SBTLayout::GetHitRecordDataSize() const {
+    return mHitRecordDataSize;
+}
+
+uint32_t SBTLayout::GetNumPipelineHitGroups() const {
+    return mNumProceduralRecords ? (2 * mNumHitGroups) : mNumHitGroups;
+}
+
+uint32_t SBTLayout::GetNumGroups() const {
+    return 1 + this->GetNumPipelineHitGroups() + mNumMissGroups;
+}
+
+uint32_t SBTLayout::GetRaygenOffset() const {
+    return 0;
+}
+
+uint32_t SBTLayout::GetRaygenSize() const {
+    return mShaderGroupAlignment;
+}
+
+uint32_t SBTLayout::GetHitGroupsOffset() const {
+    return AlignUp(this->GetRaygenOffset() + this->GetRaygenSize(), mShaderGroupAlignment);
+}
+
+uint32_t SBTLayout::GetHitGroupsSize() const {
+    return this->GetNumHitRecords() * mNumHitGroups * this->GetHitGroupsStride();
+}
+
+uint32_t SBTLayout::GetMissGroupsOffset() const {
+    return AlignUp(this->GetHitGroupsOffset() + this->GetHitGroupsSize(), mShaderGroupAlignment);
+}
+
+uint32_t SBTLayout::GetMissGroupsSize() const {
+    return mNumMissGroups * mShaderGroupAlignment;
+}
+
+uint32_t SBTLayout::GetSBTSize() const {
+    return this->GetMissGroupsOffset() + this->GetMissGroupsSize();
+}
+
+void SBTLayout::FillTable(uint8_t* table, const uint8_t* groupHandles) const {
+    memset(table, 0, this->GetSBTSize());
+
+    const uint8_t* handle = groupHandles;
+    memcpy(table + this->GetRaygenOffset(), handle, mShaderHandleSize);
+    handle += mShaderHandleSize;
+
+    // the hit groups once per record (the procedural ones for the procedural records)
+    const uint32_t hitStride = this->GetHitGroupsStride();
+    for (uint32_t record = 0; record < this->GetNumHitRecords(); ++record) {
+        uint8_t* recordMem = table + this->GetHitGroupsOffset() + this->GetHitRecordIndex(record) * hitStride;
+        const uint8_t* recordHandles = (record < mNumHitRecords) ? handle : (handle + mNumHitGroups * mShaderHandleSize);
+        for (uint32_t i = 0; i < mNumHitGroups; ++i) {
+            memcpy(recordMem + i * hitStride, recordHandles + i * mShaderHandleSize, mShaderHandleSize);
+        }
+    }
+    handle += this->GetNumPipelineHitGroups() * mShaderHandleSize;
+
+    for (uint32_t i = 0; i < mNumMissGroups; ++i) {
+        memcpy(table + this->GetMissGroupsOffset() + i * mShaderGroupAlignment, handle + i * mShaderHandleSize, mShaderHandleSize);
+    }
+}
+
+uint64_t SBTLayout::GetHitRecordsOffset(const uint32_t firstRecord) const {
+    return this->GetHitGroupsOffset() + static_cast<uint64_t>(this->GetHitRecordIndex(firstRecord)) * this->GetHitGroupsStride();
+}
+
+uint64_t SBTLayout::GetHitRecordsSize(const uint32_t numRecords) const {
+    return static_cast<uint64_t>(numRecords) * mNumHitGroups * this->GetHitGroupsStride();
+}
+
+void SBTLayout::FillHitRecords(uint8_t* records, const uint32_t numRecords, const void* data, const size_t dataStride) const {
+    const uint32_t hitStride = this->GetHitGroupsStride();
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    for (uint32_t record = 0; record < numRecords; ++record, src += dataStride) {
+        uint8_t* recordMem = records + this->GetHitRecordIndex(record) * hitStride;
+        for (uint32_t i = 0; i < mNumHitGroups; ++i) {
+            memcpy(recordMem + i * hitStride + mShaderHandleSize, src, mHitRecordDataSize);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Where everything goes in a shader binding table, and the bytes themselves, without Vulkan: SBTHelper adds the
+// stages & groups and the buffer on top (raytracerapp.h).
+// Raygen, then the hit groups, then the miss groups. Hit groups can be repeated in records (one per mesh...), a record
+// has every hit group once, each followed by hitRecordDataSize bytes of its own (shaderRecordEXT). Record r of the
+// table starts at hit group index GetHitRecordIndex(r), what its instances' instanceShaderBindingTableRecordOffset
+// has to be. Regions start on shaderGroupBaseAlignment, hit groups are a multiple of shaderGroupHandleSize apart.
+// With procedural records the pipeline has numHitGroups more hit groups, groupIndex numHitGroups + i is the procedural
+// one of ray type i (its stages include an intersection shader). The procedural records follow the triangle ones and
+// have those instead, GetProceduralRecord(n) is the n-th.
+class SBTLayout {
+public:
+    SBTLayout();
+
+    void        Initialize(const uint32_t numHitGroups, const uint32_t numMissGroups, const uint32_t shaderHandleSize, const uint32_t shaderGroupAlignment,
+                           const uint32_t numHitRecords = 1, const uint32_t hitRecordDataSize = 0, const uint32_t numProceduralRecords = 0);
+
+    uint32_t    GetGroupsStride() const;    // raygen & miss
+    uint32_t    GetHitGroupsStride() const;
+    uint32_t    GetNumHitRecords() const;       // procedural ones included
+    uint32_t    GetProceduralRecord(const uint32_t index) const;
+    uint32_t    GetHitRecordIndex(const uint32_t record) const;
+    uint32_t    GetHitRecordDataSize() const;
+    uint32_t    GetNumPipelineHitGroups() const;    // the procedural ones included
+    uint32_t    GetNumGroups() const;
+    uint32_t    GetRaygenOffset() const;
+    uint32_t    GetRaygenSize() const;
+    uint32_t    GetHitGroupsOffset() const;
+    uint32_t    GetHitGroupsSize() const;
+    uint32_t    GetMissGroupsOffset() const;
+    uint32_t    GetMissGroupsSize() const;
+    uint32_t    GetSBTSize() const;
+
+    // the whole table, GetSBTSize() bytes, from the pipeline's GetNumGroups() group handles (in group order).
+    // The records' data is all zeros
+    void        FillTable(uint8_t* table, const uint8_t* groupHandles) const;
+    // the bytes numRecords records from firstRecord on span
+    uint64_t    GetHitRecordsOffset(const uint32_t firstRecord) const;
+    uint64_t    GetHitRecordsSize(const uint32_t numRecords) const;
+    // numRecords records' data into records (the table at GetHitRecordsOffset() of the first one), every hit group
+    // of a record gets the same. dataStride apart in data
+    void        FillHitRecords(uint8_t* records, const uint32_t numRecords, const void* data, const size_t dataStride) const;
+
+protected:
+    uint32_t    mShaderHandleSize;
+    uint32_t    mShaderGroupAlignment;
+    uint32_t    mNumHitRecords;
+    uint32_t    mNumProceduralRecords;
+    uint32_t    mHitRecordDataSize;
+    uint32_t    mNumHitGroups;
+    uint32_t    mNumMissGroups;
+};
@@ -0,0 +1,122 @@
+#include "sessionrecording.h"
+
+#include <algorithm>
+#include <cstdio>
+
+static const uint32_t kRecordingMagic = 0x43455253;    // "SREC"
+static const uint32_t kRecordingVersion = 3;    // 2: sampling settings, 3: all the quality settings
+
+SessionRecording::SessionRecording() {
+}
+
+bool SessionRecording::Load(const std::string& fileName) {
+    this->Clear();
+
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        printf("Can't open recording %s\n", fileName.c_str());
+        return false;
+    }
+
+    // the frame size guards against replaying a log from a build with a different Frame layout
+    uint32_t header[4] = {};
+    bool ok = (fread(header, sizeof(header), 1, file) == 1) &&
+              header[0] == kRecordingMagic &&
+              header[1] == kRecordingVersion &&
+              header[2] == static_cast<uint32_t>(sizeof(Frame));
+    if (ok) {
+        mFrames.resize(header[3]);
+        ok = mFrames.empty() || (fread(mFrames.data(), sizeof(Frame), mFrames.size(), file) == mFrames.size());
+    }
+    fclose(file);
+
+    if (!ok) {
+        printf("%s is not a compatible recording\n", fileName.c_str());
+        this->Clear();
+    }
+    return ok;
+}
+
+bool SessionRecording::Save(const std::string& fileName) const {
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (!file) {
+        printf("Can't write recording %s\n", fileName.c_str());
+        return false;
+    }
+
+    const uint32_t header[4] = {
+        kRecordingMagic,
+        kRecordingVersion,
+        static_cast<uint32_t>(sizeof(Frame)),
+        static_cast<uint32_t>(mFrames.size())
+    };
+    bool ok = (fwrite(header, sizeof(header), 1, file) == 1);
+    if (ok && !mFrames.empty()) {
+        ok = (fwrite(mFrames.data(), sizeof(Frame), mFrames.size(), file) == mFrames.size());
+    }
+    ok = (fclose(file) == 0) && ok;
+
+    if (!ok) {
+        printf("Failed to write recording %s\n", fileName.c_str());
+    }
+    return ok;
+}
+
+void SessionRecording::Clear() {
+    mFrames.clear();
+}
+
+void SessionRecording::AddFrame(const Frame& frame) {
+    mFrames.push_back(frame);
+}
+
+size_t SessionRecording::GetNumFrames() const {
+    return mFrames.size();
+}
+
+const SessionRecording::Frame& SessionRecording::GetFrame(const size_t index) const {
+    return mFrames[index];
+}
+
+
+void FrameTimings::Clear() {
+    mMilliseconds.clear();
+}
+
+void FrameTimings::AddFrame(const double milliseconds) {
+    mMilliseconds.push_back(milliseconds);
+}
+
+size_t FrameTimings::GetNumFrames() const {
+    return mMilliseconds.size();
+}
+
+bool FrameTimings::SaveCsv(const std::string& fileName) const {
+    FILE* file = fopen(fileName.c_str(), "w");
+    if (!file) {
+        printf("Can't write timings %s\n", fileName.c_str());
+        return false;
+    }
+
+    bool ok = (fprintf(file, "frame,ms\n") > 0);
+    for (size_t i = 0; ok && i < mMilliseconds.size(); ++i) {
+        ok = (fprintf(file, "%u,%.4f\n", static_cast<uint32_t>(i), mMilliseconds[i]) > 0);
+    }
+    ok = (fclose(file) == 0) && ok;
+    return ok;
+}
+
+void FrameTimings::Print(const char* label) const {
+    if (mMilliseconds.empty()) {
+        printf("%s: no frames\n", label);
+        return;
+    }
+
+    double sum = 0.0;
+    for (const double ms : mMilliseconds) {
+        sum += ms;
+    }
+    const auto minMax = std::minmax_element(mMilliseconds.begin(), mMilliseconds.end());
+    printf("%s: %u frames, %.3f ms mean, %.3f ms min, %.3f ms max\n", label,
+           static_cast<uint32_t>(mMilliseconds.size()), sum / mMilliseconds.size(), *minMax.first, *minMax.second);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Everything the interactive controls feed the renderer, frame by frame.
+// Recorded from a live session and replayed at a fixed timestep, so two builds can be timed on exactly
+// the same sequence of frames. Binary file: header (magic, version, frame size, frame count) + raw frames.
+class SessionRecording {
+public:
+    struct Frame {
+        float       camera[20];         // CameraUniformParams as uploaded: pos, dir, up, side, nearFarFov
+        float       light[4];           // position xyz, intensity
+        float       shadowAttenuation;
+        uint32_t    mode;
+        uint32_t    lightType;
+        uint32_t    emittersMode;       // SWS_EMITTERS_*
+        float       accumulation;       // modeFrame.y
+        uint32_t    seed;               // per frame random seed
+        uint32_t    quality[6];         // what the pipeline was specialized with, the overlay can change it mid session
+    };
+
+    SessionRecording();
+    ~SessionRecording() = default;
+
+    bool            Load(const std::string& fileName);
+    bool            Save(const std::string& fileName) const;
+    void            Clear();
+
+    void            AddFrame(const Frame& frame);
+    size_t          GetNumFrames() const;
+    const Frame&    GetFrame(const size_t index) const;
+
+private:
+    std::vector<Frame>  mFrames;
+};
+
+// Per frame wall clock times of a replay, written out as csv so two runs can be diffed frame by frame
+class FrameTimings {
+public:
+    FrameTimings() = default;
+    ~FrameTimings() = default;
+
+    void        Clear();
+    void        AddFrame(const double milliseconds);
+    size_t      GetNumFrames() const;
+
+    bool        SaveCsv(const std::string& fileName) const;
+    void        Print(const char* label) const;    // count, mean, min & max
+
+private:
+    std::vector<double> mMilliseconds;
+};
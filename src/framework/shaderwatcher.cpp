@@ -0,0 +1,262 @@
+#include "shaderwatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#define popen _popen
+#define pclose _pclose
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// editors save in bursts (truncate, write, rename...), the compile waits for them to settle
+static const std::chrono::milliseconds sSettleTime(100);
+static const std::chrono::milliseconds sPollInterval(250);
+
+static String GetFolder(const String& path) {
+    const size_t separator = path.find_last_of("/\\");
+    return (separator == String::npos) ? String("./") : path.substr(0, separator + 1);
+}
+
+static String GetFileName(const String& path) {
+    const size_t separator = path.find_last_of("/\\");
+    return (separator == String::npos) ? path : path.substr(separator + 1);
+}
+
+static bool ReadWords(const String& fileName, Array<uint32_t>& words) {
+    std::ifstream file(fileName, std::ios::in | std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    const size_t fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+    if (!fileSize || (fileSize % sizeof(uint32_t))) {
+        return false;
+    }
+    words.resize(fileSize / sizeof(uint32_t));
+    file.read(reinterpret_cast<char*>(words.data()), fileSize);
+    return static_cast<bool>(file);
+}
+
+
+ShaderWatcher::ShaderWatcher()
+    : mStop(false)
+    , mNotifyFd(-1)
+    , mStamp(0) {
+}
+
+ShaderWatcher::~ShaderWatcher() {
+    this->Stop();
+}
+
+bool ShaderWatcher::Start(const String& compiler, const String& sourceFolder, const String& outputFolder,
+                          const Array<Source>& sources, const Array<String>& includes, const Callback& callback) {
+    this->Stop();
+
+    mCompiler = compiler;
+    mSourceFolder = sourceFolder;
+    mOutputFolder = outputFolder;
+    mSources = sources;
+    mCallback = callback;
+
+    mWatchedFiles.clear();
+    for (const Source& source : mSources) {
+        mWatchedFiles.push_back(mSourceFolder + source.name + ".glsl");
+    }
+    for (const String& include : includes) {
+        mWatchedFiles.push_back(mSourceFolder + include);
+    }
+
+#ifdef _WIN32
+    _mkdir(mOutputFolder.c_str());
+#else
+    mkdir(mOutputFolder.c_str(), 0755);
+#endif
+
+#ifdef __linux__
+    mNotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (mNotifyFd >= 0) {
+        Array<String> folders;
+        for (const String& file : mWatchedFiles) {
+            const String folder = GetFolder(file);
+            if (std::find(folders.begin(), folders.end(), folder) == folders.end()) {
+                folders.push_back(folder);
+            }
+        }
+        for (const String& folder : folders) {
+            // a rename over the file is how most editors save
+            if (inotify_add_watch(mNotifyFd, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+                printf("Shader watcher: can't watch %s, polling instead\n", folder.c_str());
+                close(mNotifyFd);
+                mNotifyFd = -1;
+                break;
+            }
+        }
+    }
+#endif
+    mStamp = this->GetModificationStamp();
+
+    mStop = false;
+    mThread = std::thread(&ShaderWatcher::Run, this);
+    printf("Watching %u shader files (%s)\n", static_cast<uint32_t>(mWatchedFiles.size()), (mNotifyFd >= 0) ? "inotify" : "polling");
+    return true;
+}
+
+void ShaderWatcher::Stop() {
+    mStop = true;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+#ifdef __linux__
+    if (mNotifyFd >= 0) {
+        close(mNotifyFd);
+    }
+#endif
+    mNotifyFd = -1;
+}
+
+bool ShaderWatcher::IsRunning() const {
+    return mThread.joinable();
+}
+
+bool ShaderWatcher::Compile(const String& compiler, const String& sourceFolder, const String& outputFolder,
+                            const Array<Source>& sources, Result& result) {
+    result.ok = true;
+    result.log.clear();
+    result.spirv.clear();
+
+    for (const Source& source : sources) {
+        const String command = "\"" + compiler + "\" --target-env vulkan1.2 -V -S " + source.stage + " \"" +
+                               sourceFolder + source.name + ".glsl\" -o \"" + outputFolder + source.name + ".bin\" 2>&1";
+        // popen goes through cmd.exe on Windows, which strips the outer quotes
+#ifdef _WIN32
+        FILE* pipe = popen(("\"" + command + "\"").c_str(), "r");
+#else
+        FILE* pipe = popen(command.c_str(), "r");
+#endif
+        if (!pipe) {
+            result.ok = false;
+            result.log += "can't run " + compiler + "\n";
+            break;
+        }
+
+        String output;
+        char buffer[512];
+        while (fgets(buffer, sizeof(buffer), pipe)) {
+            output += buffer;
+        }
+        if (0 != pclose(pipe)) {
+            result.ok = false;
+            result.log += output;
+        }
+    }
+
+    if (result.ok) {
+        result.spirv.resize(sources.size());
+        for (size_t i = 0; i < sources.size(); ++i) {
+            const String fileName = outputFolder + sources[i].name + ".bin";
+            if (!ReadWords(fileName, result.spirv[i])) {
+                result.ok = false;
+                result.log += "can't read " + fileName + "\n";
+            }
+        }
+    }
+    if (!result.ok) {
+        result.spirv.clear();
+    }
+
+    return result.ok;
+}
+
+void ShaderWatcher::Run() {
+    while (this->WaitForChange()) {
+        const auto startTime = std::chrono::steady_clock::now();
+        printf("Shader change detected, recompiling...\n");
+
+        Result result;
+        ShaderWatcher::Compile(mCompiler, mSourceFolder, mOutputFolder, mSources, result);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        if (result.ok) {
+            printf("Shaders recompiled in %.0f ms\n", ms);
+        } else {
+            printf("Shader compile failed, keeping the running pipeline:\n%s", result.log.c_str());
+        }
+
+        if (mCallback) {
+            mCallback(result);
+        }
+    }
+}
+
+bool ShaderWatcher::WaitForChange() {
+#ifdef __linux__
+    if (mNotifyFd >= 0) {
+        alignas(inotify_event) char buffer[4096];
+        bool changed = false;
+        while (!mStop) {
+            pollfd descriptor = { mNotifyFd, POLLIN, 0 };
+            if (poll(&descriptor, 1, static_cast<int>(sPollInterval.count())) <= 0) {
+                if (changed) {
+                    return true;    // and nothing more came during the last interval
+                }
+                continue;
+            }
+
+            ssize_t length;
+            while ((length = read(mNotifyFd, buffer, sizeof(buffer))) > 0) {
+                for (ssize_t offset = 0; offset < length; ) {
+                    const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                    offset += sizeof(inotify_event) + event->len;
+                    if (!event->len) {
+                        continue;
+                    }
+                    // sources & includes live in at most a couple of folders, names are enough
+                    for (const String& file : mWatchedFiles) {
+                        if (GetFileName(file) == event->name) {
+                            changed = true;
+                            break;
+                        }
+                    }
+                }
+            }
+            if (changed) {
+                std::this_thread::sleep_for(sSettleTime);
+            }
+        }
+        return false;
+    }
+#endif
+
+    while (!mStop) {
+        std::this_thread::sleep_for(sPollInterval);
+        const uint64_t stamp = this->GetModificationStamp();
+        if (stamp != mStamp) {
+            std::this_thread::sleep_for(sSettleTime);
+            mStamp = this->GetModificationStamp();
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t ShaderWatcher::GetModificationStamp() const {
+    // times are in seconds, sizes catch most edits made within the same one
+    uint64_t stamp = 0;
+    for (const String& file : mWatchedFiles) {
+        struct stat info;
+        if (0 == stat(file.c_str(), &info)) {
+            stamp = stamp * 31 + static_cast<uint64_t>(info.st_mtime);
+            stamp = stamp * 31 + static_cast<uint64_t>(info.st_size);
+        }
+    }
+    return stamp;
+}
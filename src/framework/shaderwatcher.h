@@ -0,0 +1,59 @@
+#pragma once
+
+#include "common.h"
+
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+// Recompiles shaders on a thread of its own whenever their sources (or anything they include) change on disk:
+// inotify on Linux, the files' modification times polled elsewhere. The compiler is glslangValidator, run with
+// the flags compile_shaders.cmd uses. Every change recompiles the whole set, includes make finer tracking moot.
+// What came out goes to the callback, still on the watcher's thread, so whatever is built from it is off the
+// render thread too.
+class ShaderWatcher {
+public:
+    struct Source {
+        String      name;       // src/shaders/<name>.glsl, compiled to <name>.bin
+        String      stage;      // glslangValidator's -S: rgen, rchit...
+    };
+
+    struct Result {
+        bool                    ok;
+        String                  log;        // the compiler's output for the sources that failed
+        Array<Array<uint32_t>>  spirv;      // in the order of the sources, when ok
+    };
+
+    using Callback = std::function<void(const Result& result)>;
+
+    ShaderWatcher();
+    ~ShaderWatcher();
+
+    // folders end with a separator. includes are file names in sourceFolder or paths relative to it ("../shared.h")
+    bool            Start(const String& compiler, const String& sourceFolder, const String& outputFolder,
+                          const Array<Source>& sources, const Array<String>& includes, const Callback& callback);
+    void            Stop();
+    bool            IsRunning() const;
+
+    // the compile itself, on the calling thread
+    static bool     Compile(const String& compiler, const String& sourceFolder, const String& outputFolder,
+                            const Array<Source>& sources, Result& result);
+
+private:
+    void            Run();
+    bool            WaitForChange();
+    uint64_t        GetModificationStamp() const;
+
+private:
+    String              mCompiler;
+    String              mSourceFolder;
+    String              mOutputFolder;
+    Array<Source>       mSources;
+    Array<String>       mWatchedFiles;      // paths of the sources & includes
+    Callback            mCallback;
+    std::thread         mThread;
+    std::atomic<bool>   mStop;
+    int                 mNotifyFd;          // inotify, -1 when polling
+    uint64_t            mStamp;             // polling: the files' latest modification time seen
+};
@@ -0,0 +1,73 @@
+#include "slotallocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+SlotAllocator::SlotAllocator()
+    : mNumAllocated(0)
+    , mHighWater(0) {
+}
+
+void SlotAllocator::Initialize(const uint32_t capacity) {
+    // reversed, so the stack hands out 0 first
+    mFreeSlots.resize(capacity);
+    for (uint32_t i = 0; i < capacity; ++i) {
+        mFreeSlots[i] = capacity - 1 - i;
+    }
+    mAllocated.assign(capacity, 0);
+    mPending.clear();
+    mNumAllocated = 0;
+    mHighWater = 0;
+}
+
+uint32_t SlotAllocator::Allocate() {
+    if (mFreeSlots.empty()) {
+        return InvalidSlot;
+    }
+
+    const uint32_t slot = mFreeSlots.back();
+    mFreeSlots.pop_back();
+    mAllocated[slot] = 1;
+    ++mNumAllocated;
+    mHighWater = std::max(mHighWater, slot + 1);
+    return slot;
+}
+
+void SlotAllocator::Release(const uint32_t slot, const uint64_t serial) {
+    assert(this->IsAllocated(slot) && "releasing a slot that isn't allocated");
+    assert((mPending.empty() || mPending.back().serial <= serial) && "releases have to come in serial order");
+
+    mAllocated[slot] = 0;
+    --mNumAllocated;
+    mPending.push_back(Pending{ serial, slot });
+}
+
+uint32_t SlotAllocator::Recycle(const uint64_t completedSerial) {
+    uint32_t numRecycled = 0;
+    while (!mPending.empty() && mPending.front().serial <= completedSerial) {
+        mFreeSlots.push_back(mPending.front().slot);
+        mPending.pop_front();
+        ++numRecycled;
+    }
+    return numRecycled;
+}
+
+uint32_t SlotAllocator::GetCapacity() const {
+    return static_cast<uint32_t>(mAllocated.size());
+}
+
+uint32_t SlotAllocator::GetNumAllocated() const {
+    return mNumAllocated;
+}
+
+uint32_t SlotAllocator::GetNumPending() const {
+    return static_cast<uint32_t>(mPending.size());
+}
+
+uint32_t SlotAllocator::GetHighWater() const {
+    return mHighWater;
+}
+
+bool SlotAllocator::IsAllocated(const uint32_t slot) const {
+    return slot < mAllocated.size() && mAllocated[slot];
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+
+// Fixed capacity slots handed out from a free list. A released slot isn't free right away: frames submitted
+// before the release may still read it, so it waits for Recycle() to report them done. Serials are whatever
+// counts frames (VulkanApp::mNumSubmittedFrames), releases have to come in non-decreasing serial order.
+// Fresh slots come lowest first, recycled ones are reused before any fresh one. Not thread-safe.
+class SlotAllocator {
+public:
+    static const uint32_t InvalidSlot = ~0u;
+
+    SlotAllocator();
+
+    void        Initialize(const uint32_t capacity);    // every slot free, pending ones dropped
+
+    // InvalidSlot when every slot is taken (or still pending)
+    uint32_t    Allocate();
+    // slot can be reused once Recycle() is told frames up to & including serial are done
+    void        Release(const uint32_t slot, const uint64_t serial);
+    // frames up to & including completedSerial won't read anything anymore, returns how many slots got freed
+    uint32_t    Recycle(const uint64_t completedSerial);
+
+    uint32_t    GetCapacity() const;
+    uint32_t    GetNumAllocated() const;    // handed out, not released
+    uint32_t    GetNumPending() const;      // released, waiting for Recycle()
+    uint32_t    GetHighWater() const;       // highest slot ever handed out + 1
+    bool        IsAllocated(const uint32_t slot) const;
+
+private:
+    struct Pending {
+        uint64_t    serial;
+        uint32_t    slot;
+    };
+
+    std::vector<uint32_t>   mFreeSlots;     // a stack, top = next one handed out
+    std::vector<uint8_t>    mAllocated;
+    std::deque<Pending>     mPending;       // oldest release first
+    uint32_t                mNumAllocated;
+    uint32_t                mHighWater;
+};
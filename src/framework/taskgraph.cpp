@@ -0,0 +1,232 @@
+#include "taskgraph.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cassert>
+
+// PrintTimeline()'s bars
+static const size_t sTimelineWidth = 40;
+
+TaskGraph::TaskGraph()
+    : mPool(nullptr)
+    , mRunning(false)
+    , mNumUnfinished(0)
+    , mTotalMs(0.0) {
+}
+
+TaskGraph::TaskId TaskGraph::Add(const char* name, const Func& func, const std::vector<TaskId>& dependencies, const std::string& detail) {
+    return this->AddTask(name, func, dependencies, detail, false);
+}
+
+TaskGraph::TaskId TaskGraph::AddMainThread(const char* name, const Func& func, const std::vector<TaskId>& dependencies, const std::string& detail) {
+    return this->AddTask(name, func, dependencies, detail, true);
+}
+
+TaskGraph::TaskId TaskGraph::AddTask(const char* name, const Func& func, const std::vector<TaskId>& dependencies, const std::string& detail, const bool mainThread) {
+    std::vector<TaskId> ready;
+    TaskId id;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        id = static_cast<TaskId>(mTasks.size());
+
+        Task task;
+        task.name = name;
+        task.detail = detail;
+        task.func = func;
+        task.numPending = 0;
+        task.mainThread = mainThread;
+        task.started = false;
+        task.done = false;
+        task.startMs = 0.0;
+        task.endMs = 0.0;
+        task.thread = 0;
+        mTasks.push_back(std::move(task));
+
+        for (const TaskId dependency : dependencies) {
+            assert(dependency < id && "dependencies have to be added first");
+            Task& other = mTasks[dependency];
+            if (!other.done) {
+                other.dependents.push_back(id);
+                ++mTasks[id].numPending;
+            }
+        }
+
+        ++mNumUnfinished;
+        if (mRunning && !mTasks[id].numPending && this->MakeReadyLocked(id)) {
+            ready.push_back(id);
+        }
+    }
+    this->Dispatch(ready);
+    return id;
+}
+
+void TaskGraph::Run(ThreadPool& pool) {
+    std::vector<TaskId> ready;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPool = &pool;
+        mRunning = true;
+        mStartTime = std::chrono::steady_clock::now();
+        mThreads.assign(1, std::this_thread::get_id());
+        for (TaskId id = 0; id < static_cast<TaskId>(mTasks.size()); ++id) {
+            const Task& task = mTasks[id];
+            if (!task.started && !task.numPending && this->MakeReadyLocked(id)) {
+                ready.push_back(id);
+            }
+        }
+    }
+    this->Dispatch(ready);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;) {
+        mCondition.wait(lock, [this]() { return !mMainQueue.empty() || !mNumUnfinished; });
+        if (mMainQueue.empty()) {
+            break;
+        }
+        const TaskId id = mMainQueue.front();
+        mMainQueue.pop_front();
+
+        lock.unlock();
+        this->Execute(id);
+        lock.lock();
+    }
+
+    mTotalMs = this->GetMsLocked();
+    mRunning = false;
+    mPool = nullptr;
+}
+
+void TaskGraph::Clear() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    assert(!mRunning);
+    mTasks.clear();
+    mMainQueue.clear();
+    mNumUnfinished = 0;
+    mTotalMs = 0.0;
+}
+
+size_t TaskGraph::GetNumTasks() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mTasks.size();
+}
+
+double TaskGraph::GetTotalMs() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mTotalMs;
+}
+
+void TaskGraph::GetTimings(std::vector<Timing>& out) const {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        out.clear();
+        for (const Task& task : mTasks) {
+            if (task.done) {
+                out.push_back(Timing{ task.name, task.detail, task.startMs, task.endMs, task.thread });
+            }
+        }
+    }
+    std::stable_sort(out.begin(), out.end(), [](const Timing& a, const Timing& b) {
+        return a.startMs < b.startMs;
+    });
+}
+
+void TaskGraph::PrintTimeline(FILE* file, const char* title) const {
+    std::vector<Timing> timings;
+    this->GetTimings(timings);
+    const double totalMs = this->GetTotalMs();
+
+    uint32_t numThreads = 0;
+    double busyMs = 0.0;
+    for (const Timing& timing : timings) {
+        numThreads = std::max(numThreads, timing.thread + 1);
+        busyMs += timing.endMs - timing.startMs;
+    }
+
+    fprintf(file, "%s: %u tasks in %.1f ms on %u threads, %.1f ms of work\n",
+            title, static_cast<uint32_t>(timings.size()), totalMs, numThreads, busyMs);
+    fprintf(file, "  %8s %8s %8s %6s  %-*s  %s\n", "start", "end", "ms", "thread", static_cast<int>(sTimelineWidth), "", "task");
+    for (const Timing& timing : timings) {
+        // where the task sits in the run, at least one column wide
+        char bar[sTimelineWidth + 1];
+        const double scale = (totalMs > 0.0) ? (sTimelineWidth / totalMs) : 0.0;
+        const size_t begin = std::min(static_cast<size_t>(timing.startMs * scale), sTimelineWidth - 1);
+        const size_t end = std::max(begin + 1, std::min(static_cast<size_t>(timing.endMs * scale + 0.5), sTimelineWidth));
+        for (size_t i = 0; i < sTimelineWidth; ++i) {
+            bar[i] = (i >= begin && i < end) ? '#' : '.';
+        }
+        bar[sTimelineWidth] = '\0';
+
+        fprintf(file, "  %8.1f %8.1f %8.1f %6u  %s  %s%s%s%s\n",
+                timing.startMs, timing.endMs, timing.endMs - timing.startMs, timing.thread, bar, timing.name,
+                timing.detail.empty() ? "" : " (", timing.detail.c_str(), timing.detail.empty() ? "" : ")");
+    }
+}
+
+bool TaskGraph::MakeReadyLocked(const TaskId id) {
+    Task& task = mTasks[id];
+    task.started = true;
+    if (task.mainThread || !mPool->GetNumThreads()) {
+        mMainQueue.push_back(id);
+        mCondition.notify_all();
+        return false;
+    }
+    return true;
+}
+
+void TaskGraph::Dispatch(const std::vector<TaskId>& ids) {
+    for (const TaskId id : ids) {
+        mPool->Enqueue([this, id]() {
+            this->Execute(id);
+        });
+    }
+}
+
+void TaskGraph::Execute(const TaskId id) {
+    const char* name;
+    Func func;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Task& task = mTasks[id];
+        task.startMs = this->GetMsLocked();
+        task.thread = this->GetThreadIndexLocked();
+        name = task.name;
+        func = std::move(task.func);
+    }
+
+    {
+        PROFILE_ZONE(name);
+        func();
+    }
+
+    std::vector<TaskId> ready;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Task& task = mTasks[id];
+        task.endMs = this->GetMsLocked();
+        task.done = true;
+        for (const TaskId dependent : task.dependents) {
+            if (!--mTasks[dependent].numPending && this->MakeReadyLocked(dependent)) {
+                ready.push_back(dependent);
+            }
+        }
+        task.dependents.clear();
+        if (!--mNumUnfinished) {
+            mCondition.notify_all();
+        }
+    }
+    this->Dispatch(ready);
+}
+
+double TaskGraph::GetMsLocked() const {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mStartTime).count();
+}
+
+uint32_t TaskGraph::GetThreadIndexLocked() {
+    const std::thread::id thread = std::this_thread::get_id();
+    auto it = std::find(mThreads.begin(), mThreads.end(), thread);
+    if (it == mThreads.end()) {
+        mThreads.push_back(thread);
+        return static_cast<uint32_t>(mThreads.size() - 1);
+    }
+    return static_cast<uint32_t>(it - mThreads.begin());
+}
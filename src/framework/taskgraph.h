@@ -0,0 +1,87 @@
+#pragma once
+
+#include "threadpool.h"
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// Tasks with explicit dependencies, run on a ThreadPool: a task starts as soon as everything it depends on is
+// done, independent ones overlap. Dependencies can only name tasks added before, so the graph can't have cycles.
+// Tasks may add more tasks while the graph runs (work that's only known along the way, one per mesh loaded...),
+// Run() returns once every task, added before or during the run, is done.
+// Main thread tasks run on the thread that called Run(), for what has to stay there (queue submissions, or
+// anything sharing the app's command pool). Without pool workers everything runs there, in dependency order.
+// Start & end of every task are kept for PrintTimeline().
+class TaskGraph {
+public:
+    using TaskId = uint32_t;
+    using Func = std::function<void()>;
+
+    struct Timing {
+        const char*     name;
+        std::string     detail;
+        double          startMs;        // since Run() started
+        double          endMs;
+        uint32_t        thread;         // 0 - the one that called Run(), then the workers in order of appearance
+    };
+
+    TaskGraph();
+    ~TaskGraph() = default;
+
+    // name is kept by pointer (it's a profiler zone too) - string literals. detail only shows in the timeline
+    TaskId      Add(const char* name, const Func& func, const std::vector<TaskId>& dependencies = {}, const std::string& detail = std::string());
+    TaskId      AddMainThread(const char* name, const Func& func, const std::vector<TaskId>& dependencies = {}, const std::string& detail = std::string());
+
+    // must not be called from inside a pool job (the pool's ParallelFor has the same rule)
+    void        Run(ThreadPool& pool);
+    void        Clear();
+
+    size_t      GetNumTasks() const;
+    double      GetTotalMs() const;
+    // in the order tasks started
+    void        GetTimings(std::vector<Timing>& out) const;
+    void        PrintTimeline(FILE* file = stdout, const char* title = "Tasks") const;
+
+private:
+    struct Task {
+        const char*             name;
+        std::string             detail;
+        Func                    func;
+        std::vector<TaskId>     dependents;
+        uint32_t                numPending;     // dependencies not done yet
+        bool                    mainThread;
+        bool                    started;
+        bool                    done;
+        double                  startMs;
+        double                  endMs;
+        uint32_t                thread;
+    };
+
+    TaskId      AddTask(const char* name, const Func& func, const std::vector<TaskId>& dependencies, const std::string& detail, const bool mainThread);
+    // locked: the task can start, queues it for the main thread or hands it to the pool (returned, the pool is
+    // only called once the lock is released)
+    bool        MakeReadyLocked(const TaskId id);
+    void        Dispatch(const std::vector<TaskId>& ids);
+    void        Execute(const TaskId id);
+    double      GetMsLocked() const;
+    uint32_t    GetThreadIndexLocked();
+
+private:
+    mutable std::mutex                      mMutex;
+    std::condition_variable                 mCondition;     // main thread work or everything done
+    std::deque<Task>                        mTasks;         // a deque: tasks are added while others refer to theirs
+    std::deque<TaskId>                      mMainQueue;
+    std::vector<std::thread::id>            mThreads;       // index = Timing::thread
+    ThreadPool*                             mPool;
+    bool                                    mRunning;
+    size_t                                  mNumUnfinished;
+    std::chrono::steady_clock::time_point   mStartTime;
+    double                                  mTotalMs;
+};
@@ -0,0 +1,450 @@
+#include "texturecache.h"
+#include "memorytracker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+// textures stamped this many frames before the ones that may still be in flight get loaded
+static const uint32_t sRequestFrames = 4;
+// decodes queued at once, the worker pool is shared with the scene loader
+static const uint32_t sMaxLoadsInFlight = 4;
+// uploads started per frame, each one is a submit & a staging buffer
+static const uint32_t sMaxUploadsPerFrame = 4;
+
+TextureCache::TextureCache(const uint32_t maxTextures)
+    : mPhysicalDevice(VK_NULL_HANDLE)
+    , mDevice(VK_NULL_HANDLE)
+    , mCommandPool(VK_NULL_HANDLE)
+    , mQueue(VK_NULL_HANDLE)
+    , mRegistry(nullptr)
+    , mTable(0)
+    , mThreadPool(nullptr)
+    , mMaxTextures(maxTextures)
+    , mBudgetBytes(0)
+    , mFormat(TextureFormat::RGBA8)
+    , mSampler(VK_NULL_HANDLE)
+    , mSlots(nullptr)
+    , mUse(nullptr)
+    , mNumJobs(0)
+    , mResidentBytes(0)
+    , mNumUploads(0)
+    , mNumEvictions(0)
+{
+}
+TextureCache::~TextureCache() {
+    this->Destroy();
+}
+
+bool TextureCache::Initialize(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandPool commandPool, VkQueue queue,
+                              BindlessRegistry* registry, const uint32_t table, ThreadPool* threadPool,
+                              const uint64_t budgetBytes, const TextureFormat format) {
+    mPhysicalDevice = physicalDevice;
+    mDevice = device;
+    mCommandPool = commandPool;
+    mQueue = queue;
+    mRegistry = registry;
+    mTable = table;
+    mThreadPool = threadPool;
+    mBudgetBytes = budgetBytes;
+
+    mFormat = format;
+    while (!this->IsSupported(mFormat)) {
+        const TextureFormat fallback = (mFormat == TextureFormat::BC7) ? TextureFormat::BC1 : TextureFormat::RGBA8;
+        printf("Textures: %s can't be sampled on this device, using %s\n", GetTextureFormatName(mFormat), GetTextureFormatName(fallback));
+        mFormat = fallback;
+    }
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    VkResult error = vkCreateSampler(mDevice, &samplerInfo, nullptr, &mSampler);
+    if (VK_SUCCESS != error) {
+        return false;
+    }
+
+    MemoryTracker::Scope memoryScope(MemoryCategory::Texture, "texture slots & use");
+    const VkDeviceSize bufferSize = mMaxTextures * sizeof(uint32_t);
+    error = mSlotsBuffer.Create(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (VK_SUCCESS != error) {
+        return false;
+    }
+    error = mUseBuffer.Create(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (VK_SUCCESS != error) {
+        return false;
+    }
+
+    mSlots = reinterpret_cast<uint32_t*>(mSlotsBuffer.Map());
+    std::fill(mSlots, mSlots + mMaxTextures, InvalidId);
+    uint32_t* use = reinterpret_cast<uint32_t*>(mUseBuffer.Map());
+    std::fill(use, use + mMaxTextures, 0u);
+    mUse = use;
+
+    printf("Textures: %s, %.0f MB budget, %u slots\n", GetTextureFormatName(mFormat), mBudgetBytes / (1024.0 * 1024.0),
+           mRegistry->GetCapacity(BindlessRegistry::Kind::Texture));
+    return true;
+}
+
+void TextureCache::Destroy() {
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mJobsDone.wait(lock, [this]() { return mNumJobs == 0; });
+    }
+
+    for (Upload& upload : mUploads) {
+        vkFreeCommandBuffers(mDevice, mCommandPool, 1, &upload.commandBuffer);
+        vkDestroyFence(mDevice, upload.fence, nullptr);
+    }
+    mUploads.clear();
+    mRetired.clear();
+    mTextures.clear();
+    mIds.clear();
+    mResidentBytes = 0;
+
+    if (mSlots) {
+        mSlotsBuffer.Unmap();
+        mUseBuffer.Unmap();
+        mSlots = nullptr;
+        mUse = nullptr;
+    }
+    mSlotsBuffer.Destroy();
+    mUseBuffer.Destroy();
+
+    if (mSampler) {
+        vkDestroySampler(mDevice, mSampler, nullptr);
+        mSampler = VK_NULL_HANDLE;
+    }
+}
+
+uint32_t TextureCache::Register(const std::string& fileName) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mIds.find(fileName);
+    if (it != mIds.end()) {
+        return it->second;
+    }
+    if (mTextures.size() >= mMaxTextures) {
+        printf("Textures: more than %u files, %s won't be sampled\n", mMaxTextures, fileName.c_str());
+        return InvalidId;
+    }
+
+    const uint32_t id = static_cast<uint32_t>(mTextures.size());
+    mTextures.emplace_back();
+    Texture& texture = mTextures.back();
+    texture.fileName = fileName;
+    texture.state = State::Unloaded;
+    texture.slot = SlotAllocator::InvalidSlot;
+    texture.lastUse = 0;
+    texture.bytes = 0;
+    mIds.insert(std::make_pair(fileName, id));
+    return id;
+}
+
+bool TextureCache::Update(const uint64_t frame, const uint64_t completedFrame, const uint32_t framesInFlight, bool& rerecord) {
+    rerecord = false;
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    const uint32_t published = this->PublishUploads();
+    if (published && !mRegistry->IsUpdateAfterBind()) {
+        rerecord = true;
+    }
+
+    while (!mRetired.empty() && mRetired.front().frame <= completedFrame) {
+        mRetired.pop_front();
+    }
+
+    // stamps only ever come from frames that are done, the last framesInFlight ones can't have any yet
+    const uint32_t stamp = GetStamp(frame);
+    const uint32_t requestWindow = framesInFlight + sRequestFrames;
+    uint32_t numLoads = 0;
+    for (const Texture& texture : mTextures) {
+        numLoads += (texture.state == State::Loading) ? 1 : 0;
+    }
+
+    uint32_t numUploads = 0;
+    for (uint32_t id = 0; id < static_cast<uint32_t>(mTextures.size()); ++id) {
+        Texture& texture = mTextures[id];
+        texture.lastUse = mUse[id];
+        const bool recent = texture.lastUse && (stamp - texture.lastUse) <= requestWindow;
+
+        if (texture.state == State::Unloaded && recent && numLoads < sMaxLoadsInFlight) {
+            texture.state = State::Loading;
+            ++numLoads;
+            this->Load(id);
+        } else if (texture.state == State::Loaded && numUploads < sMaxUploadsPerFrame) {
+            // waits for the budget (or a slot) to free up otherwise, as long as anything else is resident
+            if (this->MakeRoom(texture.bytes, stamp, framesInFlight, frame) && this->StartUpload(id, frame)) {
+                ++numUploads;
+            }
+        }
+    }
+
+    return published > 0;
+}
+
+uint32_t TextureCache::GetStamp(const uint64_t frame) {
+    return static_cast<uint32_t>(frame) + 1u;
+}
+
+const vulkanhelpers::Buffer& TextureCache::GetSlotsBuffer() const {
+    return mSlotsBuffer;
+}
+
+const vulkanhelpers::Buffer& TextureCache::GetUseBuffer() const {
+    return mUseBuffer;
+}
+
+TextureFormat TextureCache::GetFormat() const {
+    return mFormat;
+}
+
+TextureCache::Stats TextureCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Stats stats = {};
+    stats.numTextures = static_cast<uint32_t>(mTextures.size());
+    for (const Texture& texture : mTextures) {
+        stats.numResident += (texture.state == State::Resident) ? 1 : 0;
+        stats.numLoading += (texture.state == State::Loading || texture.state == State::Loaded || texture.state == State::Uploading) ? 1 : 0;
+        stats.numFailed += (texture.state == State::Failed) ? 1 : 0;
+    }
+    stats.residentBytes = mResidentBytes;
+    stats.budgetBytes = mBudgetBytes;
+    stats.numUploads = mNumUploads;
+    stats.numEvictions = mNumEvictions;
+    return stats;
+}
+
+VkFormat TextureCache::GetVkFormat(const TextureFormat format) const {
+    // diffuse maps, color data
+    switch (format) {
+        case TextureFormat::BC1: return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+        case TextureFormat::BC7: return VK_FORMAT_BC7_SRGB_BLOCK;
+        default:                 return VK_FORMAT_R8G8B8A8_SRGB;
+    }
+}
+
+bool TextureCache::IsSupported(const TextureFormat format) const {
+    if (format == TextureFormat::RGBA8) {
+        return true;
+    }
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(mPhysicalDevice, this->GetVkFormat(format), &properties);
+    const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    return (properties.optimalTilingFeatures & needed) == needed;
+}
+
+void TextureCache::Load(const uint32_t id) {
+    ++mNumJobs;
+    const std::string fileName = mTextures[id].fileName;
+    const TextureFormat format = mFormat;
+
+    mThreadPool->Enqueue([this, id, fileName, format]() {
+        std::vector<uint8_t> rgba;
+        uint32_t width = 0, height = 0;
+        TextureMips mips;
+        const bool loaded = LoadTextureRGBA8(fileName, rgba, width, height);
+        if (loaded) {
+            TextureMips chain;
+            GenerateTextureMips(rgba.data(), width, height, true, chain);
+            if (format == TextureFormat::RGBA8) {
+                mips = std::move(chain);
+            } else {
+                EncodeTextureMips(chain, format, mips);
+            }
+        } else {
+            printf("Textures: couldn't load %s\n", fileName.c_str());
+        }
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        Texture& texture = mTextures[id];
+        if (loaded) {
+            texture.bytes = mips.data.size();
+            texture.mips = std::move(mips);
+            texture.state = State::Loaded;
+        } else {
+            texture.state = State::Failed;
+        }
+        --mNumJobs;
+        mJobsDone.notify_all();
+    });
+}
+
+uint32_t TextureCache::FindVictim(const uint32_t stamp, const uint32_t framesInFlight) const {
+    // least recently used first, never the ones the last frames sampled: that would only thrash
+    uint32_t victim = InvalidId;
+    for (uint32_t id = 0; id < static_cast<uint32_t>(mTextures.size()); ++id) {
+        const Texture& texture = mTextures[id];
+        if (texture.state != State::Resident || (stamp - texture.lastUse) <= framesInFlight + 1) {
+            continue;
+        }
+        if (victim == InvalidId || (stamp - texture.lastUse) > (stamp - mTextures[victim].lastUse)) {
+            victim = id;
+        }
+    }
+    return victim;
+}
+
+bool TextureCache::MakeRoom(const uint64_t bytes, const uint32_t stamp, const uint32_t framesInFlight, const uint64_t frame) {
+    // one texture bigger than the whole budget still gets in, alone
+    while (mResidentBytes && mResidentBytes + bytes > mBudgetBytes) {
+        const uint32_t victim = this->FindVictim(stamp, framesInFlight);
+        if (victim == InvalidId) {
+            return false;
+        }
+        this->Evict(victim, frame);
+    }
+
+    // out of slots: one gets evicted, it's free again once the frames that may read it are done
+    const SlotAllocator& slots = mRegistry->GetSlots(BindlessRegistry::Kind::Texture);
+    if (slots.GetNumAllocated() + slots.GetNumPending() >= slots.GetCapacity()) {
+        const uint32_t victim = slots.GetNumPending() ? InvalidId : this->FindVictim(stamp, framesInFlight);
+        if (victim != InvalidId) {
+            this->Evict(victim, frame);
+        }
+        return false;
+    }
+    return true;
+}
+
+void TextureCache::Evict(const uint32_t id, const uint64_t frame) {
+    Texture& texture = mTextures[id];
+    mSlots[id] = InvalidId;
+    mRegistry->Release(BindlessRegistry::Kind::Texture, texture.slot, frame);
+
+    Retired retired;
+    retired.image = std::move(texture.image);
+    retired.frame = frame;
+    mRetired.push_back(std::move(retired));
+
+    mResidentBytes -= texture.bytes;
+    texture.slot = SlotAllocator::InvalidSlot;
+    texture.state = State::Unloaded;
+    ++mNumEvictions;
+}
+
+bool TextureCache::StartUpload(const uint32_t id, const uint64_t frame) {
+    Texture& texture = mTextures[id];
+    const TextureMips& mips = texture.mips;
+
+    // evicted slots come back once the frames that may read them are done
+    const uint32_t slot = mRegistry->Allocate(BindlessRegistry::Kind::Texture);
+    if (slot == SlotAllocator::InvalidSlot) {
+        return false;
+    }
+
+    MemoryTracker::Scope memoryScope(MemoryCategory::Texture, texture.fileName);
+    const VkFormat format = this->GetVkFormat(mips.format);
+    const uint32_t numLevels = mips.GetNumLevels();
+
+    std::unique_ptr<vulkanhelpers::Image> image(new vulkanhelpers::Image());
+    VkResult error = image->Create(VK_IMAGE_TYPE_2D, format, { mips.width, mips.height, 1 }, VK_IMAGE_TILING_OPTIMAL,
+                                   VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, numLevels);
+    VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, numLevels, 0, 1 };
+    if (VK_SUCCESS == error) {
+        error = image->CreateImageView(VK_IMAGE_VIEW_TYPE_2D, format, range);
+    }
+
+    std::unique_ptr<vulkanhelpers::Buffer> staging(new vulkanhelpers::Buffer());
+    if (VK_SUCCESS == error) {
+        error = staging->Create(mips.data.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+    if (VK_SUCCESS != error || !staging->UploadData(mips.data.data(), mips.data.size())) {
+        printf("Textures: couldn't create %s's image (%.2f MB)\n", texture.fileName.c_str(), mips.data.size() / (1024.0 * 1024.0));
+        mRegistry->Release(BindlessRegistry::Kind::Texture, slot, frame);
+        texture.mips = TextureMips();
+        texture.state = State::Failed;
+        return false;
+    }
+
+    Upload upload;
+    upload.texture = id;
+
+    VkCommandBufferAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool = mCommandPool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 1;
+    error = vkAllocateCommandBuffers(mDevice, &allocateInfo, &upload.commandBuffer);
+    CHECK_VK_ERROR(error, "vkAllocateCommandBuffers");
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    error = vkCreateFence(mDevice, &fenceInfo, nullptr, &upload.fence);
+    CHECK_VK_ERROR(error, "vkCreateFence");
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(upload.commandBuffer, &beginInfo);
+
+    vulkanhelpers::ImageBarrier(upload.commandBuffer, image->GetImage(), range, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    std::vector<VkBufferImageCopy> regions(numLevels, VkBufferImageCopy{});
+    for (uint32_t level = 0; level < numLevels; ++level) {
+        VkBufferImageCopy& region = regions[level];
+        region.bufferOffset = mips.offsets[level];
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+        region.imageExtent = { mips.GetLevelWidth(level), mips.GetLevelHeight(level), 1 };
+    }
+    vkCmdCopyBufferToImage(upload.commandBuffer, staging->GetBuffer(), image->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           numLevels, regions.data());
+
+    vulkanhelpers::ImageBarrier(upload.commandBuffer, image->GetImage(), range, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    vkEndCommandBuffer(upload.commandBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &upload.commandBuffer;
+    error = vkQueueSubmit(mQueue, 1, &submitInfo, upload.fence);
+    CHECK_VK_ERROR(error, "vkQueueSubmit");
+
+    upload.staging = std::move(staging);
+    mUploads.push_back(std::move(upload));
+
+    texture.image = std::move(image);
+    texture.slot = slot;
+    texture.mips = TextureMips();
+    texture.state = State::Uploading;
+    mResidentBytes += texture.bytes;
+    ++mNumUploads;
+    return true;
+}
+
+uint32_t TextureCache::PublishUploads() {
+    // the slots are fresh ones no frame reads, only the mapping makes the textures visible
+    uint32_t published = 0;
+    while (!mUploads.empty() && VK_SUCCESS == vkGetFenceStatus(mDevice, mUploads.front().fence)) {
+        if (!published && !mRegistry->IsUpdateAfterBind()) {
+            // no descriptor of a bound set can be written under a pending command buffer
+            vkDeviceWaitIdle(mDevice);
+        }
+
+        Upload& upload = mUploads.front();
+        Texture& texture = mTextures[upload.texture];
+
+        VkDescriptorImageInfo imageInfo;
+        imageInfo.sampler = mSampler;
+        imageInfo.imageView = texture.image->GetImageView();
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        mRegistry->WriteImage(mTable, texture.slot, imageInfo);
+        mSlots[upload.texture] = texture.slot;
+        texture.state = State::Resident;
+
+        vkFreeCommandBuffers(mDevice, mCommandPool, 1, &upload.commandBuffer);
+        vkDestroyFence(mDevice, upload.fence, nullptr);
+        mUploads.pop_front();
+        ++published;
+    }
+    return published;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "vulkanhelpers.h"
+#include "bindlessregistry.h"
+#include "texturecodec.h"
+#include "threadpool.h"
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <cstdint>
+
+// The scene's textures, streamed in & out of device memory under a budget. Materials reference a texture by the
+// id Register() gave its file, the shaders map it to a bindless slot through Slots[id] (InvalidId while it isn't
+// resident: they fall back to the material's color) and stamp Use[id] with the frame's stamp whenever they
+// sample it, even when it isn't resident. That feedback drives the cache: textures used in the last frames get
+// loaded (decoded, mipmapped & block compressed on the worker pool, uploaded from the render thread and
+// published once their fence is signaled), the resident ones used the longest ago get evicted when the budget
+// would be exceeded. An evicted texture's slot & image stay untouched until the frames that may read them are done.
+// Slots & Use are host visible and shared by the frames in flight, a frame sees the old or the new slot of a
+// texture that changes residency, both are valid.
+class TextureCache {
+public:
+    static const uint32_t InvalidId = ~0u;
+
+    struct Stats {
+        uint32_t    numTextures;
+        uint32_t    numResident;
+        uint32_t    numLoading;     // decoding, waiting for room or uploading
+        uint32_t    numFailed;
+        uint64_t    residentBytes;
+        uint64_t    budgetBytes;
+        uint64_t    numUploads;     // since Initialize()
+        uint64_t    numEvictions;
+    };
+
+    // files that can be registered, resident or not. They can be before Initialize()
+    explicit TextureCache(const uint32_t maxTextures);
+    ~TextureCache();
+
+    // textures are sampled from table's slots (combined image samplers). commandPool & queue are the render
+    // thread's, format falls back to what the device can sample (BC7 -> BC1 -> RGBA8)
+    bool            Initialize(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandPool commandPool, VkQueue queue,
+                               BindlessRegistry* registry, const uint32_t table, ThreadPool* threadPool,
+                               const uint64_t budgetBytes, const TextureFormat format);
+    // waits for the loads in flight, the GPU has to be idle. Registered files are forgotten
+    void            Destroy();
+
+    // any thread, the same id for the same file. InvalidId once maxTextures files are in
+    uint32_t        Register(const std::string& fileName);
+
+    // render thread, once per frame before it's recorded / submitted: frame is its serial, frames up to
+    // completedFrame are done. True when textures got published, the frames have to start accumulating over.
+    // rerecord: without update-after-bind the descriptors were written with the GPU idle, the command buffers
+    // have to be recorded again
+    bool            Update(const uint64_t frame, const uint64_t completedFrame, const uint32_t framesInFlight, bool& rerecord);
+
+    // what the shaders stamp Use[] with during frame (UniformParams), 0 is never
+    static uint32_t GetStamp(const uint64_t frame);
+
+    const vulkanhelpers::Buffer&    GetSlotsBuffer() const;
+    const vulkanhelpers::Buffer&    GetUseBuffer() const;
+    TextureFormat   GetFormat() const;
+    Stats           GetStats() const;
+
+private:
+    enum class State : uint32_t {
+        Unloaded,
+        Loading,        // a worker is decoding it
+        Loaded,         // mips ready, waiting for budget or a slot
+        Uploading,
+        Resident,
+        Failed
+    };
+
+    struct Texture {
+        std::string                             fileName;
+        State                                   state;
+        uint32_t                                slot;
+        uint32_t                                lastUse;    // stamp
+        uint64_t                                bytes;      // texel data of every level
+        TextureMips                             mips;       // Loaded only
+        std::unique_ptr<vulkanhelpers::Image>   image;
+    };
+
+    struct Upload {
+        uint32_t                                texture;
+        std::unique_ptr<vulkanhelpers::Buffer>  staging;
+        VkCommandBuffer                         commandBuffer;
+        VkFence                                 fence;
+    };
+
+    struct Retired {
+        std::unique_ptr<vulkanhelpers::Image>   image;
+        uint64_t                                frame;      // last one that may read it
+    };
+
+    VkFormat        GetVkFormat(const TextureFormat format) const;
+    bool            IsSupported(const TextureFormat format) const;
+    void            Load(const uint32_t id);
+    uint32_t        FindVictim(const uint32_t stamp, const uint32_t framesInFlight) const;
+    bool            MakeRoom(const uint64_t bytes, const uint32_t stamp, const uint32_t framesInFlight, const uint64_t frame);
+    void            Evict(const uint32_t id, const uint64_t frame);
+    bool            StartUpload(const uint32_t id, const uint64_t frame);
+    uint32_t        PublishUploads();
+
+private:
+    VkPhysicalDevice            mPhysicalDevice;
+    VkDevice                    mDevice;
+    VkCommandPool               mCommandPool;
+    VkQueue                     mQueue;
+    BindlessRegistry*           mRegistry;
+    uint32_t                    mTable;
+    ThreadPool*                 mThreadPool;
+    const uint32_t              mMaxTextures;
+    uint64_t                    mBudgetBytes;
+    TextureFormat               mFormat;
+    VkSampler                   mSampler;
+
+    vulkanhelpers::Buffer       mSlotsBuffer;   // uint per id
+    vulkanhelpers::Buffer       mUseBuffer;     // uint per id, the GPU writes it
+    uint32_t*                   mSlots;         // both stay mapped
+    const uint32_t*             mUse;
+
+    mutable std::mutex          mMutex;         // the textures & the jobs' results
+    std::condition_variable     mJobsDone;
+    uint32_t                    mNumJobs;
+    std::vector<Texture>        mTextures;
+    std::map<std::string, uint32_t> mIds;
+
+    std::deque<Upload>          mUploads;       // oldest first, the queue finishes them in that order
+    std::deque<Retired>         mRetired;
+    uint64_t                    mResidentBytes; // uploading ones included
+    uint64_t                    mNumUploads;
+    uint64_t                    mNumEvictions;
+};
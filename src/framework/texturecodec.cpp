@@ -0,0 +1,603 @@
+#include "texturecodec.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cassert>
+
+// BC7 4 bit index interpolation weights, out of 64
+static const uint32_t sBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+// BC1 4 colors mode, where each index sits between the two endpoints
+static const float sBC1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+static const float* GetSrgbToLinearTable() {
+    struct Table {
+        float values[256];
+        Table() {
+            for (int i = 0; i < 256; ++i) {
+                const float c = static_cast<float>(i) / 255.0f;
+                values[i] = (c <= 0.04045f) ? (c / 12.92f) : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+        }
+    };
+    static const Table table;
+    return table.values;
+}
+
+static uint8_t LinearToSrgb8(const float linear) {
+    const float c = (linear <= 0.0031308f) ? (linear * 12.92f) : (1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f);
+    return static_cast<uint8_t>(std::min(std::max(c * 255.0f + 0.5f, 0.0f), 255.0f));
+}
+
+// principal axis of the texels (numChannels of 4), power iteration on their covariance. Zero when they're all the same
+static void PrincipalAxis(const uint8_t* rgba, const int numChannels, float* mean, float* axis) {
+    for (int c = 0; c < numChannels; ++c) {
+        float sum = 0.0f;
+        for (int i = 0; i < 16; ++i) {
+            sum += rgba[4 * i + c];
+        }
+        mean[c] = sum / 16.0f;
+    }
+
+    float cov[4][4] = {};
+    for (int i = 0; i < 16; ++i) {
+        float d[4];
+        for (int c = 0; c < numChannels; ++c) {
+            d[c] = rgba[4 * i + c] - mean[c];
+        }
+        for (int a = 0; a < numChannels; ++a) {
+            for (int b = 0; b < numChannels; ++b) {
+                cov[a][b] += d[a] * d[b];
+            }
+        }
+    }
+
+    float v[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int a = 0; a < numChannels; ++a) {
+            for (int b = 0; b < numChannels; ++b) {
+                next[a] += cov[a][b] * v[b];
+            }
+            length = std::max(length, std::fabs(next[a]));
+        }
+        if (length <= 0.0f) {
+            std::fill(axis, axis + numChannels, 0.0f);
+            return;
+        }
+        for (int c = 0; c < numChannels; ++c) {
+            v[c] = next[c] / length;
+        }
+    }
+
+    float length = 0.0f;
+    for (int c = 0; c < numChannels; ++c) {
+        length += v[c] * v[c];
+    }
+    length = std::sqrt(length);
+    for (int c = 0; c < numChannels; ++c) {
+        axis[c] = v[c] / length;
+    }
+}
+
+// the texels' extent along the axis, as two endpoints (unquantized)
+static void AxisEndpoints(const uint8_t* rgba, const int numChannels, const float* mean, const float* axis, float* e0, float* e1) {
+    float tMin = 0.0f, tMax = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        float t = 0.0f;
+        for (int c = 0; c < numChannels; ++c) {
+            t += (rgba[4 * i + c] - mean[c]) * axis[c];
+        }
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    for (int c = 0; c < numChannels; ++c) {
+        e0[c] = std::min(std::max(mean[c] + axis[c] * tMin, 0.0f), 255.0f);
+        e1[c] = std::min(std::max(mean[c] + axis[c] * tMax, 0.0f), 255.0f);
+    }
+}
+
+// endpoints minimizing the squared error of the texels for the weights their indices have, false when degenerate
+static bool LeastSquaresEndpoints(const uint8_t* rgba, const int numChannels, const float* weights, float* e0, float* e1) {
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < 16; ++i) {
+        const float t = weights[i];
+        const float s = 1.0f - t;
+        aa += s * s;
+        ab += s * t;
+        bb += t * t;
+        for (int c = 0; c < numChannels; ++c) {
+            ax[c] += s * rgba[4 * i + c];
+            bx[c] += t * rgba[4 * i + c];
+        }
+    }
+
+    const float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f) {
+        return false;
+    }
+    for (int c = 0; c < numChannels; ++c) {
+        e0[c] = std::min(std::max((bb * ax[c] - ab * bx[c]) / det, 0.0f), 255.0f);
+        e1[c] = std::min(std::max((aa * bx[c] - ab * ax[c]) / det, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+static void WriteBits(uint8_t* block, uint32_t& pos, const uint32_t value, const uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i, ++pos) {
+        if ((value >> i) & 1u) {
+            block[pos >> 3] |= static_cast<uint8_t>(1u << (pos & 7u));
+        }
+    }
+}
+
+static uint32_t ReadBits(const uint8_t* block, uint32_t& pos, const uint32_t count) {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < count; ++i, ++pos) {
+        value |= static_cast<uint32_t>((block[pos >> 3] >> (pos & 7u)) & 1u) << i;
+    }
+    return value;
+}
+
+
+uint32_t TextureMips::GetNumLevels() const {
+    return static_cast<uint32_t>(offsets.size());
+}
+
+uint32_t TextureMips::GetLevelWidth(const uint32_t level) const {
+    return std::max(width >> level, 1u);
+}
+
+uint32_t TextureMips::GetLevelHeight(const uint32_t level) const {
+    return std::max(height >> level, 1u);
+}
+
+const char* GetTextureFormatName(const TextureFormat format) {
+    switch (format) {
+        case TextureFormat::BC1: return "bc1";
+        case TextureFormat::BC7: return "bc7";
+        default:                 return "rgba8";
+    }
+}
+
+bool ParseTextureFormat(const std::string& name, TextureFormat& format) {
+    if (name == "rgba8") {
+        format = TextureFormat::RGBA8;
+    } else if (name == "bc1") {
+        format = TextureFormat::BC1;
+    } else if (name == "bc7") {
+        format = TextureFormat::BC7;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+size_t GetTextureBlockSize(const TextureFormat format) {
+    switch (format) {
+        case TextureFormat::BC1: return 8;
+        case TextureFormat::BC7: return 16;
+        default:                 return 4;
+    }
+}
+
+size_t GetTextureLevelSize(const TextureFormat format, const uint32_t width, const uint32_t height) {
+    if (format == TextureFormat::RGBA8) {
+        return static_cast<size_t>(width) * height * 4;
+    }
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * GetTextureBlockSize(format);
+}
+
+uint32_t GetTextureNumLevels(const uint32_t width, const uint32_t height) {
+    uint32_t numLevels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+        ++numLevels;
+    }
+    return numLevels;
+}
+
+bool LoadTextureRGBA8(const std::string& fileName, std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height) {
+    int w = 0, h = 0, channels = 0;
+    stbi_uc* pixels = stbi_load(fileName.c_str(), &w, &h, &channels, STBI_rgb_alpha);
+    if (!pixels) {
+        return false;
+    }
+
+    width = static_cast<uint32_t>(w);
+    height = static_cast<uint32_t>(h);
+    rgba.assign(pixels, pixels + static_cast<size_t>(w) * h * 4);
+    stbi_image_free(pixels);
+    return true;
+}
+
+void GenerateTextureMips(const uint8_t* rgba, const uint32_t width, const uint32_t height, const bool srgb, TextureMips& out) {
+    const uint32_t numLevels = GetTextureNumLevels(width, height);
+    out.format = TextureFormat::RGBA8;
+    out.srgb = srgb;
+    out.width = width;
+    out.height = height;
+    out.offsets.resize(numLevels);
+    out.sizes.resize(numLevels);
+
+    size_t total = 0;
+    for (uint32_t level = 0; level < numLevels; ++level) {
+        out.offsets[level] = total;
+        out.sizes[level] = GetTextureLevelSize(TextureFormat::RGBA8, out.GetLevelWidth(level), out.GetLevelHeight(level));
+        total += out.sizes[level];
+    }
+    out.data.resize(total);
+    memcpy(out.data.data(), rgba, out.sizes[0]);
+
+    const float* toLinear = GetSrgbToLinearTable();
+    for (uint32_t level = 1; level < numLevels; ++level) {
+        const uint32_t srcWidth = out.GetLevelWidth(level - 1), srcHeight = out.GetLevelHeight(level - 1);
+        const uint32_t dstWidth = out.GetLevelWidth(level), dstHeight = out.GetLevelHeight(level);
+        const uint8_t* src = out.data.data() + out.offsets[level - 1];
+        uint8_t* dst = out.data.data() + out.offsets[level];
+
+        for (uint32_t y = 0; y < dstHeight; ++y) {
+            const uint32_t y0 = std::min(2 * y, srcHeight - 1), y1 = std::min(2 * y + 1, srcHeight - 1);
+            for (uint32_t x = 0; x < dstWidth; ++x) {
+                const uint32_t x0 = std::min(2 * x, srcWidth - 1), x1 = std::min(2 * x + 1, srcWidth - 1);
+                const uint8_t* texels[4] = {
+                    src + 4 * (static_cast<size_t>(y0) * srcWidth + x0), src + 4 * (static_cast<size_t>(y0) * srcWidth + x1),
+                    src + 4 * (static_cast<size_t>(y1) * srcWidth + x0), src + 4 * (static_cast<size_t>(y1) * srcWidth + x1)
+                };
+                uint8_t* texel = dst + 4 * (static_cast<size_t>(y) * dstWidth + x);
+
+                for (int c = 0; c < 4; ++c) {
+                    if (srgb && c < 3) {
+                        const float sum = toLinear[texels[0][c]] + toLinear[texels[1][c]] + toLinear[texels[2][c]] + toLinear[texels[3][c]];
+                        texel[c] = LinearToSrgb8(0.25f * sum);
+                    } else {
+                        texel[c] = static_cast<uint8_t>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void EncodeTextureMips(const TextureMips& rgba, const TextureFormat format, TextureMips& out) {
+    assert(rgba.format == TextureFormat::RGBA8);
+    if (format == TextureFormat::RGBA8) {
+        out = rgba;
+        return;
+    }
+
+    const uint32_t numLevels = rgba.GetNumLevels();
+    const size_t blockSize = GetTextureBlockSize(format);
+    out.format = format;
+    out.srgb = rgba.srgb;
+    out.width = rgba.width;
+    out.height = rgba.height;
+    out.offsets.resize(numLevels);
+    out.sizes.resize(numLevels);
+
+    size_t total = 0;
+    for (uint32_t level = 0; level < numLevels; ++level) {
+        out.offsets[level] = total;
+        out.sizes[level] = GetTextureLevelSize(format, rgba.GetLevelWidth(level), rgba.GetLevelHeight(level));
+        total += out.sizes[level];
+    }
+    out.data.assign(total, 0);
+
+    for (uint32_t level = 0; level < numLevels; ++level) {
+        const uint32_t width = rgba.GetLevelWidth(level), height = rgba.GetLevelHeight(level);
+        const uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        const uint8_t* src = rgba.data.data() + rgba.offsets[level];
+        uint8_t* dst = out.data.data() + out.offsets[level];
+
+        uint8_t texels[64];
+        for (uint32_t by = 0; by < blocksY; ++by) {
+            for (uint32_t bx = 0; bx < blocksX; ++bx) {
+                for (uint32_t i = 0; i < 16; ++i) {
+                    const uint32_t x = std::min(4 * bx + (i & 3), width - 1);
+                    const uint32_t y = std::min(4 * by + (i >> 2), height - 1);
+                    memcpy(texels + 4 * i, src + 4 * (static_cast<size_t>(y) * width + x), 4);
+                }
+
+                uint8_t* block = dst + (static_cast<size_t>(by) * blocksX + bx) * blockSize;
+                if (format == TextureFormat::BC1) {
+                    EncodeBC1Block(texels, block);
+                } else {
+                    EncodeBC7Block(texels, block);
+                }
+            }
+        }
+    }
+}
+
+
+//////////////////////////////////////// BC1 ////////////////////////////////////////
+
+static uint16_t To565(const float* rgb) {
+    const uint32_t r = static_cast<uint32_t>(std::min(std::max(rgb[0] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f));
+    const uint32_t g = static_cast<uint32_t>(std::min(std::max(rgb[1] * 63.0f / 255.0f + 0.5f, 0.0f), 63.0f));
+    const uint32_t b = static_cast<uint32_t>(std::min(std::max(rgb[2] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void From565(const uint16_t color, int* rgb) {
+    const int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// the 4 colors of the c0 > c1 mode
+static void BC1Palette(const uint16_t c0, const uint16_t c1, int palette[4][3]) {
+    From565(c0, palette[0]);
+    From565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+}
+
+// c0 > c1 has to hold, returns the squared error
+static uint32_t BC1Indices(const uint8_t* rgba, const uint16_t c0, const uint16_t c1, uint32_t& indices) {
+    int palette[4][3];
+    BC1Palette(c0, c1, palette);
+
+    uint32_t error = 0;
+    indices = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t best = 0, bestError = UINT32_MAX;
+        for (uint32_t p = 0; p < 4; ++p) {
+            uint32_t e = 0;
+            for (int c = 0; c < 3; ++c) {
+                const int d = rgba[4 * i + c] - palette[p][c];
+                e += static_cast<uint32_t>(d * d);
+            }
+            if (e < bestError) {
+                bestError = e;
+                best = p;
+            }
+        }
+        indices |= best << (2 * i);
+        error += bestError;
+    }
+    return error;
+}
+
+// quantized endpoints in the 4 colors order, false when they collapse to the same color
+static bool BC1Endpoints(const float* e0, const float* e1, uint16_t& c0, uint16_t& c1) {
+    c0 = To565(e0);
+    c1 = To565(e1);
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+    return c0 != c1;
+}
+
+static void WriteBC1Block(uint8_t* block, const uint16_t c0, const uint16_t c1, const uint32_t indices) {
+    block[0] = static_cast<uint8_t>(c0 & 0xFF);
+    block[1] = static_cast<uint8_t>(c0 >> 8);
+    block[2] = static_cast<uint8_t>(c1 & 0xFF);
+    block[3] = static_cast<uint8_t>(c1 >> 8);
+    for (int i = 0; i < 4; ++i) {
+        block[4 + i] = static_cast<uint8_t>((indices >> (8 * i)) & 0xFF);
+    }
+}
+
+void EncodeBC1Block(const uint8_t* rgba, uint8_t* block) {
+    float mean[3], axis[3], e0[3], e1[3];
+    PrincipalAxis(rgba, 3, mean, axis);
+    AxisEndpoints(rgba, 3, mean, axis, e0, e1);
+
+    // pulled in a bit, the extremes rarely are where the error is smallest
+    for (int c = 0; c < 3; ++c) {
+        const float inset = (e1[c] - e0[c]) / 16.0f;
+        e0[c] += inset;
+        e1[c] -= inset;
+    }
+
+    uint16_t c0, c1;
+    if (!BC1Endpoints(e0, e1, c0, c1)) {
+        // a single color: c0 > c1 has to hold for the 4 colors mode, else index 0 is all it takes
+        const uint16_t color = To565(mean);
+        if (color > 0) {
+            WriteBC1Block(block, color, static_cast<uint16_t>(color - 1), 0);
+        } else {
+            WriteBC1Block(block, 1, 0, 0x55555555u);
+        }
+        return;
+    }
+
+    uint32_t indices;
+    uint32_t error = BC1Indices(rgba, c0, c1, indices);
+
+    // one least squares pass over the indices found
+    float weights[16];
+    for (int i = 0; i < 16; ++i) {
+        weights[i] = sBC1Weights[(indices >> (2 * i)) & 3];
+    }
+    uint16_t r0, r1;
+    if (LeastSquaresEndpoints(rgba, 3, weights, e0, e1) && BC1Endpoints(e0, e1, r0, r1)) {
+        uint32_t refinedIndices;
+        const uint32_t refinedError = BC1Indices(rgba, r0, r1, refinedIndices);
+        if (refinedError < error) {
+            c0 = r0;
+            c1 = r1;
+            indices = refinedIndices;
+            error = refinedError;
+        }
+    }
+
+    WriteBC1Block(block, c0, c1, indices);
+}
+
+void DecodeBC1Block(const uint8_t* block, uint8_t* rgba) {
+    const uint16_t c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+    const uint16_t c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+    const uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+
+    int palette[4][4];
+    From565(c0, palette[0]);
+    From565(c1, palette[1]);
+    palette[0][3] = palette[1][3] = 255;
+    for (int c = 0; c < 3; ++c) {
+        if (c0 > c1) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = (c0 > c1) ? 255 : 0;
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        const int* color = palette[(indices >> (2 * i)) & 3];
+        for (int c = 0; c < 4; ++c) {
+            rgba[4 * i + c] = static_cast<uint8_t>(color[c]);
+        }
+    }
+}
+
+
+//////////////////////////////////////// BC7 ////////////////////////////////////////
+
+// mode 6 endpoint: 7 bits per channel + a p-bit shared by the channels, the one that lands closer
+static void BC7QuantizeEndpoint(const float* e, uint32_t* q, uint32_t& p) {
+    float bestError = 0.0f;
+    for (uint32_t bit = 0; bit < 2; ++bit) {
+        uint32_t candidate[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; ++c) {
+            const float v = (e[c] - static_cast<float>(bit)) * 0.5f;
+            candidate[c] = static_cast<uint32_t>(std::min(std::max(v + 0.5f, 0.0f), 127.0f));
+            const float d = static_cast<float>((candidate[c] << 1) | bit) - e[c];
+            error += d * d;
+        }
+        if (!bit || error < bestError) {
+            bestError = error;
+            memcpy(q, candidate, sizeof(candidate));
+            p = bit;
+        }
+    }
+}
+
+struct BC7Mode6 {
+    uint32_t    q[2][4];    // 7 bit endpoints
+    uint32_t    p[2];
+    uint8_t     indices[16];
+};
+
+static uint32_t BC7Indices(const uint8_t* rgba, BC7Mode6& encoded) {
+    int e[2][4];
+    for (int i = 0; i < 2; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            e[i][c] = static_cast<int>((encoded.q[i][c] << 1) | encoded.p[i]);
+        }
+    }
+    int palette[16][4];
+    for (int w = 0; w < 16; ++w) {
+        for (int c = 0; c < 4; ++c) {
+            palette[w][c] = ((64 - static_cast<int>(sBC7Weights[w])) * e[0][c] + static_cast<int>(sBC7Weights[w]) * e[1][c] + 32) >> 6;
+        }
+    }
+
+    uint32_t error = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t best = 0, bestError = UINT32_MAX;
+        for (uint32_t w = 0; w < 16; ++w) {
+            uint32_t d = 0;
+            for (int c = 0; c < 4; ++c) {
+                const int diff = rgba[4 * i + c] - palette[w][c];
+                d += static_cast<uint32_t>(diff * diff);
+            }
+            if (d < bestError) {
+                bestError = d;
+                best = w;
+            }
+        }
+        encoded.indices[i] = static_cast<uint8_t>(best);
+        error += bestError;
+    }
+    return error;
+}
+
+void EncodeBC7Block(const uint8_t* rgba, uint8_t* block) {
+    float mean[4], axis[4], e0[4], e1[4];
+    PrincipalAxis(rgba, 4, mean, axis);
+    AxisEndpoints(rgba, 4, mean, axis, e0, e1);
+
+    BC7Mode6 encoded;
+    BC7QuantizeEndpoint(e0, encoded.q[0], encoded.p[0]);
+    BC7QuantizeEndpoint(e1, encoded.q[1], encoded.p[1]);
+    uint32_t error = BC7Indices(rgba, encoded);
+
+    // one least squares pass over the indices found
+    float weights[16];
+    for (int i = 0; i < 16; ++i) {
+        weights[i] = static_cast<float>(sBC7Weights[encoded.indices[i]]) / 64.0f;
+    }
+    if (error && LeastSquaresEndpoints(rgba, 4, weights, e0, e1)) {
+        BC7Mode6 refined;
+        BC7QuantizeEndpoint(e0, refined.q[0], refined.p[0]);
+        BC7QuantizeEndpoint(e1, refined.q[1], refined.p[1]);
+        if (BC7Indices(rgba, refined) < error) {
+            encoded = refined;
+        }
+    }
+
+    // the anchor (texel 0) index has its top bit implied to be 0: swap the endpoints if it isn't
+    if (encoded.indices[0] & 8) {
+        for (int c = 0; c < 4; ++c) {
+            std::swap(encoded.q[0][c], encoded.q[1][c]);
+        }
+        std::swap(encoded.p[0], encoded.p[1]);
+        for (int i = 0; i < 16; ++i) {
+            encoded.indices[i] = static_cast<uint8_t>(15 - encoded.indices[i]);
+        }
+    }
+
+    memset(block, 0, 16);
+    uint32_t pos = 0;
+    WriteBits(block, pos, 1u << 6, 7);
+    for (int c = 0; c < 4; ++c) {
+        WriteBits(block, pos, encoded.q[0][c], 7);
+        WriteBits(block, pos, encoded.q[1][c], 7);
+    }
+    WriteBits(block, pos, encoded.p[0], 1);
+    WriteBits(block, pos, encoded.p[1], 1);
+    WriteBits(block, pos, encoded.indices[0], 3);
+    for (int i = 1; i < 16; ++i) {
+        WriteBits(block, pos, encoded.indices[i], 4);
+    }
+    assert(pos == 128);
+}
+
+bool DecodeBC7Block(const uint8_t* block, uint8_t* rgba) {
+    uint32_t pos = 0;
+    if (ReadBits(block, pos, 7) != (1u << 6)) {
+        memset(rgba, 0, 64);
+        return false;
+    }
+
+    uint32_t q[2][4], p[2];
+    for (int c = 0; c < 4; ++c) {
+        q[0][c] = ReadBits(block, pos, 7);
+        q[1][c] = ReadBits(block, pos, 7);
+    }
+    p[0] = ReadBits(block, pos, 1);
+    p[1] = ReadBits(block, pos, 1);
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        const uint32_t w = sBC7Weights[ReadBits(block, pos, i ? 4 : 3)];
+        for (int c = 0; c < 4; ++c) {
+            const uint32_t a = (q[0][c] << 1) | p[0];
+            const uint32_t b = (q[1][c] << 1) | p[1];
+            rgba[4 * i + c] = static_cast<uint8_t>(((64 - w) * a + w * b + 32) >> 6);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// CPU side of the textures: decoding (stb_image), mip chains & block compression, no Vulkan in here.
+// BC1 - 4 bpp, opaque rgb. BC7 - 8 bpp, rgba, only mode 6 (one subset, 7.7.7.7 endpoints + p-bit, 4 bit
+// indices) is written: the best single mode there is, a fraction of the cost of a full mode search.
+enum class TextureFormat : uint32_t {
+    RGBA8,
+    BC1,
+    BC7
+};
+
+// One texture's mip chain, level 0 first, every level tightly packed in the same format
+struct TextureMips {
+    TextureFormat           format;
+    bool                    srgb;
+    uint32_t                width;      // of level 0
+    uint32_t                height;
+    std::vector<size_t>     offsets;    // of every level in data
+    std::vector<size_t>     sizes;
+    std::vector<uint8_t>    data;
+
+    uint32_t                GetNumLevels() const;
+    uint32_t                GetLevelWidth(const uint32_t level) const;
+    uint32_t                GetLevelHeight(const uint32_t level) const;
+};
+
+const char* GetTextureFormatName(const TextureFormat format);
+// "rgba8", "bc1" or "bc7", false for anything else
+bool        ParseTextureFormat(const std::string& name, TextureFormat& format);
+// bytes of a 4x4 block, of a pixel for RGBA8
+size_t      GetTextureBlockSize(const TextureFormat format);
+// tightly packed, partial blocks count as whole ones
+size_t      GetTextureLevelSize(const TextureFormat format, const uint32_t width, const uint32_t height);
+// levels down to 1x1
+uint32_t    GetTextureNumLevels(const uint32_t width, const uint32_t height);
+
+// any format stb_image reads, expanded to rgba
+bool        LoadTextureRGBA8(const std::string& fileName, std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height);
+
+// full RGBA8 chain, 2x2 box filter (edges clamped on odd sizes). srgb: color averaged in linear space, alpha never is
+void        GenerateTextureMips(const uint8_t* rgba, const uint32_t width, const uint32_t height, const bool srgb, TextureMips& out);
+// every level of an RGBA8 chain to format, blocks sticking out of a level are padded with its edge texels
+void        EncodeTextureMips(const TextureMips& rgba, const TextureFormat format, TextureMips& out);
+
+// rgba - 4x4 texels, row major
+void        EncodeBC1Block(const uint8_t* rgba, uint8_t* block);
+void        EncodeBC7Block(const uint8_t* rgba, uint8_t* block);
+void        DecodeBC1Block(const uint8_t* block, uint8_t* rgba);
+// false (and black) for the modes EncodeBC7Block never writes
+bool        DecodeBC7Block(const uint8_t* block, uint8_t* rgba);
@@ -0,0 +1,131 @@
+#include "threadpool.h"
+
+ThreadPool::ThreadPool()
+    : mNumActiveJobs(0)
+    , mQuit(false)
+{
+}
+ThreadPool::~ThreadPool() {
+    this->Shutdown();
+}
+
+void ThreadPool::Initialize(const size_t numThreads) {
+    this->Shutdown();
+
+    size_t count = numThreads;
+    if (!count) {
+        count = std::thread::hardware_concurrency();
+    }
+    if (!count) {
+        count = 1;
+    }
+
+    mQuit = false;
+    mWorkers.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        mWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+void ThreadPool::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mJobAvailable.notify_all();
+
+    for (std::thread& worker : mWorkers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    mWorkers.clear();
+    mJobs.clear();
+    mNumActiveJobs = 0;
+}
+
+void ThreadPool::Enqueue(const Job& job) {
+    // no workers - just run it in place
+    if (mWorkers.empty()) {
+        job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.push_back(job);
+        ++mNumActiveJobs;
+    }
+    mJobAvailable.notify_one();
+}
+
+void ThreadPool::ParallelFor(const size_t count, const size_t grainSize, const RangeJob& job) {
+    if (!count) {
+        return;
+    }
+
+    const size_t grain = grainSize ? grainSize : 1;
+    const size_t numChunks = (count + grain - 1) / grain;
+
+    if (mWorkers.empty() || numChunks == 1) {
+        job(0, count);
+        return;
+    }
+
+    // every chunk signals its own counter, so ParallelFor can be called while other jobs are in flight
+    // (must not be called from inside a pool job though)
+    size_t chunksLeft = numChunks;
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+
+    for (size_t chunk = 0; chunk < numChunks; ++chunk) {
+        const size_t begin = chunk * grain;
+        const size_t end = (begin + grain < count) ? (begin + grain) : count;
+
+        this->Enqueue([&job, &chunksLeft, &doneMutex, &doneCondition, begin, end]() {
+            job(begin, end);
+
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (--chunksLeft == 0) {
+                doneCondition.notify_one();
+            }
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(doneMutex);
+    doneCondition.wait(lock, [&chunksLeft]() { return chunksLeft == 0; });
+}
+
+void ThreadPool::WaitIdle() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mJobsDone.wait(lock, [this]() { return mNumActiveJobs == 0; });
+}
+
+size_t ThreadPool::GetNumThreads() const {
+    return mWorkers.size();
+}
+
+void ThreadPool::WorkerLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mJobAvailable.wait(lock, [this]() { return mQuit || !mJobs.empty(); });
+            if (mQuit && mJobs.empty()) {
+                return;
+            }
+            job = mJobs.front();
+            mJobs.pop_front();
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            --mNumActiveJobs;
+            if (!mNumActiveJobs) {
+                mJobsDone.notify_all();
+            }
+        }
+    }
+}
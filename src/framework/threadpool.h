@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Simple fixed-size worker pool.
+// Jobs are plain std::function's, ParallelFor splits a range into chunks and blocks until all of them are done.
+class ThreadPool {
+public:
+    using Job = std::function<void()>;
+    using RangeJob = std::function<void(const size_t begin, const size_t end)>;
+
+    ThreadPool();
+    ~ThreadPool();
+
+    void        Initialize(const size_t numThreads = 0); // 0 - use all hardware threads
+    void        Shutdown();
+
+    void        Enqueue(const Job& job);
+    void        ParallelFor(const size_t count, const size_t grainSize, const RangeJob& job);
+    void        WaitIdle();
+
+    size_t      GetNumThreads() const;
+
+private:
+    void        WorkerLoop();
+
+private:
+    std::vector<std::thread>    mWorkers;
+    std::deque<Job>             mJobs;
+    std::mutex                  mMutex;
+    std::condition_variable     mJobAvailable;
+    std::condition_variable     mJobsDone;
+    size_t                      mNumActiveJobs;
+    bool                        mQuit;
+};
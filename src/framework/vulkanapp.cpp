@@ -2,6 +2,19 @@
 
 // include volk.c for implementation
 #include "volk.c"
+
+#include "imgui.h"
+#include "texturecodec.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// headless readback ring: the CPU writes one frame while the GPU renders the next
+static const size_t sHeadlessFramesInFlight = 2;
+// the overlay's shaders sit with the app's
+static const String sShadersFolder = "_data/shaders/";
+
 VulkanApp::VulkanApp()
     : mSettings({})
     , mWindow(nullptr)
@@ -14,6 +27,9 @@ VulkanApp::VulkanApp()
     , mCommandPool(VK_NULL_HANDLE)
     , mSemaphoreImageAcquired(VK_NULL_HANDLE)
     , mSemaphoreRenderFinished(VK_NULL_HANDLE)
+    , mNumSubmittedFrames(0)
+    , mFrameStatsSummary({})
+    , mLastCpuFrameMs(0.0f)
     , mGraphicsQueueFamilyIndex(0u)
     , mComputeQueueFamilyIndex(0u)
     , mTransferQueueFamilyIndex(0u)
@@ -27,21 +43,28 @@ VulkanApp::~VulkanApp() {
     this->FreeVulkan();
 }
 
-void VulkanApp::Run() {
+void VulkanApp::Run(const int argc, const char** argv) {
+    mCommandLine.assign(argv + (argc > 0 ? 1 : 0), argv + argc);
+    PROFILE_THREAD_NAME("main");
+
     if (this->Initialize()) {
         this->Loop();
         this->Shutdown();
         this->FreeResources();
     }
+
+#if SWS_PROFILER
+    if (!mSettings.traceFile.empty()) {
+        profiler::SaveChromeTrace(mSettings.traceFile);
+    }
+#endif
 }
 
 
 bool VulkanApp::Initialize() {
-    if (!glfwInit()) {
-        return false;
-    }
+    PROFILE_ZONE("Initialize");
 
-    if (!glfwVulkanSupported()) {
+    if (!this->InitializeSettings()) {
         return false;
     }
 
@@ -49,34 +72,58 @@ bool VulkanApp::Initialize() {
         return false;
     }
 
-    this->InitializeSettings();
+    // render farm nodes have no display, GLFW wouldn't even initialize there
+    if (!mSettings.headless) {
+        if (!glfwInit()) {
+            return false;
+        }
 
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-    window = glfwCreateWindow(static_cast<int>(mSettings.resolutionX),
-                                          static_cast<int>(mSettings.resolutionY),
-                                          mSettings.name.c_str(),
-                                          nullptr, nullptr);
-    if (!window) {
-        return false;
-    }
+        if (!glfwVulkanSupported()) {
+            return false;
+        }
 
-    glfwSetWindowUserPointer(window, this);
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        window = glfwCreateWindow(static_cast<int>(mSettings.resolutionX),
+                                  static_cast<int>(mSettings.resolutionY),
+                                  mSettings.name.c_str(),
+                                  nullptr, nullptr);
+        if (!window) {
+            return false;
+        }
 
-    glfwSetKeyCallback(window, [](GLFWwindow* wnd, int key, int scancode, int action, int mods) {
-        VulkanApp* _this = reinterpret_cast<VulkanApp*>(glfwGetWindowUserPointer(wnd));
-        _this->OnKey(key, scancode, action, mods);
-    });
-    glfwSetMouseButtonCallback(window, [](GLFWwindow* wnd, int button, int action, int mods) {
-        VulkanApp* _this = reinterpret_cast<VulkanApp*>(glfwGetWindowUserPointer(wnd));
-        _this->OnMouseButton(button, action, mods);
-    });
-    glfwSetCursorPosCallback(window, [](GLFWwindow* wnd, double x, double y) {
-        VulkanApp* _this = reinterpret_cast<VulkanApp*>(glfwGetWindowUserPointer(wnd));
-        _this->OnMouseMove(static_cast<float>(x), static_cast<float>(y));
-    });
+        glfwSetWindowUserPointer(window, this);
 
-    mWindow = window;
+        glfwSetKeyCallback(window, [](GLFWwindow* wnd, int key, int scancode, int action, int mods) {
+            VulkanApp* _this = reinterpret_cast<VulkanApp*>(glfwGetWindowUserPointer(wnd));
+            if (GLFW_KEY_F1 == key && GLFW_PRESS == action) {
+                _this->ToggleOverlay();
+                return;
+            }
+            if (GLFW_KEY_F2 == key && GLFW_PRESS == action) {
+                GetMemoryTracker().PrintReport();
+                return;
+            }
+            // typing into the overlay, releases still go through so no key stays down
+            if (GLFW_RELEASE != action && _this->mOverlay.WantsKeyboard()) {
+                return;
+            }
+            _this->OnKey(key, scancode, action, mods);
+        });
+        glfwSetMouseButtonCallback(window, [](GLFWwindow* wnd, int button, int action, int mods) {
+            VulkanApp* _this = reinterpret_cast<VulkanApp*>(glfwGetWindowUserPointer(wnd));
+            if (GLFW_RELEASE != action && _this->mOverlay.WantsMouse()) {
+                return;
+            }
+            _this->OnMouseButton(button, action, mods);
+        });
+        glfwSetCursorPosCallback(window, [](GLFWwindow* wnd, double x, double y) {
+            VulkanApp* _this = reinterpret_cast<VulkanApp*>(glfwGetWindowUserPointer(wnd));
+            _this->OnMouseMove(static_cast<float>(x), static_cast<float>(y));
+        });
+
+        mWindow = window;
+    }
 
     if (!this->InitializeVulkan()) {
         return false;
@@ -87,17 +134,28 @@ bool VulkanApp::Initialize() {
     if (!this->InitializeDevicesAndQueues()) {
         return false;
     }
-    if (!this->InitializeSurface()) {
-        return false;
-    }
-    if (!this->InitializeSwapchain()) {
-        return false;
+    if (mSettings.headless) {
+        mSurfaceFormat.format = mSettings.surfaceFormat;
+        mSurfaceFormat.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+    } else {
+        if (!this->InitializeSurface()) {
+            return false;
+        }
+        if (!this->InitializeSwapchain()) {
+            return false;
+        }
     }
     if (!this->InitializeFencesAndCommandPool()) {
         return false;
     }
 
     vulkanhelpers::Initialize(mPhysicalDevice, mDevice, mCommandPool, mGraphicsQueue);
+    // embedded SPIR-V first, _data/shaders/ for builds without it
+    if (mSettings.shadersFolder.empty()) {
+        vulkanhelpers::SetShadersFolder(sShadersFolder, false);
+    } else {
+        vulkanhelpers::SetShadersFolder(mSettings.shadersFolder, true);
+    }
 
     if (!this->InitializeOffscreenImage()) {
         return false;
@@ -108,15 +166,57 @@ bool VulkanApp::Initialize() {
     if (!this->InitializeSynchronization()) {
         return false;
     }
+    if (mSettings.headless && !this->InitializeHeadlessOffscreenLayout()) {
+        return false;
+    }
+    // always on, the overlay's GPU frame time comes from it
+    mGpuProfiler.Initialize(mPhysicalDevice, mDevice, mGraphicsQueueFamilyIndex, mCommandBuffers.size() + 1);
+    // ImGui chains the GLFW callbacks installed above. Not fatal, the app just runs without it
+    if (!mSettings.headless &&
+        !mOverlay.Initialize(mWindow, mDevice, mGraphicsQueue, mGraphicsQueueFamilyIndex, mSurfaceFormat.format,
+                             { mSettings.resolutionX, mSettings.resolutionY }, mSwapchainImageViews)) {
+        printf("Overlay disabled\n");
+    }
 
-    this->InitApp();
+    {
+        PROFILE_ZONE("InitApp");
+        this->InitApp();
+    }
+    // the peaks include whatever InitApp only needed while setting up
+    GetMemoryTracker().PrintReport();
     this->FillCommandBuffers();
 
-
     return true;
 }
 
 void VulkanApp::Loop() {
+    if (mSettings.headless) {
+        printf("Headless: %u frames x %s%u samples, %ux%u, writing to %s\n",
+               mSettings.headlessFrames, (mSettings.errorThreshold > 0.0f) ? "up to " : "", mSettings.headlessSamples,
+               mSettings.resolutionX, mSettings.resolutionY, mSettings.outputFolder.c_str());
+
+        const auto startTime = std::chrono::steady_clock::now();
+        auto prevTime = startTime;
+        while (!this->IsHeadlessFinished()) {
+            const auto curTime = std::chrono::steady_clock::now();
+            const float deltaTime = std::chrono::duration<float>(curTime - prevTime).count();
+            prevTime = curTime;
+            if (!this->ProcessHeadlessFrame(deltaTime)) {
+                printf("Headless: frame submission failed, stopping\n");
+                break;
+            }
+        }
+
+        vkDeviceWaitIdle(mDevice);
+        this->FlushFrames();
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        printf("Headless: %llu passes in %.2f s (%.2f ms per pass)\n",
+               static_cast<unsigned long long>(mNumSubmittedFrames), seconds,
+               mNumSubmittedFrames ? (seconds * 1000.0 / mNumSubmittedFrames) : 0.0);
+        return;
+    }
+
     glfwSetTime(0.0);
     double curTime, prevTime = 0.0, deltaTime = 0.0;
     while (!glfwWindowShouldClose(mWindow)) {
@@ -132,11 +232,15 @@ void VulkanApp::Loop() {
 void VulkanApp::Shutdown() {
 
     vkDeviceWaitIdle(mDevice);
+    mGpuProfiler.ResolveAll();
+    mOverlay.Destroy();     // before GLFW goes, it gives the callbacks back
 
-    glfwTerminate();
+    if (!mSettings.headless) {
+        glfwTerminate();
+    }
 }
 
-void VulkanApp::InitializeSettings() {
+bool VulkanApp::InitializeSettings() {
     mSettings.name = "VulkanApp";
     mSettings.resolutionX = 1280;
     mSettings.resolutionY = 720;
@@ -144,8 +248,123 @@ void VulkanApp::InitializeSettings() {
     mSettings.enableValidation = false;
     mSettings.supportRaytracing = false;
     mSettings.supportDescriptorIndexing = false;
+    mSettings.headless = false;
+    mSettings.headlessFrames = 1;
+    mSettings.headlessSamples = 1;
+    mSettings.outputFolder = "_data/captures/";
+    mSettings.outputFormat = "exr";
+    mSettings.cameraPath.clear();
+    mSettings.frameRate = 24.0f;
+    mSettings.errorThreshold = 0.0f;
+    mSettings.resume = false;
+    mSettings.recordFile.clear();
+    mSettings.replayFile.clear();
+    mSettings.timingsFile.clear();
+    mSettings.traceFile.clear();
+    mSettings.quality.clear();
+    mSettings.shadersFolder.clear();
+    mSettings.hotReloadShaders = false;
+    mSettings.seed = 1;
+    mSettings.textureBudgetMB = 256;
+    mSettings.textureFormat = "bc7";
 
     this->InitSettings();
+
+    // command line wins over the app defaults
+    return this->ParseCommandLine();
+}
+
+bool VulkanApp::ParseCommandLine() {
+    for (size_t i = 0; i < mCommandLine.size(); ++i) {
+        const String& arg = mCommandLine[i];
+        const bool hasValue = (i + 1) < mCommandLine.size();
+
+        if (arg == "--headless") {
+            mSettings.headless = true;
+        } else if (arg == "--frames" && hasValue) {
+            mSettings.headlessFrames = static_cast<uint32_t>(strtoul(mCommandLine[++i].c_str(), nullptr, 10));
+        } else if (arg == "--spp" && hasValue) {
+            mSettings.headlessSamples = static_cast<uint32_t>(strtoul(mCommandLine[++i].c_str(), nullptr, 10));
+        } else if (arg == "--out" && hasValue) {
+            mSettings.outputFolder = mCommandLine[++i];
+            if (!mSettings.outputFolder.empty() && mSettings.outputFolder.back() != '/' && mSettings.outputFolder.back() != '\\') {
+                mSettings.outputFolder += '/';
+            }
+        } else if (arg == "--format" && hasValue) {
+            mSettings.outputFormat = mCommandLine[++i];
+        } else if (arg == "--camera-path" && hasValue) {
+            mSettings.cameraPath = mCommandLine[++i];
+        } else if (arg == "--fps" && hasValue) {
+            mSettings.frameRate = strtof(mCommandLine[++i].c_str(), nullptr);
+        } else if (arg == "--error" && hasValue) {
+            mSettings.errorThreshold = strtof(mCommandLine[++i].c_str(), nullptr);
+        } else if (arg == "--resume") {
+            mSettings.resume = true;
+        } else if (arg == "--record" && hasValue) {
+            mSettings.recordFile = mCommandLine[++i];
+        } else if (arg == "--replay" && hasValue) {
+            mSettings.replayFile = mCommandLine[++i];
+        } else if (arg == "--timings" && hasValue) {
+            mSettings.timingsFile = mCommandLine[++i];
+        } else if (arg == "--trace" && hasValue) {
+            mSettings.traceFile = mCommandLine[++i];
+        } else if (arg == "--quality" && hasValue) {
+            mSettings.quality = mCommandLine[++i];
+        } else if (arg == "--hot-reload") {
+            mSettings.hotReloadShaders = true;
+        } else if (arg == "--shaders" && hasValue) {
+            mSettings.shadersFolder = mCommandLine[++i];
+            if (!mSettings.shadersFolder.empty() && mSettings.shadersFolder.back() != '/' && mSettings.shadersFolder.back() != '\\') {
+                mSettings.shadersFolder += '/';
+            }
+        } else if (arg == "--seed" && hasValue) {
+            mSettings.seed = static_cast<uint32_t>(strtoul(mCommandLine[++i].c_str(), nullptr, 10));
+        } else if (arg == "--texture-budget" && hasValue) {
+            mSettings.textureBudgetMB = static_cast<uint32_t>(strtoul(mCommandLine[++i].c_str(), nullptr, 10));
+        } else if (arg == "--textures" && hasValue) {
+            mSettings.textureFormat = mCommandLine[++i];
+        } else if (arg == "--width" && hasValue) {
+            mSettings.resolutionX = static_cast<uint32_t>(strtoul(mCommandLine[++i].c_str(), nullptr, 10));
+        } else if (arg == "--height" && hasValue) {
+            mSettings.resolutionY = static_cast<uint32_t>(strtoul(mCommandLine[++i].c_str(), nullptr, 10));
+        } else {
+            printf("Unknown or incomplete argument: %s\n", arg.c_str());
+            printf("usage: %s [--headless] [--frames N] [--spp N] [--out folder] [--format exr|png|ppm]\n"
+                   "       [--camera-path file] [--fps N] [--error E] [--resume] [--width N] [--height N]\n"
+                   "       [--record file | --replay file [--timings file.csv]] [--trace file.json] [--quality preset]\n"
+                   "       [--shaders folder] [--hot-reload] [--seed N] [--texture-budget MB] [--textures bc7|bc1|rgba8]\n", mSettings.name.c_str());
+            return false;
+        }
+    }
+
+    if (!mSettings.headlessFrames || !mSettings.headlessSamples || !mSettings.resolutionX || !mSettings.resolutionY) {
+        printf("--frames, --spp, --width and --height must be greater than 0\n");
+        return false;
+    }
+    if (mSettings.frameRate <= 0.0f || mSettings.errorThreshold < 0.0f) {
+        printf("--fps must be greater than 0, --error can't be negative\n");
+        return false;
+    }
+    if (!mSettings.recordFile.empty() && (mSettings.headless || !mSettings.replayFile.empty())) {
+        printf("--record only works in an interactive session that isn't a replay\n");
+        return false;
+    }
+    if (!mSettings.replayFile.empty() && !mSettings.cameraPath.empty()) {
+        printf("--replay and --camera-path both drive the camera, pick one\n");
+        return false;
+    }
+    TextureFormat textureFormat;
+    if (!ParseTextureFormat(mSettings.textureFormat, textureFormat)) {
+        printf("--textures must be bc7, bc1 or rgba8\n");
+        return false;
+    }
+#if !SWS_PROFILER
+    if (!mSettings.traceFile.empty()) {
+        printf("--trace: the profiler is compiled out of this build (configure with -DRTXON_PROFILER=ON), no trace will be written\n");
+    }
+#endif
+
+    return true;
 }
 
 bool VulkanApp::InitializeVulkan() {
@@ -158,18 +377,22 @@ bool VulkanApp::InitializeVulkan() {
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.apiVersion = VK_API_VERSION_1_2;
 
-    uint32_t requiredExtensionsCount = 0;
-    const char** requiredExtensions = glfwGetRequiredInstanceExtensions(&requiredExtensionsCount);
-
     Array<const char*> extensions;
     Array<const char*> layers;
 
-    extensions.insert(extensions.begin(), requiredExtensions, requiredExtensions + requiredExtensionsCount);
+    if (!mSettings.headless) {
+        uint32_t requiredExtensionsCount = 0;
+        const char** requiredExtensions = glfwGetRequiredInstanceExtensions(&requiredExtensionsCount);
+        extensions.insert(extensions.begin(), requiredExtensions, requiredExtensions + requiredExtensionsCount);
+    }
 
     if (mSettings.enableValidation) {
         extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
         layers.push_back("VK_LAYER_KHRONOS_validation");
-		layers.push_back("VK_LAYER_LUNARG_monitor");
+        // the monitor layer draws into the window title
+        if (!mSettings.headless) {
+            layers.push_back("VK_LAYER_LUNARG_monitor");
+        }
     }
 
     VkInstanceCreateInfo instInfo;
@@ -280,7 +503,10 @@ bool VulkanApp::InitializeDevicesAndQueues() {
     VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddress = { };
     bufferDeviceAddress.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
 
-    Array<const char*> deviceExtensions({ VK_KHR_SWAPCHAIN_EXTENSION_NAME });
+    Array<const char*> deviceExtensions;
+    if (!mSettings.headless) {
+        deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
     if (mSettings.supportRaytracing) {
         deviceExtensions.push_back(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
         deviceExtensions.push_back(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
@@ -489,7 +715,7 @@ bool VulkanApp::InitializeFencesAndCommandPool() {
     fenceCreateInfo.pNext = nullptr;
     fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    mWaitForFrameFences.resize(mSwapchainImages.size());
+    mWaitForFrameFences.resize(this->GetNumFramesInFlight());
     for (VkFence& fence : mWaitForFrameFences) {
         vkCreateFence(mDevice, &fenceCreateInfo, nullptr, &fence);
     }
@@ -506,11 +732,12 @@ bool VulkanApp::InitializeFencesAndCommandPool() {
 
 bool VulkanApp::InitializeOffscreenImage() {
     const VkExtent3D extent = { mSettings.resolutionX, mSettings.resolutionY, 1 };
+    MemoryTracker::Scope memoryScope(MemoryCategory::Image, "offscreen");
     VkResult error = mOffscreenImage.Create(VK_IMAGE_TYPE_2D,
                                             mSurfaceFormat.format,
                                             extent,
                                             VK_IMAGE_TILING_OPTIMAL,
-                                            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
     if (VK_SUCCESS != error) {
@@ -523,7 +750,7 @@ bool VulkanApp::InitializeOffscreenImage() {
 }
 
 bool VulkanApp::InitializeCommandBuffers() {
-    mCommandBuffers.resize(mSwapchainImages.size());
+    mCommandBuffers.resize(this->GetNumFramesInFlight());
 
     VkCommandBufferAllocateInfo commandBufferAllocateInfo;
     commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -551,7 +778,57 @@ bool VulkanApp::InitializeSynchronization() {
     return (VK_SUCCESS == error);
 }
 
+bool VulkanApp::InitializeHeadlessOffscreenLayout() {
+    // headless passes accumulate into the offscreen image, so it lives in GENERAL for good instead of
+    // being discarded (UNDEFINED -> GENERAL) at the start of every frame
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.pNext = nullptr;
+    commandBufferAllocateInfo.commandPool = mCommandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    VkResult error = vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &commandBuffer);
+    if (VK_SUCCESS != error) {
+        return false;
+    }
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.pNext = nullptr;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = nullptr;
+
+    VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+    vulkanhelpers::ImageBarrier(commandBuffer,
+                                mOffscreenImage.GetImage(),
+                                subresourceRange,
+                                0,
+                                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                                VK_IMAGE_LAYOUT_UNDEFINED,
+                                VK_IMAGE_LAYOUT_GENERAL);
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    error = vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    if (VK_SUCCESS == error) {
+        error = vkQueueWaitIdle(mGraphicsQueue);
+    }
+
+    vkFreeCommandBuffers(mDevice, mCommandPool, 1, &commandBuffer);
+    return (VK_SUCCESS == error);
+}
+
 void VulkanApp::FillCommandBuffers() {
+    PROFILE_ZONE("FillCommandBuffers");
+
     VkCommandBufferBeginInfo commandBufferBeginInfo;
     commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     commandBufferBeginInfo.pNext = nullptr;
@@ -565,17 +842,39 @@ void VulkanApp::FillCommandBuffers() {
 
         VkResult error = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
         CHECK_VK_ERROR(error, "vkBeginCommandBuffer");
-
-        vulkanhelpers::ImageBarrier(commandBuffer,
-                                    mOffscreenImage.GetImage(),
-                                    subresourceRange,
-                                    0,
-                                    VK_ACCESS_SHADER_WRITE_BIT,
-                                    VK_IMAGE_LAYOUT_UNDEFINED,
-                                    VK_IMAGE_LAYOUT_GENERAL);
+        mGpuProfiler.BeginCommandBuffer(commandBuffer, i);
+        // not a PROFILE_GPU_ZONE, the overlay needs the GPU frame time in every build
+        const uint32_t frameZone = mGpuProfiler.BeginZone(commandBuffer, i, "Frame");
+
+        if (mSettings.headless) {
+            // previous pass may still be reading it back (or uploading the denoised frame into it)
+            vulkanhelpers::ImageBarrier(commandBuffer,
+                                        mOffscreenImage.GetImage(),
+                                        subresourceRange,
+                                        VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                                        VK_IMAGE_LAYOUT_GENERAL,
+                                        VK_IMAGE_LAYOUT_GENERAL);
+        } else {
+            vulkanhelpers::ImageBarrier(commandBuffer,
+                                        mOffscreenImage.GetImage(),
+                                        subresourceRange,
+                                        0,
+                                        VK_ACCESS_SHADER_WRITE_BIT,
+                                        VK_IMAGE_LAYOUT_UNDEFINED,
+                                        VK_IMAGE_LAYOUT_GENERAL);
+        }
 
         this->FillCommandBuffer(commandBuffer, i); // user draw code
 
+        // nothing to present, the app reads the offscreen image back itself
+        if (mSettings.headless) {
+            mGpuProfiler.EndZone(commandBuffer, i, frameZone);
+            error = vkEndCommandBuffer(commandBuffer);
+            CHECK_VK_ERROR(error, "vkEndCommandBuffer");
+            continue;
+        }
+
         vulkanhelpers::ImageBarrier(commandBuffer,
                                     mSwapchainImages[i],
                                     subresourceRange,
@@ -599,13 +898,16 @@ void VulkanApp::FillCommandBuffers() {
         copyRegion.dstOffset = { 0, 0, 0 };
         copyRegion.extent = { mSettings.resolutionX, mSettings.resolutionY, 1 };
 
-        vkCmdCopyImage(commandBuffer,
-                       mOffscreenImage.GetImage(),
-                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                       mSwapchainImages[i],
-                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                       1,
-                       &copyRegion);
+        {
+            PROFILE_GPU_ZONE(mGpuProfiler, commandBuffer, i, "Present copy");
+            vkCmdCopyImage(commandBuffer,
+                           mOffscreenImage.GetImage(),
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           mSwapchainImages[i],
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           1,
+                           &copyRegion);
+        }
 
         vulkanhelpers::ImageBarrier(commandBuffer,
                                     mSwapchainImages[i], subresourceRange,
@@ -614,29 +916,95 @@ void VulkanApp::FillCommandBuffers() {
                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                     VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 
+        mGpuProfiler.EndZone(commandBuffer, i, frameZone);
         error = vkEndCommandBuffer(commandBuffer);
         CHECK_VK_ERROR(error, "vkEndCommandBuffer");
     }
 }
 
+size_t VulkanApp::GetNumFramesInFlight() const {
+    return mSettings.headless ? sHeadlessFramesInFlight : mSwapchainImages.size();
+}
+
+size_t VulkanApp::GetSetupProfilerSlot() const {
+    return mCommandBuffers.size();
+}
+
+void VulkanApp::ToggleOverlay() {
+    mOverlay.SetVisible(!mOverlay.IsVisible());
+    // stats of frames from before it was hidden would only skew the percentiles
+    if (mOverlay.IsVisible()) {
+        mFrameStats.Reset();
+    }
+}
+
+void VulkanApp::DrawOverlay() {
+    mFrameStats.Summarize(mFrameStatsSummary);
+    const FrameStats::Summary& stats = mFrameStatsSummary;
+
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    ImGui::Begin("Performance (F1)", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    ImGui::Text("last %u frames        p50      p95      p99", static_cast<uint32_t>(stats.frame.count));
+    ImGui::Text("frame interval  %8.2f %8.2f %8.2f ms", stats.frame.p50, stats.frame.p95, stats.frame.p99);
+    ImGui::Text("CPU             %8.2f %8.2f %8.2f ms", stats.cpu.p50, stats.cpu.p95, stats.cpu.p99);
+    if (stats.gpu.count) {
+        ImGui::Text("GPU             %8.2f %8.2f %8.2f ms", stats.gpu.p50, stats.gpu.p95, stats.gpu.p99);
+    } else {
+        ImGui::TextDisabled("GPU             no timestamps yet");
+    }
+    ImGui::Text("%.1f fps (median)", (stats.frame.p50 > 0.0f) ? (1000.0f / stats.frame.p50) : 0.0f);
+
+    this->OnDrawOverlay();
+    ImGui::End();
+}
+
 
 //
 void VulkanApp::ProcessFrame(const float dt) {
+    PROFILE_ZONE("Frame");
 
     uint32_t imageIndex;
-    VkResult error = vkAcquireNextImageKHR(mDevice, mSwapchain, UINT64_MAX, mSemaphoreImageAcquired, VK_NULL_HANDLE, &imageIndex);
+    VkResult error;
+    {
+        PROFILE_ZONE("AcquireNextImage");
+        error = vkAcquireNextImageKHR(mDevice, mSwapchain, UINT64_MAX, mSemaphoreImageAcquired, VK_NULL_HANDLE, &imageIndex);
+    }
     if (VK_SUCCESS != error) {
         return;
     }
 
     const VkFence fence = mWaitForFrameFences[imageIndex];
-    error = vkWaitForFences(mDevice, 1, &fence, VK_TRUE, UINT64_MAX);
+    {
+        PROFILE_ZONE("WaitForFence");
+        error = vkWaitForFences(mDevice, 1, &fence, VK_TRUE, UINT64_MAX);
+    }
     if (VK_SUCCESS != error) {
         return;
     }
     vkResetFences(mDevice, 1, &fence);
+    const double gpuFrameMs = mGpuProfiler.Resolve(imageIndex);
+    const auto cpuStart = std::chrono::steady_clock::now();
+
+    {
+        PROFILE_ZONE("Update");
+        this->Update(imageIndex, dt);
+    }
 
-    this->Update(imageIndex, dt);
+    // the overlay goes in the same submission, right after the frame
+    VkCommandBuffer commandBuffers[2] = { mCommandBuffers[imageIndex], VK_NULL_HANDLE };
+    uint32_t numCommandBuffers = 1;
+    if (mOverlay.IsVisible()) {
+        PROFILE_ZONE("Overlay");
+        // this frame's CPU time isn't known yet, the previous one's goes with this GPU time instead
+        const FrameStats::Sample sample = { dt * 1000.0f, mLastCpuFrameMs, static_cast<float>(gpuFrameMs) };
+        mFrameStats.AddFrame(sample);
+
+        mOverlay.BeginFrame();
+        this->DrawOverlay();
+        commandBuffers[numCommandBuffers++] = mOverlay.EndFrame(imageIndex);
+    }
 
     const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
@@ -646,15 +1014,18 @@ void VulkanApp::ProcessFrame(const float dt) {
     submitInfo.waitSemaphoreCount = 1;
     submitInfo.pWaitSemaphores = &mSemaphoreImageAcquired;
     submitInfo.pWaitDstStageMask = &waitStageMask;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &mCommandBuffers[imageIndex];
+    submitInfo.commandBufferCount = numCommandBuffers;
+    submitInfo.pCommandBuffers = commandBuffers;
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = &mSemaphoreRenderFinished;
 
+    mGpuProfiler.MarkSubmit(imageIndex);
     error = vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, fence);
+    mLastCpuFrameMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
     if (VK_SUCCESS != error) {
         return;
     }
+    ++mNumSubmittedFrames;
 
     VkPresentInfoKHR presentInfo;
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -666,13 +1037,63 @@ void VulkanApp::ProcessFrame(const float dt) {
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = nullptr;
 
+    PROFILE_ZONE("Present");
     error = vkQueuePresentKHR(mGraphicsQueue, &presentInfo);
     if (VK_SUCCESS != error) {
         return;
     }
 }
 
+bool VulkanApp::ProcessHeadlessFrame(const float dt) {
+    PROFILE_ZONE("Frame");
+
+    // no swapchain to acquire from, just cycle through the ring
+    const size_t imageIndex = static_cast<size_t>(mNumSubmittedFrames % this->GetNumFramesInFlight());
+
+    const VkFence fence = mWaitForFrameFences[imageIndex];
+    VkResult error;
+    {
+        PROFILE_ZONE("WaitForFence");
+        error = vkWaitForFences(mDevice, 1, &fence, VK_TRUE, UINT64_MAX);
+    }
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "vkWaitForFences");
+        return false;
+    }
+    vkResetFences(mDevice, 1, &fence);
+    mGpuProfiler.Resolve(imageIndex);
+
+    {
+        PROFILE_ZONE("Update");
+        this->Update(imageIndex, dt);
+    }
+
+    VkSubmitInfo submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = nullptr;
+    submitInfo.waitSemaphoreCount = 0;
+    submitInfo.pWaitSemaphores = nullptr;
+    submitInfo.pWaitDstStageMask = nullptr;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &mCommandBuffers[imageIndex];
+    submitInfo.signalSemaphoreCount = 0;
+    submitInfo.pSignalSemaphores = nullptr;
+
+    mGpuProfiler.MarkSubmit(imageIndex);
+    error = vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, fence);
+    if (VK_SUCCESS != error) {
+        CHECK_VK_ERROR(error, "vkQueueSubmit");
+        return false;
+    }
+
+    ++mNumSubmittedFrames;
+    return true;
+}
+
 void VulkanApp::FreeVulkan() {
+    mOverlay.Destroy();
+    mGpuProfiler.Destroy();
+
     if (mSemaphoreRenderFinished) {
         vkDestroySemaphore(mDevice, mSemaphoreRenderFinished, nullptr);
         mSemaphoreRenderFinished = VK_NULL_HANDLE;
@@ -753,3 +1174,13 @@ void VulkanApp::OnKey(const int, const int, const int, const int) {
 void VulkanApp::Update(const size_t, const float) {
 }
 
+void VulkanApp::FlushFrames() {
+}
+
+bool VulkanApp::IsHeadlessFinished() const {
+    return mNumSubmittedFrames >= static_cast<uint64_t>(mSettings.headlessFrames) * mSettings.headlessSamples;
+}
+
+void VulkanApp::OnDrawOverlay() {
+}
+
@@ -1,4 +1,8 @@
 #include "vulkanhelpers.h"
+#include "gpuprofiler.h"
+#include "overlay.h"
+#include "framestats.h"
+#include "memorytracker.h"
 
 #include "GLFW/glfw3.h"
 
@@ -12,6 +16,33 @@ struct AppSettings {
     bool        enableValidation;
     bool        supportRaytracing;
     bool        supportDescriptorIndexing;
+
+    // headless mode (--headless): no window/swapchain, frames are read back and written to disk
+    bool        headless;
+    uint32_t    headlessFrames;             // frames to write before quitting
+    uint32_t    headlessSamples;            // passes accumulated into every written frame (the maximum when adaptive)
+    String      outputFolder;
+    String      outputFormat;               // exr, png or ppm
+
+    // batch renders
+    String      cameraPath;                 // keyframed camera, sets the frame count (--frames is ignored then)
+    float       frameRate;                  // path time between two written frames is 1 / frameRate
+    float       errorThreshold;             // > 0: stop accumulating a frame once its relative error drops below this
+    bool        resume;                     // skip the frames already written to outputFolder
+
+    // interactive sessions: --record logs what the controls did every frame, --replay plays such a log
+    // back at a fixed timestep (headless too, one logged frame per written frame)
+    String      recordFile;
+    String      replayFile;
+    String      timingsFile;                // per frame replay times, csv
+
+    String      traceFile;                  // --trace: CPU & GPU zones as a Chrome trace, written on exit
+    String      quality;                    // --quality: preset to start with, the app defines which ones there are
+    String      shadersFolder;              // --shaders: loose .bin files that win over the embedded SPIR-V
+    bool        hotReloadShaders;           // --hot-reload: shader source changes are recompiled and swapped in
+    uint32_t    seed;                       // --seed: what the made up materials (shapes without one) are drawn from
+    uint32_t    textureBudgetMB;            // --texture-budget: device memory the resident textures may take
+    String      textureFormat;              // --textures: bc7, bc1 or rgba8, what they're compressed to on load
 };
 
 class VulkanApp {
@@ -19,16 +50,15 @@ public:
     VulkanApp();
     virtual ~VulkanApp();
 
-    void    Run();
-
-	
+    void    Run(const int argc, const char** argv);
 
 protected:
     bool    Initialize();
     void    Loop();
     void    Shutdown();
 
-    void    InitializeSettings();
+    bool    InitializeSettings();
+    bool    ParseCommandLine();
     bool    InitializeVulkan();
     bool    InitializeDevicesAndQueues();
     bool    InitializeSurface();
@@ -37,10 +67,16 @@ protected:
     bool    InitializeOffscreenImage();
     bool    InitializeCommandBuffers();
     bool    InitializeSynchronization();
+    bool    InitializeHeadlessOffscreenLayout();
     void    FillCommandBuffers();
+    size_t  GetNumFramesInFlight() const;
+    size_t  GetSetupProfilerSlot() const;   // GPU profiler slot for one-off command buffers (AS builds)
+    void    ToggleOverlay();
+    void    DrawOverlay();                  // frame times, then the app's sections
 
     //
     void    ProcessFrame(const float dt);
+    bool    ProcessHeadlessFrame(const float dt);
     void    FreeVulkan();
 
     // to be overriden by subclasses
@@ -53,9 +89,13 @@ protected:
     virtual void OnMouseButton(const int button, const int action, const int mods);
     virtual void OnKey(const int key, const int scancode, const int action, const int mods);
     virtual void Update(const size_t imageIndex, const float dt);
+    virtual void FlushFrames();     // device is idle, last chance to consume the frames still in flight
+    virtual bool IsHeadlessFinished() const;
+    virtual void OnDrawOverlay();   // ImGui calls, inside the overlay's window
 protected:
 	GLFWwindow* window;
     AppSettings             mSettings;
+    Array<String>           mCommandLine;
     GLFWwindow*             mWindow;
 
     VkInstance              mInstance;
@@ -72,6 +112,14 @@ protected:
     Array<VkCommandBuffer>  mCommandBuffers;
     VkSemaphore             mSemaphoreImageAcquired;
     VkSemaphore             mSemaphoreRenderFinished;
+    uint64_t                mNumSubmittedFrames;
+    GpuProfiler             mGpuProfiler;   // one slot per command buffer + the setup one
+
+    // F1: performance overlay, windowed only. Frame stats are only gathered while it's shown
+    Overlay                 mOverlay;
+    FrameStats              mFrameStats;
+    FrameStats::Summary     mFrameStatsSummary;     // as of the last overlay frame
+    float                   mLastCpuFrameMs;
 
     uint32_t                mGraphicsQueueFamilyIndex;
     uint32_t                mComputeQueueFamilyIndex;
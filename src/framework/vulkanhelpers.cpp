@@ -1,11 +1,17 @@
 #include "vulkanhelpers.h"
+#include "memorytracker.h"
+#include "embeddedshaders.h"
 #include <string>
 #include <vector>
 #include <fstream>
 #include <cstring> // for memcpy
+#include <cstdio>
 
 namespace vulkanhelpers {
 
+static std::string sShadersFolder;
+static bool sShadersOverrideEmbedded = false;
+
 void Initialize(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandPool commandPool, VkQueue transferQueue) {
     __details::sPhysDevice = physicalDevice;
     __details::sDevice = device;
@@ -15,6 +21,11 @@ void Initialize(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandPool
     vkGetPhysicalDeviceMemoryProperties(physicalDevice, &__details::sPhysicalDeviceMemoryProperties);
 }
 
+void SetShadersFolder(const std::string& folder, const bool overrideEmbedded) {
+    sShadersFolder = folder;
+    sShadersOverrideEmbedded = overrideEmbedded;
+}
+
 uint32_t GetMemoryType(VkMemoryRequirements& memoryRequiriments, VkMemoryPropertyFlags memoryProperties) {
     uint32_t result = 0;
     for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < VK_MAX_MEMORY_TYPES; ++memoryTypeIndex) {
@@ -112,6 +123,8 @@ VkResult Buffer::Create(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPro
                 vkFreeMemory(__details::sDevice, mMemory, nullptr);
                 mBuffer = VK_NULL_HANDLE;
                 mMemory = VK_NULL_HANDLE;
+            } else {
+                GetMemoryTracker().OnAllocate(GetMemoryId(mMemory), memoryRequirements.size);
             }
         }
     }
@@ -125,6 +138,7 @@ void Buffer::Destroy() {
         mBuffer = VK_NULL_HANDLE;
     }
     if (mMemory) {
+        GetMemoryTracker().OnFree(GetMemoryId(mMemory));
         vkFreeMemory(__details::sDevice, mMemory, nullptr);
         mMemory = VK_NULL_HANDLE;
     }
@@ -188,7 +202,8 @@ VkResult Image::Create(VkImageType imageType,
                        VkExtent3D extent,
                        VkImageTiling tiling,
                        VkImageUsageFlags usage,
-                       VkMemoryPropertyFlags memoryProperties) {
+                       VkMemoryPropertyFlags memoryProperties,
+                       uint32_t mipLevels) {
     VkResult result = VK_SUCCESS;
 
     mFormat = format;
@@ -198,7 +213,7 @@ VkResult Image::Create(VkImageType imageType,
     imageCreateInfo.imageType = imageType;
     imageCreateInfo.format = format;
     imageCreateInfo.extent = extent;
-    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.mipLevels = mipLevels;
     imageCreateInfo.arrayLayers = 1;
     imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageCreateInfo.tiling = tiling;
@@ -228,6 +243,8 @@ VkResult Image::Create(VkImageType imageType,
                 vkFreeMemory(__details::sDevice, mMemory, nullptr);
                 mImage = VK_NULL_HANDLE;
                 mMemory = VK_NULL_HANDLE;
+            } else {
+                GetMemoryTracker().OnAllocate(GetMemoryId(mMemory), memoryRequirements.size);
             }
         }
     }
@@ -245,6 +262,7 @@ void Image::Destroy() {
         mImageView = VK_NULL_HANDLE;
     }
     if (mMemory) {
+        GetMemoryTracker().OnFree(GetMemoryId(mMemory));
         vkFreeMemory(__details::sDevice, mMemory, nullptr);
         mMemory = VK_NULL_HANDLE;
     }
@@ -268,6 +286,30 @@ VkResult Image::CreateImageView(VkImageViewType viewType, VkFormat format, VkIma
     return vkCreateImageView(__details::sDevice, &imageViewCreateInfo, nullptr, &mImageView);
 }
 
+VkResult Image::CreateSampler(VkFilter magFilter, VkFilter minFilter, VkSamplerMipmapMode mipmapMode, VkSamplerAddressMode addressMode) {
+    VkSamplerCreateInfo samplerCreateInfo;
+    samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerCreateInfo.pNext = nullptr;
+    samplerCreateInfo.flags = 0;
+    samplerCreateInfo.magFilter = magFilter;
+    samplerCreateInfo.minFilter = minFilter;
+    samplerCreateInfo.mipmapMode = mipmapMode;
+    samplerCreateInfo.addressModeU = addressMode;
+    samplerCreateInfo.addressModeV = addressMode;
+    samplerCreateInfo.addressModeW = addressMode;
+    samplerCreateInfo.mipLodBias = 0.0f;
+    samplerCreateInfo.anisotropyEnable = VK_FALSE;
+    samplerCreateInfo.maxAnisotropy = 1.0f;
+    samplerCreateInfo.compareEnable = VK_FALSE;
+    samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerCreateInfo.minLod = 0.0f;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+    samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+    samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+
+    return vkCreateSampler(__details::sDevice, &samplerCreateInfo, nullptr, &mSampler);
+}
+
 // getters
 VkFormat Image::GetFormat() const {
     return mFormat;
@@ -295,6 +337,24 @@ Shader::~Shader() {
     this->Destroy();
 }
 
+bool Shader::Load(const char* name) {
+    const std::string fileName = sShadersFolder + name;
+    const EmbeddedShader* embedded = FindEmbeddedShader(name);
+    if (embedded && !sShadersOverrideEmbedded) {
+        return this->LoadFromMemory(embedded->code, embedded->size);
+    }
+
+    if (this->LoadFromFile(fileName.c_str())) {
+        return true;
+    }
+    if (embedded) {
+        printf("Can't load %s, using the embedded one\n", fileName.c_str());
+        return this->LoadFromMemory(embedded->code, embedded->size);
+    }
+    printf("Can't load %s\n", fileName.c_str());
+    return false;
+}
+
 bool Shader::LoadFromFile(const char* fileName) {
     bool result = false;
 
@@ -304,23 +364,30 @@ bool Shader::LoadFromFile(const char* fileName) {
         const size_t fileSize = file.tellg();
         file.seekg(0, std::ios::beg);
 
-        std::vector<char> bytecode(fileSize);
-        bytecode.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-
-        VkShaderModuleCreateInfo shaderModuleCreateInfo;
-        shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        shaderModuleCreateInfo.pNext = nullptr;
-        shaderModuleCreateInfo.codeSize = bytecode.size();
-        shaderModuleCreateInfo.pCode = reinterpret_cast<uint32_t*>(bytecode.data());
-        shaderModuleCreateInfo.flags = 0;
+        // words, SPIR-V has to be 4 bytes aligned
+        std::vector<uint32_t> bytecode((fileSize + 3) / 4);
+        file.read(reinterpret_cast<char*>(bytecode.data()), fileSize);
 
-        const VkResult error = vkCreateShaderModule(__details::sDevice, &shaderModuleCreateInfo, nullptr, &mModule);
-        result = (VK_SUCCESS == error);
+        result = file && this->LoadFromMemory(bytecode.data(), fileSize);
     }
 
     return result;
 }
 
+bool Shader::LoadFromMemory(const void* code, const size_t size) {
+    this->Destroy();
+
+    VkShaderModuleCreateInfo shaderModuleCreateInfo;
+    shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderModuleCreateInfo.pNext = nullptr;
+    shaderModuleCreateInfo.codeSize = size;
+    shaderModuleCreateInfo.pCode = static_cast<const uint32_t*>(code);
+    shaderModuleCreateInfo.flags = 0;
+
+    const VkResult error = vkCreateShaderModule(__details::sDevice, &shaderModuleCreateInfo, nullptr, &mModule);
+    return (VK_SUCCESS == error);
+}
+
 void Shader::Destroy() {
     if (mModule) {
         vkDestroyShaderModule(__details::sDevice, mModule, nullptr);
@@ -342,6 +409,11 @@ VkPipelineShaderStageCreateInfo Shader::GetShaderStage(VkShaderStageFlagBits sta
 
 
 
+uint64_t GetMemoryId(VkDeviceMemory memory) {
+    // handles are pointers or 64 bit integers depending on the platform
+    return (uint64_t)(memory);
+}
+
 VkDeviceOrHostAddressKHR GetBufferDeviceAddress(const vulkanhelpers::Buffer& buffer) {
     VkBufferDeviceAddressInfoKHR info = {
         VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
@@ -5,6 +5,7 @@
 #include "volk.h"
 
 #include <cassert>
+#include <string>
 
 #define CHECK_VK_ERROR(_error, _message) do {   \
     if (VK_SUCCESS != error) {                  \
@@ -24,6 +25,9 @@ namespace vulkanhelpers {
     } // namespace __details
 
     void     Initialize(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandPool commandPool, VkQueue transferQueue);
+    // where Shader::Load() finds the .bin files the executable doesn't embed. overrideEmbedded: the files there win,
+    // to try shader changes without rebuilding
+    void     SetShadersFolder(const std::string& folder, const bool overrideEmbedded);
     uint32_t GetMemoryType(VkMemoryRequirements& memoryRequiriments, VkMemoryPropertyFlags memoryProperties);
     void     ImageBarrier(VkCommandBuffer commandBuffer,
                           VkImage image,
@@ -68,7 +72,8 @@ namespace vulkanhelpers {
                            VkExtent3D extent,
                            VkImageTiling tiling,
                            VkImageUsageFlags usage,
-                           VkMemoryPropertyFlags memoryProperties);
+                           VkMemoryPropertyFlags memoryProperties,
+                           uint32_t mipLevels = 1);
 
         void        Destroy();
         bool        Load(const char* fileName);
@@ -95,7 +100,10 @@ namespace vulkanhelpers {
         Shader();
         ~Shader();
 
+        // by the .bin's name ("ray_gen.bin"): the embedded SPIR-V or the file in the shaders folder
+        bool    Load(const char* name);
         bool    LoadFromFile(const char* fileName);
+        bool    LoadFromMemory(const void* code, const size_t size);
         void    Destroy();
 
         VkPipelineShaderStageCreateInfo GetShaderStage(VkShaderStageFlagBits stage);
@@ -106,6 +114,9 @@ namespace vulkanhelpers {
 
 
 
+    // the id GetMemoryTracker() knows an allocation by, to report memory allocated by hand
+    uint64_t GetMemoryId(VkDeviceMemory memory);
+
     VkDeviceOrHostAddressKHR GetBufferDeviceAddress(const Buffer& buffer);
     VkDeviceOrHostAddressConstKHR GetBufferDeviceAddressConst(const Buffer& buffer);
 
@@ -1,5 +1,5 @@
 #include "raytracerapp.h"
 int main(int argc, const char** argv) {
     RayTracerApp app;
-    app.Run();
+    app.Run(argc, argv);
 }
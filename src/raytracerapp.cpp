@@ -3,12 +3,87 @@
 #include "shared.h"
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
+#include "framework/objmesh.h"
+#include "imgui.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
 
-static const String sShadersFolder = "_data/shaders/";
 static const String sScenesFolder = "_data/scenes/";
 
+// the ray tracing stages, in RTPipelineSet::shaders' order. name.glsl compiles to name.bin
+static const struct {
+	const char*     name;
+	const char*     stage;      // glslangValidator's -S
+} sRTShaders[] = {
+	{ "ray_gen", "rgen" },
+	{ "ray_chit", "rchit" },
+	{ "ray_ahit", "rahit" },
+	{ "ray_miss", "rmiss" },
+	{ "shadow_ray_ahit", "rahit" },
+	{ "shadow_ray_miss", "rmiss" },
+	{ "indirect_ray_chit", "rchit" },
+	{ "indirect_ray_miss", "rmiss" },
+	{ "analytic_ray_rint", "rint" },
+};
+static const size_t sNumRTShaders = sizeof(sRTShaders) / sizeof(sRTShaders[0]);
+static_assert(sNumRTShaders == sizeof(RTPipelineSet::shaders) / sizeof(RTPipelineSet::shaders[0]), "sRTShaders must match RTPipelineSet::shaders");
+
+// --hot-reload: sources are watched where the working directory has them, recompiled into the loose files' folder
+static const String sShaderSourcesFolder = "src/shaders/";
+static const String sReloadedShadersFolder = "_data/shaders/";
+#ifdef SWS_GLSLANG_VALIDATOR
+static const String sShaderCompiler = SWS_GLSLANG_VALIDATOR;
+#else
+static const String sShaderCompiler = "glslangValidator";
+#endif
+
+// upper bound of the per-mesh descriptor arrays, the device's own limit may lower it
+static const uint32_t sMaxSceneMeshes = 4096;
+// the scene file's spheres & capsules all go in one analytic mesh, its SBT record follows the slots' ones
+static const uint32_t sNumProceduralRecords = 1;
+// texture files a scene can reference, and upper bound of the ones resident at once (the device may lower it)
+static const uint32_t sMaxSceneTextures = 4096;
+static const uint32_t sMaxResidentTextures = 1024;
+static const size_t sTextureLoadThreads = 2;
+// progressive loading: meshes are handed to the render thread in batches of about this many triangles
+static const uint32_t sSceneBatchFaces = 256 * 1024;
+// overlay sliders' upper ends
+static const int sMaxAntialiasingSamples = 16;
+static const int sMaxPathsPerSample = 100;
+static const int sMaxPathDepth = 16;
+static const int sMaxShadowSamples = 16;
+static const int sMaxReflections = 8;
+
+// --quality & P: preview is for moving around, final is shared.h's defaults
+static const struct {
+	const char*         name;
+	QualitySettings     settings;
+} sQualityPresets[] = {
+	{ "preview", { 1, 4, 4, 2, 1, 2 } },
+	{ "final", { MAX_ANTIALIASING_ITER, MAX_PATH_TRACED, MAX_PATH_DEPTH, SWS_RR_MIN_DEPTH, MAX_LIGHTS, SWS_MAX_RECURSION } },
+};
+static const size_t sNumQualityPresets = sizeof(sQualityPresets) / sizeof(sQualityPresets[0]);
+static const size_t sDefaultQualityPreset = 1;
+
+static_assert(sizeof(CameraUniformParams) == sizeof(SessionRecording::Frame::camera), "SessionRecording::Frame::camera must match CameraUniformParams");
+
+// indexed by binding - SWS_AOV_FIRST_BINDING
+static const VkFormat sAOVFormats[SWS_NUM_AOVS] = {
+	VK_FORMAT_R8G8B8A8_UNORM,   // albedo
+	VK_FORMAT_R32_SFLOAT,       // depth
+	VK_FORMAT_R16G16_SNORM,     // octahedral normal
+	VK_FORMAT_R32_UINT,         // instance id
+	VK_FORMAT_R32_UINT,         // primitive id
+};
+
+static bool IsBGRA(const VkFormat format) {
+	return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
 static vec4 backgroundColor = vec4(0.7 , 0.8 , 1.0,1.0);
-static vec4 planeColor = vec4(0.7 , 0.8 , 0.5,1.0);
 static int mode = 1;
 static int startTime;
 static int lightType = 9;
@@ -18,8 +93,9 @@ static const float sRotateSpeed = 0.25f;
 RayTracerApp::RayTracerApp()
     : VulkanApp()
     , mRTPipelineLayout(VK_NULL_HANDLE)
-    , mRTPipeline(VK_NULL_HANDLE)
+    , mRTPipeline(nullptr)
     , mRTDescriptorPool(VK_NULL_HANDLE)
+	, mCameraParamsStride(0)
 	, mLMBDown(false)
 	, mWKeyDown(false)
 	, mAKeyDown(false)
@@ -29,8 +105,45 @@ RayTracerApp::RayTracerApp()
 	, mLeftKeyDown(false)
 	, mDownKeyDown(false)
 	, mUpKeyDown(false)
+	, mUniformParamsStride(0)
+	, mMaxSceneMeshes(0)
+	, mAttribsTable(0)
+	, mFacesTable(0)
+	, mMeshInfoTable(0)
+	, mTexturesTable(0)
+	, mTextures(sMaxSceneTextures)
+	, mNumHitRecords(0)
+	, mEmittersMode(SWS_EMITTERS_LIGHT_BVH)
+	, mQuality(sQualityPresets[sDefaultQualityPreset].settings)
+	, mQualityEdit(sQualityPresets[sDefaultQualityPreset].settings)
+	, mQualityPreset(sDefaultQualityPreset)
+	, mResetAccumulation(false)
+	, mAccumulatedFrames(1.0f)
+	, mAOVMask(SWS_AOV_ALL_BITS)
+	, mDenoiserEnabled(false)
+	, mCaptureEnabled(false)
+	, mReplayFrame(0)
+	, mReplayFrameStarted(false)
+	, mStopSceneLoader(false)
+	, mNumReadyMeshes(0)
+	, mNumSceneMeshes(0)
+	, mNumSceneEmitters(0)
+	, mSceneLoaded(false)
+	, mNumSceneBuilds(0)
+	, mSceneComplete(false)
+	, mFirstFrameStarted(false)
 {
 	startTime= floor(glfwGetTime()*100);
+	mScene.numMeshes = 0;
+	mScene.numMaterials = 0;
+	mScene.lightsCapacity = 0;
+	mScene.lightsSet = 0;
+	mScene.lightsSetRetired = 0;
+	mScene.numEmissiveTriangles = 0;
+	mScene.emissiveInvTotalWeight = 0.0f;
+	mScene.lightsPending = false;
+	mSceneBuild.commandBuffer = VK_NULL_HANDLE;
+	mSceneBuild.fence = VK_NULL_HANDLE;
 
 }
 RayTracerApp::~RayTracerApp() {
@@ -45,23 +158,99 @@ void RayTracerApp::InitSettings() {
 }
 
 void RayTracerApp::InitApp() {
+	mStartupTime = std::chrono::steady_clock::now();
+
+	// startup as a task graph: the pipeline & the layouts don't wait for the scene, which streams in on the loader
+	// thread meanwhile (parsed while the pipeline compiles), the AS build (queue & command pool) stays on this thread
+	if (!mThreadPool.GetNumThreads()) {
+		mThreadPool.Initialize();
+	}
+	mReadback.Initialize(mSettings.resolutionX, mSettings.resolutionY, IsBGRA(mSurfaceFormat.format), &mThreadPool);
+	this->StartSceneLoader();
+
+	TaskGraph startup;
+	const TaskGraph::TaskId layouts = startup.Add("CreateDescriptorSetsLayouts", [this]() {
+		this->CreateDescriptorSetsLayouts();
+	});
+	const TaskGraph::TaskId pipeline = startup.Add("CreateRaytracingPipelineAndSBT", [this]() {
+		this->CreateRaytracingPipelineAndSBT();
+	}, { layouts });
+	const TaskGraph::TaskId camera = startup.Add("CreateCamera", [this]() {
+		this->CreateCamera();
+	});
+	const TaskGraph::TaskId aovs = startup.Add("CreateAOVImages", [this]() {
+		this->CreateAOVImages();
+	});
+	// empty to begin with, meshes get built into it as they arrive (UpdateStreamedScene)
+	const TaskGraph::TaskId scene = startup.AddMainThread("CreateScene", [this]() {
+		this->CreateScene();
+	}, { layouts });
+	// the materials & the lights get room for the whole scene before anything is bound, so the meshes that stream in
+	// never have to replace them: waits for the OBJ to be parsed (meanwhile the pipeline compiles)
+	const TaskGraph::TaskId lights = startup.Add("CreateLightsAndMaterials", [this]() {
+		const uint32_t numEmitters = this->WaitForSceneParsed();
+		this->CreateMaterials();
+		this->CreateLights(numEmitters);
+	}, { scene });
+	const TaskGraph::TaskId textures = startup.Add("CreateTextureCache", [this]() {
+		this->CreateTextureCache();
+	}, { layouts });
+	startup.Add("UpdateDescriptorSets", [this]() {
+		this->UpdateDescriptorSets();
+	}, { scene, lights, textures, pipeline, camera, aovs });
+	startup.Run(mThreadPool);
+	startup.PrintTimeline(stdout, "Startup");
+	// the queue & the command pool are this thread's
+	this->ClearRadianceImage();
+
+	// batch renders & replays are of the whole scene, only interactive sessions start on a partial one
+	if (mSettings.headless || !mSettings.replayFile.empty()) {
+		if (mSceneLoader.joinable()) {
+			mSceneLoader.join();
+		}
+		bool loaded;
+		const uint32_t numMeshes = this->GetReadyMeshes(loaded);
+		this->BuildSceneMeshes(numMeshes, false);
+	}
 
-	this->LoadSceneGeometry();
-    this->CreateScene();
-	this->CreateCamera();
-    this->CreateDescriptorSetsLayouts();
-    this->CreateRaytracingPipelineAndSBT();
-    this->UpdateDescriptorSets();
+	this->InitSession();
+
+	if (mSettings.headless) {
+		this->InitHeadlessCapture();
+	}
 }
-void RayTracerApp::updateUniformParams(const float deltaTime,int frameNumber) {
+
+void RayTracerApp::updateUniformParams(const size_t imageIndex, const float deltaTime,int frameNumber) {
+	// a replay takes everything the keyboard and mouse would have changed from the log
+	const SessionRecording::Frame* replayFrame = this->GetReplayFrame();
+	if (replayFrame) {
+		mode = static_cast<int>(replayFrame->mode);
+		lightType = static_cast<int>(replayFrame->lightType);
+		mEmittersMode = replayFrame->emittersMode;
+		mLight.lightPos = vec3(replayFrame->light[0], replayFrame->light[1], replayFrame->light[2]);
+		mLight.LightIntensity = replayFrame->light[3];
+		mLight.ShadowAttenuation = replayFrame->shadowAttenuation;
+		mQuality.antialiasingSamples = replayFrame->quality[0];
+		mQuality.pathsPerSample = replayFrame->quality[1];
+		mQuality.maxPathDepth = replayFrame->quality[2];
+		mQuality.rouletteMinDepth = replayFrame->quality[3];
+		mQuality.shadowSamples = replayFrame->quality[4];
+		mQuality.maxReflections = replayFrame->quality[5];
+		mQualityEdit = mQuality;
+	}
+	// frame boundary: hot reloaded shaders go in before anything is recorded with the old ones
+	this->SwapReloadedPipelines();
+	// mode & quality are baked into the pipeline, switching re-records the command buffers
+	this->SelectPipelineVariant();
+
 	// update values
-	if (mWKeyDown) {
+	if (!replayFrame && mWKeyDown) {
 		mLight.move(vec3(0.01, 0, 0));
 	}
-	if (mSKeyDown) {
+	if (!replayFrame && mSKeyDown) {
 		mLight.move(vec3(-0.01, 0, 0));
 	}
-	if (mRightKeyDown || mLeftKeyDown || mDownKeyDown || mUpKeyDown){
+	if (!replayFrame && (mRightKeyDown || mLeftKeyDown || mDownKeyDown || mUpKeyDown)){
 		vec2 moveDelta(0.0f, 0.0f);
 		if (mUpKeyDown) {
 			moveDelta.y += 1.0f;
@@ -78,101 +267,217 @@ void RayTracerApp::updateUniformParams(const float deltaTime,int frameNumber) {
 
 		moveDelta *= sMoveSpeed * deltaTime;
 		mCamera.Move(moveDelta.x, moveDelta.y);
+		mDenoiser.ResetHistory();
 	}
 	//////////////////////////////////////////////////////////
-	// copy camera data to gpu
-	CameraUniformParams* cameraParams = reinterpret_cast<CameraUniformParams*>(mCameraBuffer.Map());
-	cameraParams->pos = vec4(mCamera.GetPosition(), 0.0f);
-	cameraParams->dir = vec4(mCamera.GetDirection(), 0.0f);
-	cameraParams->up = vec4(mCamera.GetUp(), 0.0f);
-	cameraParams->side = vec4(mCamera.GetSide(), 0.0f);
-	cameraParams->nearFarFov = vec4(mCamera.GetNearPlane(), mCamera.GetFarPlane(), Deg2Rad(mCamera.GetFovY()), 0.0f);
+	CameraUniformParams camera;
+	if (replayFrame) {
+		memcpy(&camera, replayFrame->camera, sizeof(camera));
+	} else {
+		camera.pos = vec4(mCamera.GetPosition(), 0.0f);
+		camera.dir = vec4(mCamera.GetDirection(), 0.0f);
+		camera.up = vec4(mCamera.GetUp(), 0.0f);
+		camera.side = vec4(mCamera.GetSide(), 0.0f);
+		camera.nearFarFov = vec4(mCamera.GetNearPlane(), mCamera.GetFarPlane(), Deg2Rad(mCamera.GetFovY()), 0.0f);
+	}
+
+	// copy camera data to gpu, into this frame's slot - the other frames in flight may still be reading theirs
+	CameraUniformParams* cameraParams = reinterpret_cast<CameraUniformParams*>(mCameraBuffer.Map(sizeof(CameraUniformParams), imageIndex * mCameraParamsStride));
+	*cameraParams = camera;
 	mCameraBuffer.Unmap();
 
+	// the denoiser does its own accumulation, so every frame should be a fresh one
+	float accumulation = mDenoiserEnabled ? 0.0f : deltaTime;
+	// fresh samples every pass, the same ones again when replaying
+	uint32_t seed = static_cast<uint32_t>(mNumSubmittedFrames);
+	if (mSettings.headless) {
+		// running average over the passes of the frame being written, its first pass overwrites
+		accumulation = static_cast<float>(mBatch.GetPass());
+	} else if (replayFrame) {
+		accumulation = replayFrame->accumulation;
+		seed = replayFrame->seed;
+	} else if (mResetAccumulation) {
+		accumulation = 0.0f;
+	}
+	mResetAccumulation = false;
+
+	// frames' worth of samples the blend leaves in the image: mixing a new frame in with weight a
+	// turns the variance of n frames into (1 - a)^2 / n + a^2 frames'
+	if (mOverlay.IsVisible()) {
+		const float a = (accumulation > 0.0f) ? (1.0f / (accumulation + 1.0f)) : 1.0f;
+		mAccumulatedFrames = 1.0f / ((1.0f - a) * (1.0f - a) / mAccumulatedFrames + a * a);
+	}
+
 	// copy others data to gpu
-	UniformParams* params = reinterpret_cast<UniformParams*>(mUniformParamsBuffer.Map());
+	UniformParams* params = reinterpret_cast<UniformParams*>(mUniformParamsBuffer.Map(sizeof(UniformParams), imageIndex * mUniformParamsStride));
 	params->clearColor = backgroundColor;
 	params->LightPos = mLight.getLightPos();
 	params->LightInfo = vec4(lightType, mLight.ShadowAttenuation, 0,0);
-	params->modeFrame= vec4(mode, deltaTime,0.0,0.0);
+	// the seed travels as a float, keep it exact
+	params->modeFrame= vec4(mode, accumulation, static_cast<float>(seed & 0xFFFFFFu), 0.0);
+	params->aovMask = uvec4(this->GetActiveAOVMask(), 0u, 0u, 0u);
+	params->emissiveInfo = vec4(static_cast<float>(mScene.numEmissiveTriangles), mScene.emissiveInvTotalWeight, static_cast<float>(mEmittersMode),
+		static_cast<float>(mScene.lightsSet * mScene.lightsCapacity));
+	params->textureInfo = uvec4(TextureCache::GetStamp(mNumSubmittedFrames), 0u, 0u, 0u);
 	mUniformParamsBuffer.Unmap();
+
+	if (!mSettings.recordFile.empty()) {
+		SessionRecording::Frame frame;
+		memcpy(frame.camera, &camera, sizeof(frame.camera));
+		frame.light[0] = mLight.lightPos.x;
+		frame.light[1] = mLight.lightPos.y;
+		frame.light[2] = mLight.lightPos.z;
+		frame.light[3] = mLight.LightIntensity;
+		frame.shadowAttenuation = mLight.ShadowAttenuation;
+		frame.mode = static_cast<uint32_t>(mode);
+		frame.lightType = static_cast<uint32_t>(lightType);
+		frame.emittersMode = mEmittersMode;
+		frame.accumulation = accumulation;
+		frame.seed = seed;
+		frame.quality[0] = mQuality.antialiasingSamples;
+		frame.quality[1] = mQuality.pathsPerSample;
+		frame.quality[2] = mQuality.maxPathDepth;
+		frame.quality[3] = mQuality.rouletteMinDepth;
+		frame.quality[4] = mQuality.shadowSamples;
+		frame.quality[5] = mQuality.maxReflections;
+		mRecording.AddFrame(frame);
+	}
 }
 void RayTracerApp::FreeResources() {
+	// it still creates meshes, on the pool
+	this->StopSceneLoader();
+
+	this->FinishSession();
+	// the frame in flight submits its capture to the writer
+	mDenoiser.Destroy();
+	mCapture.Shutdown();
+	// its loads run on their own pool
+	mTextures.Destroy();
+	mTextureThreadPool.Shutdown();
+	mThreadPool.Shutdown();
+	mReadback.Destroy();
+	for (vulkanhelpers::Image& image : mAOVImages) {
+		image.Destroy();
+	}
+	mRadianceImage.Destroy();
+
+	// the device is idle, a build still in flight is done
+	if (mSceneBuild.commandBuffer) {
+		this->FinishSceneBuild();
+	}
+	if (mSceneBuild.fence) {
+		vkDestroyFence(mDevice, mSceneBuild.fence, nullptr);
+		mSceneBuild.fence = VK_NULL_HANDLE;
+	}
 
 	for (RTMesh& mesh : mScene.meshes) {
-		vkDestroyAccelerationStructureKHR(mDevice, mesh.blas.accelerationStructure, nullptr);
-		vkFreeMemory(mDevice, mesh.blas.memory, nullptr);
+		this->DestroyAS(mesh.blas);
 	}
 	mScene.meshes.clear();
+	mScene.numMeshes = 0;
+	mScene.numMaterials = 0;
 
-	if (mScene.topLevelAS.accelerationStructure) {
-		vkDestroyAccelerationStructureKHR(mDevice, mScene.topLevelAS.accelerationStructure, nullptr);
-		mScene.topLevelAS.accelerationStructure = VK_NULL_HANDLE;
-	}
-	if (mScene.topLevelAS.memory) {
-		vkFreeMemory(mDevice, mScene.topLevelAS.memory, nullptr);
-		mScene.topLevelAS.memory = VK_NULL_HANDLE;
-	}
+	this->DestroyAS(mScene.topLevelAS);
+	mScene.instancesBuffer.Destroy();
+	mScene.lightsBuffer.Destroy();
+	mScene.lightNodesBuffer.Destroy();
+	mScene.materialsBuffer.Destroy();
 
     if (mRTDescriptorPool) {
         vkDestroyDescriptorPool(mDevice, mRTDescriptorPool, nullptr);
         mRTDescriptorPool = VK_NULL_HANDLE;
     }
+	mRTDescriptorSets.clear();
 
-    mShaderBindingTable.Destroy();
-
-    if (mRTPipeline) {
-        vkDestroyPipeline(mDevice, mRTPipeline, nullptr);
-        mRTPipeline = VK_NULL_HANDLE;
-    }
+    // the watcher's thread may be building a set
+    mShaderWatcher.Stop();
+    mReloadedPipelineSet.reset();
+    mRTPipelineSet.reset();
+    mRTPipeline = nullptr;
+    mRTPipelineKey.clear();
 
     if (mRTPipelineLayout) {
         vkDestroyPipelineLayout(mDevice, mRTPipelineLayout, nullptr);
         mRTPipelineLayout = VK_NULL_HANDLE;
     }
 
-	for (VkDescriptorSetLayout& dsl : mRTDescriptorSetsLayouts) {
-		vkDestroyDescriptorSetLayout(mDevice, dsl, nullptr);
+	// the per-mesh ones are the registry's
+	if (!mRTDescriptorSetsLayouts.empty()) {
+		vkDestroyDescriptorSetLayout(mDevice, mRTDescriptorSetsLayouts[SWS_SCENE_AS_SET], nullptr);
 	}
 	mRTDescriptorSetsLayouts.clear();
+	mBindless.Destroy();
    
 }
 
 void RayTracerApp::FillCommandBuffer(VkCommandBuffer commandBuffer, const size_t imageIndex) {
+	// AOVs are fully rewritten every frame, no need to keep previous contents
+	VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	for (const vulkanhelpers::Image& image : mAOVImages) {
+		vulkanhelpers::ImageBarrier(commandBuffer,
+			image.GetImage(),
+			subresourceRange,
+			0,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_GENERAL);
+	}
+	// the radiance accumulates, it stays in GENERAL (ClearRadianceImage): after the previous frame's trace & readback
+	vulkanhelpers::ImageBarrier(commandBuffer,
+		mRadianceImage.GetImage(),
+		subresourceRange,
+		VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+		VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_GENERAL,
+		VK_IMAGE_LAYOUT_GENERAL);
+
     vkCmdBindPipeline(commandBuffer,
                       VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
-                      mRTPipeline);
+                      mRTPipeline->pipeline);
 
+	// every frame in flight reads its own camera & params slot
+	const uint32_t dynamicOffsets[2] = {
+		static_cast<uint32_t>(imageIndex * mCameraParamsStride),
+		static_cast<uint32_t>(imageIndex * mUniformParamsStride)
+	};
 	vkCmdBindDescriptorSets(commandBuffer,
 		VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
 		mRTPipelineLayout, 0,
 		static_cast<uint32_t>(mRTDescriptorSets.size()), mRTDescriptorSets.data(),
-		0, 0);
+		2, dynamicOffsets);
 
     VkStridedBufferRegionKHR raygenSBT = {
-        mShaderBindingTable.GetSBTBuffer(),
-        mShaderBindingTable.GetRaygenOffset(),
-        mShaderBindingTable.GetGroupsStride(),
-        mShaderBindingTable.GetRaygenSize()
+        mRTPipeline->sbt.GetBuffer(),
+        mRTPipelineSet->sbt.GetRaygenOffset(),
+        mRTPipelineSet->sbt.GetGroupsStride(),
+        mRTPipelineSet->sbt.GetRaygenSize()
     };
 
     VkStridedBufferRegionKHR hitSBT = {
-        mShaderBindingTable.GetSBTBuffer(),
-        mShaderBindingTable.GetHitGroupsOffset(),
-        mShaderBindingTable.GetGroupsStride(),
-        mShaderBindingTable.GetHitGroupsSize()
+        mRTPipeline->sbt.GetBuffer(),
+        mRTPipelineSet->sbt.GetHitGroupsOffset(),
+        mRTPipelineSet->sbt.GetHitGroupsStride(),
+        mRTPipelineSet->sbt.GetHitGroupsSize()
     };
 
     VkStridedBufferRegionKHR missSBT = {
-        mShaderBindingTable.GetSBTBuffer(),
-        mShaderBindingTable.GetMissGroupsOffset(),
-        mShaderBindingTable.GetGroupsStride(),
-        mShaderBindingTable.GetMissGroupsSize()
+        mRTPipeline->sbt.GetBuffer(),
+        mRTPipelineSet->sbt.GetMissGroupsOffset(),
+        mRTPipelineSet->sbt.GetGroupsStride(),
+        mRTPipelineSet->sbt.GetMissGroupsSize()
     };
 
     VkStridedBufferRegionKHR callableSBT = {};
 
-   vkCmdTraceRaysKHR(commandBuffer, &raygenSBT, &missSBT, &hitSBT, &callableSBT, mSettings.resolutionX, mSettings.resolutionY, 1u);
+   {
+	   PROFILE_GPU_ZONE(mGpuProfiler, commandBuffer, imageIndex, "TraceRays");
+	   vkCmdTraceRaysKHR(commandBuffer, &raygenSBT, &missSBT, &hitSBT, &callableSBT, mSettings.resolutionX, mSettings.resolutionY, 1u);
+   }
+
+   if (!mReadback.IsEmpty()) {
+	   PROFILE_GPU_ZONE(mGpuProfiler, commandBuffer, imageIndex, "Readback copies");
+	   mReadback.RecordCopies(commandBuffer, imageIndex, mOffscreenImage, mRadianceImage, mAOVImages, this->GetActiveAOVMask(), mDenoiserEnabled);
+   }
 }
 
 void RayTracerApp::OnKey(const int key, const int scancode, const int action, const int mods)
@@ -184,6 +489,10 @@ void RayTracerApp::OnKey(const int key, const int scancode, const int action, co
 		case GLFW_KEY_3: mode = 3; break;
 		case GLFW_KEY_0: lightType = 0; break;
 		case GLFW_KEY_9: lightType = 9; break;
+		case GLFW_KEY_N: this->ToggleDenoiser(); break;
+		case GLFW_KEY_C: this->ToggleCapture(); break;
+		case GLFW_KEY_L: this->CycleEmittersMode(); break;
+		case GLFW_KEY_P: this->CycleQualityPreset(); break;
 		case GLFW_KEY_W: mWKeyDown = false; break;
 		case GLFW_KEY_A: mAKeyDown = false; break;
 		case GLFW_KEY_S: mSKeyDown = false; break;
@@ -216,6 +525,7 @@ void RayTracerApp::OnMouseMove(const float x, const float y) {
 
 	if (mLMBDown) {
 		mCamera.Rotate(delta.x * sRotateSpeed, delta.y * sRotateSpeed);
+		mDenoiser.ResetHistory();
 	}
 
 	mCursorPos = newPos;
@@ -230,17 +540,76 @@ void RayTracerApp::OnMouseButton(const int button, const int action, const int m
 	}
 }
 
-void RayTracerApp::Update(const size_t, const float deltaTime) {
-    // Update FPS text
+void RayTracerApp::Update(const size_t imageIndex, const float deltaTime) {
 	int currTime = floor(glfwGetTime()*100);
 	int frameNumber = currTime-startTime;
-    /////////////////
-	this->updateUniformParams(deltaTime, frameNumber);
+
+	// this image's fence has been waited on: frames up to one ring ago are done, slots released before can go back
+	const uint64_t numFramesInFlight = static_cast<uint64_t>(this->GetNumFramesInFlight());
+	if (mNumSubmittedFrames >= numFramesInFlight) {
+		mBindless.Recycle(mNumSubmittedFrames - numFramesInFlight);
+	}
+	{
+		PROFILE_ZONE("UpdateTextures");
+		this->UpdateTextures();
+	}
+
+	// whatever the loader readied since the last frame goes into this one, its lights once a set is free
+	{
+		PROFILE_ZONE("UpdateStreamedScene");
+		this->UpdateStreamedScene();
+		this->UpdateLights();
+	}
+	if (!mFirstFrameStarted) {
+		mFirstFrameStarted = true;
+		bool loaded;
+		const uint32_t numReady = this->GetReadyMeshes(loaded);
+		printf("First frame after %.0f ms, %u meshes in the scene (%u ready, %s)\n",
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mStartupTime).count(),
+			mScene.numMeshes, numReady, loaded ? "loading done" : "still loading");
+	}
+
+	// the fence of this image has been waited on, so whatever it read back last time is complete.
+	// Consume it first, a batch render decides how many more passes the frame needs from it
+	if (!mReadback.IsEmpty()) {
+		PROFILE_ZONE("ConsumeReadback");
+		this->ConsumeReadback(mReadback.GetFrame(imageIndex));
+	}
+	if (mSettings.headless) {
+		this->BeginBatchPass();
+	} else if (!mSettings.replayFile.empty()) {
+		this->MarkReplayFrame();
+	}
+
+	{
+		PROFILE_ZONE("UpdateUniformParams");
+		this->updateUniformParams(imageIndex, deltaTime, frameNumber);
+	}
+
+	if (!mReadback.IsEmpty()) {
+		// this frame's command buffer is about to fill the readback buffers, ConsumeReadback has emptied them
+		mReadback.Prepare(imageIndex, !mSettings.headless || mBatch.IsPassFinal(), mBatch.GetFrame(), mBatch.GetPass());
+	}
+	if (mSettings.headless) {
+		mBatch.EndPass();
+	} else if (!mSettings.replayFile.empty() && ++mReplayFrame >= mRecording.GetNumFrames()) {
+		// the last logged frame is on its way, let the loop wind down
+		glfwSetWindowShouldClose(mWindow, GLFW_TRUE);
+	}
 }
 
 
 void RayTracerApp::CreateCamera() {
-   VkResult error = mCameraBuffer.Create(sizeof(CameraUniformParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	// one slot per frame in flight, so the CPU can set up the next frame while the GPU still renders the current one
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &props);
+	const VkDeviceSize align = props.limits.minUniformBufferOffsetAlignment ? props.limits.minUniformBufferOffsetAlignment : 1;
+	const VkDeviceSize numSlots = static_cast<VkDeviceSize>(this->GetNumFramesInFlight());
+	mCameraParamsStride = (sizeof(CameraUniformParams) + align - 1) / align * align;
+	mUniformParamsStride = (sizeof(UniformParams) + align - 1) / align * align;
+
+	MemoryTracker::Scope memoryScope(MemoryCategory::Uniform);
+	VkResult error = mCameraBuffer.Create(mCameraParamsStride * numSlots, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 	CHECK_VK_ERROR(error, "mCameraBuffer.Create");
 
 	mCamera.SetViewport({ 0, 0, static_cast<int>(mSettings.resolutionX), static_cast<int>(mSettings.resolutionY) });
@@ -249,7 +618,7 @@ void RayTracerApp::CreateCamera() {
 	mCamera.LookAt(vec3(-5.0f, 3.0f, 8), vec3(-5.0f, 3.0f, 7.0f));
 
 	/////////////////////////////////////////
-	error = mUniformParamsBuffer.Create(sizeof(UniformParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	error = mUniformParamsBuffer.Create(mUniformParamsStride * numSlots, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 	CHECK_VK_ERROR(error, "mUniformParamsBuffer.Create");
 }
 bool RayTracerApp::CreateAS(const VkAccelerationStructureTypeKHR type,
@@ -293,6 +662,7 @@ bool RayTracerApp::CreateAS(const VkAccelerationStructureTypeKHR type,
         CHECK_VK_ERROR(error, "vkAllocateMemory for AS");
         return false;
     }
+    GetMemoryTracker().OnAllocate(vulkanhelpers::GetMemoryId(_as.memory), memoryAllocateInfo.allocationSize);
 
     VkBindAccelerationStructureMemoryInfoKHR bindInfo = {};
     bindInfo.sType = VK_STRUCTURE_TYPE_BIND_ACCELERATION_STRUCTURE_MEMORY_INFO_KHR;
@@ -315,38 +685,97 @@ bool RayTracerApp::CreateAS(const VkAccelerationStructureTypeKHR type,
 	
     return true;
 }
+void RayTracerApp::DestroyAS(RTAccelerationStructure& _as) {
+	if (_as.accelerationStructure) {
+		vkDestroyAccelerationStructureKHR(mDevice, _as.accelerationStructure, nullptr);
+		_as.accelerationStructure = VK_NULL_HANDLE;
+	}
+	if (_as.memory) {
+		GetMemoryTracker().OnFree(vulkanhelpers::GetMemoryId(_as.memory));
+		vkFreeMemory(mDevice, _as.memory, nullptr);
+		_as.memory = VK_NULL_HANDLE;
+	}
+}
+// what a mesh's BLAS is created with (CreateMeshBLAS) and built from (CreateScene)
+static VkAccelerationStructureCreateGeometryTypeInfoKHR GetMeshGeometryInfo(const RTMesh& mesh) {
+	VkAccelerationStructureCreateGeometryTypeInfoKHR geometryInfo = {};
+	geometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_GEOMETRY_TYPE_INFO_KHR;
+	if (mesh.isAnalytic) {
+		// an AABB per primitive, the intersection shader does the rest
+		geometryInfo.geometryType = VK_GEOMETRY_TYPE_AABBS_KHR;
+		geometryInfo.maxPrimitiveCount = mesh.numFaces;
+		geometryInfo.allowsTransforms = VK_FALSE;
+		return geometryInfo;
+	}
+	geometryInfo.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+	geometryInfo.maxPrimitiveCount = mesh.numFaces;
+	geometryInfo.indexType = VK_INDEX_TYPE_UINT32;
+	geometryInfo.maxVertexCount = mesh.numVertices;
+	geometryInfo.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+	geometryInfo.allowsTransforms = VK_FALSE;
+	return geometryInfo;
+}
+// the obj shape unpacked into the mesh's buffers (see CreateMeshBuffers), its faces' materials along with it
+static void FillMeshBuffers(const RTMesh& mesh, const tinyobj::attrib_t& attrib, const tinyobj::shape_t& shape, const std::vector<uint32_t>& materialIndices, const uint32_t defaultMaterial) {
+	static_assert(sizeof(vec3) == kObjPositionSize && sizeof(VertexAttribute) == kObjAttribSize, "ObjMeshBuffers layout has to match the shaders'");
+	ObjMeshBuffers buffers;
+	buffers.positions = reinterpret_cast<float*>(mesh.positions.Map());
+	buffers.attribs = reinterpret_cast<float*>(mesh.attribs.Map());
+	buffers.indices = reinterpret_cast<uint32_t*>(mesh.indices.Map());
+	buffers.faces = reinterpret_cast<uint32_t*>(mesh.faces.Map());
+	vec4* infos = reinterpret_cast<vec4*>(mesh.infos.Map());
+
+	FillObjMeshBuffers(attrib, shape, materialIndices, defaultMaterial, buffers);
+
+	infos[0] = vec4(-1.0f);		// x - first emitter index (see AppendLights)
+	if (mesh.firstEmitter != SWS_INVALID_ID) {
+		infos[0].x = static_cast<float>(mesh.firstEmitter);
+	}
+
+	mesh.indices.Unmap();
+	mesh.attribs.Unmap();
+	mesh.positions.Unmap();
+	mesh.faces.Unmap();
+	mesh.infos.Unmap();
+}
+// what the hit shaders get with the mesh's SBT record (hitrecord.glsl), its material when its triangles share one
+static HitRecordData MakeHitRecord(const RTMesh& mesh, const MaterialTable& materials) {
+	static_assert(sizeof(MaterialTable::Material) == sizeof(MaterialData), "MaterialTable::Material has to match the shaders' MaterialData");
+	const uint64_t facesAddress = vulkanhelpers::GetBufferDeviceAddress(mesh.faces).deviceAddress;
+	const uint64_t attribsAddress = vulkanhelpers::GetBufferDeviceAddress(mesh.attribs).deviceAddress;
+
+	HitRecordData record;
+	if (mesh.material != SWS_INVALID_ID) {
+		memcpy(&record.material, &materials.GetMaterial(mesh.material), sizeof(MaterialData));
+	} else {
+		memset(&record.material, 0, sizeof(MaterialData));
+		record.material.textures = uvec4(SWS_INVALID_ID);
+	}
+	record.info = uvec4(mesh.material, 0u, 0u, 0u);
+	record.addresses = uvec4(static_cast<uint32_t>(facesAddress), static_cast<uint32_t>(facesAddress >> 32),
+		static_cast<uint32_t>(attribsAddress), static_cast<uint32_t>(attribsAddress >> 32));
+	return record;
+}
 void RayTracerApp::LoadSceneGeometry() {
+	// the loader thread's
+	PROFILE_THREAD_NAME("scene loader");
+	PROFILE_ZONE("LoadSceneGeometry");
 
 	mScene.meshes.clear(); 
 	LoadObj(sScenesFolder + "test.obj");//
 	//LoadObj(sScenesFolder + "test2.obj");
-	// prepare shader resources infos
-	const size_t numMeshes = mScene.meshes.size();
-	mScene.meshInfoBufferInfos.resize(numMeshes);
-	mScene.attribsBufferInfos.resize(numMeshes);
-	mScene.facesBufferInfos.resize(numMeshes);
-	for (size_t i = 0; i < numMeshes; ++i) {
-		const RTMesh& mesh = mScene.meshes[i];
-		VkDescriptorBufferInfo& meshInfo = mScene.meshInfoBufferInfos[i];
-		VkDescriptorBufferInfo& attribsInfo = mScene.attribsBufferInfos[i];
-		VkDescriptorBufferInfo& facesInfo = mScene.facesBufferInfos[i];
-
-		attribsInfo.buffer = mesh.attribs.GetBuffer();
-		attribsInfo.offset = 0;
-		attribsInfo.range = mesh.attribs.GetSize();
 
-		facesInfo.buffer = mesh.faces.GetBuffer();
-		facesInfo.offset = 0;
-		facesInfo.range = mesh.faces.GetSize();
-
-		meshInfo.buffer = mesh.infos.GetBuffer();
-		meshInfo.offset = 0;
-		meshInfo.range = mesh.infos.GetSize();
-	}
+	std::lock_guard<std::mutex> lock(mSceneMutex);
+	mSceneLoaded = true;
+	mSceneParsed.notify_all();
 }
 void RayTracerApp::LoadObj(String fileName) {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
+	// tinyobj parses the whole file at once, the meshes are readied in batches after that
+	struct ObjData {
+		tinyobj::attrib_t               attrib;
+		std::vector<tinyobj::shape_t>   shapes;
+	};
+	std::unique_ptr<ObjData> obj(new ObjData());
 	std::vector<tinyobj::material_t> materials;
 	String warn, error;
 
@@ -356,10 +785,37 @@ void RayTracerApp::LoadObj(String fileName) {
 		baseDir.erase(slash);
 	}
 
-	const bool result = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &error, fileName.c_str(), baseDir.c_str(), true);
+	const bool result = tinyobj::LoadObj(&obj->attrib, &obj->shapes, &materials, &warn, &error, fileName.c_str(), baseDir.c_str(), true);
 	if (result) {
 		int currentMeshNumer =0;
-		mScene.meshes.resize(shapes.size());
+		const std::vector<tinyobj::shape_t>& shapes = obj->shapes;
+
+		// the spheres & capsules the file describes along with its shapes (objprimitives.h), one analytic mesh after them
+		std::vector<String> materialNames(materials.size());
+		for (size_t i = 0; i < materials.size(); ++i) {
+			materialNames[i] = materials[i].name;
+		}
+		Array<ObjPrimitive> primitives;
+		LoadObjPrimitives(fileName, materialNames, primitives);
+		const size_t numMeshes = shapes.size() + (primitives.empty() ? 0 : 1);
+
+		// sized once and for all before the render thread sees any of it
+		mScene.meshes.resize(numMeshes);
+		mScene.meshInfoBufferInfos.resize(numMeshes);
+		mScene.attribsBufferInfos.resize(numMeshes);
+		mScene.facesBufferInfos.resize(numMeshes);
+
+		// the .mtl's materials, then made up ones for the shapes with faces that have none (mSettings.seed)
+		mMaterials.Clear();
+		std::vector<uint32_t> materialIndices(materials.size());    // tinyobj material id -> mMaterials index
+		// map_Kd only, registered here and loaded once something samples it
+		for (size_t i = 0; i < materials.size(); ++i) {
+			const String& diffuseMap = materials[i].diffuse_texname;
+			const uint32_t diffuseTexture = diffuseMap.empty() ? MaterialTable::NoTexture : mTextures.Register(baseDir + "/" + diffuseMap);
+			materialIndices[i] = mMaterials.Add(MaterialTable::FromMtl(materials[i], diffuseTexture));
+		}
+		const uint32_t numMtlMaterials = static_cast<uint32_t>(mMaterials.GetNumMaterials());
+		Array<uint32_t> defaultMaterials(numMeshes, SWS_INVALID_ID);
 
 		for (size_t shapeIdx = 0; shapeIdx < shapes.size(); ++shapeIdx) {
 			RTMesh& mesh = mScene.meshes[shapeIdx];
@@ -368,221 +824,542 @@ void RayTracerApp::LoadObj(String fileName) {
 			const size_t numFaces = shape.mesh.num_face_vertices.size();
 			const size_t numVertices = numFaces * 3;
 
+			mesh.name = shape.name.empty() ? ("shape " + std::to_string(shapeIdx)) : shape.name;
 			mesh.numVertices = static_cast<uint32_t>(numVertices);
 			mesh.numFaces = static_cast<uint32_t>(numFaces);
+			mesh.isAnalytic = false;
 
+			// what its faces use decides its opacity, emission & whether its hit record has the material inline
+			mesh.material = SWS_INVALID_ID;
+			mesh.isOpaque = true;
+			mesh.isEmissive = false;
+			bool sameMaterial = true;
+			for (size_t f = 0; f < numFaces; ++f) {
+				const int materialId = (f < shape.mesh.material_ids.size()) ? shape.mesh.material_ids[f] : -1;
+				uint32_t material;
+				if (materialId >= 0 && static_cast<size_t>(materialId) < materialIndices.size()) {
+					material = materialIndices[materialId];
+				} else {
+					if (defaultMaterials[shapeIdx] == SWS_INVALID_ID) {
+						defaultMaterials[shapeIdx] = mMaterials.Add(MaterialTable::MakeDefault(mSettings.seed, static_cast<uint32_t>(shapeIdx)));
+					}
+					material = defaultMaterials[shapeIdx];
+				}
 
-			const size_t positionsBufferSize = numVertices * sizeof(vec3);
-			const size_t indicesBufferSize = numFaces * 3 * sizeof(uint32_t);
-			const size_t facesBufferSize = numFaces * 4 * sizeof(uint32_t);
-			const size_t attribsBufferSize = numVertices * sizeof(VertexAttribute);
-			const size_t meshInfosBufferSize = 2 * sizeof(vec4);
-
-			VkResult error = mesh.positions.Create(positionsBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			CHECK_VK_ERROR(error, "mesh.positions.Create");
+				if (!f) {
+					mesh.material = material;
+				} else if (material != mesh.material) {
+					sameMaterial = false;
+				}
+				// anything not fully opaque goes through the any-hit shaders
+				mesh.isOpaque = mesh.isOpaque && MaterialTable::IsOpaque(mMaterials.GetMaterial(material));
+				mesh.isEmissive = mesh.isEmissive || MaterialTable::IsEmissive(mMaterials.GetMaterial(material));
+			}
+			if (!sameMaterial) {
+				mesh.material = SWS_INVALID_ID;
+			}
+		}
 
-			error = mesh.indices.Create(indicesBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			CHECK_VK_ERROR(error, "mesh.indices.Create");
+		if (!primitives.empty()) {
+			RTMesh& mesh = mScene.meshes[shapes.size()];
+			mesh.name = "analytic primitives";
+			mesh.numVertices = 0;
+			mesh.numFaces = static_cast<uint32_t>(primitives.size());
+			mesh.isAnalytic = true;
+			mesh.isOpaque = true;
+			// emissive ones glow when hit, the emitters sampled are only ever triangles though (AppendLights)
+			mesh.isEmissive = false;
+			for (size_t i = 0; i < primitives.size(); ++i) {
+				// the .mtl index they come with becomes the material's, as the faces' do
+				uint32_t& material = primitives[i].info[1];
+				if (material != kObjNoMaterial && material < materialIndices.size()) {
+					material = materialIndices[material];
+				} else {
+					if (defaultMaterials[shapes.size()] == SWS_INVALID_ID) {
+						defaultMaterials[shapes.size()] = mMaterials.Add(MaterialTable::MakeDefault(mSettings.seed, static_cast<uint32_t>(shapes.size())));
+					}
+					material = defaultMaterials[shapes.size()];
+				}
 
-			error = mesh.faces.Create(facesBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			CHECK_VK_ERROR(error, "mesh.faces.Create");
+				mesh.material = (!i || material == mesh.material) ? material : SWS_INVALID_ID;
+				mesh.isOpaque = mesh.isOpaque && MaterialTable::IsOpaque(mMaterials.GetMaterial(material));
+			}
+			printf("Analytic primitives: %u spheres & capsules, traced through their AABBs\n", mesh.numFaces);
+		}
 
-			error = mesh.attribs.Create(attribsBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			CHECK_VK_ERROR(error, "mesh.attribs.Create");
+		uint32_t numAnyHitMeshes = 0, numAnyHitFaces = 0, numFaces = 0;
+		for (const RTMesh& mesh : mScene.meshes) {
+			numFaces += mesh.numFaces;
+			if (!mesh.isOpaque) {
+				++numAnyHitMeshes;
+				numAnyHitFaces += mesh.numFaces;
+			}
+		}
+		printf("Opacity: %u of %u meshes (%u of %u triangles) need any-hit\n",
+			numAnyHitMeshes, static_cast<uint32_t>(mScene.meshes.size()), numAnyHitFaces, numFaces);
+		printf("Materials: %u distinct, %u of them from %u .mtl entries, the rest made up with seed %u\n",
+			static_cast<uint32_t>(mMaterials.GetNumMaterials()), numMtlMaterials, static_cast<uint32_t>(materials.size()), mSettings.seed);
+
+		// every triangle of the emissive meshes is an emitter, numbered in mesh order: the meshes arrive in that order
+		// and only ever get appended to the lights
+		uint32_t numEmitters = 0;
+		for (RTMesh& mesh : mScene.meshes) {
+			mesh.firstEmitter = mesh.isEmissive ? numEmitters : SWS_INVALID_ID;
+			numEmitters += mesh.isEmissive ? mesh.numFaces : 0;
+		}
 
-			error = mesh.infos.Create(meshInfosBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			CHECK_VK_ERROR(error, "mesh.infos.Create");
+		{
+			std::lock_guard<std::mutex> lock(mSceneMutex);
+			mNumSceneMeshes = static_cast<uint32_t>(numMeshes);
+			mNumSceneEmitters = numEmitters;
+			mSceneParsed.notify_all();
+		}
 
-			vec3* positions = reinterpret_cast<vec3*>(mesh.positions.Map());
-			VertexAttribute* attribs = reinterpret_cast<VertexAttribute*>(mesh.attribs.Map());
-			uint32_t* indices = reinterpret_cast<uint32_t*>(mesh.indices.Map());
-			uint32_t* faces = reinterpret_cast<uint32_t*>(mesh.faces.Map());
-			vec4* infos = reinterpret_cast<vec4*>(mesh.infos.Map());
+		// batches of about sSceneBatchFaces triangles (a bigger mesh makes one of its own), their meshes in
+		// parallel: buffers, then their BLAS objects, the render thread builds them
+		size_t batchBegin = 0;
+		while (batchBegin < numMeshes && !mStopSceneLoader) {
+			size_t batchEnd = batchBegin;
+			uint32_t batchFaces = 0;
+			while (batchEnd < numMeshes && (batchEnd == batchBegin || batchFaces + mScene.meshes[batchEnd].numFaces <= sSceneBatchFaces)) {
+				batchFaces += mScene.meshes[batchEnd].numFaces;
+				++batchEnd;
+			}
 
-			size_t vIdx = 0;
-			for (size_t f = 0; f < numFaces; ++f) {
-				assert(shape.mesh.num_face_vertices[f] == 3);
-				for (size_t j = 0; j < 3; ++j, ++vIdx) {
-					const tinyobj::index_t& i = shape.mesh.indices[vIdx];
-
-					vec3& pos = positions[vIdx];
-					vec4& normal = attribs[vIdx].normal;
-					vec4& uv = attribs[vIdx].uv;
-
-					pos.x = attrib.vertices[3 * i.vertex_index + 0];
-					pos.y = attrib.vertices[3 * i.vertex_index + 1];
-					pos.z = attrib.vertices[3 * i.vertex_index + 2];
-					normal.x = attrib.normals[3 * i.normal_index + 0];
-					normal.y = attrib.normals[3 * i.normal_index + 1];
-					normal.z = attrib.normals[3 * i.normal_index + 2];
-					uv.x = attrib.texcoords[2 * i.texcoord_index + 0];
-					uv.y = attrib.texcoords[2 * i.texcoord_index + 1];
+			mThreadPool.ParallelFor(batchEnd - batchBegin, 1, [this, &obj, &materialIndices, &defaultMaterials, &primitives, batchBegin](const size_t begin, const size_t end) {
+				for (size_t meshIdx = batchBegin + begin; meshIdx < batchBegin + end; ++meshIdx) {
+					if (mScene.meshes[meshIdx].isAnalytic) {
+						this->CreateAnalyticMeshBuffers(meshIdx, primitives);
+					} else {
+						this->CreateMeshBuffers(meshIdx);
+						FillMeshBuffers(mScene.meshes[meshIdx], obj->attrib, obj->shapes[meshIdx], materialIndices, defaultMaterials[meshIdx]);
+					}
+					mScene.meshes[meshIdx].hitRecord = MakeHitRecord(mScene.meshes[meshIdx], mMaterials);
+					this->CreateMeshBLAS(meshIdx);
 				}
+			});
 
-				const uint32_t a = static_cast<uint32_t>(3 * f + 0);
-				const uint32_t b = static_cast<uint32_t>(3 * f + 1);
-				const uint32_t c = static_cast<uint32_t>(3 * f + 2);
-				indices[a] = a;
-				indices[b] = b;
-				indices[c] = c;
+			std::lock_guard<std::mutex> lock(mSceneMutex);
+			mNumReadyMeshes = static_cast<uint32_t>(batchEnd);
+			batchBegin = batchEnd;
+		}
+	}
+}
+void RayTracerApp::CreateMeshBuffers(const size_t meshIdx) {
+	RTMesh& mesh = mScene.meshes[meshIdx];
 
-				faces[4 * f + 0] = a;
-				faces[4 * f + 1] = b;
-				faces[4 * f + 2] = c;
-			}
+	const size_t positionsBufferSize = mesh.numVertices * sizeof(vec3);
+	const size_t indicesBufferSize = mesh.numFaces * 3 * sizeof(uint32_t);
+	const size_t facesBufferSize = mesh.numFaces * 4 * sizeof(uint32_t);
+	const size_t attribsBufferSize = mesh.numVertices * sizeof(VertexAttribute);
+	const size_t meshInfosBufferSize = sizeof(vec4);
 
-			vec4& colorInfo = infos[0];//random rgb color
-			vec4& matInfo = infos[1];	// mat diffuse , specular
-			if (shape.name == "Plane")
-			{
-				colorInfo.x = planeColor.r;
-				colorInfo.y = planeColor.g;
-				colorInfo.z = planeColor.b;
-				colorInfo.w = 1.0;// alpha 
-
-				matInfo.x = 0.2;
-				matInfo.y = 0.2;
-				matInfo.z = 0.0;
-				matInfo.w = 0.0;
-			}
-			else if (shape.name == "Mirror")
-			{
-				colorInfo.x = 1.0;
-				colorInfo.y = 1.0;
-				colorInfo.z = 1.0;
-				colorInfo.w = 1.0;// alpha 
-
-				matInfo.x = 0.5;
-				matInfo.y = 0.5;
-				matInfo.z = 3.0;//reflect
-				matInfo.w = 0.0;
-			}
-			else
-			{
-				matInfo.x = getRandomFloat(0.3, 0.1);
-				matInfo.y = getRandomFloat(0.3, 0.1);
-				matInfo.z = 0.0;
-				matInfo.w = 0.0;
-
-				colorInfo.w = 1;// alpha  1 == opaque; 0 == fully transparent 
-
-				if (shape.name == "Light")
-				{
-					colorInfo.x = 1;
-					colorInfo.y = 1;
-					colorInfo.z = 1;
-
-					matInfo.w = 1.0;//emittance
-				}
-				else
-				{
+	MemoryTracker::Scope memoryScope(MemoryCategory::Geometry, mesh.name);
+	VkResult error = mesh.positions.Create(positionsBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VK_ERROR(error, "mesh.positions.Create");
 
-					colorInfo.x = getRandomFloat(0.5, 1.0);
-					colorInfo.y = getRandomFloat(0.5, 1.0);
-					colorInfo.z = getRandomFloat(0.5, 1.0);
+	error = mesh.indices.Create(indicesBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VK_ERROR(error, "mesh.indices.Create");
 
-				}
+	error = mesh.faces.Create(facesBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VK_ERROR(error, "mesh.faces.Create");
 
-				if (shape.name == "TMesh")
-				{
-					colorInfo.x = 1;
-					colorInfo.y = 0;
-					colorInfo.z = 0;
-					colorInfo.w = 0.2;// alpha  1 == opaque; 0 == fully transparent
-				}
-				else if (shape.name == "Sphere")
-				{
-					colorInfo.x = 0;
-					colorInfo.y = 0;
-					colorInfo.z = 1;
-				}
-				
-			}
-			mesh.indices.Unmap();
-			mesh.attribs.Unmap();
-			mesh.positions.Unmap();
-			mesh.faces.Unmap();
-			mesh.infos.Unmap();
+	error = mesh.attribs.Create(attribsBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VK_ERROR(error, "mesh.attribs.Create");
+
+	error = mesh.infos.Create(meshInfosBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VK_ERROR(error, "mesh.infos.Create");
+
+	this->PrepareMeshBufferInfos(meshIdx);
+}
+void RayTracerApp::CreateAnalyticMeshBuffers(const size_t meshIdx, const Array<ObjPrimitive>& primitives) {
+	static_assert(sizeof(ObjPrimitive) == sizeof(AnalyticPrimitive), "ObjPrimitive has to match the shaders' AnalyticPrimitive");
+	static_assert(sizeof(VkAabbPositionsKHR) == 6 * sizeof(float), "GetObjPrimitiveBounds writes VkAabbPositionsKHR");
+	RTMesh& mesh = mScene.meshes[meshIdx];
+	assert(mesh.numFaces == primitives.size());
+
+	// the BLAS is built from the AABBs, the intersection & hit shaders read the primitives (hitRecordPrimitives)
+	Array<VkAabbPositionsKHR> aabbs(primitives.size());
+	for (size_t i = 0; i < primitives.size(); ++i) {
+		GetObjPrimitiveBounds(primitives[i], &aabbs[i].minX);
+	}
+	VertexAttribute noAttribs;
+	noAttribs.normal = vec4(0.0f);
+	noAttribs.uv = vec4(0.0f);
+	const vec4 infos = vec4(-1.0f);		// x - first emitter index, none (see AppendLights)
+
+	const size_t aabbsBufferSize = aabbs.size() * sizeof(VkAabbPositionsKHR);
+	const size_t primitivesBufferSize = primitives.size() * sizeof(AnalyticPrimitive);
+
+	MemoryTracker::Scope memoryScope(MemoryCategory::Geometry, mesh.name);
+	VkResult error = mesh.positions.Create(aabbsBufferSize, VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VK_ERROR(error, "mesh.positions.Create");
+
+	error = mesh.faces.Create(primitivesBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VK_ERROR(error, "mesh.faces.Create");
+
+	// no vertices, a single attribute keeps its descriptor valid
+	error = mesh.attribs.Create(sizeof(VertexAttribute), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VK_ERROR(error, "mesh.attribs.Create");
+
+	error = mesh.infos.Create(sizeof(vec4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VK_ERROR(error, "mesh.infos.Create");
+
+	if (!mesh.positions.UploadData(aabbs.data(), aabbsBufferSize) || !mesh.faces.UploadData(primitives.data(), primitivesBufferSize) ||
+		!mesh.attribs.UploadData(&noAttribs, sizeof(VertexAttribute)) || !mesh.infos.UploadData(&infos, sizeof(vec4))) {
+		assert(false && "Failed to upload the analytic primitives");
+	}
+
+	this->PrepareMeshBufferInfos(meshIdx);
+}
+void RayTracerApp::PrepareMeshBufferInfos(const size_t meshIdx) {
+	const RTMesh& mesh = mScene.meshes[meshIdx];
+
+	// prepare shader resources infos
+	VkDescriptorBufferInfo& meshInfo = mScene.meshInfoBufferInfos[meshIdx];
+	VkDescriptorBufferInfo& attribsInfo = mScene.attribsBufferInfos[meshIdx];
+	VkDescriptorBufferInfo& facesInfo = mScene.facesBufferInfos[meshIdx];
+
+	attribsInfo.buffer = mesh.attribs.GetBuffer();
+	attribsInfo.offset = 0;
+	attribsInfo.range = mesh.attribs.GetSize();
+
+	facesInfo.buffer = mesh.faces.GetBuffer();
+	facesInfo.offset = 0;
+	facesInfo.range = mesh.faces.GetSize();
+
+	meshInfo.buffer = mesh.infos.GetBuffer();
+	meshInfo.offset = 0;
+	meshInfo.range = mesh.infos.GetSize();
+}
+void RayTracerApp::CreateMeshBLAS(const size_t meshIdx) {
+	// here we create our bottom-level acceleration structure for our mesh, CreateScene builds it
+	RTMesh& mesh = mScene.meshes[meshIdx];
+	const VkAccelerationStructureCreateGeometryTypeInfoKHR geometryInfo = GetMeshGeometryInfo(mesh);
+
+	MemoryTracker::Scope memoryScope(MemoryCategory::AccelerationStructure, mesh.name);
+	this->CreateAS(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, 1, &geometryInfo, 0, mesh.blas);
+}
+uint32_t RayTracerApp::WaitForSceneParsed() {
+	// the loader numbers the emitters and fills the material table before it hands over any mesh
+	std::unique_lock<std::mutex> lock(mSceneMutex);
+	mSceneParsed.wait(lock, [this]() {
+		return mNumSceneMeshes || mSceneLoaded;
+	});
+	return mNumSceneEmitters;
+}
+void RayTracerApp::CreateLights(const uint32_t capacity) {
+	static_assert(sizeof(LightBVH::Node) == sizeof(LightBVHNode), "LightBVH::Node has to match the shaders' LightBVHNode");
+
+	// two sets of room for every emissive triangle of the scene, a tree over n of them has 2n - 1 nodes: a set's
+	// nodes start at twice its triangles' offset (lights.glsl). Never resized, the descriptors stay the same
+	mScene.lightsCapacity = Max(capacity, 1u);
+	mScene.lightsSet = 0;
+	mScene.lightsSetRetired = 0;
+	mScene.numEmissiveTriangles = 0;
+	mScene.emissiveInvTotalWeight = 0.0f;
+	mScene.emissiveTriangles.clear();
+	mScene.emitters.clear();
+	mScene.emitterWeights.clear();
+	mScene.lightBVH.Clear();
+	mScene.pendingEmissiveTriangles = 0;
+	mScene.pendingInvTotalWeight = 0.0f;
+	mScene.lightsPending = false;
+
+	MemoryTracker::Scope memoryScope(MemoryCategory::Geometry, "lights");
+	mScene.lightsBuffer.Destroy();
+	mScene.lightNodesBuffer.Destroy();
+
+	const VkDeviceSize bufferSize = 2 * mScene.lightsCapacity * sizeof(EmissiveTriangle);
+	VkResult error = mScene.lightsBuffer.Create(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VK_ERROR(error, "mScene.lightsBuffer.Create");
+
+	const VkDeviceSize nodesBufferSize = 2 * 2 * mScene.lightsCapacity * sizeof(LightBVH::Node);
+	error = mScene.lightNodesBuffer.Create(nodesBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VK_ERROR(error, "mScene.lightNodesBuffer.Create");
+
+	printf("Light sampling: room for %u emissive triangles\n", capacity);
+}
+void RayTracerApp::AppendLights(const uint32_t firstMesh, const uint32_t lastMesh) {
+	// every triangle of the new emissive meshes after the ones so far, so the one that was hit is simply first
+	// emitter + primitive id. Emission is per triangle (its material), those of an emissive mesh that don't emit
+	// are kept with no power
+	const size_t firstNew = mScene.emissiveTriangles.size();
+	for (uint32_t meshIdx = firstMesh; meshIdx < lastMesh; ++meshIdx) {
+		const RTMesh& mesh = mScene.meshes[meshIdx];
+		if (!mesh.isEmissive) {
+			continue;
+		}
+		assert(mesh.firstEmitter == mScene.emissiveTriangles.size() && "The meshes have to arrive in the order the loader numbered their emitters in");
+
+		const vec3* positions = reinterpret_cast<const vec3*>(mesh.positions.Map());
+		const uint32_t* faces = reinterpret_cast<const uint32_t*>(mesh.faces.Map());
+		for (uint32_t f = 0; f < mesh.numFaces; ++f) {
+			const vec3& a = positions[3 * f + 0];
+			const vec3& b = positions[3 * f + 1];
+			const vec3& c = positions[3 * f + 2];
+
+			const MaterialTable::Material& material = mMaterials.GetMaterial(faces[4 * f + 3]);
+			const vec3 emission = vec3(material.emission[0], material.emission[1], material.emission[2]);
+			const float luminance = Dot(emission, vec3(0.2126f, 0.7152f, 0.0722f));
+
+			// degenerate triangles are kept (with no power) to keep the indices in sync
+			const float area = 0.5f * Length(Cross(b - a, c - a));
+
+			EmissiveTriangle tri = {};
+			tri.v0 = vec4(a, area);
+			tri.v1 = vec4(b, 0.0f);
+			tri.v2 = vec4(c, 0.0f);
+			tri.emission = vec4(emission, 0.0f);
+			tri.info = uvec4(0u, mesh.slot, f, 0u);
+			mScene.emissiveTriangles.push_back(tri);
+
+			LightBVH::Emitter emitter;
+			memcpy(emitter.v0, &a, sizeof(emitter.v0));
+			memcpy(emitter.v1, &b, sizeof(emitter.v1));
+			memcpy(emitter.v2, &c, sizeof(emitter.v2));
+			emitter.power = area * luminance;
+			mScene.emitters.push_back(emitter);
+
+			mScene.emitterWeights.push_back(area * luminance);
+		}
+		mesh.faces.Unmap();
+		mesh.positions.Unmap();
+	}
+	const size_t numTriangles = mScene.emissiveTriangles.size();
+	if (numTriangles == firstNew) {
+		return;
+	}
+	assert(numTriangles <= mScene.lightsCapacity);
+
+	// the tree only gets the new emitters (LightBVH::Append), every alias table entry depends on the total though:
+	// that one is rebuilt, in linear time from the weights kept
+	AliasTable aliasTable;
+	const bool aliasTableBuilt = aliasTable.Build(mScene.emitterWeights);
+	const bool lightBVHBuilt = mScene.lightBVH.Append(mScene.emitters, firstNew);
+	if (aliasTableBuilt && lightBVHBuilt) {
+		const Array<AliasTable::Entry>& entries = aliasTable.GetEntries();
+		const Array<uint32_t>& bitTrails = mScene.lightBVH.GetBitTrails();
+		for (size_t i = 0; i < numTriangles; ++i) {
+			EmissiveTriangle& tri = mScene.emissiveTriangles[i];
+			tri.v1.w = entries[i].probability;
+			tri.v2.w = aliasTable.GetPdf(static_cast<uint32_t>(i));
+			tri.info.x = entries[i].alias;
+			tri.info.w = bitTrails[i];
+		}
+		mScene.pendingEmissiveTriangles = static_cast<uint32_t>(numTriangles);
+		mScene.pendingInvTotalWeight = static_cast<float>(1.0 / aliasTable.GetTotalWeight());
+	} else {
+		// nothing emits yet
+		mScene.pendingEmissiveTriangles = 0;
+		mScene.pendingInvTotalWeight = 0.0f;
+	}
+	mScene.lightsPending = true;
+
+	printf("Light sampling: %u emissive triangles, light BVH of %u nodes (depth %u)\n",
+		mScene.pendingEmissiveTriangles, static_cast<uint32_t>(mScene.lightBVH.GetNodes().size()), mScene.lightBVH.GetDepth());
+}
+void RayTracerApp::UpdateLights() {
+	if (!mScene.lightsPending) {
+		return;
+	}
+
+	// the other set is free once the frames that read it before the last switch are done, this image's fence has
+	// been waited on: frames up to one ring ago are. Until then the frames go on with the emitters they have, their
+	// meshes' hits are still counted through the BSDF (emitterPdfArea)
+	const uint64_t numFramesInFlight = static_cast<uint64_t>(this->GetNumFramesInFlight());
+	if (mScene.lightsSetRetired && mNumSubmittedFrames + 1 < mScene.lightsSetRetired + numFramesInFlight) {
+		return;
+	}
+
+	const uint32_t set = 1 - mScene.lightsSet;
+	const uint32_t numTriangles = mScene.pendingEmissiveTriangles;
+	if (numTriangles) {
+		const Array<LightBVH::Node>& nodes = mScene.lightBVH.GetNodes();
+		assert(nodes.size() <= 2 * mScene.lightsCapacity);
+		if (!mScene.lightsBuffer.UploadData(mScene.emissiveTriangles.data(), numTriangles * sizeof(EmissiveTriangle),
+			set * mScene.lightsCapacity * sizeof(EmissiveTriangle))) {
+			assert(false && "Failed to upload lights buffer");
+		}
+		if (!mScene.lightNodesBuffer.UploadData(nodes.data(), nodes.size() * sizeof(LightBVH::Node),
+			set * 2 * mScene.lightsCapacity * sizeof(LightBVH::Node))) {
+			assert(false && "Failed to upload light nodes buffer");
 		}
 	}
+
+	// the frames from this one on read the new set (updateUniformParams)
+	mScene.lightsSet = set;
+	mScene.lightsSetRetired = mNumSubmittedFrames;
+	mScene.numEmissiveTriangles = numTriangles;
+	mScene.emissiveInvTotalWeight = mScene.pendingInvTotalWeight;
+	mScene.lightsPending = false;
+}
+void RayTracerApp::CreateMaterials() {
+	// the whole table, the loader has it before it hands over any mesh. A dummy entry if there's none
+	const size_t numMaterials = mMaterials.GetNumMaterials();
+	MaterialData dummy = {};
+	dummy.textures = uvec4(SWS_INVALID_ID);
+	const void* materials = numMaterials ? static_cast<const void*>(mMaterials.GetMaterials().data()) : &dummy;
+
+	MemoryTracker::Scope memoryScope(MemoryCategory::Geometry, "materials");
+	mScene.materialsBuffer.Destroy();
+
+	const VkDeviceSize bufferSize = Max(numMaterials, size_t(1)) * sizeof(MaterialData);
+	VkResult error = mScene.materialsBuffer.Create(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VK_ERROR(error, "mScene.materialsBuffer.Create");
+
+	if (!mScene.materialsBuffer.UploadData(materials, bufferSize)) {
+		assert(false && "Failed to upload materials buffer");
+	}
+	mScene.numMaterials = static_cast<uint32_t>(numMaterials);
+}
+void RayTracerApp::CreateTextureCache() {
+	// the loader may have registered some already, nothing gets loaded before a frame samples it
+	TextureFormat format = TextureFormat::BC7;
+	ParseTextureFormat(mSettings.textureFormat, format);
+	const uint64_t budget = static_cast<uint64_t>(mSettings.textureBudgetMB) * 1024 * 1024;
+	// a pool of their own: a BC7 encode takes hundreds of ms, queued with the denoiser's & the loader's jobs
+	// it would hold them up
+	if (!mTextureThreadPool.GetNumThreads()) {
+		mTextureThreadPool.Initialize(sTextureLoadThreads);
+	}
+	if (!mTextures.Initialize(mPhysicalDevice, mDevice, mCommandPool, mGraphicsQueue, &mBindless, mTexturesTable, &mTextureThreadPool, budget, format)) {
+		assert(false && "Failed to create the texture cache");
+	}
+}
+void RayTracerApp::UpdateTextures() {
+	// frames up to one ring ago are done (the same ones Recycle() got)
+	const uint64_t numFramesInFlight = static_cast<uint64_t>(this->GetNumFramesInFlight());
+	const uint64_t completedFrame = (mNumSubmittedFrames >= numFramesInFlight) ? (mNumSubmittedFrames - numFramesInFlight) : 0;
+
+	bool rerecord = false;
+	if (mTextures.Update(mNumSubmittedFrames, completedFrame, static_cast<uint32_t>(numFramesInFlight), rerecord)) {
+		// what was accumulated had the material's color where the texture is now
+		mResetAccumulation = true;
+		mDenoiser.ResetHistory();
+	}
+	if (rerecord) {
+		this->FillCommandBuffers();
+	}
 }
 void RayTracerApp::CreateScene() {
+	// room for every mesh the layouts allow from the start: the TLAS & its descriptor stay the same as meshes
+	// arrive, only the build is redone
+	mScene.numMeshes = 0;
+	{
+		MemoryTracker::Scope memoryScope(MemoryCategory::AccelerationStructure, "TLAS instances");
+		VkResult error = mScene.instancesBuffer.Create(mMaxSceneMeshes * sizeof(VkAccelerationStructureInstanceKHR), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		CHECK_VK_ERROR(error, "mScene.instancesBuffer.Create");
+	}
+
+    // and here we create out top-level acceleration structure that'll represent our scene
+    VkAccelerationStructureCreateGeometryTypeInfoKHR tlasGeoInfo = {};
+    tlasGeoInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_GEOMETRY_TYPE_INFO_KHR;
+    tlasGeoInfo.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+	tlasGeoInfo.maxPrimitiveCount = mMaxSceneMeshes;
+    tlasGeoInfo.allowsTransforms = VK_TRUE;
+
+    {
+        MemoryTracker::Scope tlasMemoryScope(MemoryCategory::AccelerationStructure, "TLAS");
+        this->CreateAS(VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, 1, &tlasGeoInfo, 1, mScene.topLevelAS);
+    }
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	VkResult error = vkCreateFence(mDevice, &fenceInfo, nullptr, &mSceneBuild.fence);
+	CHECK_VK_ERROR(error, "vkCreateFence");
+
+	// an empty scene until the first meshes are ready, the AS still has to be built to be traced
+	this->BuildSceneMeshes(0, false);
+}
+
+void RayTracerApp::BuildSceneMeshes(const uint32_t numMeshes, const bool streaming) {
+	const uint32_t firstMesh = mScene.numMeshes;
+	const uint32_t lastMesh = Min(numMeshes, mMaxSceneMeshes);
+	if (numMeshes > mMaxSceneMeshes && firstMesh < mMaxSceneMeshes) {
+		printf("The scene has more than %u meshes, the bindless registry has no more slots, dropping the rest\n", mMaxSceneMeshes);
+	}
+
+	// the lights & the materials have room for the whole scene (CreateLights, CreateMaterials), only the meshes'
+	// descriptors get written. Without update-after-bind that can't be done under a recorded command buffer: wait
+	// for the GPU and re-record
+	const bool rerecord = streaming && !mBindless.IsUpdateAfterBind();
+	if (rerecord) {
+		vkDeviceWaitIdle(mDevice);
+	}
+
 	const VkTransformMatrixKHR transform = {
 	1.0f, 0.0f, 0.0f, 0.0f,
 	0.0f, 1.0f, 0.0f, 0.0f,
 	0.0f, 0.0f, 1.0f, 0.0f,
 	};
 
-	const size_t numMeshes = mScene.meshes.size();
+	const size_t numNewMeshes = lastMesh - firstMesh;
 
-	Array<VkAccelerationStructureCreateGeometryTypeInfoKHR> geometryInfos(numMeshes, VkAccelerationStructureCreateGeometryTypeInfoKHR{});
-	Array<VkAccelerationStructureGeometryKHR> geometries(numMeshes, VkAccelerationStructureGeometryKHR{});
-	Array<VkAccelerationStructureInstanceKHR> instances(numMeshes, VkAccelerationStructureInstanceKHR{});
+	Array<VkAccelerationStructureCreateGeometryTypeInfoKHR> geometryInfos(numNewMeshes, VkAccelerationStructureCreateGeometryTypeInfoKHR{});
+	Array<VkAccelerationStructureGeometryKHR> geometries(numNewMeshes, VkAccelerationStructureGeometryKHR{});
 
-	for (size_t i = 0; i < numMeshes; ++i) {
-		RTMesh& mesh = mScene.meshes[i];
+	// the BLASes themselves were created along with their meshes (CreateMeshBLAS), only the builds are left.
+	// Instances of the meshes already built stay where they are, the pending builds are done with the buffer
+	VkAccelerationStructureInstanceKHR* instances = nullptr;
+	if (numNewMeshes) {
+		instances = reinterpret_cast<VkAccelerationStructureInstanceKHR*>(mScene.instancesBuffer.Map(numNewMeshes * sizeof(VkAccelerationStructureInstanceKHR), firstMesh * sizeof(VkAccelerationStructureInstanceKHR)));
+	}
+	for (size_t i = 0; i < numNewMeshes; ++i) {
+		const uint32_t meshIdx = firstMesh + static_cast<uint32_t>(i);
+		RTMesh& mesh = mScene.meshes[meshIdx];
+
+		// meshes never outnumber the slots (lastMesh), so there always is one
+		mesh.slot = mBindless.Allocate(BindlessRegistry::Kind::Buffer);
+		assert(mesh.slot != SlotAllocator::InvalidSlot);
+		// there's only ever the one analytic mesh, the loader puts every primitive in it
+		mesh.record = mesh.isAnalytic ? mMaxSceneMeshes : mesh.slot;    // SBTHelper::GetProceduralRecord(0)
+		this->WriteMeshDescriptors(meshIdx);
+		this->WriteMeshHitRecord(meshIdx);
 
 		VkAccelerationStructureCreateGeometryTypeInfoKHR& geometryInfo = geometryInfos[i];
 		VkAccelerationStructureGeometryKHR& geometry = geometries[i];
 
-		geometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_GEOMETRY_TYPE_INFO_KHR;
-		geometryInfo.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-		geometryInfo.maxPrimitiveCount = mesh.numFaces;
-		geometryInfo.indexType = VK_INDEX_TYPE_UINT32;
-		geometryInfo.maxVertexCount = mesh.numVertices;
-		geometryInfo.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
-		geometryInfo.allowsTransforms = VK_FALSE;
+		geometryInfo = GetMeshGeometryInfo(mesh);
 
 		geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
-		geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+		geometry.flags = mesh.isOpaque ? VK_GEOMETRY_OPAQUE_BIT_KHR : 0;
 		geometry.geometryType = geometryInfo.geometryType;
-		geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
-		geometry.geometry.triangles.vertexData = vulkanhelpers::GetBufferDeviceAddressConst(mesh.positions);
-		geometry.geometry.triangles.vertexStride = sizeof(vec3);
-		geometry.geometry.triangles.vertexFormat = geometryInfo.vertexFormat;
-		geometry.geometry.triangles.indexData = vulkanhelpers::GetBufferDeviceAddressConst(mesh.indices);
-		geometry.geometry.triangles.indexType = geometryInfo.indexType;
-
-		// here we create our bottom-level acceleration structure for our mesh
-		this->CreateAS(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, 1, &geometryInfo, 0, mesh.blas);
-
+		if (mesh.isAnalytic) {
+			geometry.geometry.aabbs.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_AABBS_DATA_KHR;
+			geometry.geometry.aabbs.data = vulkanhelpers::GetBufferDeviceAddressConst(mesh.positions);
+			geometry.geometry.aabbs.stride = sizeof(VkAabbPositionsKHR);
+		} else {
+			geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+			geometry.geometry.triangles.vertexData = vulkanhelpers::GetBufferDeviceAddressConst(mesh.positions);
+			geometry.geometry.triangles.vertexStride = sizeof(vec3);
+			geometry.geometry.triangles.vertexFormat = geometryInfo.vertexFormat;
+			geometry.geometry.triangles.indexData = vulkanhelpers::GetBufferDeviceAddressConst(mesh.indices);
+			geometry.geometry.triangles.indexType = geometryInfo.indexType;
+		}
 
-		VkAccelerationStructureInstanceKHR& instance = instances[i];
+		VkAccelerationStructureInstanceKHR instance = {};
 		instance.transform = transform;
-		instance.instanceCustomIndex = static_cast<uint32_t>(i);
+		instance.instanceCustomIndex = mesh.slot;
 		instance.mask = 0xff;
-		instance.instanceShaderBindingTableRecordOffset = 0;
+		instance.instanceShaderBindingTableRecordOffset = mesh.record * SWS_NUM_HIT_GROUPS;  // SBTHelper::GetHitRecordIndex
 		instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
 		instance.accelerationStructureReference = mesh.blas.handle;
+		instances[i] = instance;
 	}
-
-	// create instances for our meshes
-	vulkanhelpers::Buffer instancesBuffer;
-	VkResult error = instancesBuffer.Create(instances.size() * sizeof(VkAccelerationStructureInstanceKHR), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	CHECK_VK_ERROR(error, "instancesBuffer.Create");
-
-	if (!instancesBuffer.UploadData(instances.data(), instancesBuffer.GetSize())) {
-		assert(false && "Failed to upload instances buffer");
+	if (instances) {
+		mScene.instancesBuffer.Unmap();
 	}
 
-    // and here we create out top-level acceleration structure that'll represent our scene
-    VkAccelerationStructureCreateGeometryTypeInfoKHR tlasGeoInfo = {};
-    tlasGeoInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_GEOMETRY_TYPE_INFO_KHR;
-    tlasGeoInfo.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
-	tlasGeoInfo.maxPrimitiveCount = static_cast<uint32_t>(instances.size());
-    tlasGeoInfo.allowsTransforms = VK_TRUE;
-
-    this->CreateAS(VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, 1, &tlasGeoInfo, 1, mScene.topLevelAS);
-
     // now we have to build them
 	VkAccelerationStructureMemoryRequirementsInfoKHR memoryRequirementsInfo = {};
 	memoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_KHR;
 	memoryRequirementsInfo.buildType = VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR;
 
 	VkDeviceSize maximumBlasSize = 0;
-	for (const RTMesh& mesh : mScene.meshes) {
+	for (uint32_t i = firstMesh; i < lastMesh; ++i) {
 		memoryRequirementsInfo.type = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_BUILD_SCRATCH_KHR;
-		memoryRequirementsInfo.accelerationStructure = mesh.blas.accelerationStructure;
+		memoryRequirementsInfo.accelerationStructure = mScene.meshes[i].blas.accelerationStructure;
 
 		VkMemoryRequirements2 memReqBLAS = {};
 		memReqBLAS.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
@@ -599,9 +1376,13 @@ void RayTracerApp::CreateScene() {
 
     const VkDeviceSize scratchBufferSize = Max(maximumBlasSize, memReqTLAS.memoryRequirements.size);
 
-    vulkanhelpers::Buffer scratchBuffer;
-    error = scratchBuffer.Create(scratchBufferSize, VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    CHECK_VK_ERROR(error, "scratchBuffer.Create");
+	// the scratch buffer only lives until the build is done, it still counts towards the peak
+	VkResult error;
+	{
+		MemoryTracker::Scope memoryScope(MemoryCategory::Scratch, "scene build");
+		error = mSceneBuild.scratch.Create(scratchBufferSize, VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CHECK_VK_ERROR(error, "scratchBuffer.Create");
+	}
 
     VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
     commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -612,33 +1393,51 @@ void RayTracerApp::CreateScene() {
     VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
     error = vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &commandBuffer);
     CHECK_VK_ERROR(error, "vkAllocateCommandBuffers");
+	mSceneBuild.commandBuffer = commandBuffer;
 
     VkCommandBufferBeginInfo beginInfo = {};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
+	// the setup slot is only free while nothing renders, streamed builds go unprofiled
+    const size_t profilerSlot = this->GetSetupProfilerSlot();
+	if (!streaming) {
+		mGpuProfiler.BeginCommandBuffer(commandBuffer, profilerSlot);
+	}
+
+	// frames submitted before still trace the TLAS that's about to be rebuilt
+	VkMemoryBarrier tracedBarrier = {};
+	tracedBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	tracedBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+	tracedBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+		VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+		0, 1, &tracedBarrier, 0, nullptr, 0, nullptr);
+
     VkMemoryBarrier memoryBarrier = {};
     memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
     memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
     memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
 
     // build bottom-level ASs
-	// build bottom-level ASs
-	for (size_t i = 0; i < numMeshes; ++i) {
+	for (size_t i = 0; i < numNewMeshes; ++i) {
+		const RTAccelerationStructure& blas = mScene.meshes[firstMesh + i].blas;
+
 		VkAccelerationStructureGeometryKHR* geometryPtr = &geometries[i];
 
 		VkAccelerationStructureBuildGeometryInfoKHR buildInfo = {};
 		buildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-		buildInfo.type = mScene.meshes[i].blas.accelerationStructureInfo.type;
-		buildInfo.flags = mScene.meshes[i].blas.accelerationStructureInfo.flags;
+		buildInfo.type = blas.accelerationStructureInfo.type;
+		buildInfo.flags = blas.accelerationStructureInfo.flags;
 		buildInfo.update = VK_FALSE;
 		buildInfo.srcAccelerationStructure = VK_NULL_HANDLE;
-		buildInfo.dstAccelerationStructure = mScene.meshes[i].blas.accelerationStructure;
+		buildInfo.dstAccelerationStructure = blas.accelerationStructure;
 		buildInfo.geometryArrayOfPointers = VK_FALSE;
-		buildInfo.geometryCount = mScene.meshes[i].blas.accelerationStructureInfo.maxGeometryCount;
+		buildInfo.geometryCount = blas.accelerationStructureInfo.maxGeometryCount;
 		buildInfo.ppGeometries = &geometryPtr;
-		buildInfo.scratchData = vulkanhelpers::GetBufferDeviceAddress(scratchBuffer);
+		buildInfo.scratchData = vulkanhelpers::GetBufferDeviceAddress(mSceneBuild.scratch);
 
 		VkAccelerationStructureBuildOffsetInfoKHR offsetInfo;
 		offsetInfo.primitiveCount = geometryInfos[i].maxPrimitiveCount;
@@ -648,7 +1447,12 @@ void RayTracerApp::CreateScene() {
 
 		VkAccelerationStructureBuildOffsetInfoKHR* offsets[1] = { &offsetInfo };
 
-		vkCmdBuildAccelerationStructureKHR(commandBuffer, 1, &buildInfo, offsets);
+		if (!streaming) {
+			PROFILE_GPU_ZONE(mGpuProfiler, commandBuffer, profilerSlot, "Build BLAS");
+			vkCmdBuildAccelerationStructureKHR(commandBuffer, 1, &buildInfo, offsets);
+		} else {
+			vkCmdBuildAccelerationStructureKHR(commandBuffer, 1, &buildInfo, offsets);
+		}
 
 		vkCmdPipelineBarrier(commandBuffer,
 			VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
@@ -656,14 +1460,14 @@ void RayTracerApp::CreateScene() {
 			0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 	}
 
-    // build top-level AS
+    // build top-level AS, every mesh so far
     VkAccelerationStructureGeometryKHR topLevelGeometry = {};
     topLevelGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
     topLevelGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
     topLevelGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
     topLevelGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
     topLevelGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
-    topLevelGeometry.geometry.instances.data.deviceAddress = vulkanhelpers::GetBufferDeviceAddress(instancesBuffer).deviceAddress;
+    topLevelGeometry.geometry.instances.data.deviceAddress = vulkanhelpers::GetBufferDeviceAddress(mScene.instancesBuffer).deviceAddress;
 
     VkAccelerationStructureGeometryKHR* geometryPtr = &topLevelGeometry;
 
@@ -677,21 +1481,27 @@ void RayTracerApp::CreateScene() {
     buildInfo.geometryArrayOfPointers = VK_FALSE;
     buildInfo.geometryCount = 1;
     buildInfo.ppGeometries = &geometryPtr;
-    buildInfo.scratchData = vulkanhelpers::GetBufferDeviceAddress(scratchBuffer);
+    buildInfo.scratchData = vulkanhelpers::GetBufferDeviceAddress(mSceneBuild.scratch);
 
     VkAccelerationStructureBuildOffsetInfoKHR offsetInfo;
-    offsetInfo.primitiveCount = tlasGeoInfo.maxPrimitiveCount;
+    offsetInfo.primitiveCount = lastMesh;
     offsetInfo.primitiveOffset = 0;
     offsetInfo.firstVertex = 0;
     offsetInfo.transformOffset = 0;
 
     VkAccelerationStructureBuildOffsetInfoKHR* offsets[1] = { &offsetInfo };
 
-    vkCmdBuildAccelerationStructureKHR(commandBuffer, 1, &buildInfo, offsets);
+    if (!streaming) {
+        PROFILE_GPU_ZONE(mGpuProfiler, commandBuffer, profilerSlot, "Build TLAS");
+        vkCmdBuildAccelerationStructureKHR(commandBuffer, 1, &buildInfo, offsets);
+    } else {
+        vkCmdBuildAccelerationStructureKHR(commandBuffer, 1, &buildInfo, offsets);
+    }
 
+    // and the frames after it trace the new one
     vkCmdPipelineBarrier(commandBuffer,
                          VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
-                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
                          0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
     vkEndCommandBuffer(commandBuffer);
@@ -701,14 +1511,86 @@ void RayTracerApp::CreateScene() {
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    error = vkQueueWaitIdle(mGraphicsQueue);
-    CHECK_VK_ERROR(error, "vkQueueWaitIdle");
-    vkFreeCommandBuffers(mDevice, mCommandPool, 1, &commandBuffer);
+	// same queue as the frames: the ones submitted from now on see the new meshes
+	vkResetFences(mDevice, 1, &mSceneBuild.fence);
+	if (!streaming) {
+		mGpuProfiler.MarkSubmit(profilerSlot);
+	}
+    error = vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, mSceneBuild.fence);
+    CHECK_VK_ERROR(error, "vkQueueSubmit");
+	mScene.numMeshes = lastMesh;
+	++mNumSceneBuilds;
+
+	// into the set frames don't read, switched to once it's free (UpdateLights)
+	this->AppendLights(firstMesh, lastMesh);
+
+	if (!streaming) {
+		this->UpdateLights();
+		error = vkWaitForFences(mDevice, 1, &mSceneBuild.fence, VK_TRUE, UINT64_MAX);
+		CHECK_VK_ERROR(error, "vkWaitForFences");
+		mGpuProfiler.Resolve(profilerSlot);
+		this->FinishSceneBuild();
+		return;
+	}
+
+	if (rerecord) {
+		this->FillCommandBuffers();
+	}
+	mResetAccumulation = true;
+	mDenoiser.ResetHistory();
+}
+
+void RayTracerApp::FinishSceneBuild() {
+	vkFreeCommandBuffers(mDevice, mCommandPool, 1, &mSceneBuild.commandBuffer);
+	mSceneBuild.commandBuffer = VK_NULL_HANDLE;
+	mSceneBuild.scratch.Destroy();
+}
+
+void RayTracerApp::StartSceneLoader() {
+	mStopSceneLoader = false;
+	mSceneLoader = std::thread(&RayTracerApp::LoadSceneGeometry, this);
+}
+
+void RayTracerApp::StopSceneLoader() {
+	mStopSceneLoader = true;
+	if (mSceneLoader.joinable()) {
+		mSceneLoader.join();
+	}
+}
+
+uint32_t RayTracerApp::GetReadyMeshes(bool& loaded) {
+	std::lock_guard<std::mutex> lock(mSceneMutex);
+	loaded = mSceneLoaded;
+	return mNumReadyMeshes;
+}
+
+void RayTracerApp::UpdateStreamedScene() {
+	if (mSceneComplete) {
+		return;
+	}
+
+	// one build at a time, the next one reuses its instances buffer
+	if (mSceneBuild.commandBuffer) {
+		if (VK_SUCCESS != vkGetFenceStatus(mDevice, mSceneBuild.fence)) {
+			return;
+		}
+		this->FinishSceneBuild();
+	}
+
+	bool loaded;
+	const uint32_t numReady = this->GetReadyMeshes(loaded);
+	if (numReady > mScene.numMeshes && mScene.numMeshes < mMaxSceneMeshes) {
+		this->BuildSceneMeshes(numReady, true);
+	} else if (loaded) {
+		// nothing more coming, and the last build is done
+		mSceneComplete = true;
+		printf("Scene complete after %.0f ms: %u meshes, %u builds\n",
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mStartupTime).count(),
+			mScene.numMeshes, mNumSceneBuilds);
+	}
 }
 
 void RayTracerApp::CreateDescriptorSetsLayouts() {
-	const uint32_t numMeshes = static_cast<uint32_t>(mScene.meshes.size());
 	mRTDescriptorSetsLayouts.resize(SWS_NUM_SETS);
     // First set:
     //  binding 0  ->  AS
@@ -732,14 +1614,14 @@ void RayTracerApp::CreateDescriptorSetsLayouts() {
 
 	VkDescriptorSetLayoutBinding camdataBufferBinding;
 	camdataBufferBinding.binding = SWS_CAMDATA_BINDING;
-	camdataBufferBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	camdataBufferBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	camdataBufferBinding.descriptorCount = 1;
 	camdataBufferBinding.stageFlags = VK_SHADER_STAGE_ALL;
 	camdataBufferBinding.pImmutableSamplers = nullptr;
 
 	VkDescriptorSetLayoutBinding uniformParamsBinding;
 	uniformParamsBinding.binding = SWS_UNIFORMPARAMS_BINDING;
-	uniformParamsBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uniformParamsBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uniformParamsBinding.descriptorCount = 1;
 	uniformParamsBinding.stageFlags = VK_SHADER_STAGE_ALL;
 	uniformParamsBinding.pImmutableSamplers = nullptr;
@@ -751,6 +1633,44 @@ void RayTracerApp::CreateDescriptorSetsLayouts() {
 		uniformParamsBinding
 		});
 
+	//  binding 4 .. 8  ->  first-hit AOVs
+	for (uint32_t i = 0; i < SWS_NUM_AOVS; ++i) {
+		VkDescriptorSetLayoutBinding aovBinding = resultImageLayoutBinding;
+		aovBinding.binding = SWS_AOV_FIRST_BINDING + i;
+		bindings.push_back(aovBinding);
+	}
+
+	//  binding 9  ->  emissive triangles
+	VkDescriptorSetLayoutBinding lightsBinding;
+	lightsBinding.binding = SWS_LIGHTS_BINDING;
+	lightsBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	lightsBinding.descriptorCount = 1;
+	lightsBinding.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+	lightsBinding.pImmutableSamplers = nullptr;
+	bindings.push_back(lightsBinding);
+
+	//  binding 10  ->  light BVH nodes
+	lightsBinding.binding = SWS_LIGHT_NODES_BINDING;
+	bindings.push_back(lightsBinding);
+
+	//  binding 11  ->  materials, indexed per triangle (faces.w)
+	VkDescriptorSetLayoutBinding materialsBinding = lightsBinding;
+	materialsBinding.binding = SWS_MATERIALS_BINDING;
+	materialsBinding.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR;
+	bindings.push_back(materialsBinding);
+
+	//  binding 12  ->  texture id -> bindless slot, 13  ->  texture use stamps
+	VkDescriptorSetLayoutBinding textureSlotsBinding = lightsBinding;
+	textureSlotsBinding.binding = SWS_TEXTURE_SLOTS_BINDING;
+	bindings.push_back(textureSlotsBinding);
+	textureSlotsBinding.binding = SWS_TEXTURE_USE_BINDING;
+	bindings.push_back(textureSlotsBinding);
+
+	//  binding 14  ->  accumulated radiance
+	VkDescriptorSetLayoutBinding radianceImageBinding = resultImageLayoutBinding;
+	radianceImageBinding.binding = SWS_RADIANCE_IMAGE_BINDING;
+	bindings.push_back(radianceImageBinding);
+
     VkDescriptorSetLayoutCreateInfo layoutInfo;
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	layoutInfo.pNext = nullptr;
@@ -760,50 +1680,29 @@ void RayTracerApp::CreateDescriptorSetsLayouts() {
 
     VkResult error = vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mRTDescriptorSetsLayouts[SWS_SCENE_AS_SET]);
 	CHECK_VK_ERROR(error, "vkCreateDescriptorSetLayout");
-	// Second set:
-//  binding 0 .. N  ->  per-face material IDs for our meshes  (N = num meshes)
-
-	const VkDescriptorBindingFlags flag = VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
-
-	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlags;
-	bindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
-	bindingFlags.pNext = nullptr;
-	bindingFlags.pBindingFlags = &flag;
-	bindingFlags.bindingCount = 1;
-
-	VkDescriptorSetLayoutBinding ssboBinding;
-	ssboBinding.binding = 0;
-	ssboBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	ssboBinding.descriptorCount = numMeshes;
-	ssboBinding.stageFlags = VK_SHADER_STAGE_ALL;
-	ssboBinding.pImmutableSamplers = nullptr;
-
-	VkDescriptorSetLayoutCreateInfo set1LayoutInfo;
-	set1LayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	set1LayoutInfo.pNext = &bindingFlags;
-	set1LayoutInfo.flags = 0;
-	set1LayoutInfo.bindingCount = 1;
-	set1LayoutInfo.pBindings = &ssboBinding;
-
-	// 2 set:
-	//  binding 0 .. N  ->  vertex attributes for our meshes  (N = num meshes)
-	//   (re-using second's set info)
-
-	error = vkCreateDescriptorSetLayout(mDevice, &set1LayoutInfo, nullptr, &mRTDescriptorSetsLayouts[SWS_ATTRIBS_SET]);
-	CHECK_VK_ERROR(error, L"vkCreateDescriptorSetLayout");
-
-	// 3 set:
-	//  binding 0 .. N  ->  faces info (indices) for our meshes  (N = num meshes)
-	//   (re-using second's set info)
-
-	error = vkCreateDescriptorSetLayout(mDevice, &set1LayoutInfo, nullptr, &mRTDescriptorSetsLayouts[SWS_FACES_SET]);
-	CHECK_VK_ERROR(error, L"vkCreateDescriptorSetLayout");
-
-
-	error = vkCreateDescriptorSetLayout(mDevice, &set1LayoutInfo, nullptr, &mRTDescriptorSetsLayouts[SWS_MESHINFO_SET]);
-	CHECK_VK_ERROR(error, L"vkCreateDescriptorSetLayout");
 
+	// sets 1 .. 3: the per-mesh arrays, indexed by the meshes' slots (instance custom index). Sized for the most
+	// meshes a scene can have and written as meshes arrive, the registry's own layouts, pool & sets
+	//  binding 0 .. N  ->  vertex attributes for our meshes
+	mAttribsTable = mBindless.AddTable(BindlessRegistry::Kind::Buffer, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL);
+	//  binding 0 .. N  ->  faces info (indices) for our meshes
+	mFacesTable = mBindless.AddTable(BindlessRegistry::Kind::Buffer, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL);
+	//  binding 0 .. N  ->  first emitter index of our meshes
+	mMeshInfoTable = mBindless.AddTable(BindlessRegistry::Kind::Buffer, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL);
+	// set 4, binding 0 .. N  ->  the resident textures, indexed by the texture cache's slots
+	mTexturesTable = mBindless.AddTable(BindlessRegistry::Kind::Texture, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL);
+
+	// 5 more storage buffers in set 0: emissive triangles, light BVH, materials, texture slots & use
+	if (!mBindless.Create(mDevice, mPhysicalDevice, sMaxSceneMeshes, sMaxResidentTextures, 5)) {
+		assert(false && "Failed to create the bindless registry");
+	}
+	mMaxSceneMeshes = mBindless.GetCapacity(BindlessRegistry::Kind::Buffer);
+	mHitRecords.resize(mMaxSceneMeshes + sNumProceduralRecords);
 
+	mRTDescriptorSetsLayouts[SWS_ATTRIBS_SET] = mBindless.GetLayout(mAttribsTable);
+	mRTDescriptorSetsLayouts[SWS_FACES_SET] = mBindless.GetLayout(mFacesTable);
+	mRTDescriptorSetsLayouts[SWS_MESHINFO_SET] = mBindless.GetLayout(mMeshInfoTable);
+	mRTDescriptorSetsLayouts[SWS_TEXTURES_SET] = mBindless.GetLayout(mTexturesTable);
 }
 
 void RayTracerApp::CreateRaytracingPipelineAndSBT() {
@@ -815,54 +1714,122 @@ void RayTracerApp::CreateRaytracingPipelineAndSBT() {
 	VkResult error = vkCreatePipelineLayout(mDevice, &pipelineLayoutCreateInfo, nullptr, &mRTPipelineLayout);
 	CHECK_VK_ERROR(error, "vkCreatePipelineLayout");
 
-	vulkanhelpers::Shader rayGenShader, rayChitShader, rayMissShader, rayAhitShader, shadowMiss, shadowAhit, indirectChitShader, indirectMissShader;
-    rayGenShader.LoadFromFile((sShadersFolder + "ray_gen.bin").c_str());
-    rayChitShader.LoadFromFile((sShadersFolder + "ray_chit.bin").c_str());
-    rayAhitShader.LoadFromFile((sShadersFolder + "ray_ahit.bin").c_str());
-	rayMissShader.LoadFromFile((sShadersFolder + "ray_miss.bin").c_str());
-	shadowAhit.LoadFromFile((sShadersFolder + "shadow_ray_ahit.bin").c_str());
-	shadowMiss.LoadFromFile((sShadersFolder + "shadow_ray_miss.bin").c_str());;
-	indirectChitShader.LoadFromFile((sShadersFolder + "indirect_ray_chit.bin").c_str());
-	indirectMissShader.LoadFromFile((sShadersFolder + "indirect_ray_miss.bin").c_str());
+	// kept for the pipeline variants built later on
+	mRTPipelineSet.reset(new RTPipelineSet());
+	for (size_t i = 0; i < sNumRTShaders; ++i) {
+		mRTPipelineSet->shaders[i].Load((String(sRTShaders[i].name) + ".bin").c_str());
+	}
+	const bool pipelineSetOk = this->InitRaytracingPipelineSet(*mRTPipelineSet);
 
+	if (!mSettings.quality.empty()) {
+		size_t preset = 0;
+		while (preset < sNumQualityPresets && mSettings.quality != sQualityPresets[preset].name) {
+			++preset;
+		}
+		if (preset < sNumQualityPresets) {
+			this->SetQualityPreset(preset);
+		} else {
+			printf("Unknown quality preset \"%s\", using %s\n", mSettings.quality.c_str(), sQualityPresets[mQualityPreset].name);
+		}
+	}
 
-    mShaderBindingTable.Initialize(3,3, mRTProps.shaderGroupHandleSize, mRTProps.shaderGroupBaseAlignment);
-    mShaderBindingTable.SetRaygenStage(rayGenShader.GetShaderStage(VK_SHADER_STAGE_RAYGEN_BIT_KHR));
+	// the one the command buffers get recorded with, others follow on demand. A set that failed has no variants
+	if (!pipelineSetOk || !this->SelectPipelineVariant()) {
+		printf("Couldn't create the ray tracing pipeline\n");
+	}
 
-	mShaderBindingTable.AddStageToHitGroup({ rayChitShader.GetShaderStage(VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR), 
-		rayAhitShader.GetShaderStage(VK_SHADER_STAGE_ANY_HIT_BIT_KHR) }, SWS_PRIMARY_HIT_SHADERS_IDX);
+	if (mSettings.hotReloadShaders) {
+		this->StartShaderHotReload();
+	}
+}
 
-	mShaderBindingTable.AddStageToHitGroup({ indirectChitShader.GetShaderStage(VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR) }, SWS_INDIRECT_HIT_SHADERS_IDX);
-	mShaderBindingTable.AddStageToHitGroup({ shadowAhit.GetShaderStage(VK_SHADER_STAGE_ANY_HIT_BIT_KHR) }, SWS_SHADOW_HIT_SHADERS_IDX);
+bool RayTracerApp::InitRaytracingPipelineSet(RTPipelineSet& set) {
+	vulkanhelpers::Shader& rayGenShader = set.shaders[0];
+	vulkanhelpers::Shader& rayChitShader = set.shaders[1];
+	vulkanhelpers::Shader& rayAhitShader = set.shaders[2];
+	vulkanhelpers::Shader& rayMissShader = set.shaders[3];
+	vulkanhelpers::Shader& shadowAhit = set.shaders[4];
+	vulkanhelpers::Shader& shadowMiss = set.shaders[5];
+	vulkanhelpers::Shader& indirectChitShader = set.shaders[6];
+	vulkanhelpers::Shader& indirectMissShader = set.shaders[7];
+	vulkanhelpers::Shader& analyticRintShader = set.shaders[8];
+
+	// a hit record per mesh slot, with the mesh's material & buffers inline, then the analytic mesh's.
+	// Only the layout so far, no table gets allocated before a variant is created
+	set.sbt.Initialize(SWS_NUM_HIT_GROUPS, 3, mRTProps.shaderGroupHandleSize, mRTProps.shaderGroupBaseAlignment, mMaxSceneMeshes, sizeof(HitRecordData), sNumProceduralRecords);
+	if (set.sbt.GetHitGroupsStride() > mRTProps.maxShaderGroupStride) {
+		// without a create function every variant asked of the set fails
+		printf("SBT hit records of %u bytes, the device takes at most %u\n", set.sbt.GetHitGroupsStride(), mRTProps.maxShaderGroupStride);
+		return false;
+	}
+	set.sbt.SetRaygenStage(rayGenShader.GetShaderStage(VK_SHADER_STAGE_RAYGEN_BIT_KHR));
 
-	mShaderBindingTable.AddStageToMissGroup(rayMissShader.GetShaderStage(VK_SHADER_STAGE_MISS_BIT_KHR), SWS_PRIMARY_MISS_SHADERS_IDX);
-	mShaderBindingTable.AddStageToMissGroup(indirectMissShader.GetShaderStage(VK_SHADER_STAGE_MISS_BIT_KHR), SWS_INDIRECT_MISS_SHADERS_IDX);
-	mShaderBindingTable.AddStageToMissGroup(shadowMiss.GetShaderStage(VK_SHADER_STAGE_MISS_BIT_KHR), SWS_SHADOW_MISS_SHADERS_IDX);
+	set.sbt.AddStageToHitGroup({ rayChitShader.GetShaderStage(VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR), 
+		rayAhitShader.GetShaderStage(VK_SHADER_STAGE_ANY_HIT_BIT_KHR) }, SWS_PRIMARY_HIT_SHADERS_IDX);
+
+	set.sbt.AddStageToHitGroup({ indirectChitShader.GetShaderStage(VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR) }, SWS_INDIRECT_HIT_SHADERS_IDX);
+	set.sbt.AddStageToHitGroup({ shadowAhit.GetShaderStage(VK_SHADER_STAGE_ANY_HIT_BIT_KHR) }, SWS_SHADOW_HIT_SHADERS_IDX);
+
+	// the same again for spheres & capsules, with the intersection shader that finds their surface in the AABBs
+	set.sbt.AddStageToHitGroup({ rayChitShader.GetShaderStage(VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR),
+		rayAhitShader.GetShaderStage(VK_SHADER_STAGE_ANY_HIT_BIT_KHR),
+		analyticRintShader.GetShaderStage(VK_SHADER_STAGE_INTERSECTION_BIT_KHR) }, SWS_NUM_HIT_GROUPS + SWS_PRIMARY_HIT_SHADERS_IDX);
+	set.sbt.AddStageToHitGroup({ indirectChitShader.GetShaderStage(VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR),
+		analyticRintShader.GetShaderStage(VK_SHADER_STAGE_INTERSECTION_BIT_KHR) }, SWS_NUM_HIT_GROUPS + SWS_INDIRECT_HIT_SHADERS_IDX);
+	set.sbt.AddStageToHitGroup({ shadowAhit.GetShaderStage(VK_SHADER_STAGE_ANY_HIT_BIT_KHR),
+		analyticRintShader.GetShaderStage(VK_SHADER_STAGE_INTERSECTION_BIT_KHR) }, SWS_NUM_HIT_GROUPS + SWS_SHADOW_HIT_SHADERS_IDX);
+
+	set.sbt.AddStageToMissGroup(rayMissShader.GetShaderStage(VK_SHADER_STAGE_MISS_BIT_KHR), SWS_PRIMARY_MISS_SHADERS_IDX);
+	set.sbt.AddStageToMissGroup(indirectMissShader.GetShaderStage(VK_SHADER_STAGE_MISS_BIT_KHR), SWS_INDIRECT_MISS_SHADERS_IDX);
+	set.sbt.AddStageToMissGroup(shadowMiss.GetShaderStage(VK_SHADER_STAGE_MISS_BIT_KHR), SWS_SHADOW_MISS_SHADERS_IDX);
+
+	const SBTHelper& sbt = set.sbt;
+	set.variants.Initialize(mDevice, [this, &sbt](const VkSpecializationInfo& specialization, PipelineVariantCache::Variant& variant) {
+		return this->CreateRaytracingPipelineVariant(sbt, specialization, variant);
+	});
+	return true;
+}
 
+bool RayTracerApp::CreateRaytracingPipelineVariant(const SBTHelper& sbt, const VkSpecializationInfo& specialization, PipelineVariantCache::Variant& variant) {
+	// same stages as the SBT helper's, all of them specialized the same way
+	Array<VkPipelineShaderStageCreateInfo> stages(sbt.GetStages(), sbt.GetStages() + sbt.GetNumStages());
+	for (VkPipelineShaderStageCreateInfo& stage : stages) {
+		stage.pSpecializationInfo = &specialization;
+	}
 
     VkRayTracingPipelineCreateInfoKHR rayPipelineInfo = {};
     rayPipelineInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR;
-    rayPipelineInfo.stageCount = mShaderBindingTable.GetNumStages();
-    rayPipelineInfo.pStages = mShaderBindingTable.GetStages();
-    rayPipelineInfo.groupCount = mShaderBindingTable.GetNumGroups(); // 1-raygen, n-miss, n-(hit[+anyhit+intersect])
-    rayPipelineInfo.pGroups = mShaderBindingTable.GetGroups();
-    rayPipelineInfo.maxRecursionDepth = 1;
+    rayPipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+    rayPipelineInfo.pStages = stages.data();
+    rayPipelineInfo.groupCount = sbt.GetNumGroups(); // 1-raygen, n-miss, n-(hit[+anyhit+intersect])
+    rayPipelineInfo.pGroups = sbt.GetGroups();
+    rayPipelineInfo.maxRecursionDepth = 2; // ray tracer mode shoots shadow rays from its closest hit, path tracer rays never recurse
     rayPipelineInfo.layout = mRTPipelineLayout;
     rayPipelineInfo.libraries.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
 
-    error = vkCreateRayTracingPipelinesKHR(mDevice, VK_NULL_HANDLE, 1, &rayPipelineInfo, VK_NULL_HANDLE, &mRTPipeline);
-    CHECK_VK_ERROR(error, "vkCreateRayTracingPipelinesKHR");
+    const VkResult error = vkCreateRayTracingPipelinesKHR(mDevice, VK_NULL_HANDLE, 1, &rayPipelineInfo, VK_NULL_HANDLE, &variant.pipeline);
+    if (VK_SUCCESS != error) {
+        printf("vkCreateRayTracingPipelinesKHR failed (%d)\n", static_cast<int>(error));
+        return false;
+    }
+
+    if (!sbt.CreateSBT(mDevice, variant.pipeline, variant.sbt)) {
+        return false;
+    }
 
-    mShaderBindingTable.CreateSBT(mDevice, mRTPipeline);
+    // the meshes in so far, the ones after get written as they arrive (WriteMeshHitRecord)
+    std::lock_guard<std::mutex> lock(mHitRecordsMutex);
+    sbt.WriteHitRecords(variant.sbt, 0, mNumHitRecords, mHitRecords.data(), sizeof(HitRecordData));
+    return true;
 }
 
 void RayTracerApp::UpdateDescriptorSets() {
-	const uint32_t numMeshes = static_cast<uint32_t>(mScene.meshes.size());
+	// set 0 only, the per-mesh arrays are the registry's (CreateDescriptorSetsLayouts)
     std::vector<VkDescriptorPoolSize> poolSizes({
         { VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1 },       // top-level AS
-        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },                    // output image
-		 { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 },                   //  Camera uniform & general uniform
-	    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, numMeshes * 3 },       // vertex attribs+faces+infos for each mesh
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2 + SWS_NUM_AOVS },     // output & radiance images + AOVs
+		 { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2 },           //  Camera uniform & general uniform
+	    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 },                   // emissive triangles, light BVH, materials, texture slots & use
 																	
 		});
 
@@ -870,7 +1837,7 @@ void RayTracerApp::UpdateDescriptorSets() {
     descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     descriptorPoolCreateInfo.pNext = nullptr;
     descriptorPoolCreateInfo.flags = 0;
-	descriptorPoolCreateInfo.maxSets =  SWS_NUM_SETS;
+	descriptorPoolCreateInfo.maxSets = 1;
     descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     descriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
 
@@ -879,29 +1846,21 @@ void RayTracerApp::UpdateDescriptorSets() {
 
 	mRTDescriptorSets.resize(SWS_NUM_SETS);
 
-	Array<uint32_t> variableDescriptorCounts({
-		1,
-		numMeshes,      // vertex attribs for each mesh
-		numMeshes,      // faces buffer for each mesh
-		numMeshes,      // infos buffer for each mesh
-		});
-
-	VkDescriptorSetVariableDescriptorCountAllocateInfo variableDescriptorCountInfo;
-	variableDescriptorCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
-	variableDescriptorCountInfo.pNext = nullptr;
-	variableDescriptorCountInfo.descriptorSetCount = SWS_NUM_SETS;
-	variableDescriptorCountInfo.pDescriptorCounts = variableDescriptorCounts.data(); // actual number of descriptors
-
 	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
 	descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	descriptorSetAllocateInfo.pNext = &variableDescriptorCountInfo;
+	descriptorSetAllocateInfo.pNext = nullptr;
 	descriptorSetAllocateInfo.descriptorPool = mRTDescriptorPool;
-	descriptorSetAllocateInfo.descriptorSetCount = SWS_NUM_SETS;
-	descriptorSetAllocateInfo.pSetLayouts = mRTDescriptorSetsLayouts.data();
+	descriptorSetAllocateInfo.descriptorSetCount = 1;
+	descriptorSetAllocateInfo.pSetLayouts = &mRTDescriptorSetsLayouts[SWS_SCENE_AS_SET];
 
-	error = vkAllocateDescriptorSets(mDevice, &descriptorSetAllocateInfo, mRTDescriptorSets.data());
+	error = vkAllocateDescriptorSets(mDevice, &descriptorSetAllocateInfo, &mRTDescriptorSets[SWS_SCENE_AS_SET]);
     CHECK_VK_ERROR(error, "vkAllocateDescriptorSets");
 
+	mRTDescriptorSets[SWS_ATTRIBS_SET] = mBindless.GetSet(mAttribsTable);
+	mRTDescriptorSets[SWS_FACES_SET] = mBindless.GetSet(mFacesTable);
+	mRTDescriptorSets[SWS_MESHINFO_SET] = mBindless.GetSet(mMeshInfoTable);
+	mRTDescriptorSets[SWS_TEXTURES_SET] = mBindless.GetSet(mTexturesTable);
+
     ///////////////////////////////////////////////////////////
 
     VkWriteDescriptorSetAccelerationStructureKHR descriptorAccelerationStructureInfo;
@@ -942,48 +1901,10 @@ void RayTracerApp::UpdateDescriptorSets() {
     resultImageWrite.pTexelBufferView = nullptr;
 	///////////////////////////////////////////////////////////
 
-	VkWriteDescriptorSet attribsBufferWrite;
-	attribsBufferWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	attribsBufferWrite.pNext = nullptr;
-	attribsBufferWrite.dstSet = mRTDescriptorSets[SWS_ATTRIBS_SET];
-	attribsBufferWrite.dstBinding = 0;
-	attribsBufferWrite.dstArrayElement = 0;
-	attribsBufferWrite.descriptorCount = numMeshes;
-	attribsBufferWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	attribsBufferWrite.pImageInfo = nullptr;
-	attribsBufferWrite.pBufferInfo = mScene.attribsBufferInfos.data();
-	attribsBufferWrite.pTexelBufferView = nullptr;
-	///////////////////////////////////////////////////////////
-	VkWriteDescriptorSet facesBufferWrite;
-	facesBufferWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	facesBufferWrite.pNext = nullptr;
-	facesBufferWrite.dstSet = mRTDescriptorSets[SWS_FACES_SET];
-	facesBufferWrite.dstBinding = 0;
-	facesBufferWrite.dstArrayElement = 0;
-	facesBufferWrite.descriptorCount = numMeshes;
-	facesBufferWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	facesBufferWrite.pImageInfo = nullptr;
-	facesBufferWrite.pBufferInfo = mScene.facesBufferInfos.data();
-	facesBufferWrite.pTexelBufferView = nullptr;
-
-	/////////////////////////////////////////////////////////// 
-	VkWriteDescriptorSet meshInfoBufferWrite;
-	meshInfoBufferWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	meshInfoBufferWrite.pNext = nullptr;
-	meshInfoBufferWrite.dstSet = mRTDescriptorSets[SWS_MESHINFO_SET];
-	meshInfoBufferWrite.dstBinding = 0;
-	meshInfoBufferWrite.dstArrayElement = 0;
-	meshInfoBufferWrite.descriptorCount = numMeshes;
-	meshInfoBufferWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	meshInfoBufferWrite.pImageInfo = nullptr;
-	meshInfoBufferWrite.pBufferInfo = mScene.meshInfoBufferInfos.data();
-	meshInfoBufferWrite.pTexelBufferView = nullptr;
-
-	/////////////////////////////////////////////////////////// 
 	VkDescriptorBufferInfo camdataBufferInfo;
 	camdataBufferInfo.buffer = mCameraBuffer.GetBuffer();
 	camdataBufferInfo.offset = 0;
-	camdataBufferInfo.range = mCameraBuffer.GetSize();
+	camdataBufferInfo.range = sizeof(CameraUniformParams);   // one slot, FillCommandBuffer picks which
 
 	VkWriteDescriptorSet camdataBufferWrite;
 	camdataBufferWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -992,7 +1913,7 @@ void RayTracerApp::UpdateDescriptorSets() {
 	camdataBufferWrite.dstBinding = SWS_CAMDATA_BINDING;
 	camdataBufferWrite.dstArrayElement = 0;
 	camdataBufferWrite.descriptorCount = 1;
-	camdataBufferWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	camdataBufferWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	camdataBufferWrite.pImageInfo = nullptr;
 	camdataBufferWrite.pBufferInfo = &camdataBufferInfo;
 	camdataBufferWrite.pTexelBufferView = nullptr;
@@ -1000,7 +1921,7 @@ void RayTracerApp::UpdateDescriptorSets() {
 	VkDescriptorBufferInfo uniformParamsBufferInfo;
 	uniformParamsBufferInfo.buffer = mUniformParamsBuffer.GetBuffer();
 	uniformParamsBufferInfo.offset = 0;
-	uniformParamsBufferInfo.range = mUniformParamsBuffer.GetSize();
+	uniformParamsBufferInfo.range = sizeof(UniformParams);
 
 	VkWriteDescriptorSet uniformParamsBufferWrite;
 	uniformParamsBufferWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1009,51 +1930,733 @@ void RayTracerApp::UpdateDescriptorSets() {
 	uniformParamsBufferWrite.dstBinding = SWS_UNIFORMPARAMS_BINDING;
 	uniformParamsBufferWrite.dstArrayElement = 0;
 	uniformParamsBufferWrite.descriptorCount = 1;
-	uniformParamsBufferWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uniformParamsBufferWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uniformParamsBufferWrite.pImageInfo = nullptr;
 	uniformParamsBufferWrite.pBufferInfo = &uniformParamsBufferInfo;
 	uniformParamsBufferWrite.pTexelBufferView = nullptr;
 	///////////////////////////////////////////////////////////
+	VkDescriptorImageInfo aovImageInfos[SWS_NUM_AOVS];
+	VkWriteDescriptorSet aovImageWrites[SWS_NUM_AOVS];
+	for (uint32_t i = 0; i < SWS_NUM_AOVS; ++i) {
+		aovImageInfos[i] = descriptorOutputImageInfo;
+		aovImageInfos[i].imageView = mAOVImages[i].GetImageView();
+
+		aovImageWrites[i] = resultImageWrite;
+		aovImageWrites[i].dstSet = mRTDescriptorSets[SWS_AOV_SET];
+		aovImageWrites[i].dstBinding = SWS_AOV_FIRST_BINDING + i;
+		aovImageWrites[i].pImageInfo = &aovImageInfos[i];
+	}
 
+	VkDescriptorImageInfo radianceImageInfo = descriptorOutputImageInfo;
+	radianceImageInfo.imageView = mRadianceImage.GetImageView();
+
+	VkWriteDescriptorSet radianceImageWrite = resultImageWrite;
+	radianceImageWrite.dstSet = mRTDescriptorSets[SWS_RADIANCE_IMAGE_SET];
+	radianceImageWrite.dstBinding = SWS_RADIANCE_IMAGE_BINDING;
+	radianceImageWrite.pImageInfo = &radianceImageInfo;
+	///////////////////////////////////////////////////////////
     Array<VkWriteDescriptorSet> descriptorWrites({
         accelerationStructureWrite,
         resultImageWrite,
-		//
-	   attribsBufferWrite,
-	   //
-	   facesBufferWrite,
-	   //
-	   meshInfoBufferWrite,
 	   //
 	   camdataBufferWrite,
 	   //
 	   uniformParamsBufferWrite,
+	   //
+	   radianceImageWrite,
     });
+	descriptorWrites.insert(descriptorWrites.end(), aovImageWrites, aovImageWrites + SWS_NUM_AOVS);
 
     vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, VK_NULL_HANDLE);
+
+	this->WriteLightsDescriptors();
+	this->WriteMaterialsDescriptors();
+	this->WriteTexturesDescriptors();
+}
+
+void RayTracerApp::WriteMeshDescriptors(const size_t meshIdx) {
+	// one write per table, at the mesh's slot
+	const uint32_t slot = mScene.meshes[meshIdx].slot;
+	mBindless.WriteBuffer(mAttribsTable, slot, mScene.attribsBufferInfos[meshIdx]);
+	mBindless.WriteBuffer(mFacesTable, slot, mScene.facesBufferInfos[meshIdx]);
+	mBindless.WriteBuffer(mMeshInfoTable, slot, mScene.meshInfoBufferInfos[meshIdx]);
 }
 
+void RayTracerApp::WriteMeshHitRecord(const size_t meshIdx) {
+	const RTMesh& mesh = mScene.meshes[meshIdx];
+	{
+		std::lock_guard<std::mutex> lock(mHitRecordsMutex);
+		mHitRecords[mesh.record] = mesh.hitRecord;
+		mNumHitRecords = std::max(mNumHitRecords, mesh.record + 1);
+	}
 
-///////////////////////////// SBT Helper class/////////////////////////////////////////////////
+	// nothing in flight reads the record of a mesh that isn't in the TLAS yet
+	if (mRTPipelineSet) {
+		const SBTHelper& sbt = mRTPipelineSet->sbt;
+		mRTPipelineSet->variants.ForEach([&sbt, &mesh](PipelineVariantCache::Variant& variant) {
+			sbt.WriteHitRecords(variant.sbt, mesh.record, 1, &mesh.hitRecord, sizeof(HitRecordData));
+		});
+	}
+}
+
+void RayTracerApp::WriteHitRecords(RTPipelineSet& set) {
+	std::lock_guard<std::mutex> lock(mHitRecordsMutex);
+	const SBTHelper& sbt = set.sbt;
+	set.variants.ForEach([this, &sbt](PipelineVariantCache::Variant& variant) {
+		sbt.WriteHitRecords(variant.sbt, 0, mNumHitRecords, mHitRecords.data(), sizeof(HitRecordData));
+	});
+}
+
+void RayTracerApp::WriteLightsDescriptors() {
+	if (mRTDescriptorSets.empty()) {
+		return;
+	}
+
+	VkDescriptorBufferInfo lightsBufferInfo;
+	lightsBufferInfo.buffer = mScene.lightsBuffer.GetBuffer();
+	lightsBufferInfo.offset = 0;
+	lightsBufferInfo.range = mScene.lightsBuffer.GetSize();
+
+	VkWriteDescriptorSet lightsBufferWrite;
+	lightsBufferWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	lightsBufferWrite.pNext = nullptr;
+	lightsBufferWrite.dstSet = mRTDescriptorSets[SWS_LIGHTS_SET];
+	lightsBufferWrite.dstBinding = SWS_LIGHTS_BINDING;
+	lightsBufferWrite.dstArrayElement = 0;
+	lightsBufferWrite.descriptorCount = 1;
+	lightsBufferWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	lightsBufferWrite.pImageInfo = nullptr;
+	lightsBufferWrite.pBufferInfo = &lightsBufferInfo;
+	lightsBufferWrite.pTexelBufferView = nullptr;
+
+	VkDescriptorBufferInfo lightNodesBufferInfo;
+	lightNodesBufferInfo.buffer = mScene.lightNodesBuffer.GetBuffer();
+	lightNodesBufferInfo.offset = 0;
+	lightNodesBufferInfo.range = mScene.lightNodesBuffer.GetSize();
+
+	VkWriteDescriptorSet lightNodesBufferWrite = lightsBufferWrite;
+	lightNodesBufferWrite.dstBinding = SWS_LIGHT_NODES_BINDING;
+	lightNodesBufferWrite.pBufferInfo = &lightNodesBufferInfo;
+
+	const VkWriteDescriptorSet descriptorWrites[] = { lightsBufferWrite, lightNodesBufferWrite };
+	vkUpdateDescriptorSets(mDevice, 2, descriptorWrites, 0, VK_NULL_HANDLE);
+}
+
+void RayTracerApp::WriteMaterialsDescriptors() {
+	if (mRTDescriptorSets.empty()) {
+		return;
+	}
 
-static uint32_t AlignUp(const uint32_t value, const uint32_t align) {
-    return (value + align - 1) & ~(align - 1);
+	VkDescriptorBufferInfo materialsBufferInfo;
+	materialsBufferInfo.buffer = mScene.materialsBuffer.GetBuffer();
+	materialsBufferInfo.offset = 0;
+	materialsBufferInfo.range = mScene.materialsBuffer.GetSize();
+
+	VkWriteDescriptorSet materialsBufferWrite;
+	materialsBufferWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	materialsBufferWrite.pNext = nullptr;
+	materialsBufferWrite.dstSet = mRTDescriptorSets[SWS_MATERIALS_SET];
+	materialsBufferWrite.dstBinding = SWS_MATERIALS_BINDING;
+	materialsBufferWrite.dstArrayElement = 0;
+	materialsBufferWrite.descriptorCount = 1;
+	materialsBufferWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	materialsBufferWrite.pImageInfo = nullptr;
+	materialsBufferWrite.pBufferInfo = &materialsBufferInfo;
+	materialsBufferWrite.pTexelBufferView = nullptr;
+
+	vkUpdateDescriptorSets(mDevice, 1, &materialsBufferWrite, 0, VK_NULL_HANDLE);
 }
 
-SBTHelper::SBTHelper()
-    : mShaderHandleSize(0u)
-    , mShaderGroupAlignment(0u)
-    , mNumHitGroups(0u)
-    , mNumMissGroups(0u) {
+void RayTracerApp::WriteTexturesDescriptors() {
+	if (mRTDescriptorSets.empty()) {
+		return;
+	}
+
+	// both buffers live as long as the cache, the slots' images are written by the cache itself
+	const vulkanhelpers::Buffer* buffers[] = { &mTextures.GetSlotsBuffer(), &mTextures.GetUseBuffer() };
+	const uint32_t bufferBindings[] = { SWS_TEXTURE_SLOTS_BINDING, SWS_TEXTURE_USE_BINDING };
+
+	VkDescriptorBufferInfo bufferInfos[2];
+	VkWriteDescriptorSet bufferWrites[2];
+	for (size_t i = 0; i < 2; ++i) {
+		bufferInfos[i].buffer = buffers[i]->GetBuffer();
+		bufferInfos[i].offset = 0;
+		bufferInfos[i].range = buffers[i]->GetSize();
+
+		bufferWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		bufferWrites[i].pNext = nullptr;
+		bufferWrites[i].dstSet = mRTDescriptorSets[SWS_SCENE_AS_SET];
+		bufferWrites[i].dstBinding = bufferBindings[i];
+		bufferWrites[i].dstArrayElement = 0;
+		bufferWrites[i].descriptorCount = 1;
+		bufferWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bufferWrites[i].pImageInfo = nullptr;
+		bufferWrites[i].pBufferInfo = &bufferInfos[i];
+		bufferWrites[i].pTexelBufferView = nullptr;
+	}
+
+	vkUpdateDescriptorSets(mDevice, 2, bufferWrites, 0, VK_NULL_HANDLE);
+}
+
+void RayTracerApp::CreateAOVImages() {
+	const VkExtent3D extent = { mSettings.resolutionX, mSettings.resolutionY, 1 };
+	const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	const VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+	MemoryTracker::Scope memoryScope(MemoryCategory::Image, "AOVs");
+	for (uint32_t i = 0; i < SWS_NUM_AOVS; ++i) {
+		VkResult error = mAOVImages[i].Create(VK_IMAGE_TYPE_2D, sAOVFormats[i], extent, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CHECK_VK_ERROR(error, "AOV image Create");
+
+		error = mAOVImages[i].CreateImageView(VK_IMAGE_VIEW_TYPE_2D, sAOVFormats[i], range);
+		CHECK_VK_ERROR(error, "AOV image CreateImageView");
+	}
+
+	MemoryTracker::Scope radianceScope(MemoryCategory::Image, "radiance");
+	VkResult error = mRadianceImage.Create(VK_IMAGE_TYPE_2D, VK_FORMAT_R32G32B32A32_SFLOAT, extent, VK_IMAGE_TILING_OPTIMAL, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CHECK_VK_ERROR(error, "radiance image Create");
+
+	error = mRadianceImage.CreateImageView(VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R32G32B32A32_SFLOAT, range);
+	CHECK_VK_ERROR(error, "radiance image CreateImageView");
 }
 
-void SBTHelper::Initialize(const uint32_t numHitGroups, const uint32_t numMissGroups, const uint32_t shaderHandleSize, const uint32_t shaderGroupAlignment) {
-    mShaderHandleSize = shaderHandleSize;
-    mShaderGroupAlignment = shaderGroupAlignment;
-    mNumHitGroups = numHitGroups;
-    mNumMissGroups = numMissGroups;
+void RayTracerApp::ClearRadianceImage() {
+	// it accumulates across frames, so unlike the AOVs it's never discarded: into GENERAL once, and cleared so
+	// the first readback doesn't hand the denoiser garbage
+	VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+	commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferAllocateInfo.commandPool = mCommandPool;
+	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferAllocateInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	VkResult error = vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &commandBuffer);
+	CHECK_VK_ERROR(error, "vkAllocateCommandBuffers");
+
+	VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+	commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	const VkClearColorValue black = {};
+
+	vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+	vulkanhelpers::ImageBarrier(commandBuffer,
+		mRadianceImage.GetImage(),
+		subresourceRange,
+		0,
+		VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_GENERAL);
+	vkCmdClearColorImage(commandBuffer, mRadianceImage.GetImage(), VK_IMAGE_LAYOUT_GENERAL, &black, 1, &subresourceRange);
+	vulkanhelpers::ImageBarrier(commandBuffer,
+		mRadianceImage.GetImage(),
+		subresourceRange,
+		VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_GENERAL,
+		VK_IMAGE_LAYOUT_GENERAL);
+	vkEndCommandBuffer(commandBuffer);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	error = vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	CHECK_VK_ERROR(error, "vkQueueSubmit");
+	vkQueueWaitIdle(mGraphicsQueue);
+
+	vkFreeCommandBuffers(mDevice, mCommandPool, 1, &commandBuffer);
+}
+
+uint32_t RayTracerApp::GetActiveAOVMask() const {
+	// nobody reads the AOVs back - don't waste bandwidth on them
+	uint32_t mask = (mCaptureEnabled && mCapture.GetFormat() == ImageWriter::Format::Exr) ? mAOVMask : 0u;
+	if (mDenoiserEnabled) {
+		mask |= SWS_AOV_ALBEDO_BIT | SWS_AOV_DEPTH_BIT | SWS_AOV_NORMAL_BIT | SWS_AOV_INSTANCE_ID_BIT;
+	}
+	return mask;
+}
+
+void RayTracerApp::ConsumeReadback(FrameReadback::Frame& frame) {
+	// intermediate headless passes are still accumulating, only the adaptive sampling looks at them
+	if (frame.hasData && !frame.isFinalSample && mBatch.NeedsSnapshot(frame.frameIndex)) {
+		const size_t numPixels = static_cast<size_t>(mSettings.resolutionX) * mSettings.resolutionY;
+		mBatch.AddSnapshot(reinterpret_cast<const uint8_t*>(frame.color.Map()), numPixels, frame.frameIndex, frame.passIndex);
+		frame.color.Unmap();
+	}
+	if (frame.hasData && frame.isFinalSample) {
+		ImageWriter::Frame* capture = nullptr;
+		if (mCaptureEnabled) {
+			// batch frames are named after their place in the sequence, so a resumed render fills the gaps
+			const uint32_t outputIndex = mSettings.headless ? frame.frameIndex : mCapture.GetNumCaptured();
+			capture = mCapture.Capture(frame, outputIndex, mDenoiserEnabled);
+		}
+		if (mDenoiserEnabled) {
+			// the capture is finished (and submitted) by the denoiser
+			this->DenoiseFrame(frame, capture);
+		} else if (capture) {
+			mCapture.Submit(capture);
+		}
+	}
+	// this slot's command buffer shows whatever the denoiser has finished by now
+	if (mDenoiserEnabled) {
+		mReadback.UploadDenoised(frame);
+	}
+	frame.hasData = false;
+}
+
+void RayTracerApp::FlushFrames() {
+	// the last frames in flight never get their slot reused, consume them oldest first
+	const size_t numFrames = mReadback.GetNumFrames();
+	for (size_t i = 0; i < numFrames; ++i) {
+		this->ConsumeReadback(mReadback.GetFrame((mNumSubmittedFrames + i) % numFrames));
+	}
+
+	// it submits the captures it denoises
+	mDenoiser.WaitIdle();
+	mCapture.WaitIdle();
+}
+
+void RayTracerApp::DenoiseFrame(const FrameReadback::Frame& frame, ImageWriter::Frame* capture) {
+	PROFILE_ZONE("DenoiseFrame");
+	// interactively a frame that finds the denoiser busy is skipped, the next one is a better estimate anyway.
+	// A capture can't skip, it waits for the previous one instead
+	Denoiser::GBuffer* input = mDenoiser.AcquireInput(capture != nullptr);
+	if (!input) {
+		return;
+	}
+	mReadback.FillDenoiserInput(frame, *input);
+
+	mDenoiser.Submit([this, capture](const Denoiser& denoiser, const bool current) {
+		this->PublishDenoisedFrame(denoiser, current, capture);
+	});
+}
+
+void RayTracerApp::PublishDenoisedFrame(const Denoiser& denoiser, const bool current, ImageWriter::Frame* capture) {
+	// on the denoiser's thread. Filtered from a history the camera has left since, it's not worth showing
+	if (current) {
+		mReadback.PublishDenoised(denoiser);
+	}
+	if (capture) {
+		mCapture.AddDenoised(capture, denoiser, mReadback);
+		mCapture.Submit(capture);
+	}
+
+	const uint64_t numDenoised = mDenoiser.GetNumDenoisedFrames();
+	if ((numDenoised % 60) == 0) {
+		printf("Denoiser: %.2f ms on %u threads, %u frames accumulated, %llu frames denoised\n",
+			denoiser.GetLastDenoiseTime(),
+			static_cast<uint32_t>(mThreadPool.GetNumThreads()),
+			denoiser.GetNumAccumulatedFrames(),
+			static_cast<unsigned long long>(numDenoised));
+	}
+}
+
+void RayTracerApp::ToggleDenoiser() {
+	mDenoiserEnabled = !mDenoiserEnabled;
+	if (mDenoiserEnabled && !mDenoiser.IsInitialized()) {
+		mDenoiser.Initialize(mSettings.resolutionX, mSettings.resolutionY, &mThreadPool);
+	}
+	mDenoiser.ResetHistory();
+
+	this->RebuildReadback();
+}
+
+void RayTracerApp::ToggleCapture() {
+	mCaptureEnabled = !mCaptureEnabled;
+	if (mCaptureEnabled) {
+		this->InitCapture();
+		printf("Capturing frames to %s\n", mSettings.outputFolder.c_str());
+	}
+
+	this->RebuildReadback();
+}
+
+void RayTracerApp::InitCapture() {
+	mCapture.Initialize(mSettings.outputFolder, mSettings.outputFormat, mSettings.resolutionX, mSettings.resolutionY,
+		IsBGRA(mSurfaceFormat.format), &mThreadPool);
+}
+
+void RayTracerApp::InitHeadlessCapture() {
+	// headless runs exist to produce files, so capture is always on there.
+	// Called from InitApp, the command buffers get recorded with the copies right after
+	mCaptureEnabled = true;
+	this->InitCapture();
+	mReadback.Create(this->GetNumFramesInFlight());
+	this->InitBatch();
+}
+
+void RayTracerApp::InitBatch() {
+	BatchRender::Settings batch;
+	// every logged frame of a replay becomes one written frame
+	batch.numFrames = mSettings.replayFile.empty() ? mSettings.headlessFrames : static_cast<uint32_t>(mRecording.GetNumFrames());
+	batch.maxPasses = mSettings.headlessSamples;
+	batch.errorThreshold = mSettings.errorThreshold;
+	batch.cameraPath = mSettings.cameraPath;
+	batch.frameRate = mSettings.frameRate;
+	batch.resume = mSettings.resume;
+	batch.outputFolder = mSettings.outputFolder;
+	batch.extension = ImageWriter::GetExtension(mCapture.GetFormat());
+	mBatch.Initialize(batch);
+	mSettings.headlessFrames = mBatch.GetNumFrames();
+}
+
+void RayTracerApp::BeginBatchPass() {
+	// the first pass of a frame moves the camera, passes after it accumulate at the same spot
+	if (mBatch.BeginPass()) {
+		if (!mSettings.replayFile.empty()) {
+			this->MarkReplayFrame();
+		}
+		CameraPath::Key key;
+		if (mBatch.GetCameraKey(key)) {
+			mCamera.SetFovY(key.fovY);
+			mCamera.LookAt(vec3(key.position[0], key.position[1], key.position[2]), vec3(key.target[0], key.target[1], key.target[2]));
+		}
+	}
+}
+
+bool RayTracerApp::IsHeadlessFinished() const {
+	return mBatch.IsFinished();
+}
+
+void RayTracerApp::InitSession() {
+	if (!mSettings.replayFile.empty()) {
+		if (mRecording.Load(mSettings.replayFile)) {
+			printf("Replaying %u frames from %s\n", static_cast<uint32_t>(mRecording.GetNumFrames()), mSettings.replayFile.c_str());
+		} else {
+			printf("Replay failed to load, nothing to replay\n");
+		}
+	} else if (!mSettings.recordFile.empty()) {
+		printf("Recording the session to %s\n", mSettings.recordFile.c_str());
+	}
+}
+
+void RayTracerApp::FinishSession() {
+	if (!mSettings.replayFile.empty()) {
+		// the device is idle by now, which closes the last frame's time
+		this->MarkReplayFrame();
+		mReplayTimings.Print("Replay");
+		if (!mSettings.timingsFile.empty() && mReplayTimings.SaveCsv(mSettings.timingsFile)) {
+			printf("Replay timings written to %s\n", mSettings.timingsFile.c_str());
+		}
+	}
+	if (!mSettings.recordFile.empty() && mRecording.Save(mSettings.recordFile)) {
+		printf("Recorded %u frames to %s\n", static_cast<uint32_t>(mRecording.GetNumFrames()), mSettings.recordFile.c_str());
+	}
+}
+
+const SessionRecording::Frame* RayTracerApp::GetReplayFrame() const {
+	if (mSettings.replayFile.empty()) {
+		return nullptr;
+	}
+	// headless replays write one frame per logged one, whatever the number of passes it takes
+	const size_t index = mSettings.headless ? mBatch.GetFrame() : mReplayFrame;
+	return (index < mRecording.GetNumFrames()) ? &mRecording.GetFrame(index) : nullptr;
+}
 
-    mNumHitShaders.resize(numHitGroups, 0u);
+void RayTracerApp::MarkReplayFrame() {
+	// a frame's time runs from its setup to the next frame's, so it covers everything the loop did for it
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (mReplayFrameStarted) {
+		mReplayTimings.AddFrame(std::chrono::duration<double, std::milli>(now - mReplayFrameStart).count());
+	}
+	mReplayFrameStart = now;
+	mReplayFrameStarted = true;
+}
+
+void RayTracerApp::CycleEmittersMode() {
+	static const char* modeNames[SWS_NUM_EMITTERS_MODES] = { "off", "power", "light BVH" };
+
+	mEmittersMode = (mEmittersMode + 1) % SWS_NUM_EMITTERS_MODES;
+	mDenoiser.ResetHistory();
+	printf("Emitters sampling: %s\n", modeNames[mEmittersMode]);
+}
+
+void RayTracerApp::RebuildReadback() {
+	// command buffers are pre-recorded, so wait for them before re-recording with (or without) the copies
+	vkDeviceWaitIdle(mDevice);
+
+	const bool needReadback = mDenoiserEnabled || mCaptureEnabled;
+	if (needReadback && mReadback.IsEmpty()) {
+		mReadback.Create(this->GetNumFramesInFlight());
+	} else if (!needReadback) {
+		mReadback.Destroy();
+	}
+	for (size_t i = 0; i < mReadback.GetNumFrames(); ++i) {
+		mReadback.GetFrame(i).hasData = false;
+	}
+
+	this->FillCommandBuffers();
+}
+
+void RayTracerApp::SetQualityPreset(const size_t preset) {
+	mQualityPreset = preset;
+	mQuality = sQualityPresets[preset].settings;
+	mQualityEdit = mQuality;
+	mResetAccumulation = true;
+	mDenoiser.ResetHistory();
+	printf("Quality: %s\n", sQualityPresets[preset].name);
+}
+
+void RayTracerApp::CycleQualityPreset() {
+	// from edited settings it starts over at the first one
+	this->SetQualityPreset((mQualityPreset < sNumQualityPresets) ? (mQualityPreset + 1) % sNumQualityPresets : 0);
+}
+
+bool RayTracerApp::SelectPipelineVariant() {
+	// in constant_id order, see SWS_SC_*
+	const Array<uint32_t> key = {
+		static_cast<uint32_t>(mode),
+		mQuality.antialiasingSamples,
+		mQuality.pathsPerSample,
+		mQuality.maxPathDepth,
+		mQuality.rouletteMinDepth,
+		mQuality.shadowSamples,
+		mQuality.maxReflections
+	};
+	if (key == mRTPipelineKey) {
+		return true;
+	}
+
+	// a failed variant isn't asked for again until the settings change, the previous one keeps rendering
+	mRTPipelineKey = key;
+	{
+		std::lock_guard<std::mutex> lock(mReloadMutex);
+		mReloadKey = key;
+	}
+	const PipelineVariantCache::Variant* variant = mRTPipelineSet->variants.Get(key);
+	if (!variant) {
+		printf("Couldn't create the pipeline variant, keeping the previous one\n");
+		return false;
+	}
+
+	const bool recorded = (mRTPipeline != nullptr);
+	mRTPipeline = variant;
+	if (recorded) {
+		// command buffers are pre-recorded with the pipeline & its SBT
+		vkDeviceWaitIdle(mDevice);
+		this->FillCommandBuffers();
+	}
+	return true;
+}
+
+void RayTracerApp::StartShaderHotReload() {
+	Array<ShaderWatcher::Source> sources;
+	for (size_t i = 0; i < sNumRTShaders; ++i) {
+		sources.push_back({ sRTShaders[i].name, sRTShaders[i].stage });
+	}
+	const Array<String> includes = { "../shared.h", "random.glsl", "lights.glsl", "hitrecord.glsl", "textures.glsl" };
+
+	mShaderWatcher.Start(sShaderCompiler, sShaderSourcesFolder, sReloadedShadersFolder, sources, includes,
+		[this](const ShaderWatcher::Result& result) {
+			this->OnShadersRecompiled(result);
+		});
+}
+
+void RayTracerApp::OnShadersRecompiled(const ShaderWatcher::Result& result) {
+	// a failed compile already said why, the running pipeline just stays
+	if (!result.ok) {
+		return;
+	}
+
+	// watcher's thread: modules, SBT and the variant in use are all built here, the render thread only swaps
+	std::unique_ptr<RTPipelineSet> set(new RTPipelineSet());
+	for (size_t i = 0; i < sNumRTShaders; ++i) {
+		const Array<uint32_t>& spirv = result.spirv[i];
+		if (!set->shaders[i].LoadFromMemory(spirv.data(), spirv.size() * sizeof(uint32_t))) {
+			printf("Hot reload: can't create the %s module, keeping the running pipeline\n", sRTShaders[i].name);
+			return;
+		}
+	}
+	if (!this->InitRaytracingPipelineSet(*set)) {
+		printf("Hot reload: can't create the pipeline, keeping the running one\n");
+		return;
+	}
+
+	Array<uint32_t> key;
+	{
+		std::lock_guard<std::mutex> lock(mReloadMutex);
+		key = mReloadKey;
+	}
+	if (!set->variants.Get(key)) {
+		printf("Hot reload: can't create the pipeline, keeping the running one\n");
+		return;
+	}
+
+	// one that was never swapped in is simply replaced, the GPU never saw it
+	std::lock_guard<std::mutex> lock(mReloadMutex);
+	mReloadedPipelineSet = std::move(set);
+}
+
+void RayTracerApp::SwapReloadedPipelines() {
+	std::unique_ptr<RTPipelineSet> set;
+	{
+		std::lock_guard<std::mutex> lock(mReloadMutex);
+		set = std::move(mReloadedPipelineSet);
+	}
+	if (!set) {
+		return;
+	}
+
+	// built for the key of when the compile finished, if it changed since the variant is made now
+	const PipelineVariantCache::Variant* variant = set->variants.Get(mRTPipelineKey);
+	if (!variant) {
+		printf("Hot reload: can't create the pipeline, keeping the running one\n");
+		return;
+	}
+	// meshes that arrived while it was being built
+	this->WriteHitRecords(*set);
+
+	// the old set goes once nothing in flight uses it, the scene & AS stay as they are
+	vkDeviceWaitIdle(mDevice);
+	mRTPipelineSet = std::move(set);
+	mRTPipeline = variant;
+	this->FillCommandBuffers();
+
+	mResetAccumulation = true;
+	mDenoiser.ResetHistory();
+	printf("Hot reload: ray tracing pipeline swapped\n");
+}
+
+void RayTracerApp::OnDrawOverlay() {
+	this->DrawSamplingOverlay();
+	this->DrawMemoryOverlay();
+}
+
+uint32_t RayTracerApp::GetCameraSamplesPerPixel() const {
+	// every path of the path tracer starts from a camera ray of its own, mode 3 traces nothing
+	switch (mode) {
+	case 1: return mQuality.antialiasingSamples;
+	case 2: return mQuality.antialiasingSamples * mQuality.pathsPerSample;
+	default: return 0;
+	}
+}
+
+void RayTracerApp::DrawSamplingOverlay() {
+	if (!ImGui::CollapsingHeader("Sampling", ImGuiTreeNodeFlags_DefaultOpen)) {
+		return;
+	}
+
+	const uint32_t samplesPerPixel = this->GetCameraSamplesPerPixel();
+	ImGui::Text("%u spp per frame, %.1f accumulated", samplesPerPixel, samplesPerPixel * mAccumulatedFrames);
+
+	// camera rays only, the bounces and shadow rays they lead to aren't counted
+	const float gpuMs = mFrameStatsSummary.gpu.p50;
+	if (gpuMs > 0.0f) {
+		const double raysPerFrame = static_cast<double>(mSettings.resolutionX) * mSettings.resolutionY * samplesPerPixel;
+		ImGui::Text("%.1f M camera rays/s", raysPerFrame / (gpuMs * 1e-3) * 1e-6);
+	}
+
+	ImGui::Text("%u pipeline variants built", static_cast<uint32_t>(mRTPipelineSet->variants.GetNumVariants()));
+
+	if (!mSceneComplete) {
+		uint32_t numSceneMeshes;
+		{
+			std::lock_guard<std::mutex> lock(mSceneMutex);
+			numSceneMeshes = mNumSceneMeshes;
+		}
+		ImGui::Text("loading, %u of %u meshes in the scene", mScene.numMeshes, numSceneMeshes);
+	}
+
+	if (!mSettings.replayFile.empty()) {
+		ImGui::TextDisabled("sampling comes from the replay");
+		return;
+	}
+
+	const char* presetName = (mQualityPreset < sNumQualityPresets) ? sQualityPresets[mQualityPreset].name : "custom";
+	if (ImGui::BeginCombo("quality (P)", presetName)) {
+		for (size_t i = 0; i < sNumQualityPresets; ++i) {
+			if (ImGui::Selectable(sQualityPresets[i].name, i == mQualityPreset)) {
+				this->SetQualityPreset(i);
+			}
+		}
+		ImGui::EndCombo();
+	}
+
+	// every change is a pipeline variant of its own, so they only apply once the slider is let go
+	int antialiasing = static_cast<int>(mQualityEdit.antialiasingSamples);
+	int paths = static_cast<int>(mQualityEdit.pathsPerSample);
+	int depth = static_cast<int>(mQualityEdit.maxPathDepth);
+	int rouletteDepth = static_cast<int>(mQualityEdit.rouletteMinDepth);
+	int shadowSamples = static_cast<int>(mQualityEdit.shadowSamples);
+	int reflections = static_cast<int>(mQualityEdit.maxReflections);
+	bool apply = false;
+	ImGui::SliderInt("AA samples", &antialiasing, 1, sMaxAntialiasingSamples);
+	apply |= ImGui::IsItemDeactivatedAfterEdit();
+	ImGui::SliderInt("paths per sample", &paths, 1, sMaxPathsPerSample);
+	apply |= ImGui::IsItemDeactivatedAfterEdit();
+	ImGui::SliderInt("max path depth", &depth, 1, sMaxPathDepth);
+	apply |= ImGui::IsItemDeactivatedAfterEdit();
+	ImGui::SliderInt("roulette from depth", &rouletteDepth, 1, depth);
+	apply |= ImGui::IsItemDeactivatedAfterEdit();
+	ImGui::SliderInt("shadow samples", &shadowSamples, 1, sMaxShadowSamples);
+	apply |= ImGui::IsItemDeactivatedAfterEdit();
+	ImGui::SliderInt("reflections", &reflections, 0, sMaxReflections);
+	apply |= ImGui::IsItemDeactivatedAfterEdit();
+
+	// ctrl+click lets any value be typed in
+	mQualityEdit.antialiasingSamples = static_cast<uint32_t>(Clamp(antialiasing, 1, sMaxAntialiasingSamples));
+	mQualityEdit.pathsPerSample = static_cast<uint32_t>(Clamp(paths, 1, sMaxPathsPerSample));
+	mQualityEdit.maxPathDepth = static_cast<uint32_t>(Clamp(depth, 1, sMaxPathDepth));
+	mQualityEdit.rouletteMinDepth = static_cast<uint32_t>(Clamp(rouletteDepth, 1, static_cast<int>(mQualityEdit.maxPathDepth)));
+	mQualityEdit.shadowSamples = static_cast<uint32_t>(Clamp(shadowSamples, 1, sMaxShadowSamples));
+	mQualityEdit.maxReflections = static_cast<uint32_t>(Clamp(reflections, 0, sMaxReflections));
+	if (!apply || !memcmp(&mQualityEdit, &mQuality, sizeof(QualitySettings))) {
+		return;
+	}
+
+	mQuality = mQualityEdit;
+	mQualityPreset = SIZE_MAX;
+	mResetAccumulation = true;
+	mDenoiser.ResetHistory();
+}
+
+void RayTracerApp::DrawMemoryOverlay() {
+	if (!ImGui::CollapsingHeader("Memory", ImGuiTreeNodeFlags_DefaultOpen)) {
+		return;
+	}
+
+	const TextureCache::Stats textures = mTextures.GetStats();
+	if (textures.numTextures) {
+		ImGui::Text("textures: %u of %u resident, %u loading, %u failed", textures.numResident, textures.numTextures,
+			textures.numLoading, textures.numFailed);
+		ImGui::Text("  %.1f of %.1f MB (%s), %llu uploads, %llu evictions", textures.residentBytes / (1024.0 * 1024.0),
+			textures.budgetBytes / (1024.0 * 1024.0), GetTextureFormatName(mTextures.GetFormat()),
+			static_cast<unsigned long long>(textures.numUploads), static_cast<unsigned long long>(textures.numEvictions));
+	}
+
+	MemoryTracker::Report report;
+	GetMemoryTracker().GetReport(report);
+
+	ImGui::Text("%-24s %9s %9s", "", "MB", "peak MB");
+	for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); ++i) {
+		const MemoryTracker::Usage& usage = report.categories[i];
+		if (usage.peakBytes) {
+			ImGui::Text("%-24s %9.2f %9.2f", MemoryTracker::GetCategoryName(static_cast<MemoryCategory>(i)),
+				usage.bytes / (1024.0 * 1024.0), usage.peakBytes / (1024.0 * 1024.0));
+		}
+	}
+	ImGui::Separator();
+	ImGui::Text("%-24s %9.2f %9.2f", "total", report.total.bytes / (1024.0 * 1024.0), report.total.peakBytes / (1024.0 * 1024.0));
+
+	if (ImGui::Button("Print report (F2)")) {
+		GetMemoryTracker().PrintReport();
+	}
+}
+
+
+///////////////////////////// SBT Helper class/////////////////////////////////////////////////
+
+SBTHelper::SBTHelper() {
+}
+
+void SBTHelper::Initialize(const uint32_t numHitGroups, const uint32_t numMissGroups, const uint32_t shaderHandleSize, const uint32_t shaderGroupAlignment,
+                           const uint32_t numHitRecords, const uint32_t hitRecordDataSize, const uint32_t numProceduralRecords) {
+    SBTLayout::Initialize(numHitGroups, numMissGroups, shaderHandleSize, shaderGroupAlignment, numHitRecords, hitRecordDataSize, numProceduralRecords);
+
+    mNumHitShaders.assign(this->GetNumPipelineHitGroups(), 0u);
     mNumMissShaders.resize(numMissGroups, 0u);
 
     mStages.clear();
@@ -1065,8 +2668,6 @@ void SBTHelper::Destroy() {
     mNumMissShaders.clear();
     mStages.clear();
     mGroups.clear();
-
-    mSBTBuffer.Destroy();
 }
 
 void SBTHelper::SetRaygenStage(const VkPipelineShaderStageCreateInfo& stage) {
@@ -1117,8 +2718,14 @@ void SBTHelper::AddStageToHitGroup(const Array<VkPipelineShaderStageCreateInfo>&
             groupInfo.closestHitShader = shaderIdx;
         } else if (stageInfo.stage == VK_SHADER_STAGE_ANY_HIT_BIT_KHR) {
             groupInfo.anyHitShader = shaderIdx;
+        } else if (stageInfo.stage == VK_SHADER_STAGE_INTERSECTION_BIT_KHR) {
+            // AABBs geometry, the intersection shader reports what the ray hits inside them
+            groupInfo.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_PROCEDURAL_HIT_GROUP_KHR;
+            groupInfo.intersectionShader = shaderIdx;
         }
     };
+    // the procedural records only ever get the procedural groups' handles
+    assert((groupInfo.type == VK_RAY_TRACING_SHADER_GROUP_TYPE_PROCEDURAL_HIT_GROUP_KHR) == (groupIndex >= mNumHitGroups));
 
     mGroups.insert((mGroups.begin() + 1 + groupIndex), groupInfo);
 
@@ -1155,43 +2762,11 @@ void SBTHelper::AddStageToMissGroup(const VkPipelineShaderStageCreateInfo& stage
     groupInfo.intersectionShader = VK_SHADER_UNUSED_KHR;
 
     // group 0 is always for raygen, then go hit shaders
-    mGroups.insert((mGroups.begin() + (groupIndex + 1 + mNumHitGroups)), groupInfo);
+    mGroups.insert((mGroups.begin() + (groupIndex + 1 + this->GetNumPipelineHitGroups())), groupInfo);
 
     mNumMissShaders[groupIndex]++;
 }
 
-uint32_t SBTHelper::GetGroupsStride() const {
-    return mShaderGroupAlignment;
-}
-
-uint32_t SBTHelper::GetNumGroups() const {
-    return 1 + mNumHitGroups + mNumMissGroups;
-}
-
-uint32_t SBTHelper::GetRaygenOffset() const {
-    return 0;
-}
-
-uint32_t SBTHelper::GetRaygenSize() const {
-    return mShaderGroupAlignment;
-}
-
-uint32_t SBTHelper::GetHitGroupsOffset() const {
-    return this->GetRaygenOffset() + this->GetRaygenSize();
-}
-
-uint32_t SBTHelper::GetHitGroupsSize() const {
-    return mNumHitGroups * mShaderGroupAlignment;
-}
-
-uint32_t SBTHelper::GetMissGroupsOffset() const {
-    return this->GetHitGroupsOffset() + this->GetHitGroupsSize();
-}
-
-uint32_t SBTHelper::GetMissGroupsSize() const {
-    return mNumMissGroups * mShaderGroupAlignment;
-}
-
 uint32_t SBTHelper::GetNumStages() const {
     return static_cast<uint32_t>(mStages.size());
 }
@@ -1204,14 +2779,11 @@ const VkRayTracingShaderGroupCreateInfoKHR* SBTHelper::GetGroups() const {
     return mGroups.data();
 }
 
-uint32_t SBTHelper::GetSBTSize() const {
-    return this->GetNumGroups() * mShaderGroupAlignment;
-}
-
-bool SBTHelper::CreateSBT(VkDevice device, VkPipeline rtPipeline) {
+bool SBTHelper::CreateSBT(VkDevice device, VkPipeline rtPipeline, vulkanhelpers::Buffer& sbtBuffer) const {
     const size_t sbtSize = this->GetSBTSize();
 
-    VkResult error = mSBTBuffer.Create(sbtSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    MemoryTracker::Scope memoryScope(MemoryCategory::ShaderBindingTable);
+    VkResult error = sbtBuffer.Create(sbtSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     CHECK_VK_ERROR(error, "mSBT.Create");
 
     if (VK_SUCCESS != error) {
@@ -1224,18 +2796,21 @@ bool SBTHelper::CreateSBT(VkDevice device, VkPipeline rtPipeline) {
     CHECK_VK_ERROR(error, L"vkGetRayTracingShaderGroupHandlesKHR");
 
     // now we fill our SBT
-    uint8_t* mem = static_cast<uint8_t*>(mSBTBuffer.Map());
-    for (size_t i = 0; i < this->GetNumGroups(); ++i) {
-        memcpy(mem, groupHandles.data() + i * mShaderHandleSize, mShaderHandleSize);
-        mem += mShaderGroupAlignment;
-    }
-    mSBTBuffer.Unmap();
+    this->FillTable(static_cast<uint8_t*>(sbtBuffer.Map()), groupHandles.data());
+    sbtBuffer.Unmap();
 
     return (VK_SUCCESS == error);
 }
 
-VkBuffer SBTHelper::GetSBTBuffer() const {
-    return mSBTBuffer.GetBuffer();
+void SBTHelper::WriteHitRecords(vulkanhelpers::Buffer& sbtBuffer, const uint32_t firstRecord, const uint32_t numRecords, const void* data, const size_t dataStride) const {
+    assert(firstRecord + numRecords <= this->GetNumHitRecords());
+    if (!numRecords || !mHitRecordDataSize) {
+        return;
+    }
+
+    uint8_t* mem = static_cast<uint8_t*>(sbtBuffer.Map(this->GetHitRecordsSize(numRecords), this->GetHitRecordsOffset(firstRecord)));
+    this->FillHitRecords(mem, numRecords, data, dataStride);
+    sbtBuffer.Unmap();
 }
 
 ///////////////////////////// end SBTHelper ///////////////////////////////////////
\ No newline at end of file
@@ -1,8 +1,32 @@
 #pragma once
 
 #include "framework/vulkanapp.h"
+#include "shared.h"
 
 #include "framework/camera.h"
+#include "framework/threadpool.h"
+#include "framework/asyncdenoiser.h"
+#include "framework/framereadback.h"
+#include "framework/framecapture.h"
+#include "framework/batchrender.h"
+#include "framework/sessionrecording.h"
+#include "framework/aliastable.h"
+#include "framework/lightbvh.h"
+#include "framework/pipelinevariants.h"
+#include "framework/shaderwatcher.h"
+#include "framework/taskgraph.h"
+#include "framework/bindlessregistry.h"
+#include "framework/sbtlayout.h"
+#include "framework/materialtable.h"
+#include "framework/texturecache.h"
+#include "framework/objprimitives.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
 struct RTAccelerationStructure {
     VkDeviceMemory                          memory;
     VkAccelerationStructureCreateInfoKHR    accelerationStructureInfo;
@@ -10,8 +34,17 @@ struct RTAccelerationStructure {
     VkDeviceAddress                         handle;
 };
 struct RTMesh {
+	String                      name;           // the obj shape's, what its memory is reported under
 	uint32_t                    numVertices;
-	uint32_t                    numFaces;
+	uint32_t                    numFaces;       // its primitives for analytic ones
+	bool                        isAnalytic;     // the scene file's spheres & capsules: AABBs in positions, AnalyticPrimitive[] in faces
+	bool                        isOpaque;       // built with VK_GEOMETRY_OPAQUE_BIT_KHR, never runs any-hit
+	bool                        isEmissive;     // some of its triangles emit, they join the lights when it arrives
+	uint32_t                    firstEmitter;   // its first triangle's EmissiveTriangle, numbered by the loader up front
+	uint32_t                    material;       // of all its triangles (mMaterials index), SWS_INVALID_ID when they differ
+	uint32_t                    slot;           // bindless buffer slot, also its instance's custom index
+	uint32_t                    record;         // its SBT record, the slot for triangles, a procedural one for analytic meshes
+	HitRecordData               hitRecord;      // its SBT record's data, filled in with its buffers
 
 	vulkanhelpers::Buffer       positions;
 	vulkanhelpers::Buffer       attribs;
@@ -22,54 +55,90 @@ struct RTMesh {
 	RTAccelerationStructure     blas;
 };
 struct RTScene {
-	Array<RTMesh>                   meshes;
-	RTAccelerationStructure         topLevelAS;
+	Array<RTMesh>                   meshes;             // sized once the OBJ is parsed, filled in by the loader thread
+	uint32_t                        numMeshes;          // built into topLevelAS, the only ones the render thread touches
+	RTAccelerationStructure         topLevelAS;         // room for every mesh the layouts allow, rebuilt as they arrive
+	vulkanhelpers::Buffer           instancesBuffer;    // same
 
 	// shader resources stuff
 	Array<VkDescriptorBufferInfo>   meshInfoBufferInfos;
 	Array<VkDescriptorBufferInfo>   attribsBufferInfos;
 	Array<VkDescriptorBufferInfo>   facesBufferInfos;
 	//Array<VkDescriptorImageInfo>    texturesInfos;
+
+	// emissive triangles for light sampling (EmissiveTriangle[] & LightBVHNode[]), room for all of the scene's twice:
+	// frames read one set while the emitters that arrived since go in the other (UpdateLights)
+	vulkanhelpers::Buffer           lightsBuffer;
+	vulkanhelpers::Buffer           lightNodesBuffer;
+	uint32_t                        lightsCapacity;         // emissive triangles per set, the loader counts them
+	uint32_t                        lightsSet;              // the one frames read
+	uint64_t                        lightsSetRetired;       // frames before this one may still read the other one
+	uint32_t                        numEmissiveTriangles;   // in the set frames read
+	float                           emissiveInvTotalWeight;
+
+	// the emitters of the meshes built into the scene so far, waiting for a free set while lightsPending
+	Array<EmissiveTriangle>         emissiveTriangles;
+	Array<LightBVH::Emitter>        emitters;
+	Array<float>                    emitterWeights;
+	LightBVH                        lightBVH;
+	uint32_t                        pendingEmissiveTriangles;
+	float                           pendingInvTotalWeight;
+	bool                            lightsPending;
+
+	vulkanhelpers::Buffer           materialsBuffer;    // MaterialData[], never empty
+	uint32_t                        numMaterials;       // the ones of mMaterials in it
 };
 
-class SBTHelper {
+// what the ray tracing pipeline gets specialized with (SWS_SC_*, besides the render mode), fixed per pipeline variant
+struct QualitySettings {
+	uint32_t                    antialiasingSamples;
+	uint32_t                    pathsPerSample;
+	uint32_t                    maxPathDepth;
+	uint32_t                    rouletteMinDepth;
+	uint32_t                    shadowSamples;      // ray tracer mode
+	uint32_t                    maxReflections;     // ray tracer mode
+};
+
+// The ray tracing pipeline's stages & groups, on top of its table's SBTLayout: group i is the i-th handle FillTable() takes.
+class SBTHelper : public SBTLayout {
 public:
     SBTHelper();
     ~SBTHelper() = default;
 
-    void        Initialize(const uint32_t numHitGroups, const uint32_t numMissGroups, const uint32_t shaderHandleSize, const uint32_t shaderGroupAlignment);
+    void        Initialize(const uint32_t numHitGroups, const uint32_t numMissGroups, const uint32_t shaderHandleSize, const uint32_t shaderGroupAlignment,
+                           const uint32_t numHitRecords = 1, const uint32_t hitRecordDataSize = 0, const uint32_t numProceduralRecords = 0);
     void        Destroy();
     void        SetRaygenStage(const VkPipelineShaderStageCreateInfo& stage);
     void        AddStageToHitGroup(const Array<VkPipelineShaderStageCreateInfo>& stages, const uint32_t groupIndex);
     void        AddStageToMissGroup(const VkPipelineShaderStageCreateInfo& stage, const uint32_t groupIndex);
 
-    uint32_t    GetGroupsStride() const;
-    uint32_t    GetNumGroups() const;
-    uint32_t    GetRaygenOffset() const;
-    uint32_t    GetRaygenSize() const;
-    uint32_t    GetHitGroupsOffset() const;
-    uint32_t    GetHitGroupsSize() const;
-    uint32_t    GetMissGroupsOffset() const;
-    uint32_t    GetMissGroupsSize() const;
-
     uint32_t                                    GetNumStages() const;
     const VkPipelineShaderStageCreateInfo*      GetStages() const;
     const VkRayTracingShaderGroupCreateInfoKHR* GetGroups() const;
 
-    uint32_t    GetSBTSize() const;
-    bool        CreateSBT(VkDevice device, VkPipeline rtPipeline);
-    VkBuffer    GetSBTBuffer() const;
+    // every pipeline created from these stages & groups needs its own, the records' data is all zeros until written
+    bool        CreateSBT(VkDevice device, VkPipeline rtPipeline, vulkanhelpers::Buffer& sbtBuffer) const;
+    // numRecords records' data from firstRecord on, every hit group of a record gets the same. dataStride apart in data
+    void        WriteHitRecords(vulkanhelpers::Buffer& sbtBuffer, const uint32_t firstRecord, const uint32_t numRecords, const void* data, const size_t dataStride) const;
 
 private:
-    uint32_t                                    mShaderHandleSize;
-    uint32_t                                    mShaderGroupAlignment;
-    uint32_t                                    mNumHitGroups;
-    uint32_t                                    mNumMissGroups;
     Array<uint32_t>                             mNumHitShaders;
     Array<uint32_t>                             mNumMissShaders;
     Array<VkPipelineShaderStageCreateInfo>      mStages;
     Array<VkRayTracingShaderGroupCreateInfoKHR> mGroups;
-    vulkanhelpers::Buffer                       mSBTBuffer;
+};
+
+// the ray tracing shaders and everything built from them, replaced as a whole when the shaders are hot reloaded
+struct RTPipelineSet {
+	vulkanhelpers::Shader           shaders[9];     // sRTShaders' order
+	SBTHelper                       sbt;            // the stages & groups, not the table itself (that's per variant)
+	PipelineVariantCache            variants;
+};
+// meshes being built into the scene (their BLASes, then the whole TLAS again), at most one at a time
+struct RTSceneBuild {
+	VkCommandBuffer                 commandBuffer;      // VK_NULL_HANDLE when there's none in flight
+	VkFence                         fence;
+	vulkanhelpers::Buffer           scratch;
 };
 class Light
 {
@@ -98,40 +167,104 @@ public:
 protected:
     virtual void InitSettings() override;
     virtual void InitApp() override;
-	void updateUniformParams(const float deltaTime, int frameNumber);
+	void updateUniformParams(const size_t imageIndex, const float deltaTime, int frameNumber);
     virtual void FreeResources() override;
     virtual void FillCommandBuffer(VkCommandBuffer commandBuffer, const size_t imageIndex) override;
 	void OnKey(const int key, const int scancode, const int action, const int mods) override;
 	virtual void OnMouseMove(const float x, const float y) override;
 	virtual void OnMouseButton(const int button, const int action, const int mods) override;
 	void Update(const size_t, const float dt);
+	virtual void FlushFrames() override;
+	virtual bool IsHeadlessFinished() const override;
+	virtual void OnDrawOverlay() override;
 private:
     bool CreateAS(const VkAccelerationStructureTypeKHR type,
                   const uint32_t geometryCount,
                   const VkAccelerationStructureCreateGeometryTypeInfoKHR* geometries,
                   const uint32_t instanceCount,
                   RTAccelerationStructure& _as);
+	void DestroyAS(RTAccelerationStructure& _as);
 	void LoadSceneGeometry();
 	void LoadObj(String fileName);
+	void CreateMeshBuffers(const size_t meshIdx);
+	void PrepareMeshBufferInfos(const size_t meshIdx);
+	void CreateAnalyticMeshBuffers(const size_t meshIdx, const Array<ObjPrimitive>& primitives);
+	void CreateMeshBLAS(const size_t meshIdx);
+	void StartSceneLoader();
+	void StopSceneLoader();
+	uint32_t GetReadyMeshes(bool& loaded);
+	void UpdateStreamedScene();
+	void BuildSceneMeshes(const uint32_t numMeshes, const bool streaming);
+	void FinishSceneBuild();
 	void CreateCamera();
 	void CreateScene();
+	uint32_t WaitForSceneParsed();
+	void CreateLights(const uint32_t capacity);
+	void AppendLights(const uint32_t firstMesh, const uint32_t lastMesh);
+	void UpdateLights();
+	void CreateMaterials();
+	void CreateTextureCache();
+	void UpdateTextures();
+	void CreateAOVImages();
+	void ClearRadianceImage();
+	uint32_t GetActiveAOVMask() const;
+	void ConsumeReadback(FrameReadback::Frame& frame);
+	void DenoiseFrame(const FrameReadback::Frame& frame, ImageWriter::Frame* capture);
+	void PublishDenoisedFrame(const Denoiser& denoiser, const bool current, ImageWriter::Frame* capture);
+	void ToggleDenoiser();
+	void ToggleCapture();
+	void InitCapture();
+	void InitHeadlessCapture();
+	void InitBatch();
+	void BeginBatchPass();
+	void InitSession();
+	void FinishSession();
+	const SessionRecording::Frame* GetReplayFrame() const;
+	void MarkReplayFrame();
+	void CycleEmittersMode();
+	void RebuildReadback();
+	void SetQualityPreset(const size_t preset);
+	void CycleQualityPreset();
+	bool SelectPipelineVariant();
+	void StartShaderHotReload();
+	void OnShadersRecompiled(const ShaderWatcher::Result& result);
+	void SwapReloadedPipelines();
+	uint32_t GetCameraSamplesPerPixel() const;
+	void DrawSamplingOverlay();
+	void DrawMemoryOverlay();
     void CreateDescriptorSetsLayouts();
     void CreateRaytracingPipelineAndSBT();
+    bool InitRaytracingPipelineSet(RTPipelineSet& set);
+    bool CreateRaytracingPipelineVariant(const SBTHelper& sbt, const VkSpecializationInfo& specialization, PipelineVariantCache::Variant& variant);
     void UpdateDescriptorSets();
+    void WriteMeshDescriptors(const size_t meshIdx);
+    void WriteMeshHitRecord(const size_t meshIdx);
+    void WriteHitRecords(RTPipelineSet& set);
+    void WriteLightsDescriptors();
+    void WriteMaterialsDescriptors();
+    void WriteTexturesDescriptors();
 
 private:
-    VkPipeline                      mRTPipeline;
 	VkPipelineLayout                mRTPipelineLayout;
+	std::unique_ptr<RTPipelineSet>  mRTPipelineSet;         // new variants can be asked for anytime
+	const PipelineVariantCache::Variant* mRTPipeline;       // the one the command buffers are recorded with
+	Array<uint32_t>                 mRTPipelineKey;         // and its specialization constants
+
+	// hot reload: the watcher's thread builds a new set, the render thread swaps it in at the start of a frame
+	std::mutex                      mReloadMutex;
+	std::unique_ptr<RTPipelineSet>  mReloadedPipelineSet;   // guarded, waiting for the swap
+	Array<uint32_t>                 mReloadKey;             // guarded, the variant to build it with
+	ShaderWatcher                   mShaderWatcher;         // after the sets, stopped before they go
 
     VkDescriptorPool                mRTDescriptorPool;
 	Array<VkDescriptorSet>          mRTDescriptorSets;
 	Array<VkDescriptorSetLayout>    mRTDescriptorSetsLayouts;
-    SBTHelper                       mShaderBindingTable;
     RTScene                         mScene;
 	// camera 
 	Light							mLight;
 	Camera                          mCamera;
-	vulkanhelpers::Buffer           mCameraBuffer;
+	vulkanhelpers::Buffer           mCameraBuffer;          // one CameraUniformParams per frame in flight, bound with a dynamic offset
+	VkDeviceSize                    mCameraParamsStride;
 	vec2                            mCursorPos;
 	vec2 moveDelta;
 
@@ -139,6 +272,70 @@ private:
 	float							sMoveSpeed = 0.5;
 	bool							mWKeyDown,mAKeyDown,mSKeyDown,mDKeyDown;
 	bool							mRightKeyDown, mLeftKeyDown, mDownKeyDown, mUpKeyDown;
-	vulkanhelpers::Buffer mUniformParamsBuffer;
+	vulkanhelpers::Buffer mUniformParamsBuffer;             // same, one UniformParams per frame in flight
+	VkDeviceSize                    mUniformParamsStride;
+	uint32_t                        mMaxSceneMeshes;        // the registry's buffer slots, at most sMaxSceneMeshes
+	BindlessRegistry                mBindless;              // the per-mesh arrays (sets SWS_ATTRIBS_SET ..)
+	uint32_t                        mAttribsTable;          // mBindless tables
+	uint32_t                        mFacesTable;
+	uint32_t                        mMeshInfoTable;
+	uint32_t                        mTexturesTable;         // the one texture table (SWS_TEXTURES_SET)
+	TextureCache                    mTextures;              // the materials' maps, streamed by use
+	// every slot's SBT record data, what a new variant's SBT gets (the watcher's thread makes some)
+	std::mutex                      mHitRecordsMutex;
+	Array<HitRecordData>            mHitRecords;            // guarded, mMaxSceneMeshes of them, then the procedural ones
+	uint32_t                        mNumHitRecords;         // guarded, records written so far (the highest + 1)
 	int				counter;
+	uint32_t                        mEmittersMode;      // SWS_EMITTERS_*
+
+	// quality: a preset or what the overlay's sliders made of it, the pipeline variant follows on the next frame
+	QualitySettings                 mQuality;
+	QualitySettings                 mQualityEdit;           // the sliders' values, applied once one of them is let go
+	size_t                          mQualityPreset;         // SIZE_MAX once the sliders changed something
+	bool                            mResetAccumulation;     // next interactive frame starts over
+	float                           mAccumulatedFrames;     // overlay only: frames' worth of samples in the image
+
+	// AOVs
+	vulkanhelpers::Image            mAOVImages[SWS_NUM_AOVS];
+	vulkanhelpers::Image            mRadianceImage;     // SWS_RADIANCE_IMAGE_BINDING
+	uint32_t                        mAOVMask;           // AOVs written out with the beauty image (SWS_AOV_*_BIT)
+	FrameReadback                   mReadback;          // while the denoiser or the capture is on
+	ThreadPool                      mThreadPool;
+	ThreadPool                      mTextureThreadPool;     // the texture cache's loads, their encodes take long
+
+	// denoiser: filters on its own thread, the render thread hands it final frames whenever it's idle and
+	// uploads its latest result (mReadback's) into every frame in flight's upload buffer
+	AsyncDenoiser                   mDenoiser;
+	bool                            mDenoiserEnabled;
+
+	// per frame dump, written asynchronously
+	FrameCapture                    mCapture;
+	bool                            mCaptureEnabled;
+
+	// headless runs: the output frames and the passes they take
+	BatchRender                     mBatch;
+
+	// --record / --replay: the log of a session (only one of them at a time) and the replay's frame times
+	SessionRecording                mRecording;
+	size_t                          mReplayFrame;           // next logged frame, interactive replays only
+	FrameTimings                    mReplayTimings;
+	std::chrono::steady_clock::time_point mReplayFrameStart;
+	bool                            mReplayFrameStarted;
+
+	// progressive loading: the loader thread parses the OBJ and readies meshes in batches (buffers & BLAS objects),
+	// the render thread builds what arrived into the scene between frames, the first ones render meanwhile
+	std::thread                     mSceneLoader;           // after the scene & the pool, stopped before they go
+	std::atomic<bool>               mStopSceneLoader;
+	std::mutex                      mSceneMutex;
+	uint32_t                        mNumReadyMeshes;        // guarded, meshes the loader is done with
+	uint32_t                        mNumSceneMeshes;        // guarded, the OBJ's, 0 until it's parsed
+	uint32_t                        mNumSceneEmitters;      // guarded, the triangles of its emissive meshes
+	bool                            mSceneLoaded;           // guarded, the loader has nothing more coming
+	std::condition_variable         mSceneParsed;           // either of the two above
+	MaterialTable                   mMaterials;             // the loader's until the OBJ is parsed
+	RTSceneBuild                    mSceneBuild;
+	uint32_t                        mNumSceneBuilds;
+	bool                            mSceneComplete;         // reported
+	bool                            mFirstFrameStarted;     // reported
+	std::chrono::steady_clock::time_point mStartupTime;     // InitApp, what the times above are reported against
 };
@@ -0,0 +1,19 @@
+#version 460
+#extension GL_EXT_ray_tracing : require
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_buffer_reference_uvec2 : require
+
+#include "../shared.h"
+#define SWS_INTERSECTION_SHADER
+#include "hitrecord.glsl"
+
+// the AABB of one sphere / capsule of an analytic mesh was hit, the exact surface decides. Every ray type goes
+// through here, the hit kind tells the any-hit & closest-hit shaders it's not a triangle
+
+void main() {
+	const AnalyticPrimitive primitive = hitRecordPrimitives().Primitives[gl_PrimitiveID];
+	const float t = IntersectAnalyticPrimitive(primitive, gl_ObjectRayOriginEXT, gl_ObjectRayDirectionEXT, gl_RayTminEXT, gl_RayTmaxEXT);
+	if (t >= 0.0)
+		reportIntersectionEXT(t, primitive.info.x);
+}
@@ -0,0 +1,68 @@
+// The hit mesh's SBT record data (see SBTHelper & HitRecordData): its material inline when all its triangles share
+// it, its faces & attribs through their buffer device addresses, so the hit shaders need no descriptor indexing.
+// Analytic meshes have their AnalyticPrimitive[] where the faces are, and no attribs.
+// Needs GL_EXT_buffer_reference & GL_EXT_buffer_reference_uvec2 enabled and shared.h included before inclusion,
+// intersection shaders define SWS_INTERSECTION_SHADER first (there's no hit kind yet).
+
+layout(set = SWS_MATERIALS_SET, binding = SWS_MATERIALS_BINDING, std430) readonly buffer MaterialsBuffer {
+	MaterialData Materials[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer FacesRef {
+	uvec4 Faces[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer AttribsRef {
+	VertexAttribute VertexAttribs[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer PrimitivesRef {
+	AnalyticPrimitive Primitives[];
+};
+
+layout(shaderRecordEXT, std430) buffer ShaderRecord {
+	HitRecordData HitRecord;
+};
+
+FacesRef hitRecordFaces() {
+	return FacesRef(HitRecord.addresses.xy);
+}
+
+AttribsRef hitRecordAttribs() {
+	return AttribsRef(HitRecord.addresses.zw);
+}
+
+PrimitivesRef hitRecordPrimitives() {
+	return PrimitivesRef(HitRecord.addresses.xy);
+}
+
+#ifndef SWS_INTERSECTION_SHADER
+// a sphere or a capsule, reported with its SWS_ANALYTIC_* type as the hit kind
+bool hitIsAnalytic() {
+	return gl_HitKindEXT != gl_HitKindFrontFacingTriangleEXT && gl_HitKindEXT != gl_HitKindBackFacingTriangleEXT;
+}
+
+// the hit triangle's, only meshes made of several materials read faces.w for it (the primitive's info.y)
+uint hitMaterialIndex() {
+	if (HitRecord.info.x != SWS_INVALID_ID)
+		return HitRecord.info.x;
+	if (hitIsAnalytic())
+		return hitRecordPrimitives().Primitives[gl_PrimitiveID].info.y;
+	return hitRecordFaces().Faces[gl_PrimitiveID].w;
+}
+
+MaterialData hitMaterial() {
+	if (HitRecord.info.x != SWS_INVALID_ID)
+		return HitRecord.material;
+	return Materials[hitMaterialIndex()];
+}
+
+// what the closest-hit shaders get from a sphere / capsule instead of the triangle's vertices: the normal, uvs
+// mapping the normal's latitude & longitude, and the LOD constant that goes with them
+void analyticHit(vec3 pos, out vec3 normal, out vec2 uv, out float lodConstant) {
+	const AnalyticPrimitive primitive = hitRecordPrimitives().Primitives[gl_PrimitiveID];
+	normal = AnalyticPrimitiveNormal(primitive, pos);
+	uv = vec2(atan(normal.x, normal.z) * (0.5 / 3.14159265) + 0.5, acos(clamp(normal.y, -1.0, 1.0)) * (1.0 / 3.14159265));
+	lodConstant = AnalyticPrimitiveLodConstant(primitive);
+}
+#endif // SWS_INTERSECTION_SHADER
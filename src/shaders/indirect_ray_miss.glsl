@@ -6,16 +6,9 @@
 #include "../shared.h"
 
 layout(location = SWS_LOC_INDIRECT_RAY) rayPayloadInEXT IndirectRayPayload indirectRay;
-layout(set = SWS_UNIFORMPARAMS_SET, binding = SWS_UNIFORMPARAMS_BINDING, std140)     uniform AppData{
-	UniformParams Params;
-};
 
 void main() {
-	indirectRay.hitValue = vec3(Params.clearColor);
-	if (indirectRay.rayDepth > 0) //first iteration 
-	{
-		indirectRay.hitValue = vec3(0.001);  // No contribution from environment
-		
-	}
-	indirectRay.rayDepth = MAX_PATH_DEPTH;
-}
\ No newline at end of file
+	indirectRay.hitT = -1.0; // environment is handled in pathtracerLoop
+	indirectRay.meshId = SWS_INVALID_ID;
+	indirectRay.primId = SWS_INVALID_ID;
+}
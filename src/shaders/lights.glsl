@@ -0,0 +1,293 @@
+// Emissive triangles sampling (next event estimation).
+// A triangle is picked either proportionally to area * luminance through the alias table built on the CPU (see AliasTable),
+// or by walking down the light BVH (see LightBVH) which also accounts for distance & orientation to the shading point.
+// A point is then picked uniformly over the triangle, so pdf (area measure) = pmf(triangle) / area.
+// Needs random.glsl, the meshInfoArray buffers, the AppData uniform block, the Scene AS and the ShadowRay payload
+// declared before inclusion: shootShadowRay() & sampleEmitters() are shared by the ray tracer's hit shader and the
+// path tracer's ray generation.
+
+layout(set = SWS_LIGHTS_SET, binding = SWS_LIGHTS_BINDING, std430) readonly buffer LightsBuffer {
+	EmissiveTriangle EmissiveTriangles[];
+};
+
+layout(set = SWS_LIGHTS_SET, binding = SWS_LIGHT_NODES_BINDING, std430) readonly buffer LightNodesBuffer {
+	LightBVHNode LightNodes[];
+};
+
+struct LightSample {
+	vec3 pos;
+	vec3 normal;
+	vec3 emission;
+	float pdfArea;
+};
+
+uint emittersSamplingMode()
+{
+	return uint(Params.emissiveInfo.z);
+}
+
+bool emittersSamplingEnabled()
+{
+	return emittersSamplingMode() != SWS_EMITTERS_OFF && Params.emissiveInfo.x > 0.0;
+}
+
+// the buffers hold two sets of lights, the frame reads the one at this offset (nodes at twice that, see
+// RayTracerApp::UpdateLights) while the other one gets the emitters streamed in since
+uint lightsBase()
+{
+	return uint(Params.emissiveInfo.w);
+}
+
+EmissiveTriangle emissiveTriangle(uint index)
+{
+	return EmissiveTriangles[lightsBase() + index];
+}
+
+LightBVHNode lightNode(uint index)
+{
+	return LightNodes[2u * lightsBase() + index];
+}
+
+// index of the emissive triangle that was hit, SWS_INVALID_ID if the mesh doesn't emit
+uint emitterIndex(uint objId, uint primId)
+{
+	const float firstEmitter = meshInfoArray[nonuniformEXT(objId)].info[0].x;
+	return (firstEmitter < 0.0) ? SWS_INVALID_ID : (uint(firstEmitter) + primId);
+}
+
+// mirrors AliasTable::Sample
+uint sampleEmissiveTriangleIndex(float u)
+{
+	const uint count = uint(Params.emissiveInfo.x);
+	const float scaled = u * float(count);
+	const uint index = min(uint(scaled), count - 1);
+	const float remainder = scaled - float(index);
+	const EmissiveTriangle tri = emissiveTriangle(index);
+	return (remainder < tri.v1.w) ? index : tri.info.x;
+}
+
+// cos(max(0, a - b)) and sin(max(0, a - b)), both angles in [0, pi]
+float cosSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	return (cosA > cosB) ? 1.0 : (cosA * cosB + sinA * sinB);
+}
+
+float sinSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	return (cosA > cosB) ? 0.0 : (sinA * cosB - cosA * sinB);
+}
+
+// mirrors LightBVH::Importance
+float lightNodeImportance(uint nodeIndex, vec3 p, vec3 n)
+{
+	const LightBVHNode node = lightNode(nodeIndex);
+	if (node.boundsMin.w <= 0.0)
+		return 0.0;
+
+	const vec3 pc = 0.5 * (node.boundsMin.xyz + node.boundsMax.xyz);
+	const vec3 diag = node.boundsMax.xyz - node.boundsMin.xyz;
+	vec3 wi = p - pc;
+
+	const float distSq = dot(wi, wi);
+	const float radiusSq = 0.25 * dot(diag, diag);
+	const float d2 = max(max(distSq, 0.5 * length(diag)), 1e-12);
+	wi = (distSq > 0.0) ? (wi * inversesqrt(distSq)) : vec3(0.0, 0.0, 1.0);
+
+	const float cosThetaW = abs(dot(node.axis.xyz, wi));
+	const float sinThetaW = sqrt(max(1.0 - cosThetaW * cosThetaW, 0.0));
+
+	const float cosThetaB = (distSq < radiusSq) ? -1.0 : sqrt(max(1.0 - radiusSq / distSq, 0.0));
+	const float sinThetaB = sqrt(max(1.0 - cosThetaB * cosThetaB, 0.0));
+
+	const float cosThetaO = node.boundsMax.w;
+	const float sinThetaO = sqrt(max(1.0 - cosThetaO * cosThetaO, 0.0));
+	const float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	const float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	const float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if (cosThetaP <= node.axis.w)
+		return 0.0;
+
+	const float cosThetaI = -dot(wi, n);
+	const float sinThetaI = sqrt(max(1.0 - cosThetaI * cosThetaI, 0.0));
+	const float cosThetaPI = cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+
+	return node.boundsMin.w * cosThetaP / d2 * max(cosThetaPI, 0.0);
+}
+
+// mirrors LightBVH::Sample, returns SWS_INVALID_ID if nothing can light this point
+uint sampleLightBVH(vec3 p, vec3 n, float u, out float pmf)
+{
+	pmf = 0.0;
+	if (lightNodeImportance(0, p, n) <= 0.0)
+		return SWS_INVALID_ID;
+
+	float prob = 1.0;
+	uint nodeIndex = 0;
+	while (lightNode(nodeIndex).info.z == 0)
+	{
+		const uvec4 children = lightNode(nodeIndex).info;
+		const float ci0 = lightNodeImportance(children.x, p, n);
+		const float ci1 = lightNodeImportance(children.y, p, n);
+		if (ci0 <= 0.0 && ci1 <= 0.0)
+			return SWS_INVALID_ID;
+
+		// reuse the random number all the way down
+		const float p0 = ci0 / (ci0 + ci1);
+		if (u < p0)
+		{
+			u = min(u / p0, 0.99999994);
+			prob *= p0;
+			nodeIndex = children.x;
+		}
+		else
+		{
+			u = min((u - p0) / (1.0 - p0), 0.99999994);
+			prob *= 1.0 - p0;
+			nodeIndex = children.y;
+		}
+	}
+
+	pmf = prob;
+	return lightNode(nodeIndex).info.x;
+}
+
+// mirrors LightBVH::GetPmf
+float lightBVHPmf(vec3 p, vec3 n, uint emitter)
+{
+	if (lightNodeImportance(0, p, n) <= 0.0)
+		return 0.0;
+
+	uint bitTrail = emissiveTriangle(emitter).info.w;
+	float prob = 1.0;
+	uint nodeIndex = 0;
+	while (lightNode(nodeIndex).info.z == 0)
+	{
+		const uvec4 children = lightNode(nodeIndex).info;
+		const float ci0 = lightNodeImportance(children.x, p, n);
+		const float ci1 = lightNodeImportance(children.y, p, n);
+		if (ci0 <= 0.0 && ci1 <= 0.0)
+			return 0.0;
+
+		const bool second = (bitTrail & 1u) != 0;
+		prob *= (second ? ci1 : ci0) / (ci0 + ci1);
+		nodeIndex = second ? children.y : children.x;
+		bitTrail >>= 1;
+	}
+
+	return (lightNode(nodeIndex).info.x == emitter) ? prob : 0.0;
+}
+
+// area measure pdf of reaching this point of an emitter through light sampling from (p, n)
+float emitterPdfArea(vec3 p, vec3 n, uint emitter)
+{
+	// its mesh is traced a few frames before its emitters are in the set the frame reads, light sampling can't pick
+	// them until then
+	if (emitter >= uint(Params.emissiveInfo.x))
+		return 0.0;
+
+	const EmissiveTriangle tri = emissiveTriangle(emitter);
+	const float area = tri.v0.w;
+	if (area <= 0.0)
+		return 0.0;
+
+	const float pmf = (emittersSamplingMode() == SWS_EMITTERS_LIGHT_BVH) ? lightBVHPmf(p, n, emitter) : tri.v2.w;
+	return pmf / area;
+}
+
+// pdfArea is 0 when there's nothing to sample
+LightSample sampleEmissiveTriangle(vec3 p, vec3 n, inout uint seed)
+{
+	LightSample ls;
+	ls.pdfArea = 0.0;
+
+	float pmf;
+	uint index;
+	if (emittersSamplingMode() == SWS_EMITTERS_LIGHT_BVH)
+	{
+		index = sampleLightBVH(p, n, nextRand(seed), pmf);
+		if (index == SWS_INVALID_ID)
+			return ls;
+	}
+	else
+	{
+		index = sampleEmissiveTriangleIndex(nextRand(seed));
+		pmf = emissiveTriangle(index).v2.w;
+	}
+
+	const EmissiveTriangle tri = emissiveTriangle(index);
+
+	// uniform point over the triangle
+	const float su = sqrt(nextRand(seed));
+	const float v = nextRand(seed);
+	const vec3 bary = vec3(1.0 - su, su * (1.0 - v), su * v);
+
+	const vec3 e1 = tri.v1.xyz - tri.v0.xyz;
+	const vec3 e2 = tri.v2.xyz - tri.v0.xyz;
+
+	ls.pos = tri.v0.xyz * bary.x + tri.v1.xyz * bary.y + tri.v2.xyz * bary.z;
+	ls.normal = normalize(cross(e1, e2));
+	ls.emission = tri.emission.rgb;
+	ls.pdfArea = (tri.v0.w > 0.0) ? (pmf / tri.v0.w) : 0.0;
+	return ls;
+}
+
+float powerHeuristic(float pdfA, float pdfB)
+{
+	const float a = pdfA * pdfA;
+	const float b = pdfB * pdfB;
+	return (a + b) > 0.0 ? a / (a + b) : 0.0;
+}
+
+// true when something opaque blocks the segment, translucent hits only tint ShadowRay.attenuation (shadow_ray_ahit)
+bool shootShadowRay(vec3 origin, vec3 dirToLight, float distToLight)
+{
+	const uint shadowRayFlags = gl_RayFlagsTerminateOnFirstHitEXT | gl_RayFlagsSkipClosestHitShaderEXT;
+	const uint cullMask = 0xFF;
+	const uint stbRecordStride = 1;
+	ShadowRay.isShadowed = true;
+	traceRayEXT(Scene,
+		shadowRayFlags,
+		cullMask,
+		SWS_SHADOW_HIT_SHADERS_IDX,
+		stbRecordStride,
+		SWS_SHADOW_MISS_SHADERS_IDX,
+		origin,
+		0.0f,
+		dirToLight,
+		distToLight,
+		SWS_LOC_SHADOW_RAY);
+	if (ShadowRay.isShadowed)
+		ShadowRay.attenuation = Params.LightInfo.y;
+	return ShadowRay.isShadowed;
+}
+
+// one sample of the emissive triangles for a diffuse surface, brdf is its Lambertian matColor * kd / pi.
+// useMIS weights it against the path finding the same emitter through a cosine sampled bounce
+vec3 sampleEmitters(vec3 p, vec3 n, vec3 brdf, bool useMIS, inout uint seed)
+{
+	if (!emittersSamplingEnabled())
+		return vec3(0);
+
+	const LightSample ls = sampleEmissiveTriangle(p, n, seed);
+	if (ls.pdfArea <= 0.0)
+		return vec3(0);
+
+	const vec3 toLight = ls.pos - p;
+	const float distSq = dot(toLight, toLight);
+	const float dist = sqrt(distSq);
+	const vec3 dirToLight = toLight / dist;
+	const float cosSurface = dot(n, dirToLight);
+	const float cosLight = abs(dot(ls.normal, dirToLight)); // emitters are double-sided, same as when a path hits them
+	if (cosSurface <= 0.0 || cosLight <= 0.0)
+		return vec3(0);
+
+	ShadowRay.attenuation = 1.0;
+	if (shootShadowRay(p + n * 0.001f, dirToLight, dist * 0.999))
+		return vec3(0);
+
+	const float pdfLight = ls.pdfArea * distSq / cosLight; // solid angle
+	vec3 contribution = ls.emission * brdf * cosSurface * ShadowRay.attenuation / pdfLight;
+	if (useMIS)
+		contribution *= powerHeuristic(pdfLight, cosSurface / M_PI);
+	return contribution;
+}
@@ -0,0 +1,12 @@
+#version 460
+
+layout(set = 0, binding = 0) uniform sampler2D FontAtlas;
+
+layout(location = 0) in vec4 inColor;
+layout(location = 1) in vec2 inUV;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	outColor = inColor * texture(FontAtlas, inUV);
+}
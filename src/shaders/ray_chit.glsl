@@ -2,19 +2,16 @@
 #extension GL_EXT_ray_tracing : enable
 #extension GL_GOOGLE_include_directive : require
 #extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_buffer_reference_uvec2 : require
 
 #include "../shared.h"
 #include "random.glsl"
+#include "hitrecord.glsl"
 
 layout(set = SWS_SCENE_AS_SET, binding = SWS_SCENE_AS_BINDING)            uniform accelerationStructureEXT Scene;
-layout(set = SWS_ATTRIBS_SET, binding = 0, std430) readonly buffer AttribsBuffer {
-	VertexAttribute VertexAttribs[];
-} AttribsArray[];
-
-layout(set = SWS_FACES_SET, binding = 0, std430) readonly buffer FacesBuffer {
-	uvec4 Faces[];
-} FacesArray[];
 
+// the emitters' indices only (lights.glsl), the rest comes with the SBT record
 layout(set = SWS_MESHINFO_SET, binding = 0, std430) readonly buffer meshInfoBuffer {
 	vec4 info[];
 } meshInfoArray[];
@@ -30,66 +27,66 @@ layout(set = SWS_UNIFORMPARAMS_SET, binding = SWS_UNIFORMPARAMS_BINDING, std140)
 layout(location = SWS_LOC_PRIMARY_RAY) rayPayloadInEXT RayPayload PrimaryRay;
 layout(location = SWS_LOC_SHADOW_RAY)  rayPayloadEXT ShadowRayPayload ShadowRay;
 
+#include "lights.glsl"
+#include "textures.glsl"
+
 hitAttributeEXT vec2 HitAttribs;
 
 
-ShadingData getHitShadingData(uint objId)
+ShadingData getHitShadingData()
 {
 	ShadingData closestHit;
-	// Indices of the triangle
-	const uvec4 face = FacesArray[nonuniformEXT(gl_InstanceCustomIndexEXT)].Faces[gl_PrimitiveID];
-
-	VertexAttribute v0 = AttribsArray[nonuniformEXT(gl_InstanceCustomIndexEXT)].VertexAttribs[int(face.x)];
-	VertexAttribute v1 = AttribsArray[nonuniformEXT(gl_InstanceCustomIndexEXT)].VertexAttribs[int(face.y)];
-	VertexAttribute v2 = AttribsArray[nonuniformEXT(gl_InstanceCustomIndexEXT)].VertexAttribs[int(face.z)];
+	closestHit.pos = gl_WorldRayOriginEXT + gl_WorldRayDirectionEXT * gl_HitTEXT;
+	vec2 uv;
+	float lodConstant;
+	if (hitIsAnalytic())
+	{
+		// spheres & capsules have no vertices, the surface itself gives it all (analytic_ray_rint.glsl hit it)
+		analyticHit(gl_ObjectRayOriginEXT + gl_ObjectRayDirectionEXT * gl_HitTEXT, closestHit.normal, uv, lodConstant);
+	}
+	else
+	{
+		// Indices of the triangle
+		const uvec4 face = hitRecordFaces().Faces[gl_PrimitiveID];
 
-	const vec3 barycentrics = vec3(1.0f - HitAttribs.x - HitAttribs.y, HitAttribs.x, HitAttribs.y);
+		const AttribsRef attribs = hitRecordAttribs();
+		VertexAttribute v0 = attribs.VertexAttribs[int(face.x)];
+		VertexAttribute v1 = attribs.VertexAttribs[int(face.y)];
+		VertexAttribute v2 = attribs.VertexAttribs[int(face.z)];
 
-	// Computing the normal at hit position
-	closestHit.normal = normalize(BaryLerp(v0.normal.xyz, v1.normal.xyz, v2.normal.xyz, barycentrics));
-	closestHit.pos = gl_WorldRayOriginEXT + gl_WorldRayDirectionEXT * gl_HitTEXT;
-	closestHit.matColor = meshInfoArray[objId].info[0];
+		const vec3 barycentrics = vec3(1.0f - HitAttribs.x - HitAttribs.y, HitAttribs.x, HitAttribs.y);
 
-	closestHit.kd = meshInfoArray[objId].info[1].x;
-	closestHit.ks = meshInfoArray[objId].info[1].y;
-	closestHit.mat = int(meshInfoArray[objId].info[1].z);
-	closestHit.emittance = vec3(meshInfoArray[objId].info[1].w);
+		// Computing the normal at hit position
+		closestHit.normal = normalize(BaryLerp(v0.normal.xyz, v1.normal.xyz, v2.normal.xyz, barycentrics));
+		uv = BaryLerp(v0.uv.xy, v1.uv.xy, v2.uv.xy, barycentrics);
+		// the triangle's texel density, the same on its 3 vertices
+		lodConstant = v0.uv.z;
+	}
+	const MaterialData material = hitMaterial();
+	// the cone's footprint here, over the surface's texel density
+	const float coneWidth = RayConeWidth(PrimaryRay.cone.x, PrimaryRay.cone.y, gl_HitTEXT);
+	const float lodBias = RayConeLodBias(lodConstant, coneWidth, dot(gl_WorldRayDirectionEXT, closestHit.normal));
+	closestHit.matColor = materialColor(material, uv, lodBias);
+
+	closestHit.kd = material.params.x;
+	closestHit.ks = material.params.y;
+	closestHit.mat = int(material.params.z);
+	closestHit.shininess = material.params.w;
+	closestHit.emittance = material.emission.rgb;
 
 	
 
 
 	return closestHit;
 }
-bool shootShadowRay(vec3 shadowRayOrigin, vec3 dirToLight, float min, float distToLight)
-{
-	const uint shadowRayFlags = gl_RayFlagsNoOpaqueEXT | gl_RayFlagsSkipClosestHitShaderEXT;
-	const uint cullMask = 0xFF;
-	const uint stbRecordStride = 1;
-	const float tmin = min;
-	const float tmax = distToLight;
-	ShadowRay.isShadowed = true;
-	traceRayEXT(Scene,
-		shadowRayFlags,
-		cullMask,
-		SWS_SHADOW_HIT_SHADERS_IDX,
-		stbRecordStride,
-		SWS_SHADOW_MISS_SHADERS_IDX,
-		shadowRayOrigin,
-		0.0f,
-		dirToLight,
-		tmax,
-		SWS_LOC_SHADOW_RAY);
-	return ShadowRay.isShadowed;
-
-}
-vec3 DiffuseShade(vec3 HitPosition, vec3 HitNormal, vec3 HitMatColor, float kd, float ks)
+vec3 DiffuseShade(vec3 HitPosition, vec3 HitNormal, vec3 HitMatColor, float kd, float ks, float shininess)
 {
 	// Get information about this light; access your frameworks scene structs
 	int LightType = int(Params.LightInfo.x);
 	vec3 hitValues = vec3(0);
 
 
-	for (int j = 0; j < MAX_LIGHTS; j++)//SoftShadows
+	for (int j = 0; j < ShadowSamples; j++)//SoftShadows
 	{
 		float r1 = nextRand(PrimaryRay.rndSeed);
 		float r2 = nextRand(PrimaryRay.rndSeed);
@@ -127,7 +124,7 @@ vec3 DiffuseShade(vec3 HitPosition, vec3 HitNormal, vec3 HitMatColor, float kd,
 			const vec3 shadowRayOrigin = HitPosition + HitNormal * 0.001f;
 
 			ShadowRay.attenuation = attenuation;
-			bool isShadowed = shootShadowRay(shadowRayOrigin, dirToLight, 0.001, distToLight);
+			bool isShadowed = shootShadowRay(shadowRayOrigin, dirToLight, distToLight);
 			attenuation = ShadowRay.attenuation;
 
 			if (isShadowed)
@@ -136,29 +133,36 @@ vec3 DiffuseShade(vec3 HitPosition, vec3 HitNormal, vec3 HitMatColor, float kd,
 			}
 			else
 			{
-				specular = computeSpecular(gl_WorldRayDirectionEXT, dirToLight, HitNormal, vec3(ks), 100.0);
+				specular = computeSpecular(gl_WorldRayDirectionEXT, dirToLight, HitNormal, vec3(ks), shininess);
 			}
 		}
 
 		hitValues += vec3(attenuation * lightIntensity * (diffuse + specular));
+		// plus one sample of the emissive geometry with the path tracer's BRDF, nothing else can find it in this mode so no MIS
+		hitValues += sampleEmitters(HitPosition, HitNormal, HitMatColor * kd / M_PI, false, PrimaryRay.rndSeed);
 	}
 
-	vec3 finalcolor = hitValues / float(MAX_LIGHTS);
+	vec3 finalcolor = hitValues / float(ShadowSamples);
 	return finalcolor;
 }
 void main() {
 
 	PrimaryRay.isMiss = false;
 	const uint objId = gl_InstanceCustomIndexEXT;
-	ShadingData hit = getHitShadingData(objId);
+	ShadingData hit = getHitShadingData();
 
-	PrimaryRay.hitValue = DiffuseShade(hit.pos, hit.normal, hit.matColor.xyz, hit.kd, hit.ks);
+	PrimaryRay.hitValue = DiffuseShade(hit.pos, hit.normal, hit.matColor.xyz, hit.kd, hit.ks, hit.shininess);
 	PrimaryRay.matColor = hit.matColor.xyz;
-	if (hit.mat == 3)// Reflection
+	PrimaryRay.hitNormal = hit.normal;
+	PrimaryRay.hitT = gl_HitTEXT;
+	PrimaryRay.meshId = objId;
+	PrimaryRay.primId = uint(gl_PrimitiveID);
+	if (hit.mat == SWS_MAT_MIRROR)// Reflection
 	{
 		vec3 origin = hit.pos;
 		vec3 rayDir = reflection(gl_WorldRayDirectionEXT, hit.normal);
 		PrimaryRay.attenuation *= hit.ks;
+		PrimaryRay.cone = vec2(RayConeWidth(PrimaryRay.cone.x, PrimaryRay.cone.y, gl_HitTEXT), RayConeBounceSpread(PrimaryRay.cone.y, true));
 		PrimaryRay.done = false;
 		PrimaryRay.rayOrigin = origin;
 		PrimaryRay.rayDir = rayDir;
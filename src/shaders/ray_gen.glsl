@@ -1,13 +1,27 @@
 #version 460
 #extension GL_EXT_ray_tracing : enable
 #extension GL_GOOGLE_include_directive : require
-#extension GL_ARB_shader_clock : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
 #include "../shared.h"
 #include "random.glsl"
 
 layout(set = SWS_SCENE_AS_SET, binding = SWS_SCENE_AS_BINDING)            uniform accelerationStructureEXT Scene;
 layout(set = SWS_RESULT_IMAGE_SET, binding = SWS_RESULT_IMAGE_BINDING, rgba8) uniform image2D ResultImage;
+layout(set = SWS_RADIANCE_IMAGE_SET, binding = SWS_RADIANCE_IMAGE_BINDING, rgba32f) uniform image2D RadianceImage;
+layout(set = SWS_AOV_SET, binding = SWS_AOV_ALBEDO_BINDING, rgba8) uniform image2D AlbedoImage;
+layout(set = SWS_AOV_SET, binding = SWS_AOV_DEPTH_BINDING, r32f) uniform image2D DepthImage;
+layout(set = SWS_AOV_SET, binding = SWS_AOV_NORMAL_BINDING, rg16_snorm) uniform image2D NormalImage;
+layout(set = SWS_AOV_SET, binding = SWS_AOV_INSTANCE_ID_BINDING, r32ui) uniform uimage2D InstanceIdImage;
+layout(set = SWS_AOV_SET, binding = SWS_AOV_PRIMITIVE_ID_BINDING, r32ui) uniform uimage2D PrimitiveIdImage;
+
+layout(set = SWS_MESHINFO_SET, binding = 0, std430) readonly buffer meshInfoBuffer {
+	vec4 info[];
+} meshInfoArray[];
+
+layout(set = SWS_MATERIALS_SET, binding = SWS_MATERIALS_BINDING, std430) readonly buffer MaterialsBuffer {
+	MaterialData Materials[];
+};
 
 layout(set = SWS_CAMDATA_SET, binding = SWS_CAMDATA_BINDING, std140)     uniform CameraData{
 	CameraUniformParams Camera;
@@ -19,17 +33,71 @@ layout(set = SWS_UNIFORMPARAMS_SET, binding = SWS_UNIFORMPARAMS_BINDING, std140)
 
 layout(location = SWS_LOC_PRIMARY_RAY) rayPayloadEXT RayPayload PrimaryRay;
 layout(location = SWS_LOC_INDIRECT_RAY) rayPayloadEXT IndirectRayPayload indirectRay;
-vec3 CalcRayDir(vec2 pixel, float aspect) {
+layout(location = SWS_LOC_SHADOW_RAY)  rayPayloadEXT ShadowRayPayload ShadowRay;
+
+#include "lights.glsl"
+#include "textures.glsl"
 
-	pixel.x *= aspect* tan(Camera.nearFarFov.z / 2.0f);
-	pixel.y *= tan(Camera.nearFarFov.z / 2.0f);
+// first-hit AOVs, taken from the very first camera ray of the pixel
+bool aovCaptured = false;
+vec3 aovAlbedo = vec3(1.0);
+vec3 aovNormal = vec3(0.0);
+float aovDepth = 0.0;
+uint aovMeshId = SWS_INVALID_ID;
+uint aovPrimId = SWS_INVALID_ID;
+
+void captureAOVs(bool isMiss, vec3 albedo, vec3 normal, float hitT, uint meshId, uint primId)
+{
+	if (aovCaptured)
+		return;
+	aovCaptured = true;
+	if (!isMiss)
+	{
+		aovAlbedo = albedo;
+		aovNormal = normal;
+		aovDepth = hitT;
+		aovMeshId = meshId;
+		aovPrimId = primId;
+	}
+}
+// octahedral normal encoding, fits a unit vector into two snorm channels
+vec2 OctEncode(vec3 n)
+{
+	n /= (abs(n.x) + abs(n.y) + abs(n.z));
+	vec2 e = n.xy;
+	if (n.z < 0.0)
+		e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return e;
+}
+void storeAOVs()
+{
+	const ivec2 pixel = ivec2(gl_LaunchIDEXT.xy);
+	const uint mask = Params.aovMask.x;
+
+	if ((mask & SWS_AOV_ALBEDO_BIT) != 0)
+		imageStore(AlbedoImage, pixel, vec4(aovAlbedo, 1.f));
+	if ((mask & SWS_AOV_DEPTH_BIT) != 0)
+		imageStore(DepthImage, pixel, vec4(aovDepth));
+	if ((mask & SWS_AOV_NORMAL_BIT) != 0)
+		imageStore(NormalImage, pixel, vec4(aovDepth > 0.0 ? OctEncode(aovNormal) : vec2(0.0), 0.0, 0.0));
+	if ((mask & SWS_AOV_INSTANCE_ID_BIT) != 0)
+		imageStore(InstanceIdImage, pixel, uvec4(aovMeshId));
+	if ((mask & SWS_AOV_PRIMITIVE_ID_BIT) != 0)
+		imageStore(PrimitiveIdImage, pixel, uvec4(aovPrimId));
+}
+// coneSpread - the ray cone's spread angle, what one pixel subtends
+vec3 CalcRayDir(vec2 pixel, float aspect, out float coneSpread) {
+	const float tanHalfFov = tan(Camera.nearFarFov.z / 2.0f);
+	pixel.x *= aspect * tanHalfFov;
+	pixel.y *= tanHalfFov;
+	coneSpread = RayConeCameraSpread(tanHalfFov, float(gl_LaunchSizeEXT.y));
 
 	const vec3 rayDir = normalize(Camera.dir.xyz + (Camera.side.xyz * pixel.x) - (Camera.up.xyz * pixel.y));
 	return rayDir;
 }
-vec3 shootColorRay(vec3 rayOrigin, vec3 rayDirection, float min, float max)
+vec3 shootColorRay(vec3 rayOrigin, vec3 rayDirection, float coneSpread, float min, float max)
 {
-	const uint rayFlags = gl_RayFlagsNoOpaqueEXT;// gl_RayFlagsNoneEXT; ;// gl_RayFlagsOpaqueEXT;
+	const uint rayFlags = gl_RayFlagsNoneEXT; // translucent meshes aren't built opaque, only they run the any-hit
 
 	const uint cullMask = 0xFF;
 	const uint stbRecordStride = 1;
@@ -42,11 +110,13 @@ vec3 shootColorRay(vec3 rayOrigin, vec3 rayDirection, float min, float max)
 	PrimaryRay.rayDir = rayDirection.xyz;
 	PrimaryRay.hitValue = vec3(0);
 	PrimaryRay.attenuation = 1.f;
+	PrimaryRay.isMiss = true;
+	PrimaryRay.cone = vec2(0.0, coneSpread);
 	//PrimaryRay.accColor = vec4(0);
 	
 
 	vec3 hitValue = vec3(0);
-	for (int i = 0; i < SWS_MAX_RECURSION; i++)//for reflective material 
+	for (int i = 0; i < MaxReflections; i++)//for reflective material 
 	{
 		traceRayEXT(Scene,
 			rayFlags,
@@ -60,6 +130,9 @@ vec3 shootColorRay(vec3 rayOrigin, vec3 rayDirection, float min, float max)
 			tmax,
 			SWS_LOC_PRIMARY_RAY);
 
+		if (i == 0)
+			captureAOVs(PrimaryRay.isMiss, PrimaryRay.matColor, PrimaryRay.hitNormal, PrimaryRay.hitT, PrimaryRay.meshId, PrimaryRay.primId);
+
 		hitValue += PrimaryRay.hitValue * PrimaryRay.attenuation;
 		if (PrimaryRay.done)
 			break;
@@ -79,7 +152,7 @@ vec3 raytracer(uint rndSeed)
 	// Do diffuse shading at the primary hit
 	// monte carlo antialiasing
 	vec3 hitValues = vec3(0);
-	for (int smpl = 0; smpl < MAX_ANTIALIASING_ITER; smpl++)
+	for (int smpl = 0; smpl < AntialiasingSamples; smpl++)
 	{
 		float r1 = nextRand(rndSeed);
 		float r2 = nextRand(rndSeed);
@@ -92,64 +165,183 @@ vec3 raytracer(uint rndSeed)
 
 		// Initialize a ray structure for our ray tracer
 		vec3 origin = Camera.pos.xyz;
-		vec3 direction = CalcRayDir(pixel, aspect);
+		float coneSpread;
+		vec3 direction = CalcRayDir(pixel, aspect, coneSpread);
 
 		PrimaryRay.rndSeed = rndSeed;
-		hitValues += shootColorRay(origin, direction, 0.0001, 10000.0);
+		hitValues += shootColorRay(origin, direction, coneSpread, 0.0001, 10000.0);
 		rndSeed = PrimaryRay.rndSeed;
 
 	}
-	return ( hitValues / float(MAX_ANTIALIASING_ITER));
+	return ( hitValues / float(AntialiasingSamples));
+}
+ShadingData getHitShadingData(uint materialId, vec3 pos, vec3 normal, vec2 uv, float lodBias)
+{
+	const MaterialData material = Materials[materialId];
+	ShadingData hit;
+	hit.pos = pos;
+	hit.normal = normal;
+	hit.matColor = materialColor(material, uv, lodBias);
+	hit.kd = material.params.x;
+	hit.ks = material.params.y;
+	hit.mat = int(material.params.z);
+	hit.shininess = material.params.w;
+	hit.emittance = material.emission.rgb;
+	return hit;
 }
-vec3 pathtracerLoop(vec3 origin,vec3 direction)
+// one sample of the scene light (Params.LightPos): Phong diffuse + specular behind a shadow ray. A light term of its
+// own, added to the radiance as is - not a factor of the path's throughput
+vec3 DiffuseShade(vec3 HitPosition, vec3 HitNormal, vec3 viewDir, vec3 HitMatColor, float kd, float ks, float shininess, inout uint seed)
 {
-	////////////////// path tracing ////////////////////////
-	const uint rayFlags = gl_RayFlagsOpaqueEXT;// gl_RayFlagsNoneEXT; 
+	int LightType = int(Params.LightInfo.x);
+	float r1 = nextRand(seed);
+	float r2 = nextRand(seed);
+	float r3 = nextRand(seed);
+
+	vec3 lightPos = Params.LightPos.xyz + vec3(r1, r2, r3);
+	vec3 dirToLight;
+	float distToLight, lightIntensity;
+	if (LightType == 0)// Point light
+	{
+		dirToLight = normalize(lightPos - HitPosition);
+		distToLight = length(lightPos - HitPosition);
+		lightIntensity = Params.LightPos.w / (distToLight * distToLight);
+	}
+	else  // Directional light
+	{
+		dirToLight = normalize(lightPos - vec3(0));
+		distToLight = length(lightPos - vec3(0));
+		lightIntensity = Params.LightPos.w;
+	}
+
+	vec3 diffuse = computeDiffuse(dirToLight, HitNormal, vec3(kd), HitMatColor);
+
+	// Tracing shadow ray only if the light is visible from the surface
+	vec3 specular = vec3(0);
+	float attenuation = 1;
+	if (dot(HitNormal, dirToLight) > 0.0)
+	{
+		ShadowRay.attenuation = attenuation;
+		bool isShadowed = shootShadowRay(HitPosition + HitNormal * 0.001f, dirToLight, distToLight);
+		attenuation = ShadowRay.attenuation;
 
+		if (!isShadowed)
+			specular = computeSpecular(viewDir, dirToLight, HitNormal, vec3(ks), shininess);
+	}
+
+	return vec3(attenuation * lightIntensity * (diffuse + specular));
+}
+// probability for a path to keep going, mirrored by PathTracer::SurvivalProbability
+float russianRouletteSurvival(vec3 throughput)
+{
+	return min(max(throughput.r, max(throughput.g, throughput.b)), SWS_RR_MAX_SURVIVAL);
+}
+// one path, all the bounces are driven from here so the hit shaders never recurse
+vec3 pathtracerLoop(vec3 rayOrigin, vec3 rayDirection, float coneSpread, inout uint seed)
+{
+	const uint rayFlags = gl_RayFlagsOpaqueEXT;
 	const uint cullMask = 0xFF;
 	const uint stbRecordStride = 1;
 	const float tmin = 0.001;
 	const float tmax = 1000.0;
-	vec3 hitValues = vec3(0);
-	for (int p = 0; p < MAX_PATH_TRACED; p++)
+
+	vec3 radiance = vec3(0);
+	vec3 throughput = vec3(1);
+	float bsdfPdf = 0.0; // solid angle pdf of the current ray, 0 for camera rays and perfect reflections (no MIS)
+	vec3 prevNormal = vec3(0);
+	vec2 cone = vec2(0.0, coneSpread); // ray cone at rayOrigin, width & spread
+
+	for (int depth = 0; depth < MaxPathDepth; depth++)
 	{
+		indirectRay.cone = cone;
+		traceRayEXT(Scene,
+			rayFlags,
+			cullMask,
+			SWS_INDIRECT_HIT_SHADERS_IDX,
+			stbRecordStride,
+			SWS_INDIRECT_MISS_SHADERS_IDX,
+			rayOrigin,
+			tmin,
+			rayDirection,
+			tmax,
+			SWS_LOC_INDIRECT_RAY);
+
+		const bool isMiss = (indirectRay.hitT < 0.0);
+		ShadingData hit;
+		if (!isMiss)
+			hit = getHitShadingData(indirectRay.materialId, rayOrigin + rayDirection * indirectRay.hitT, indirectRay.hitNormal, indirectRay.uv, indirectRay.lodBias);
+
+		if (depth == 0)
+			captureAOVs(isMiss, isMiss ? vec3(1.0) : hit.matColor.xyz, indirectRay.hitNormal, indirectRay.hitT, indirectRay.meshId, indirectRay.primId);
+
+		if (isMiss)
+		{
+			// only the camera sees the background, no contribution from the environment after that
+			radiance += throughput * ((depth == 0) ? vec3(Params.clearColor) : vec3(0.001));
+			break;
+		}
 
-		vec3 rayOrigin = origin.xyz;
-		vec3 rayDirection = direction.xyz;
-		indirectRay.weight = vec3(0);
-		indirectRay.rayDepth = 0;
-		indirectRay.hitValue = vec3(0);
-		vec3 curWeight = vec3(1);
-		for (; indirectRay.rayDepth < MAX_PATH_DEPTH; indirectRay.rayDepth++)
+		if (any(greaterThan(hit.emittance, vec3(0.0))))
 		{
+			// light sampling at the previous vertex could have picked this point too, weight it accordingly
+			float misWeight = 1.0;
+			const uint emitter = emitterIndex(indirectRay.meshId, indirectRay.primId);
+			if (emittersSamplingEnabled() && bsdfPdf > 0.0 && emitter != SWS_INVALID_ID)
+			{
+				const float cosLight = max(abs(dot(hit.normal, rayDirection)), 1e-6);
+				const float pdfLight = emitterPdfArea(rayOrigin, prevNormal, emitter) * indirectRay.hitT * indirectRay.hitT / cosLight;
+				misWeight = powerHeuristic(bsdfPdf, pdfLight);
+			}
+			radiance += throughput * hit.emittance * misWeight;
+			break;
+		}
 
-			traceRayEXT(Scene,
-				rayFlags,
-				cullMask,
-				SWS_INDIRECT_HIT_SHADERS_IDX,
-				stbRecordStride,
-				SWS_INDIRECT_MISS_SHADERS_IDX,
-				rayOrigin,
-				tmin,
-				rayDirection,
-				tmax,
-				SWS_LOC_INDIRECT_RAY);
-
-			hitValues += indirectRay.hitValue *curWeight;
-			curWeight *= indirectRay.weight;
-			rayOrigin = indirectRay.rayOrigin;
-			rayDirection = indirectRay.rayDir;
+		if (hit.mat == SWS_MAT_MIRROR)
+		{
+			// Specular BRDF - one incoming direction & one outgoing direction, that is, the perfect reflection direction.
+			throughput *= hit.ks;
+			bsdfPdf = 0.0; // delta distribution, light sampling can't find this direction
+			rayDirection = reflection(rayDirection, hit.normal);
+		}
+		else
+		{
+			// Diffuse BRDF - Lambertian, choose an outgoing direction with cosine weighted hemisphere sampling.
+			const vec3 BRDF = hit.matColor.rgb * hit.kd / M_PI;
+
+			// the scene light (Params.LightPos) is shaded on its own, it's not part of the BRDF
+			radiance += throughput * DiffuseShade(hit.pos, hit.normal, rayDirection, hit.matColor.xyz, hit.kd, hit.ks, hit.shininess, seed);
+			radiance += throughput * sampleEmitters(hit.pos, hit.normal, BRDF, true, seed);
+
+			vec3 tangent, bitangent;
+			createCoordinateSystem(hit.normal, tangent, bitangent);
+			rayDirection = samplingHemisphere(seed, tangent, bitangent, hit.normal);
+
+			// BRDF * cos / pdf, with pdf = cos / pi
+			const float cos_theta = dot(rayDirection, hit.normal);
+			bsdfPdf = max(cos_theta, 1e-6) / M_PI;
+			throughput *= BRDF * cos_theta / bsdfPdf;
+			prevNormal = hit.normal;
 		}
+		rayOrigin = hit.pos;
+		cone = vec2(indirectRay.cone.x, RayConeBounceSpread(cone.y, hit.mat == SWS_MAT_MIRROR));
 
+		// Russian roulette: past a few bounces, stop low contribution paths and boost the survivors to stay unbiased
+		if (depth + 1 >= RouletteMinDepth)
+		{
+			const float survival = russianRouletteSurvival(throughput);
+			if (nextRand(seed) >= survival)
+				break;
+			throughput /= survival;
+		}
 	}
 
-	return (hitValues / float(MAX_PATH_TRACED));
+	return radiance;
 }
 vec3 pathtracer(uint rndSeed)
 {
 	// monte carlo antialiasing
 	vec3 hitValues = vec3(0);
-	for (int smpl = 0; smpl < MAX_ANTIALIASING_ITER; smpl++)
+	for (int smpl = 0; smpl < AntialiasingSamples; smpl++)
 	{
 		float r1 = nextRand(rndSeed);
 		float r2 = nextRand(rndSeed);
@@ -162,20 +354,25 @@ vec3 pathtracer(uint rndSeed)
 
 		// Initialize a ray structure for our ray tracer
 		vec3 origin = Camera.pos.xyz;
-		vec3 direction = CalcRayDir(pixel, aspect);
+		float coneSpread;
+		vec3 direction = CalcRayDir(pixel, aspect, coneSpread);
 
-		indirectRay.rndSeed = rndSeed;
-		hitValues += pathtracerLoop(origin, direction);
-		rndSeed = indirectRay.rndSeed;
+		vec3 pathValues = vec3(0);
+		for (int p = 0; p < PathsPerSample; p++)
+		{
+			pathValues += pathtracerLoop(origin, direction, coneSpread, rndSeed);
+		}
+		hitValues += pathValues / float(PathsPerSample);
 
 	}
-	return (hitValues / float(MAX_ANTIALIASING_ITER));
+	return (hitValues / float(AntialiasingSamples));
 }
 void main() {
-	int mode = int(Params.modeFrame.x);
+	// specialized pipelines only keep the branch of their mode
+	int mode = (RenderMode != 0) ? RenderMode : int(Params.modeFrame.x);
 	float deltaTime = Params.modeFrame.y;
-	// Initialize the random number
-	uint rndSeed = tea(gl_LaunchIDEXT.y * gl_LaunchSizeEXT.x + gl_LaunchIDEXT.x, int(clockARB()));
+	// Initialize the random number, seeded per frame by the app so replays render the same samples
+	uint rndSeed = tea(gl_LaunchIDEXT.y * gl_LaunchSizeEXT.x + gl_LaunchIDEXT.x, int(Params.modeFrame.z));
 
 
 	vec3 color = vec3(0.3);
@@ -190,16 +387,16 @@ void main() {
 		color = pathtracer(rndSeed);
 	}
 
-	// Do accumulation over time
+	// Do accumulation over time, in float: the 8 bit result image is only what gets displayed
 	if (deltaTime > 0)
 	{
 		float a = 1.0f / float(deltaTime + 1);
-		vec3  old_color = imageLoad(ResultImage, ivec2(gl_LaunchIDEXT.xy)).xyz;
-		imageStore(ResultImage, ivec2(gl_LaunchIDEXT.xy), vec4(mix(old_color, color, a), 1.f));
-	}
-	else
-	{
-		// First frame, replace the value in the buffer
-		imageStore(ResultImage, ivec2(gl_LaunchIDEXT.xy), vec4(color, 1.f));
+		vec3  old_color = imageLoad(RadianceImage, ivec2(gl_LaunchIDEXT.xy)).xyz;
+		color = mix(old_color, color, a);
 	}
+	// on the first frame it simply replaces the value in the buffer
+	imageStore(RadianceImage, ivec2(gl_LaunchIDEXT.xy), vec4(color, 1.f));
+	imageStore(ResultImage, ivec2(gl_LaunchIDEXT.xy), vec4(clamp(color, 0.0, 1.0), 1.f));
+
+	storeAOVs();
 }
\ No newline at end of file
@@ -15,4 +15,6 @@ void main() {
 	//else
 	PrimaryRay.hitValue = vec3(Params.clearColor);
 	PrimaryRay.isMiss = true;
+	PrimaryRay.meshId = SWS_INVALID_ID;
+	PrimaryRay.primId = SWS_INVALID_ID;
 }
\ No newline at end of file
@@ -0,0 +1,31 @@
+// The scene's textures, streamed by the CPU (see TextureCache): a texture id maps to a bindless slot through
+// TextureSlots (SWS_INVALID_ID while it isn't resident, the material's color is all there is until then), every
+// lookup stamps TextureUse with the frame's stamp, resident or not, that's what the cache loads & evicts by.
+// Needs GL_EXT_nonuniform_qualifier enabled and the AppData uniform block declared before inclusion.
+
+layout(set = SWS_TEXTURES_SET, binding = 0) uniform sampler2D Textures[];
+
+layout(set = 0, binding = SWS_TEXTURE_SLOTS_BINDING, std430) readonly buffer TextureSlotsBuffer {
+	uint TextureSlots[];
+};
+
+layout(set = 0, binding = SWS_TEXTURE_USE_BINDING, std430) buffer TextureUseBuffer {
+	uint TextureUse[];
+};
+
+// the diffuse color at uv, the map's texels modulated by the material's color. lodBias - the hit's RayConeLodBias
+vec4 materialColor(MaterialData material, vec2 uv, float lodBias) {
+	const uint id = material.textures.x;
+	if (id == SWS_INVALID_ID)
+		return material.color;
+
+	// plain stores, any of the lanes racing for it writes the same value
+	if (TextureUse[id] != Params.textureInfo.x)
+		TextureUse[id] = Params.textureInfo.x;
+
+	const uint slot = TextureSlots[id];
+	if (slot == SWS_INVALID_ID)
+		return material.color;
+	const float lod = RayConeTextureLod(lodBias, vec2(textureSize(Textures[nonuniformEXT(slot)], 0)));
+	return vec4(material.color.rgb * textureLod(Textures[nonuniformEXT(slot)], uv, lod).rgb, material.color.a);
+}
@@ -4,9 +4,16 @@
 #ifdef __cplusplus
 // include vec & mat types (same namings as in GLSL)
 #include "framework/common.h"
+// helpers below get compiled into every C++ translation unit that includes this file
+#define SWS_INLINE inline
+#else
+#define SWS_INLINE
 #endif // __cplusplus
-#define MAX_LIGHTS			 	5
-#define MAX_PATH_DEPTH			 	5
+// quality defaults, the "final" preset: the ray tracing pipeline gets them as specialization constants (SWS_SC_*)
+#define MAX_LIGHTS			 	5       // soft shadow samples of the ray tracer mode
+#define MAX_PATH_DEPTH			 	8
+#define SWS_RR_MIN_DEPTH			3       // russian roulette kicks in after this many bounces
+#define SWS_RR_MAX_SURVIVAL			0.95f   // even bright paths get a chance to stop
 #define MAX_PATH_TRACED			50
 #define MAX_ANTIALIASING_ITER   5
 //
@@ -17,6 +24,11 @@
 
 #define SWS_SHADOW_HIT_SHADERS_IDX       2
 #define SWS_SHADOW_MISS_SHADERS_IDX      2
+#define SWS_NUM_HIT_GROUPS               3   // per SBT record, a mesh's record starts at slot * SWS_NUM_HIT_GROUPS
+
+// AnalyticPrimitive::info.x, also the hit kind the intersection shader reports them with (triangles' are 0xFE / 0xFF)
+#define SWS_ANALYTIC_SPHERE              0u
+#define SWS_ANALYTIC_CAPSULE             1u
 ///////////////////////////////////////////
 // resource locations
 #define SWS_SCENE_AS_SET                0
@@ -31,12 +43,60 @@
 #define SWS_UNIFORMPARAMS_SET           0
 #define SWS_UNIFORMPARAMS_BINDING       3
 
+// first-hit AOVs, AOV i lives at binding SWS_AOV_FIRST_BINDING + i
+#define SWS_AOV_SET                     0
+#define SWS_AOV_FIRST_BINDING           4
+#define SWS_AOV_ALBEDO_BINDING          4   // rgba8
+#define SWS_AOV_DEPTH_BINDING           5   // r32f, hit distance along the camera ray
+#define SWS_AOV_NORMAL_BINDING          6   // rg16_snorm, octahedral encoded world normal
+#define SWS_AOV_INSTANCE_ID_BINDING     7   // r32ui
+#define SWS_AOV_PRIMITIVE_ID_BINDING    8   // r32ui
+#define SWS_NUM_AOVS                    5
+
+// UniformParams::aovMask.x bits, only the enabled AOVs get written
+#define SWS_AOV_ALBEDO_BIT              0x01u
+#define SWS_AOV_DEPTH_BIT               0x02u
+#define SWS_AOV_NORMAL_BIT              0x04u
+#define SWS_AOV_INSTANCE_ID_BIT         0x08u
+#define SWS_AOV_PRIMITIVE_ID_BIT        0x10u
+#define SWS_AOV_ALL_BITS                0x1Fu
+
+// emissive triangles + their alias table (EmissiveTriangle[]) and the light BVH over them (LightBVHNode[]), two sets
+// of each: the one frames read and the one the next emitters go in (UniformParams::emissiveInfo.w)
+#define SWS_LIGHTS_SET                  0
+#define SWS_LIGHTS_BINDING              9
+#define SWS_LIGHT_NODES_BINDING         10
+
+// the scene's materials (MaterialData[]), a triangle's is Materials[faces.w]
+#define SWS_MATERIALS_SET               0
+#define SWS_MATERIALS_BINDING           11
+
+// MaterialData::params.z
+#define SWS_MAT_DIFFUSE                 0
+#define SWS_MAT_MIRROR                  3   // ray traced reflection
+
+// the texture cache's tables (uint per texture id): TextureSlots[id] - bindless slot of the resident ones
+// (SWS_INVALID_ID otherwise), TextureUse[id] - stamped with UniformParams::textureInfo.x whenever it's sampled
+#define SWS_TEXTURE_SLOTS_BINDING       12
+#define SWS_TEXTURE_USE_BINDING         13
+
+// rgba32f, the radiance accumulated over the frames: ResultImage is its clamped 8 bit copy, the denoiser reads this one
+#define SWS_RADIANCE_IMAGE_SET          0
+#define SWS_RADIANCE_IMAGE_BINDING      14
+
+// UniformParams::emissiveInfo.z, how the emitter to sample is picked
+#define SWS_EMITTERS_OFF                0u
+#define SWS_EMITTERS_POWER              1u  // proportional to power, through the alias table
+#define SWS_EMITTERS_LIGHT_BVH          2u  // stochastic light BVH traversal, accounts for distance & orientation
+#define SWS_NUM_EMITTERS_MODES          3u
+
 //////////////////////////////////////////
 #define SWS_ATTRIBS_SET                 1
 #define SWS_FACES_SET                   2
 #define SWS_MESHINFO_SET                3
+#define SWS_TEXTURES_SET                4   // sampler2D[], indexed by TextureSlots[]
 
-#define SWS_NUM_SETS                    4
+#define SWS_NUM_SETS                    5
 /////////////////////////////////////////
 // cross-shader locations
 #define SWS_LOC_PRIMARY_RAY             0
@@ -45,7 +105,33 @@
 #define SWS_LOC_INDIRECT_RAY            3
 #define SWS_LOC_INDIRECT_RAY2            4
 
-#define SWS_MAX_RECURSION               10
+#define SWS_MAX_RECURSION               10      // mirror bounces of the ray tracer mode
+
+// specialization constant ids. Every variant of the ray tracing pipeline is built with all of them set,
+// a blob used as is runs with the defaults below
+#define SWS_SC_RENDER_MODE              0       // 0 - Params.modeFrame.x picks the mode at runtime
+#define SWS_SC_ANTIALIASING_SAMPLES     1
+#define SWS_SC_PATHS_PER_SAMPLE         2
+#define SWS_SC_MAX_PATH_DEPTH           3
+#define SWS_SC_RR_MIN_DEPTH             4
+#define SWS_SC_SHADOW_SAMPLES           5
+#define SWS_SC_MAX_REFLECTIONS          6
+#define SWS_NUM_SPEC_CONSTANTS          7
+
+#ifndef __cplusplus
+layout(constant_id = SWS_SC_RENDER_MODE)            const int RenderMode = 0;
+layout(constant_id = SWS_SC_ANTIALIASING_SAMPLES)   const int AntialiasingSamples = MAX_ANTIALIASING_ITER;
+layout(constant_id = SWS_SC_PATHS_PER_SAMPLE)       const int PathsPerSample = MAX_PATH_TRACED;
+layout(constant_id = SWS_SC_MAX_PATH_DEPTH)         const int MaxPathDepth = MAX_PATH_DEPTH;
+layout(constant_id = SWS_SC_RR_MIN_DEPTH)           const int RouletteMinDepth = SWS_RR_MIN_DEPTH;
+layout(constant_id = SWS_SC_SHADOW_SAMPLES)         const int ShadowSamples = MAX_LIGHTS;
+layout(constant_id = SWS_SC_MAX_REFLECTIONS)        const int MaxReflections = SWS_MAX_RECURSION;
+#endif // __cplusplus
+
+#define SWS_INVALID_ID                  0xFFFFFFFFu   // instance & primitive id AOVs on a miss
+
+// ray cones: how much a diffuse bounce opens the cone up (radians), it only follows one direction of the lobe
+#define SWS_RAY_CONE_DIFFUSE_SPREAD     0.2f
 //////////////////////////////////////////
 struct RayPayload {
 	uint rndSeed;// used in anyhit
@@ -58,18 +144,24 @@ struct RayPayload {
 	vec3 rayDir;
 	float attenuation;
 	bool done;
+	// first hit info for AOVs
+	vec3 hitNormal;
+	float hitT;
+	uint meshId;
+	uint primId;
+	// ray cone: x - footprint width at rayOrigin, y - spread angle. The hit sets the reflected ray's
+	vec2 cone;
 };
+// path tracer rays only bring back what they hit, the bounce loop lives in ray_gen.glsl
 struct IndirectRayPayload {
 	vec3 hitNormal;
-	vec3 hitPos;
-	vec3 hitColor;
-	vec3 hitValue;
-	bool isMiss;
-	uint rndSeed; // current random seed
-	int rayDepth;
-	vec3 weight;
-	vec3 rayOrigin;
-	vec3 rayDir;
+	float hitT;     // negative on a miss
+	uint meshId;
+	uint primId;
+	uint materialId;
+	vec2 uv;
+	vec2 cone;      // ray cone: x - footprint width at the origin, y - spread angle. The hit sets x to the width there
+	float lodBias;  // texture LOD of the hit for a 1x1 texture (RayConeLodBias)
 };
 struct ShadowRayPayload {
 	bool isShadowed;
@@ -77,7 +169,7 @@ struct ShadowRayPayload {
 };
 struct VertexAttribute {
     vec4 normal;
-    vec4 uv;
+    vec4 uv;        // z - its triangle's TriangleLodConstant (vertices aren't shared)
 };
 struct ShadingData {
 	vec4 matColor;
@@ -87,6 +179,7 @@ struct ShadingData {
 	vec3 pos;
 	int mat;
 	float ks, kd;
+	float shininess;
 };
 // packed std140
 struct CameraUniformParams {
@@ -102,19 +195,58 @@ struct UniformParams {
 	// Lighting
 	vec4 LightPos;
 	vec4 LightInfo;
-	vec4 modeFrame;
+	vec4 modeFrame;     // x - mode, y - accumulation (0 starts over), z - random seed of the frame
+	uvec4 aovMask;
+	vec4 emissiveInfo; // x - number of emissive triangles, y - 1 / sum(area * luminance), z - SWS_EMITTERS_* mode, w - first triangle of the set the frame reads
+	uvec4 textureInfo; // x - the frame's texture use stamp (TextureCache::GetStamp)
+};
+// packed std430, one per emissive triangle, the alias table entry lives alongside
+struct EmissiveTriangle {
+	vec4 v0;        // xyz - position, w - area
+	vec4 v1;        // xyz - position, w - alias table probability
+	vec4 v2;        // xyz - position, w - probability of this triangle being picked
+	vec4 emission;  // rgb - radiance
+	uvec4 info;     // x - alias index, y - instance id, z - primitive id, w - path to its light BVH leaf (bit i set = second child at depth i)
+};
+// packed std430, same layout as LightBVH::Node
+struct LightBVHNode {
+	vec4 boundsMin; // xyz - aabb min, w - power of all the emitters below
+	vec4 boundsMax; // xyz - aabb max, w - cos of the normals spread around the axis
+	vec4 axis;      // xyz - normals cone axis, w - cos of the emission spread around every normal
+	uvec4 info;     // x - first child (emitter index for leaves), y - second child, z - 1 for leaves
+};
+
+// packed std430, one per distinct material of the scene (MaterialTable::Material)
+struct MaterialData {
+	vec4 color;     // rgb - diffuse color, a - opacity
+	vec4 params;    // x - kd, y - ks, z - SWS_MAT_* type, w - shininess
+	vec4 emission;  // rgb - radiance
+	uvec4 textures; // x - diffuse map (texture id), SWS_INVALID_ID for none
+};
+// packed std430, the shaderRecordEXT data of a mesh's SBT record (after the handle of each of its hit groups)
+struct HitRecordData {
+	MaterialData material;  // copy of Materials[info.x], when there's one
+	uvec4 addresses;        // xy - faces buffer device address, zw - attribs buffer device address (low, high)
+	uvec4 info;             // x - the material of all its triangles, SWS_INVALID_ID when they differ (faces.w)
+};
+// packed std430, one per sphere / capsule of the scene file, where an analytic mesh's faces address points to.
+// Its AABB is primitive gl_PrimitiveID of the mesh's procedural BLAS
+struct AnalyticPrimitive {
+	vec4 p0;        // xyz - sphere center / capsule first end, w - radius
+	vec4 p1;        // xyz - capsule second end
+	uvec4 info;     // x - SWS_ANALYTIC_* type, y - material
 };
 
 // shaders helper functions
-vec2 BaryLerp(vec2 a, vec2 b, vec2 c, vec3 barycentrics) {
+SWS_INLINE vec2 BaryLerp(vec2 a, vec2 b, vec2 c, vec3 barycentrics) {
     return a * barycentrics.x + b * barycentrics.y + c * barycentrics.z;
 }
 
-vec3 BaryLerp(vec3 a, vec3 b, vec3 c, vec3 barycentrics) {
+SWS_INLINE vec3 BaryLerp(vec3 a, vec3 b, vec3 c, vec3 barycentrics) {
     return a * barycentrics.x + b * barycentrics.y + c * barycentrics.z;
 }
 
-float LinearToSrgb(float channel) {
+SWS_INLINE float LinearToSrgb(float channel) {
     if (channel <= 0.0031308f) {
         return 12.92f * channel;
     } else {
@@ -122,10 +254,158 @@ float LinearToSrgb(float channel) {
     }
 }
 
-vec3 LinearToSrgb(vec3 linear) {
+SWS_INLINE vec3 LinearToSrgb(vec3 linear) {
     return vec3(LinearToSrgb(linear.r), LinearToSrgb(linear.g), LinearToSrgb(linear.b));
 }
 
+// Ray cones, texture LOD without screen space derivatives (Akenine-Moller et al., "Texture Level of Detail Strategies
+// for Real-Time Ray Tracing"): a ray carries its footprint's width at its origin and the angle it spreads by, the
+// width at a hit over the triangle's texel density picks the mip.
+
+// camera rays: CalcRayDir spreads the image's height over [0, tanHalfFovY] of a plane 1 away, one pixel's worth
+SWS_INLINE float RayConeCameraSpread(float tanHalfFovY, float imageHeight) {
+    return atan(tanHalfFovY / ((imageHeight > 2.0f) ? (imageHeight - 1.0f) : 1.0f));
+}
+
+// the footprint's width once the ray went hitT (spread is small, tan(spread) ~ spread)
+SWS_INLINE float RayConeWidth(float width, float spread, float hitT) {
+    return width + spread * hitT;
+}
+
+// the spread of the ray leaving a surface: a mirror keeps it (flat surfaces assumed), a diffuse bounce widens it
+SWS_INLINE float RayConeBounceSpread(float spread, bool mirror) {
+    return mirror ? spread : (spread + SWS_RAY_CONE_DIFFUSE_SPREAD);
+}
+
+// 0.5 * log2(uv area / world area): the LOD of a 1x1 texture under a footprint 1 wide, at normal incidence.
+// 0 for triangles without uvs (a single texel, any mip does) or without area
+SWS_INLINE float TriangleLodConstant(vec3 p0, vec3 p1, vec3 p2, vec2 uv0, vec2 uv1, vec2 uv2) {
+    const vec2 e1 = uv1 - uv0;
+    const vec2 e2 = uv2 - uv0;
+    const float uvArea = e1.x * e2.y - e1.y * e2.x;     // both doubled, the ratio's the same
+    const float worldArea = length(cross(p1 - p0, p2 - p0));
+    const float absUvArea = (uvArea < 0.0f) ? -uvArea : uvArea;
+    if (absUvArea <= 0.0f || worldArea <= 0.0f) {
+        return 0.0f;
+    }
+    return 0.5f * log2(absUvArea / worldArea);
+}
+
+// everything of the LOD but the texture's size: the footprint over the triangle, stretched on grazing hits.
+// cosTheta - between the ray & the surface normal
+SWS_INLINE float RayConeLodBias(float lodConstant, float width, float cosTheta) {
+    const float absWidth = (width < 0.0f) ? -width : width;
+    const float absCos = (cosTheta < 0.0f) ? -cosTheta : cosTheta;
+    return lodConstant + log2((absWidth > 1e-20f) ? absWidth : 1e-20f) - log2((absCos > 1e-4f) ? absCos : 1e-4f);
+}
+
+// the mip of a texture that size, unclamped (the sampler clamps to its levels)
+SWS_INLINE float RayConeTextureLod(float lodBias, vec2 textureSize) {
+    return lodBias + 0.5f * log2(textureSize.x * textureSize.y);
+}
+
+// Analytic primitives: the intersection shader (analytic_ray_rint.glsl) and the host harness (primitivebench) share
+// these. A hit is the nearest t in [tMin, tMax] where the ray meets the surface, from outside or from inside, and
+// -1 when there's none. dir doesn't have to be normalized, t is in its units.
+
+SWS_INLINE float IntersectSphere(vec3 center, float radius, vec3 origin, vec3 dir, float tMin, float tMax) {
+    const vec3 oc = origin - center;
+    const float a = dot(dir, dir);
+    const float b = dot(oc, dir);
+    const float c = dot(oc, oc) - radius * radius;
+    const float h = b * b - a * c;
+    if (h < 0.0f) {
+        return -1.0f;
+    }
+    const float s = sqrt(h);
+    const float tNear = (-b - s) / a;
+    if (tNear >= tMin && tNear <= tMax) {
+        return tNear;
+    }
+    const float tFar = (-b + s) / a;
+    return (tFar >= tMin && tFar <= tMax) ? tFar : -1.0f;
+}
+
+// every point within radius of the segment p0 - p1: a cylinder cut at the ends, plus the halves of the two end
+// spheres past them. Only the parts on the capsule's surface count, so rays starting inside find their way out
+SWS_INLINE float IntersectCapsule(vec3 p0, vec3 p1, float radius, vec3 origin, vec3 dir, float tMin, float tMax) {
+    const vec3 axis = p1 - p0;
+    const vec3 o0 = origin - p0;
+    const float axisSq = dot(axis, axis);
+    const float axisDir = dot(axis, dir);
+    const float axisO0 = dot(axis, o0);
+    const float dirSq = dot(dir, dir);
+    float best = -1.0f;
+
+    // the cylinder, scaled by axisSq so nothing gets divided. Rays along the axis never hit it, only the caps
+    const float a = axisSq * dirSq - axisDir * axisDir;
+    const float b = axisSq * dot(o0, dir) - axisO0 * axisDir;
+    const float c = axisSq * dot(o0, o0) - axisO0 * axisO0 - radius * radius * axisSq;
+    const float h = b * b - a * c;
+    if (a > 1e-6f * axisSq * dirSq && h >= 0.0f) {
+        const float s = sqrt(h);
+        for (int i = 0; i < 2; ++i) {
+            const float t = (-b + ((i == 0) ? -s : s)) / a;
+            const float along = axisO0 + t * axisDir;   // axisSq * where it is along the segment
+            if (t >= tMin && t <= tMax && along >= 0.0f && along <= axisSq && (best < 0.0f || t < best)) {
+                best = t;
+            }
+        }
+    }
+
+    // the caps, the end sphere's points on the far side of its end
+    for (int e = 0; e < 2; ++e) {
+        const vec3 oc = (e == 0) ? o0 : (origin - p1);
+        const float cb = dot(oc, dir);
+        const float cc = dot(oc, oc) - radius * radius;
+        const float ch = cb * cb - dirSq * cc;
+        if (ch < 0.0f) {
+            continue;
+        }
+        const float s = sqrt(ch);
+        for (int i = 0; i < 2; ++i) {
+            const float t = (-cb + ((i == 0) ? -s : s)) / dirSq;
+            const float along = axisO0 + t * axisDir;
+            const bool onCap = (e == 0) ? (along <= 0.0f) : (along >= axisSq);
+            if (onCap && t >= tMin && t <= tMax && (best < 0.0f || t < best)) {
+                best = t;
+            }
+        }
+    }
+    return best;
+}
+
+SWS_INLINE float IntersectAnalyticPrimitive(AnalyticPrimitive primitive, vec3 origin, vec3 dir, float tMin, float tMax) {
+    if (primitive.info.x == SWS_ANALYTIC_CAPSULE) {
+        return IntersectCapsule(vec3(primitive.p0), vec3(primitive.p1), primitive.p0.w, origin, dir, tMin, tMax);
+    }
+    return IntersectSphere(vec3(primitive.p0), primitive.p0.w, origin, dir, tMin, tMax);
+}
+
+// outwards, of a point on the surface
+SWS_INLINE vec3 AnalyticPrimitiveNormal(AnalyticPrimitive primitive, vec3 pos) {
+    vec3 center = vec3(primitive.p0);
+    if (primitive.info.x == SWS_ANALYTIC_CAPSULE) {
+        const vec3 axis = vec3(primitive.p1) - center;
+        const float axisSq = dot(axis, axis);
+        float along = (axisSq > 0.0f) ? (dot(pos - center, axis) / axisSq) : 0.0f;
+        along = (along < 0.0f) ? 0.0f : ((along > 1.0f) ? 1.0f : along);
+        center = center + axis * along;
+    }
+    return normalize(pos - center);
+}
+
+// TriangleLodConstant of the shaders' latitude / longitude mapping of the normal: the whole uv square over the
+// surface's area. A capsule's cylinder stretches its equator, its area still spreads the texels
+SWS_INLINE float AnalyticPrimitiveLodConstant(AnalyticPrimitive primitive) {
+    const float radius = primitive.p0.w;
+    float area = 4.0f * 3.14159265f * radius * radius;
+    if (primitive.info.x == SWS_ANALYTIC_CAPSULE) {
+        area += 2.0f * 3.14159265f * radius * length(vec3(primitive.p1) - vec3(primitive.p0));
+    }
+    return (area > 0.0f) ? (-0.5f * log2(area)) : 0.0f;
+}
+
 
 
 
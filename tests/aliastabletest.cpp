@@ -0,0 +1,105 @@
+#include "testing.h"
+
+#include "framework/aliastable.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+// random tables: a fifth of the weights zero, a tenth of them huge
+static std::vector<float> RandomWeights(std::mt19937& rng) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<float> weights(1 + rng() % 300);
+    for (float& w : weights) {
+        const float r = uniform(rng);
+        w = (r < 0.2f) ? 0.0f : ((r < 0.3f) ? 1000.0f * uniform(rng) : uniform(rng));
+    }
+    return weights;
+}
+
+static void TestDistribution() {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    for (int t = 0; t < 50; ++t) {
+        const std::vector<float> weights = RandomWeights(rng);
+        const size_t n = weights.size();
+        double total = 0.0;
+        for (const float w : weights) {
+            total += w;
+        }
+
+        AliasTable table;
+        const bool built = table.Build(weights);
+        CHECK(built == (total > 0.0));
+        if (!built) {
+            continue;
+        }
+        CHECK(table.GetSize() == n);
+
+        // the exact pmf the entries encode, every bin has 1/n to be picked and splits it with its alias
+        std::vector<double> pmf(n, 0.0);
+        for (size_t i = 0; i < n; ++i) {
+            const AliasTable::Entry& entry = table.GetEntries()[i];
+            CHECK(entry.alias < n);
+            pmf[i] += entry.probability / static_cast<double>(n);
+            pmf[entry.alias] += (1.0 - entry.probability) / static_cast<double>(n);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            CHECK_NEAR(pmf[i], weights[i] / total, 1e-6);
+            CHECK_NEAR(table.GetPdf(static_cast<uint32_t>(i)), weights[i] / total, 1e-6);
+            // a zero weight emitter is never picked, not even through an alias
+            if (weights[i] == 0.0f) {
+                CHECK(pmf[i] < 1e-7);
+            }
+        }
+
+        // and what Sample() actually returns: chi-square against the weights, ~6 sigma of slack
+        const int numSamples = 200000;
+        std::vector<int> histogram(n, 0);
+        for (int k = 0; k < numSamples; ++k) {
+            const uint32_t index = table.Sample(uniform(rng));
+            CHECK(index < n);
+            ++histogram[std::min<size_t>(index, n - 1)];
+        }
+        double chiSquare = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            const double expected = numSamples * weights[i] / total;
+            if (expected > 0.0) {
+                chiSquare += (histogram[i] - expected) * (histogram[i] - expected) / expected;
+            } else {
+                CHECK(histogram[i] == 0);
+            }
+        }
+        CHECK(chiSquare < n + 6.0 * std::sqrt(2.0 * n) + 20.0);
+    }
+}
+
+static void TestEdgeCases() {
+    // nothing to sample
+    AliasTable table;
+    CHECK(!table.Build(std::vector<float>(5, 0.0f)));
+    CHECK(!table.Build(std::vector<float>()));
+
+    AliasTable one;
+    CHECK(one.Build(std::vector<float>(1, 3.0f)));
+    CHECK(one.Sample(0.0f) == 0);
+    CHECK(one.Sample(0.999999f) == 0);
+    CHECK(one.GetPdf(0) == 1.0f);
+    CHECK_NEAR(one.GetTotalWeight(), 3.0, 1e-9);
+
+    // u right below 1 stays in range
+    std::vector<float> weights(7, 1.0f);
+    weights[6] = 0.0f;
+    AliasTable last;
+    CHECK(last.Build(weights));
+    CHECK(last.Sample(0.99999994f) < 6);
+}
+
+int main() {
+    TestDistribution();
+    TestEdgeCases();
+
+    return TEST_RESULT();
+}
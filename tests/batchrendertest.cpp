@@ -0,0 +1,216 @@
+#include "testing.h"
+
+#include "framework/batchrender.h"
+
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <vector>
+
+static BatchRender::Settings MakeSettings(const uint32_t numFrames, const uint32_t maxPasses, const float errorThreshold) {
+    BatchRender::Settings settings;
+    settings.numFrames = numFrames;
+    settings.maxPasses = maxPasses;
+    settings.errorThreshold = errorThreshold;
+    settings.frameRate = 24.0f;
+    settings.resume = false;
+    settings.extension = "exr";
+    return settings;
+}
+
+struct Readback {
+    uint32_t    frameIndex;
+    uint32_t    passIndex;
+    bool        isFinal;
+};
+
+// the render loop of a headless run: the readback of a pass comes back numInFlight passes later, its image is what
+// image() makes of the frame & the passes accumulated. Returns the passes every frame took
+template <typename ImageFn>
+static std::vector<uint32_t> Run(BatchRender& batch, const size_t numInFlight, ImageFn image) {
+    const size_t numPixels = 64;
+    std::vector<uint32_t> passes;
+    std::deque<Readback> inFlight;
+    uint32_t numFirstPasses = 0;
+    for (int guard = 0; !batch.IsFinished() && guard < 100000; ++guard) {
+        if (inFlight.size() == numInFlight) {
+            const Readback readback = inFlight.front();
+            inFlight.pop_front();
+            if (!readback.isFinal && batch.NeedsSnapshot(readback.frameIndex)) {
+                const std::vector<uint8_t> texels = image(readback.frameIndex, readback.passIndex + 1, numPixels);
+                batch.AddSnapshot(texels.data(), numPixels, readback.frameIndex, readback.passIndex);
+            }
+        }
+
+        numFirstPasses += batch.BeginPass() ? 1 : 0;
+        inFlight.push_back({ batch.GetFrame(), batch.GetPass(), batch.IsPassFinal() });
+        if (batch.IsPassFinal()) {
+            passes.push_back(batch.GetPass() + 1);
+        }
+        batch.EndPass();
+    }
+    CHECK(numFirstPasses == passes.size());
+    return passes;
+}
+
+// the same image whatever the passes: converged from the start
+static std::vector<uint8_t> Converged(const uint32_t, const uint32_t, const size_t numPixels) {
+    return std::vector<uint8_t>(numPixels * 4, 128);
+}
+
+static void TestFixedPasses() {
+    BatchRender batch;
+    batch.Initialize(MakeSettings(3, 5, 0.0f));
+    CHECK(batch.GetNumFrames() == 3);
+    CHECK(!batch.NeedsSnapshot(0));
+    const std::vector<uint32_t> passes = Run(batch, 2, Converged);
+    CHECK(passes.size() == 3);
+    for (const uint32_t n : passes) {
+        CHECK(n == 5);
+    }
+    CHECK(batch.GetFrame() == 3);
+
+    // one pass per frame, each one final
+    batch.Initialize(MakeSettings(4, 1, 0.0f));
+    CHECK(Run(batch, 3, Converged) == std::vector<uint32_t>(4, 1));
+}
+
+static void TestAdaptive() {
+    // converged frames stop at the minimum passes, give or take the estimate trailing behind
+    BatchRender batch;
+    batch.Initialize(MakeSettings(3, 64, 0.05f));
+    const std::vector<uint32_t> converged = Run(batch, 2, Converged);
+    CHECK(converged.size() == 3);
+    for (const uint32_t n : converged) {
+        CHECK(n >= 4 && n <= 6);
+    }
+
+    // the running mean of noisy passes around a mid grey, the way the accumulation makes it: sigma 30 is ~25
+    // passes for 5%, ~150 for 2%
+    std::mt19937 rng(7);
+    std::normal_distribution<float> normal(0.0f, 30.0f);
+    std::vector<std::vector<float>> sums;     // per frame, the sum of the passes made so far
+    std::vector<uint32_t> numSummed;
+    const auto noisy = [&](const uint32_t frame, const uint32_t numPasses, const size_t numPixels) {
+        if (sums.size() <= frame) {
+            sums.resize(frame + 1, std::vector<float>(numPixels * 4, 0.0f));
+            numSummed.resize(frame + 1, 0);
+        }
+        for (; numSummed[frame] < numPasses; ++numSummed[frame]) {
+            for (float& s : sums[frame]) {
+                s += 128.0f + normal(rng);
+            }
+        }
+        std::vector<uint8_t> texels(numPixels * 4);
+        for (size_t i = 0; i < texels.size(); ++i) {
+            const float v = sums[frame][i] / static_cast<float>(numPasses);
+            texels[i] = static_cast<uint8_t>(std::fmin(std::fmax(v + 0.5f, 0.0f), 255.0f));
+        }
+        return texels;
+    };
+    batch.Initialize(MakeSettings(2, 256, 0.05f));
+    const std::vector<uint32_t> loose = Run(batch, 2, noisy);
+    sums.clear();
+    numSummed.clear();
+    batch.Initialize(MakeSettings(2, 256, 0.02f));
+    const std::vector<uint32_t> tight = Run(batch, 2, noisy);
+    CHECK(loose.size() == 2 && tight.size() == 2);
+    for (size_t i = 0; i < loose.size() && i < tight.size(); ++i) {
+        printf("frame %u: %u passes at 5%%, %u at 2%%\n", static_cast<uint32_t>(i), loose[i], tight[i]);
+        CHECK(loose[i] > 4 && loose[i] < 256);
+        CHECK(tight[i] > loose[i]);
+        CHECK(tight[i] <= 256);
+    }
+
+    // a snapshot of the frame before doesn't count towards the next one
+    batch.Initialize(MakeSettings(2, 64, 0.05f));
+    batch.BeginPass();
+    batch.EndPass();
+    CHECK(batch.NeedsSnapshot(0) && !batch.NeedsSnapshot(1));
+}
+
+static void TestResume() {
+    // frames 0 & 1 are there, 3 too - the render starts over at the first one missing
+    const std::string extension = "batchrendertest";
+    const uint32_t written[] = { 0, 1, 3 };
+    for (const uint32_t index : written) {
+        FILE* file = fopen(BatchRender::GetFrameFileName(index, extension).c_str(), "wb");
+        CHECK(file != nullptr);
+        if (file) {
+            fclose(file);
+        }
+    }
+    CHECK(BatchRender::GetFrameFileName(12, "exr") == "frame_00012.exr");
+
+    BatchRender::Settings settings = MakeSettings(5, 2, 0.0f);
+    settings.resume = true;
+    settings.extension = extension;
+    BatchRender batch;
+    batch.Initialize(settings);
+    CHECK(batch.GetFrame() == 2);
+    CHECK(Run(batch, 2, Converged).size() == 3);
+
+    // everything written already
+    settings.numFrames = 2;
+    batch.Initialize(settings);
+    CHECK(batch.IsFinished());
+
+    for (const uint32_t index : written) {
+        remove(BatchRender::GetFrameFileName(index, extension).c_str());
+    }
+}
+
+static void TestCameraPath() {
+    const char* fileName = "batchrendertest_path.txt";
+    FILE* file = fopen(fileName, "w");
+    CHECK(file != nullptr);
+    if (!file) {
+        return;
+    }
+    fprintf(file, "# time  position  target  fovY\n");
+    fprintf(file, "1.0  0 0 0  0 0 -1  40\n");
+    fprintf(file, "2.0  4 0 0  4 0 -1  60\n");
+    fclose(file);
+
+    // a second at 4 fps, both ends included
+    BatchRender::Settings settings = MakeSettings(100, 3, 0.0f);
+    settings.cameraPath = fileName;
+    settings.frameRate = 4.0f;
+    BatchRender batch;
+    batch.Initialize(settings);
+    CHECK(batch.GetNumFrames() == 5);
+
+    // the camera only moves on a frame's first pass, to the frame's time on the path
+    std::vector<float> fovs;
+    while (!batch.IsFinished()) {
+        if (batch.BeginPass()) {
+            CameraPath::Key key;
+            CHECK(batch.GetCameraKey(key));
+            fovs.push_back(key.fovY);
+        }
+        batch.EndPass();
+    }
+    CHECK(fovs.size() == 5);
+    for (size_t i = 0; i < fovs.size(); ++i) {
+        CHECK_NEAR(fovs[i], 40.0f + 5.0f * i, 1e-4);
+    }
+    remove(fileName);
+
+    // a path that doesn't load renders nothing, no path leaves the camera alone
+    settings.cameraPath = "batchrendertest_missing.txt";
+    batch.Initialize(settings);
+    CHECK(batch.GetNumFrames() == 0 && batch.IsFinished());
+    settings.cameraPath.clear();
+    batch.Initialize(settings);
+    CameraPath::Key key;
+    CHECK(!batch.GetCameraKey(key));
+}
+
+int main() {
+    TestFixedPasses();
+    TestAdaptive();
+    TestResume();
+    TestCameraPath();
+    return TEST_RESULT();
+}
@@ -0,0 +1,266 @@
+#include "testing.h"
+
+#include "framework/asyncdenoiser.h"
+#include "framework/threadpool.h"
+
+#include <cmath>
+#include <random>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+// a floor, a sphere and a box in front of a wall: 4 meshes, normal & depth edges and a shadow edge on the floor
+static const uint32_t kWidth = 160;
+static const uint32_t kHeight = 96;
+static const size_t kNumPixels = kWidth * kHeight;
+
+static void FillGBuffer(Denoiser::GBuffer& g, std::vector<float> truth[3], const float exposure) {
+    for (uint32_t y = 0; y < kHeight; ++y) {
+        for (uint32_t x = 0; x < kWidth; ++x) {
+            const size_t i = y * kWidth + x;
+            const float dx = (static_cast<float>(x) - 50.0f) / 30.0f;
+            const float dy = (static_cast<float>(y) - 40.0f) / 30.0f;
+
+            uint32_t id;
+            float albedo[3], n[3], depth;
+            if (y > kHeight * 2 / 3) {
+                id = 0; albedo[0] = 0.7f; albedo[1] = 0.8f; albedo[2] = 0.5f; n[0] = 0.0f; n[1] = 1.0f; n[2] = 0.0f;
+                depth = 5.0f + static_cast<float>(y - kHeight * 2 / 3) * 0.05f;
+            } else if (dx * dx + dy * dy < 1.0f) {
+                id = 1; albedo[0] = 0.2f; albedo[1] = 0.3f; albedo[2] = 0.9f;
+                n[0] = dx; n[1] = -dy; n[2] = std::sqrt(std::max(0.0f, 1.0f - dx * dx - dy * dy));
+                depth = 4.0f - n[2];
+            } else if (x > 100 && x < 140 && y > 20 && y < 60) {
+                id = 2; albedo[0] = 0.9f; albedo[1] = 0.2f; albedo[2] = 0.2f; n[0] = 0.0f; n[1] = 0.0f; n[2] = 1.0f;
+                depth = 6.0f;
+            } else {
+                id = 3; albedo[0] = 0.6f; albedo[1] = 0.6f; albedo[2] = 0.6f; n[0] = 0.0f; n[1] = 0.0f; n[2] = 1.0f;
+                depth = 10.0f;
+            }
+            float light = 0.3f + 0.7f * std::max(0.0f, n[0] * 0.3f + n[1] * 0.8f + n[2] * 0.5f);
+            if (id == 0 && x > (y * 3) % kWidth) {
+                light *= 0.4f;
+            }
+
+            g.albedoR[i] = albedo[0]; g.albedoG[i] = albedo[1]; g.albedoB[i] = albedo[2];
+            g.normalX[i] = n[0]; g.normalY[i] = n[1]; g.normalZ[i] = n[2];
+            g.depth[i] = depth;
+            g.meshId[i] = id;
+            for (int c = 0; c < 3; ++c) {
+                truth[c][i] = albedo[c] * light * exposure;
+            }
+        }
+    }
+}
+
+// a few samples per pixel worth of noise, unbiased
+static void AddNoise(Denoiser::GBuffer& g, const std::vector<float> truth[3], std::mt19937& rng) {
+    std::exponential_distribution<float> sample(1.0f);
+    for (size_t i = 0; i < kNumPixels; ++i) {
+        float s = 0.0f;
+        for (int k = 0; k < 4; ++k) {
+            s += sample(rng);
+        }
+        s *= 0.25f;
+        g.colorR[i] = truth[0][i] * s;
+        g.colorG[i] = truth[1][i] * s;
+        g.colorB[i] = truth[2][i] * s;
+    }
+}
+
+static double MeanSquaredError(const std::vector<float> truth[3], const float* r, const float* g, const float* b) {
+    double sum = 0.0;
+    for (size_t i = 0; i < kNumPixels; ++i) {
+        const double e[3] = { r[i] - truth[0][i], g[i] - truth[1][i], b[i] - truth[2][i] };
+        sum += e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+    }
+    return sum / static_cast<double>(kNumPixels * 3);
+}
+
+static double Mean(const float* values) {
+    double sum = 0.0;
+    for (size_t i = 0; i < kNumPixels; ++i) {
+        sum += values[i];
+    }
+    return sum / static_cast<double>(kNumPixels);
+}
+
+static void TestFiltersNoise(ThreadPool& pool) {
+    std::vector<float> truth[3];
+    for (std::vector<float>& plane : truth) {
+        plane.resize(kNumPixels);
+    }
+    std::mt19937 rng(1);
+
+    Denoiser denoiser;
+    denoiser.Initialize(kWidth, kHeight, &pool);
+    denoiser.GetSettings().temporal = false;
+    Denoiser::GBuffer& input = denoiser.GetInput();
+    FillGBuffer(input, truth, 1.0f);
+    AddNoise(input, truth, rng);
+
+    const double noisy = MeanSquaredError(truth, input.colorR.data(), input.colorG.data(), input.colorB.data());
+    denoiser.Denoise();
+    const double filtered = MeanSquaredError(truth, denoiser.GetOutputR(), denoiser.GetOutputG(), denoiser.GetOutputB());
+    // better than 3 dB
+    CHECK(filtered * 2.0 < noisy);
+
+    // the same on one thread, rows are independent of how they're split
+    Denoiser serial;
+    serial.Initialize(kWidth, kHeight, nullptr);
+    serial.GetSettings().temporal = false;
+    serial.GetInput() = input;
+    serial.Denoise();
+    double maxDifference = 0.0;
+    for (size_t i = 0; i < kNumPixels; ++i) {
+        maxDifference = std::max(maxDifference, static_cast<double>(std::fabs(serial.GetOutputR()[i] - denoiser.GetOutputR()[i])));
+    }
+    CHECK(maxDifference < 1e-5);
+}
+
+static void TestKeepsHdr(ThreadPool& pool) {
+    // the app feeds it the float radiance, a sunlit scene is way above 1: nothing may clamp it on the way
+    std::vector<float> truth[3];
+    for (std::vector<float>& plane : truth) {
+        plane.resize(kNumPixels);
+    }
+    std::mt19937 rng(2);
+
+    Denoiser denoiser;
+    denoiser.Initialize(kWidth, kHeight, &pool);
+    denoiser.GetSettings().temporal = false;
+    FillGBuffer(denoiser.GetInput(), truth, 8.0f);
+    AddNoise(denoiser.GetInput(), truth, rng);
+    denoiser.Denoise();
+
+    const double expected = Mean(truth[0].data());
+    CHECK(expected > 1.0);
+    CHECK_NEAR(Mean(denoiser.GetOutputR()), expected, expected * 0.05);
+    float maxValue = 0.0f;
+    for (size_t i = 0; i < kNumPixels; ++i) {
+        maxValue = std::max(maxValue, denoiser.GetOutputG()[i]);
+    }
+    CHECK(maxValue > 1.0f);
+}
+
+static void TestAsync(ThreadPool& pool) {
+    std::vector<float> truth[3];
+    for (std::vector<float>& plane : truth) {
+        plane.resize(kNumPixels);
+    }
+    std::mt19937 rng(3);
+
+    AsyncDenoiser async;
+    CHECK(!async.IsInitialized());
+    async.Initialize(kWidth, kHeight, &pool);
+    CHECK(async.IsInitialized());
+
+    // what the callback sees, matches a synchronous run of the same input
+    Denoiser reference;
+    reference.Initialize(kWidth, kHeight, &pool);
+
+    Denoiser::GBuffer* input = async.AcquireInput(false);
+    CHECK(input != nullptr);
+    FillGBuffer(*input, truth, 1.0f);
+    AddNoise(*input, truth, rng);
+    reference.GetInput() = *input;
+    reference.Denoise();
+
+    std::atomic<bool> release(false);
+    std::atomic<int> numCalls(0);
+    std::atomic<bool> wasCurrent(false);
+    std::atomic<bool> sameOutput(false);
+    std::atomic<std::thread::id> callbackThread;
+    async.Submit([&](const Denoiser& denoiser, const bool current) {
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        bool same = true;
+        for (size_t i = 0; i < kNumPixels; ++i) {
+            same = same && denoiser.GetOutputB()[i] == reference.GetOutputB()[i];
+        }
+        sameOutput = same;
+        wasCurrent = current;
+        callbackThread = std::this_thread::get_id();
+        ++numCalls;
+    });
+
+    // in flight: the render thread doesn't get the input, it skips the frame
+    CHECK(async.AcquireInput(false) == nullptr);
+    release = true;
+    async.WaitIdle();
+    CHECK(numCalls == 1);
+    CHECK(wasCurrent);
+    CHECK(sameOutput);
+    CHECK(callbackThread.load() != std::this_thread::get_id());
+    CHECK(async.GetNumDenoisedFrames() == 1);
+    CHECK(async.GetNumAccumulatedFrames() == 1);
+
+    // the camera moves while a frame is in the callback: the reset waits for the next frame
+    release = false;
+    std::atomic<bool> entered(false);
+    input = async.AcquireInput(true);
+    CHECK(input != nullptr);
+    async.Submit([&](const Denoiser&, const bool) {
+        entered = true;
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ++numCalls;
+    });
+    while (!entered) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    async.ResetHistory();
+    release = true;
+    // waits for it rather than skipping
+    input = async.AcquireInput(true);
+    CHECK(input != nullptr);
+    CHECK(numCalls == 2);
+    CHECK(async.GetNumAccumulatedFrames() == 2);
+
+    async.Submit([&](const Denoiser&, const bool current) {
+        wasCurrent = current;
+        ++numCalls;
+    });
+    async.WaitIdle();
+    CHECK(numCalls == 3);
+    CHECK(wasCurrent);
+    CHECK(async.GetNumAccumulatedFrames() == 1);
+
+    // a reset right after the submit races the worker: either the frame was picked up before it, it's stale and
+    // still extends the old history, or after, it starts the new one and is current
+    input = async.AcquireInput(true);
+    CHECK(input != nullptr);
+    async.Submit([&](const Denoiser&, const bool current) {
+        wasCurrent = current;
+        ++numCalls;
+    });
+    async.ResetHistory();
+    async.WaitIdle();
+    CHECK(numCalls == 4);
+    CHECK(wasCurrent == (async.GetNumAccumulatedFrames() == 1));
+    CHECK(async.GetNumDenoisedFrames() == 4);
+
+    // a frame still in flight is finished, not dropped
+    input = async.AcquireInput(false);
+    CHECK(input != nullptr);
+    async.Submit([&](const Denoiser&, const bool) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ++numCalls;
+    });
+    async.Destroy();
+    CHECK(numCalls == 5);
+    CHECK(!async.IsInitialized());
+}
+
+int main() {
+    ThreadPool pool;
+    pool.Initialize(4);
+
+    TestFiltersNoise(pool);
+    TestKeepsHdr(pool);
+    TestAsync(pool);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,191 @@
+#include "testing.h"
+
+#include "shared.h"
+
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+static AnalyticPrimitive MakePrimitive(const uint32_t type, const vec3& p0, const vec3& p1, const float radius) {
+    AnalyticPrimitive primitive;
+    primitive.p0 = vec4(p0, radius);
+    primitive.p1 = vec4(p1, 0.0f);
+    primitive.info = uvec4(type, 0u, 0u, 0u);
+    return primitive;
+}
+
+// signed distance to the surface, in doubles: to the segment p0 - p1 (p0 alone for a sphere) minus the radius
+static double SurfaceDistance(const AnalyticPrimitive& primitive, const double p[3]) {
+    double ab[3], ap[3];
+    double abSq = 0.0, apAb = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        ab[i] = (primitive.info.x == SWS_ANALYTIC_CAPSULE) ? (double((&primitive.p1.x)[i]) - (&primitive.p0.x)[i]) : 0.0;
+        ap[i] = p[i] - (&primitive.p0.x)[i];
+        abSq += ab[i] * ab[i];
+        apAb += ap[i] * ab[i];
+    }
+    const double h = (abSq > 0.0) ? std::min(std::max(apAb / abSq, 0.0), 1.0) : 0.0;
+    double distSq = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        const double d = ap[i] - ab[i] * h;
+        distSq += d * d;
+    }
+    return std::sqrt(distSq) - primitive.p0.w;
+}
+
+static double SurfaceDistanceAt(const AnalyticPrimitive& primitive, const vec3& origin, const vec3& dir, const double t) {
+    const double p[3] = { origin.x + dir.x * t, origin.y + dir.y * t, origin.z + dir.z * t };
+    return SurfaceDistance(primitive, p);
+}
+
+// brute force: march [tMin, tMax] for the first sign change of the distance and bisect it. closest - the smallest
+// |distance| the march saw, a ray that only grazes the surface can be missed by either side
+static double ReferenceIntersect(const AnalyticPrimitive& primitive, const vec3& origin, const vec3& dir,
+                                 const float tMin, const float tMax, double& closest) {
+    const int numSteps = 4000;
+    double prevT = tMin;
+    double prev = SurfaceDistanceAt(primitive, origin, dir, prevT);
+    closest = std::fabs(prev);
+    for (int i = 1; i <= numSteps; ++i) {
+        const double t = tMin + (double(tMax) - tMin) * i / numSteps;
+        const double f = SurfaceDistanceAt(primitive, origin, dir, t);
+        closest = std::min(closest, std::fabs(f));
+        if ((prev > 0.0) != (f > 0.0)) {
+            double lo = prevT, hi = t;
+            for (int k = 0; k < 60; ++k) {
+                const double mid = 0.5 * (lo + hi);
+                if ((SurfaceDistanceAt(primitive, origin, dir, mid) > 0.0) == (prev > 0.0)) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            return 0.5 * (lo + hi);
+        }
+        prev = f;
+        prevT = t;
+    }
+    return -1.0;
+}
+
+// random spheres, capsules, capsules along an axis and capsules shorter than float precision can tell, from
+// origins inside and outside, some rays along the axes or along the capsule, some clipped by tMin / tMax
+static void TestAgainstReference() {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uniform(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> radii(0.1f, 1.0f);
+
+    const int numRays = 20000;
+    int numHits = 0, numInside = 0, numGrazing = 0, numMismatches = 0, numBadNormals = 0;
+    double worstError = 0.0;
+    for (int i = 0; i < numRays; ++i) {
+        const int kind = i % 4;
+        const vec3 a(uniform(rng), uniform(rng), uniform(rng));
+        vec3 b = a;
+        if (kind == 1) {
+            b = a + vec3(uniform(rng), uniform(rng), uniform(rng));
+        } else if (kind == 2) {
+            b = a + vec3(0.0f, uniform(rng), 0.0f);
+        } else if (kind == 3) {
+            b = a + vec3(1e-7f, 0.0f, 0.0f);
+        }
+        const AnalyticPrimitive primitive = MakePrimitive(kind ? SWS_ANALYTIC_CAPSULE : SWS_ANALYTIC_SPHERE, a, b, radii(rng));
+
+        // a third of the origins near the primitive, most rays aimed close to it
+        const float spread = (i % 3 == 0) ? 0.25f : 3.0f;
+        const vec3 origin = a + vec3(uniform(rng), uniform(rng), uniform(rng)) * spread;
+        vec3 dir = glm::normalize(a + vec3(uniform(rng), uniform(rng), uniform(rng)) * 0.5f - origin);
+        if (i % 3 == 1) {
+            dir = glm::normalize(vec3(uniform(rng), uniform(rng), uniform(rng)));
+        }
+        if (i % 7 == 0) {
+            dir = vec3(0.0f, 0.0f, 1.0f);
+        }
+        if (i % 11 == 0 && (kind == 1 || kind == 2)) {
+            dir = glm::normalize(b - a);
+        }
+        const float tMin = (i % 5 == 0) ? 0.5f : 0.0f;
+        const float tMax = (i % 13 == 0) ? 3.0f : 20.0f;
+
+        const float t = IntersectAnalyticPrimitive(primitive, origin, dir, tMin, tMax);
+        double closest;
+        const double reference = ReferenceIntersect(primitive, origin, dir, tMin, tMax, closest);
+        if (SurfaceDistanceAt(primitive, origin, dir, tMin) < 0.0) {
+            ++numInside;
+        }
+
+        const bool mismatch = ((t < 0.0f) != (reference < 0.0)) || (t >= 0.0f && std::fabs(t - reference) > 2e-3);
+        if (mismatch && closest < 1e-3) {
+            ++numGrazing;
+            continue;
+        }
+        if (mismatch) {
+            if (++numMismatches <= 5) {
+                printf("kind %d: t %f, reference %f\n", kind, t, reference);
+            }
+            continue;
+        }
+        if (t < 0.0f) {
+            continue;
+        }
+        ++numHits;
+        worstError = std::max(worstError, std::fabs(t - reference));
+
+        // unit length, and pointing where the distance to the surface grows
+        const vec3 pos = origin + dir * t;
+        const vec3 normal = AnalyticPrimitiveNormal(primitive, pos);
+        if (std::fabs(glm::length(normal) - 1.0f) > 1e-3f ||
+            SurfaceDistanceAt(primitive, pos, normal, 1e-2) <= SurfaceDistanceAt(primitive, pos, normal, 0.0)) {
+            ++numBadNormals;
+        }
+    }
+    printf("%d rays, %d hits, %d from inside, %d grazing, worst |t - reference| %g\n",
+           numRays, numHits, numInside, numGrazing, worstError);
+    CHECK(numMismatches == 0);
+    CHECK(numBadNormals == 0);
+    CHECK(numGrazing < numRays / 1000);
+    // the cases are all there
+    CHECK(numHits > numRays / 4);
+    CHECK(numInside > numRays / 10);
+}
+
+static void TestSphere() {
+    const AnalyticPrimitive sphere = MakePrimitive(SWS_ANALYTIC_SPHERE, vec3(0.0f), vec3(0.0f), 1.0f);
+    CHECK_NEAR(IntersectAnalyticPrimitive(sphere, vec3(0.0f, 0.0f, -3.0f), vec3(0.0f, 0.0f, 1.0f), 0.0f, 10.0f), 2.0f, 1e-5);
+    // tMin past the near hit gives the far one, tMax short of the near hit none
+    CHECK_NEAR(IntersectAnalyticPrimitive(sphere, vec3(0.0f, 0.0f, -3.0f), vec3(0.0f, 0.0f, 1.0f), 2.5f, 10.0f), 4.0f, 1e-5);
+    CHECK(IntersectAnalyticPrimitive(sphere, vec3(0.0f, 0.0f, -3.0f), vec3(0.0f, 0.0f, 1.0f), 0.0f, 1.5f) < 0.0f);
+    // from inside, the way out
+    CHECK_NEAR(IntersectAnalyticPrimitive(sphere, vec3(0.0f), vec3(1.0f, 0.0f, 0.0f), 0.0f, 10.0f), 1.0f, 1e-5);
+    // t is in the units of dir
+    CHECK_NEAR(IntersectAnalyticPrimitive(sphere, vec3(0.0f, 0.0f, -3.0f), vec3(0.0f, 0.0f, 2.0f), 0.0f, 10.0f), 1.0f, 1e-5);
+    CHECK(IntersectAnalyticPrimitive(sphere, vec3(0.0f, 2.0f, -3.0f), vec3(0.0f, 0.0f, 1.0f), 0.0f, 10.0f) < 0.0f);
+}
+
+static void TestCapsule() {
+    const AnalyticPrimitive capsule = MakePrimitive(SWS_ANALYTIC_CAPSULE, vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), 0.5f);
+    // the cylinder, the caps from along the axis, from inside along the axis
+    CHECK_NEAR(IntersectAnalyticPrimitive(capsule, vec3(-3.0f, 0.5f, 0.0f), vec3(1.0f, 0.0f, 0.0f), 0.0f, 10.0f), 2.5f, 1e-5);
+    CHECK_NEAR(IntersectAnalyticPrimitive(capsule, vec3(0.0f, 5.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), 0.0f, 10.0f), 3.5f, 1e-5);
+    CHECK_NEAR(IntersectAnalyticPrimitive(capsule, vec3(0.0f), vec3(0.0f, -1.0f, 0.0f), 0.0f, 10.0f), 1.5f, 1e-5);
+    // along the axis but off it by more than the radius: nothing
+    CHECK(IntersectAnalyticPrimitive(capsule, vec3(0.6f, 5.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), 0.0f, 10.0f) < 0.0f);
+    const vec3 normal = AnalyticPrimitiveNormal(capsule, vec3(0.0f, 1.5f, 0.0f));
+    CHECK_NEAR(normal.y, 1.0f, 1e-6);
+
+    // shorter than float precision can tell from a point: a sphere
+    const AnalyticPrimitive degenerate = MakePrimitive(SWS_ANALYTIC_CAPSULE, vec3(1.0f), vec3(1.0f + 1e-7f, 1.0f, 1.0f), 0.5f);
+    const AnalyticPrimitive sphere = MakePrimitive(SWS_ANALYTIC_SPHERE, vec3(1.0f), vec3(1.0f), 0.5f);
+    const vec3 origin(-2.0f, 0.0f, 1.5f);
+    const vec3 dir = glm::normalize(vec3(1.0f) - origin);
+    CHECK_NEAR(IntersectAnalyticPrimitive(degenerate, origin, dir, 0.0f, 10.0f),
+               IntersectAnalyticPrimitive(sphere, origin, dir, 0.0f, 10.0f), 1e-4);
+    CHECK_NEAR(glm::length(AnalyticPrimitiveNormal(degenerate, vec3(1.0f, 1.5f, 1.0f))), 1.0f, 1e-5);
+}
+
+int main() {
+    TestSphere();
+    TestCapsule();
+    TestAgainstReference();
+    return TEST_RESULT();
+}
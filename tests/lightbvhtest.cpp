@@ -0,0 +1,223 @@
+#include "testing.h"
+
+#include "framework/lightbvh.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+// triangles scattered over a 10^3 box, every fifth one without power
+static std::vector<LightBVH::Emitter> RandomEmitters(std::mt19937& rng, const int numEmitters) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<LightBVH::Emitter> emitters(numEmitters);
+    for (int i = 0; i < numEmitters; ++i) {
+        LightBVH::Emitter& e = emitters[i];
+        for (int k = 0; k < 3; ++k) {
+            const float c = 10.0f * uniform(rng);
+            e.v0[k] = c + uniform(rng);
+            e.v1[k] = c + uniform(rng);
+            e.v2[k] = c + uniform(rng);
+        }
+        e.power = (i % 5 == 3) ? 0.0f : (uniform(rng) + 0.1f);
+    }
+    return emitters;
+}
+
+// any point of the emitter above the shading point's horizon
+static bool IsAboveHorizon(const LightBVH::Emitter& e, const float p[3], const float n[3], std::mt19937& rng) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    for (int s = 0; s < 64; ++s) {
+        const float su = std::sqrt(uniform(rng)), v = uniform(rng);
+        float d = 0.0f;
+        for (int k = 0; k < 3; ++k) {
+            const float q = e.v0[k] * (1.0f - su) + e.v1[k] * su * (1.0f - v) + e.v2[k] * su * v;
+            d += (q - p[k]) * n[k];
+        }
+        if (d > 1e-4f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// random shading points in and around the emitters: pmfs sum to at most 1, zero power emitters are never picked,
+// nothing that can light the point gets a zero pmf, and Sample() agrees with GetPmf(). With histogram, that Sample()
+// also picks them that often
+static void CheckPmfs(const LightBVH& bvh, const std::vector<LightBVH::Emitter>& emitters, std::mt19937& rng, const bool histogram) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    const int numEmitters = int(emitters.size());
+
+    for (int t = 0; t < 50; ++t) {
+        const float p[3] = { 12.0f * uniform(rng) - 1.0f, 12.0f * uniform(rng) - 1.0f, 12.0f * uniform(rng) - 1.0f };
+        float n[3] = { uniform(rng) - 0.5f, uniform(rng) - 0.5f, uniform(rng) - 0.5f };
+        const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (float& x : n) {
+            x /= length;
+        }
+
+        double sum = 0.0;
+        int numZeroPower = 0, numMissed = 0;
+        for (int i = 0; i < numEmitters; ++i) {
+            const float pmf = bvh.GetPmf(p, n, i);
+            sum += pmf;
+            if (emitters[i].power == 0.0f && pmf > 0.0f) {
+                ++numZeroPower;
+            }
+            if (emitters[i].power > 0.0f && pmf == 0.0f && IsAboveHorizon(emitters[i], p, n, rng)) {
+                ++numMissed;
+            }
+        }
+        CHECK(numZeroPower == 0);
+        CHECK(numMissed == 0);
+        CHECK(sum <= 1.0 + 1e-4);
+        if (sum <= 0.0) {
+            continue;
+        }
+
+        int numMismatches = 0;
+        for (int s = 0; s < 200; ++s) {
+            float pmf;
+            const uint32_t e = bvh.Sample(p, n, uniform(rng), pmf);
+            if (e == LightBVH::kInvalidIndex) {
+                continue;
+            }
+            if (e >= uint32_t(numEmitters) || std::fabs(bvh.GetPmf(p, n, e) - pmf) > 1e-5f * std::max(1.0f, pmf)) {
+                ++numMismatches;
+            }
+        }
+        CHECK(numMismatches == 0);
+
+        if (histogram) {
+            const int numSamples = 200000;
+            std::vector<int> counts(numEmitters, 0);
+            for (int s = 0; s < numSamples; ++s) {
+                float pmf;
+                const uint32_t e = bvh.Sample(p, n, uniform(rng), pmf);
+                if (e < uint32_t(numEmitters)) {
+                    ++counts[e];
+                }
+            }
+            for (int i = 0; i < numEmitters; ++i) {
+                const double expected = double(bvh.GetPmf(p, n, i)) * numSamples;
+                CHECK(std::fabs(counts[i] - expected) <= 5.0 * std::sqrt(expected + 1.0) + 1.0);
+            }
+        }
+    }
+}
+
+static void TestPmfs() {
+    std::mt19937 rng(7);
+
+    const int sizes[] = { 1, 2, 3, 7, 64, 1000 };
+    for (const int numEmitters : sizes) {
+        const std::vector<LightBVH::Emitter> emitters = RandomEmitters(rng, numEmitters);
+        LightBVH bvh;
+        CHECK(bvh.Build(emitters));
+        CHECK(bvh.GetDepth() <= LightBVH::kMaxDepth);
+        CheckPmfs(bvh, emitters, rng, numEmitters == 7);
+    }
+}
+
+// emitters arriving in batches the way the scene streams in: small ones get a subtree next to the old root (whose
+// nodes stay as they were), big ones or too many small ones rebuild the tree, it holds up either way
+static void TestAppend() {
+    std::mt19937 rng(11);
+    const std::vector<LightBVH::Emitter> all = RandomEmitters(rng, 1500);
+
+    const size_t batches[] = { 0, 3, 200, 250, 1, 40, 7, 500, 2, 1, 1, 1, 1, 1, 1, 491 };
+    std::vector<LightBVH::Emitter> emitters;
+    LightBVH bvh;
+    int numAppended = 0, numRebuilt = 0;
+    for (const size_t batch : batches) {
+        const size_t firstNew = emitters.size();
+        emitters.insert(emitters.end(), all.begin() + firstNew, all.begin() + firstNew + batch);
+
+        const std::vector<LightBVH::Node> before = bvh.GetNodes();
+        const bool result = bvh.Append(emitters, firstNew);
+        CHECK(result == !emitters.empty());
+        if (!result) {
+            continue;
+        }
+        CHECK(bvh.GetBitTrails().size() == emitters.size());
+        CHECK(bvh.GetDepth() <= LightBVH::kMaxDepth);
+        size_t numLit = 0;
+        for (const LightBVH::Emitter& e : emitters) {
+            numLit += (e.power > 0.0f) ? 1 : 0;
+        }
+        CHECK(bvh.GetNodes().size() == 2 * numLit - 1);
+
+        // appended: everything but the root is where it was, the old root right after it
+        const std::vector<LightBVH::Node>& nodes = bvh.GetNodes();
+        if (!before.empty() && nodes.size() > before.size() &&
+            !std::memcmp(nodes.data() + 1, before.data() + 1, (before.size() - 1) * sizeof(LightBVH::Node)) &&
+            !std::memcmp(&nodes[before.size()], &before[0], sizeof(LightBVH::Node))) {
+            ++numAppended;
+        } else if (!before.empty()) {
+            ++numRebuilt;
+        }
+        CheckPmfs(bvh, emitters, rng, emitters.size() == 3);
+    }
+    CHECK(numAppended >= 4);
+    CHECK(numRebuilt >= 2);
+
+    // nothing lit so far, then something
+    std::vector<LightBVH::Emitter> dark = RandomEmitters(rng, 4);
+    for (LightBVH::Emitter& e : dark) {
+        e.power = 0.0f;
+    }
+    LightBVH late;
+    CHECK(!late.Append(dark, 0));
+    dark.push_back(all[0]);
+    CHECK(late.Append(dark, 4));
+    CheckPmfs(late, dark, rng, false);
+}
+
+static void TestDegenerate() {
+    // nothing to sample
+    std::vector<LightBVH::Emitter> dark(3);
+    for (LightBVH::Emitter& e : dark) {
+        for (int k = 0; k < 3; ++k) {
+            e.v0[k] = 0.0f;
+            e.v1[k] = 1.0f;
+            e.v2[k] = float(k);
+        }
+        e.power = 0.0f;
+    }
+    LightBVH bvh;
+    CHECK(!bvh.Build(dark));
+    CHECK(!bvh.Build(std::vector<LightBVH::Emitter>()));
+
+    // thousands of copies of one triangle can't be split by position, the tree still stays within kMaxDepth and
+    // seen from straight above they're all equally likely
+    std::vector<LightBVH::Emitter> same(5000);
+    for (LightBVH::Emitter& e : same) {
+        for (int k = 0; k < 3; ++k) {
+            e.v0[k] = 0.0f;
+            e.v1[k] = (k == 0) ? 1.0f : 0.0f;
+            e.v2[k] = (k == 1) ? 1.0f : 0.0f;
+        }
+        e.power = 1.0f;
+    }
+    CHECK(bvh.Build(same));
+    CHECK(bvh.GetDepth() <= LightBVH::kMaxDepth);
+    const float p[3] = { 0.3f, 0.3f, 2.0f }, n[3] = { 0.0f, 0.0f, -1.0f };
+    double sum = 0.0;
+    float minPmf = 1.0f, maxPmf = 0.0f;
+    for (uint32_t i = 0; i < uint32_t(same.size()); ++i) {
+        const float pmf = bvh.GetPmf(p, n, i);
+        sum += pmf;
+        minPmf = std::min(minPmf, pmf);
+        maxPmf = std::max(maxPmf, pmf);
+    }
+    CHECK_NEAR(sum, 1.0, 1e-3);
+    CHECK_NEAR(minPmf, maxPmf, 1e-6);
+}
+
+int main() {
+    TestPmfs();
+    TestDegenerate();
+    TestAppend();
+    return TEST_RESULT();
+}
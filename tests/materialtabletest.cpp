@@ -0,0 +1,130 @@
+#include "testing.h"
+
+#include "framework/materialtable.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static MaterialTable::Material MakeMaterial() {
+    MaterialTable::Material material = {};
+    for (int i = 0; i < 4; ++i) {
+        material.color[i] = 0.25f * (i + 1);
+        material.params[i] = 0.1f * (i + 1);
+        material.emission[i] = 0.0f;
+        material.textures[i] = MaterialTable::NoTexture;
+    }
+    return material;
+}
+
+static bool BitEqual(const MaterialTable::Material& a, const MaterialTable::Material& b) {
+    return memcmp(&a, &b, sizeof(MaterialTable::Material)) == 0;
+}
+
+static void TestAdd() {
+    MaterialTable table;
+    const MaterialTable::Material base = MakeMaterial();
+    CHECK(table.Add(base) == 0);
+    CHECK(table.Add(base) == 0);
+    CHECK(table.Add(MakeMaterial()) == 0);
+    CHECK(table.GetNumMaterials() == 1);
+
+    // a change in any member is a material of its own, and adding it again finds it
+    uint32_t expected = 1;
+    for (int i = 0; i < 4; ++i) {
+        MaterialTable::Material changed[4] = { base, base, base, base };
+        changed[0].color[i] += 0.5f;
+        changed[1].params[i] += 0.5f;
+        changed[2].emission[i] += 0.5f;
+        changed[3].textures[i] = static_cast<uint32_t>(i);
+        for (const MaterialTable::Material& material : changed) {
+            CHECK(table.Add(material) == expected);
+            CHECK(table.Add(material) == expected);
+            CHECK(BitEqual(table.GetMaterial(expected), material));
+            ++expected;
+        }
+    }
+    CHECK(table.GetNumMaterials() == expected);
+    CHECK(table.GetMaterials().size() == expected);
+    CHECK(table.Add(base) == 0);
+
+    // it's the bits that count, 0 & -0 shade the same but aren't the same key
+    MaterialTable::Material negativeZero = base;
+    negativeZero.emission[0] = -0.0f;
+    CHECK(table.Add(negativeZero) == expected);
+
+    table.Clear();
+    CHECK(table.GetNumMaterials() == 0);
+    CHECK(table.Add(negativeZero) == 0);
+    CHECK(table.Add(base) == 1);
+}
+
+static void TestMakeDefault() {
+    // same seed & shape, same bits, every call
+    for (uint32_t shape = 0; shape < 16; ++shape) {
+        const MaterialTable::Material a = MaterialTable::MakeDefault(42, shape);
+        const MaterialTable::Material b = MaterialTable::MakeDefault(42, shape);
+        CHECK(BitEqual(a, b));
+
+        CHECK(!BitEqual(a, MaterialTable::MakeDefault(43, shape)));
+        CHECK(!BitEqual(a, MaterialTable::MakeDefault(42, shape + 1)));
+        CHECK(!BitEqual(a, MaterialTable::MakeDefault(0, shape)));
+
+        // a diffuse, opaque, untextured one in the ranges the scenes always had
+        for (int i = 0; i < 3; ++i) {
+            CHECK(a.color[i] >= 0.5f && a.color[i] < 1.0f);
+            CHECK(a.emission[i] == 0.0f);
+        }
+        CHECK(a.params[0] >= 0.1f && a.params[0] < 0.3f);
+        CHECK(a.params[1] >= 0.1f && a.params[1] < 0.3f);
+        CHECK(a.params[2] == static_cast<float>(MaterialTable::DiffuseType));
+        CHECK(MaterialTable::IsOpaque(a) && !MaterialTable::IsEmissive(a));
+        for (int i = 0; i < 4; ++i) {
+            CHECK(a.textures[i] == MaterialTable::NoTexture);
+        }
+    }
+
+    // the seed & shape index aren't just summed
+    CHECK(!BitEqual(MaterialTable::MakeDefault(1, 0), MaterialTable::MakeDefault(0, 1)));
+
+    // made up materials of a scene's shapes are mostly distinct ones
+    MaterialTable table;
+    for (uint32_t shape = 0; shape < 64; ++shape) {
+        table.Add(MaterialTable::MakeDefault(7, shape));
+    }
+    CHECK(table.GetNumMaterials() == 64);
+}
+
+static void TestOpaqueEmissive() {
+    MaterialTable::Material material = MakeMaterial();
+
+    material.color[3] = 1.0f;
+    CHECK(MaterialTable::IsOpaque(material));
+    material.color[3] = std::nextafter(1.0f, 0.0f);
+    CHECK(!MaterialTable::IsOpaque(material));
+    material.color[3] = 0.0f;
+    CHECK(!MaterialTable::IsOpaque(material));
+
+    // the smallest radiance in any channel makes an emitter, nothing or a negative one doesn't
+    CHECK(!MaterialTable::IsEmissive(material));
+    for (int i = 0; i < 3; ++i) {
+        MaterialTable::Material emitter = MakeMaterial();
+        emitter.emission[i] = std::numeric_limits<float>::denorm_min();
+        CHECK(MaterialTable::IsEmissive(emitter));
+        emitter.emission[i] = -1.0f;
+        CHECK(!MaterialTable::IsEmissive(emitter));
+        emitter.emission[i] = -0.0f;
+        CHECK(!MaterialTable::IsEmissive(emitter));
+    }
+
+    // emission's a isn't a channel
+    material.emission[3] = 1.0f;
+    CHECK(!MaterialTable::IsEmissive(material));
+}
+
+int main() {
+    TestAdd();
+    TestMakeDefault();
+    TestOpaqueEmissive();
+    return TEST_RESULT();
+}
@@ -0,0 +1,214 @@
+#include "testing.h"
+
+#include "framework/memorytracker.h"
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// stands in for the driver: hands out ids, reusing freed ones like real handles get reused
+class FakeBackend {
+public:
+    explicit FakeBackend(MemoryTracker& tracker)
+        : mTracker(tracker)
+        , mNextId(1) {
+    }
+
+    uint64_t Allocate(const uint64_t bytes) {
+        uint64_t id;
+        if (!mFreeIds.empty()) {
+            id = mFreeIds.back();
+            mFreeIds.pop_back();
+        } else {
+            id = mNextId++;
+        }
+        mTracker.OnAllocate(id, bytes);
+        return id;
+    }
+
+    void Free(const uint64_t id) {
+        mTracker.OnFree(id);
+        mFreeIds.push_back(id);
+    }
+
+private:
+    MemoryTracker&          mTracker;
+    uint64_t                mNextId;
+    std::vector<uint64_t>   mFreeIds;
+};
+
+static const MemoryTracker::OwnerUsage* FindOwner(const MemoryTracker::Report& report, const char* name, const MemoryCategory category) {
+    for (const MemoryTracker::OwnerUsage& owner : report.owners) {
+        if (owner.owner == name && owner.category == category) {
+            return &owner;
+        }
+    }
+    return nullptr;
+}
+
+// what a scene load looks like: per mesh buffers and BLASes, the build's scratch, a TLAS
+static void TestAttribution() {
+    MemoryTracker tracker;
+    FakeBackend backend(tracker);
+
+    std::vector<uint64_t> scratch;
+    const char* meshes[] = { "Plane", "Sphere", "Box" };
+    const uint64_t vertexBytes[] = { 100, 4000, 600 };
+    for (size_t i = 0; i < 3; ++i) {
+        MemoryTracker::Scope meshScope(MemoryCategory::Geometry, meshes[i]);
+        backend.Allocate(vertexBytes[i]);
+        backend.Allocate(vertexBytes[i] / 2);
+        {
+            // nested: the BLAS is the same mesh's, in another category
+            MemoryTracker::Scope blasScope(MemoryCategory::AccelerationStructure, std::string(meshes[i]));
+            backend.Allocate(vertexBytes[i] * 2);
+            {
+                // no owner: unattributed
+                MemoryTracker::Scope scratchScope(MemoryCategory::Scratch);
+                scratch.push_back(backend.Allocate(vertexBytes[i] * 4));
+            }
+        }
+        // back to the mesh's scope
+        backend.Allocate(8);
+    }
+    {
+        MemoryTracker::Scope tlasScope(MemoryCategory::AccelerationStructure, "TLAS");
+        backend.Allocate(256);
+    }
+
+    // all the builds' scratch was alive at once
+    const uint64_t scratchBytes = (100 + 4000 + 600) * 4;
+    CHECK(tracker.GetUsage(MemoryCategory::Scratch).bytes == scratchBytes);
+    const uint64_t peak = tracker.GetAllocatedBytes();
+    for (const uint64_t id : scratch) {
+        backend.Free(id);
+    }
+    CHECK(tracker.GetUsage(MemoryCategory::Scratch).bytes == 0);
+    CHECK(tracker.GetUsage(MemoryCategory::Scratch).allocations == 0);
+    CHECK(tracker.GetUsage(MemoryCategory::Scratch).peakBytes == scratchBytes);
+    CHECK(tracker.GetUsage(MemoryCategory::Scratch).peakAllocations == 3);
+    CHECK(tracker.GetPeakBytes() == peak);
+    CHECK(tracker.GetAllocatedBytes() == peak - scratchBytes);
+
+    const uint64_t geometry = (100 + 50 + 8) + (4000 + 2000 + 8) + (600 + 300 + 8);
+    CHECK(tracker.GetUsage(MemoryCategory::Geometry).bytes == geometry);
+    CHECK(tracker.GetUsage(MemoryCategory::Geometry).allocations == 9);
+    CHECK(tracker.GetUsage(MemoryCategory::AccelerationStructure).bytes == (100 + 4000 + 600) * 2 + 256);
+
+    MemoryTracker::Report report;
+    tracker.GetReport(report);
+    CHECK(report.total.bytes == tracker.GetAllocatedBytes());
+    CHECK(report.owners.size() == 7);   // 3 meshes x 2 categories + the TLAS, scratch is unattributed
+    const MemoryTracker::OwnerUsage* sphere = FindOwner(report, "Sphere", MemoryCategory::Geometry);
+    CHECK(sphere && sphere->usage.bytes == 6008 && sphere->usage.allocations == 3);
+    const MemoryTracker::OwnerUsage* sphereBlas = FindOwner(report, "Sphere", MemoryCategory::AccelerationStructure);
+    CHECK(sphereBlas && sphereBlas->usage.bytes == 8000);
+    CHECK(FindOwner(report, "TLAS", MemoryCategory::AccelerationStructure) != nullptr);
+
+    // largest first
+    for (size_t i = 1; i < report.owners.size(); ++i) {
+        CHECK(report.owners[i - 1].usage.bytes >= report.owners[i].usage.bytes);
+    }
+    CHECK(report.owners.front().owner == "Sphere");
+}
+
+static void TestReportOrderAndPeaks() {
+    MemoryTracker tracker;
+    FakeBackend backend(tracker);
+
+    // same current size, ties go to the larger peak
+    uint64_t transient;
+    {
+        MemoryTracker::Scope scope(MemoryCategory::Texture, "a");
+        backend.Allocate(100);
+    }
+    {
+        MemoryTracker::Scope scope(MemoryCategory::Texture, "b");
+        backend.Allocate(100);
+        transient = backend.Allocate(900);
+    }
+    backend.Free(transient);
+
+    MemoryTracker::Report report;
+    tracker.GetReport(report);
+    CHECK(report.owners.size() == 2);
+    CHECK(report.owners[0].owner == "b" && report.owners[0].usage.peakBytes == 1000);
+    CHECK(report.owners[1].owner == "a");
+
+    // a reused id that was never freed replaces the old allocation, unknown frees are ignored
+    const uint64_t id = backend.Allocate(7);
+    CHECK(tracker.GetUsage(MemoryCategory::Other).bytes == 7);
+    tracker.OnAllocate(id, 9);
+    CHECK(tracker.GetUsage(MemoryCategory::Other).bytes == 9);
+    CHECK(tracker.GetUsage(MemoryCategory::Other).allocations == 1);
+    tracker.OnFree(12345);
+    CHECK(tracker.GetAllocatedBytes() == 209);
+
+    // explicit category & owner, no scope needed
+    tracker.OnAllocate(777, 50, MemoryCategory::Readback, "frame in flight 0");
+    tracker.GetReport(report);
+    CHECK(FindOwner(report, "frame in flight 0", MemoryCategory::Readback) != nullptr);
+
+    tracker.ResetPeaks();
+    CHECK(tracker.GetPeakBytes() == tracker.GetAllocatedBytes());
+    CHECK(tracker.GetUsage(MemoryCategory::Texture).peakBytes == 200);
+
+    // the report names the categories & the owners, trimmed to maxOwners
+    FILE* file = tmpfile();
+    CHECK(file != nullptr);
+    if (file) {
+        tracker.PrintReport(file, 1);
+        rewind(file);
+        std::string text;
+        char buffer[256];
+        while (fgets(buffer, sizeof(buffer), file)) {
+            text += buffer;
+        }
+        fclose(file);
+        CHECK(text.find(MemoryTracker::GetCategoryName(MemoryCategory::Texture)) != std::string::npos);
+        CHECK(text.find("more") != std::string::npos);
+    }
+
+    tracker.Reset();
+    CHECK(tracker.GetAllocatedBytes() == 0);
+    CHECK(tracker.GetPeakBytes() == 0);
+}
+
+// scopes are per thread
+static void TestThreads() {
+    MemoryTracker tracker;
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&tracker, t]() {
+            MemoryTracker::Scope scope(MemoryCategory::Image, "thread " + std::to_string(t));
+            for (uint64_t i = 0; i < 10000; ++i) {
+                const uint64_t id = (static_cast<uint64_t>(t) << 32) | i;
+                tracker.OnAllocate(id, 16);
+                if (i % 2) {
+                    tracker.OnFree(id);
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    CHECK(tracker.GetAllocatedBytes() == 4 * 5000 * 16);
+    MemoryTracker::Report report;
+    tracker.GetReport(report);
+    CHECK(report.owners.size() == 4);
+    for (const MemoryTracker::OwnerUsage& owner : report.owners) {
+        CHECK(owner.category == MemoryCategory::Image);
+        CHECK(owner.usage.bytes == 5000 * 16);
+    }
+}
+
+int main() {
+    TestAttribution();
+    TestReportOrderAndPeaks();
+    TestThreads();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,129 @@
+#include "testing.h"
+
+#include "framework/pathtracer.h"
+
+#include <cmath>
+#include <random>
+
+// A synthetic scene: at every vertex the path hits an emitter with probability 0.15, otherwise it picks up a bit of
+// light and a random weight. Russian roulette must not change the mean, only the variance (and the path length).
+static const float kEmitterChance = 0.15f;
+static const float kEmission[3] = { 2.0f, 1.0f, 0.5f };
+static const float kWeightScale[3] = { 1.0f, 0.8f, 0.5f };  // weight: U(0.2, 1.2) * scale
+
+static float VertexRadiance(const uint32_t depth, const int channel, const float u) {
+    const float radiance[3] = { 0.05f * u, 0.05f, 0.1f * static_cast<float>(depth % 2) };
+    return radiance[channel];
+}
+
+// the fixed depth loop's expected value: vertex d is reached (and not an emitter yet) with probability 0.85^d,
+// with an expected throughput of E[weight]^d, everything independent
+static double ExpectedRadiance(const uint32_t maxDepth, const int channel) {
+    const double meanWeight = 0.7 * kWeightScale[channel];
+    double expected = 0.0;
+    double reach = 1.0;
+    for (uint32_t depth = 0; depth < maxDepth; ++depth) {
+        const double meanVertex = (channel == 0) ? 0.025 : VertexRadiance(depth, channel, 0.0f);
+        expected += reach * (kEmitterChance * kEmission[channel] + (1.0 - kEmitterChance) * meanVertex);
+        reach *= (1.0 - kEmitterChance) * meanWeight;
+    }
+    return expected;
+}
+
+struct Stats {
+    double  sum[3];
+    double  sumSquares[3];
+    double  numVertices;
+
+    double Mean(const int k, const int n) const {
+        return sum[k] / n;
+    }
+    double Variance(const int k, const int n) const {
+        const double mean = this->Mean(k, n);
+        return sumSquares[k] / n - mean * mean;
+    }
+};
+
+int main() {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    const PathTracer::VertexFunc vertexFunc = [&](const uint32_t depth, PathTracer::Vertex& vertex) {
+        if (uniform(rng) < kEmitterChance) {
+            for (int k = 0; k < 3; ++k) {
+                vertex.radiance[k] = kEmission[k];
+            }
+            vertex.terminate = true;
+            return;
+        }
+        const float w = 0.2f + uniform(rng);
+        const float u = uniform(rng);
+        for (int k = 0; k < 3; ++k) {
+            vertex.weight[k] = w * kWeightScale[k];
+            vertex.radiance[k] = VertexRadiance(depth, k, u);
+        }
+    };
+    const PathTracer::RandomFunc randomFunc = [&]() {
+        return uniform(rng);
+    };
+
+    PathTracer fixed;
+    PathTracer roulette;
+    fixed.GetSettings().russianRoulette = false;
+    roulette.GetSettings().russianRoulette = true;
+
+    const uint32_t maxDepths[] = { 1, 3, 8, 16 };
+    const int numPaths = 1000000;
+    for (const uint32_t maxDepth : maxDepths) {
+        fixed.GetSettings().maxDepth = maxDepth;
+        roulette.GetSettings().maxDepth = maxDepth;
+
+        Stats f = {};
+        Stats r = {};
+        for (int i = 0; i < numPaths; ++i) {
+            float radiance[3];
+            f.numVertices += fixed.Trace(vertexFunc, randomFunc, radiance);
+            for (int k = 0; k < 3; ++k) {
+                f.sum[k] += radiance[k];
+                f.sumSquares[k] += radiance[k] * radiance[k];
+            }
+            r.numVertices += roulette.Trace(vertexFunc, randomFunc, radiance);
+            for (int k = 0; k < 3; ++k) {
+                r.sum[k] += radiance[k];
+                r.sumSquares[k] += radiance[k] * radiance[k];
+            }
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            const double expected = ExpectedRadiance(maxDepth, k);
+            const double meanF = f.Mean(k, numPaths);
+            const double meanR = r.Mean(k, numPaths);
+            const double errorF = std::sqrt(f.Variance(k, numPaths) / numPaths);
+            const double errorR = std::sqrt(r.Variance(k, numPaths) / numPaths);
+            // both unbiased: within 4.5 standard errors of the exact mean, and of each other
+            const double zFixed = (meanF - expected) / errorF;
+            const double zRoulette = (meanR - expected) / errorR;
+            const double zBoth = (meanR - meanF) / std::sqrt(errorF * errorF + errorR * errorR);
+            printf("depth %2u channel %d: exact %.5f fixed %.5f (z %+.2f) roulette %.5f (z %+.2f, vs fixed %+.2f)\n",
+                   maxDepth, k, expected, meanF, zFixed, meanR, zRoulette, zBoth);
+            CHECK(std::fabs(zFixed) < 4.5);
+            CHECK(std::fabs(zRoulette) < 4.5);
+            CHECK(std::fabs(zBoth) < 4.5);
+        }
+
+        // and cheaper, once it has a few bounces to cut
+        printf("depth %2u: %.3f vertices per path fixed, %.3f with roulette\n",
+               maxDepth, f.numVertices / numPaths, r.numVertices / numPaths);
+        if (maxDepth >= 2 * roulette.GetSettings().rouletteMinDepth) {
+            CHECK(r.numVertices < 0.8 * f.numVertices);
+        }
+    }
+
+    // never above the cap, the brightest channel drives it
+    const float bright[3] = { 4.0f, 0.1f, 0.1f };
+    const float dim[3] = { 0.1f, 0.3f, 0.2f };
+    CHECK(PathTracer::SurvivalProbability(bright, 0.95f) == 0.95f);
+    CHECK_NEAR(PathTracer::SurvivalProbability(dim, 0.95f), 0.3, 1e-6);
+
+    return TEST_RESULT();
+}
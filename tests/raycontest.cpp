@@ -0,0 +1,106 @@
+#include "testing.h"
+
+#include "shared.h"
+
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+// CalcRayDir of ray_gen.glsl for a camera looking down -z, side +x, up +y. pixel is the launch id over (size - 1)
+static vec3 CalcRayDir(const float px, const float py, const float aspect, const float tanHalfFov) {
+    return glm::normalize(vec3(0.0f, 0.0f, -1.0f) + vec3(1.0f, 0.0f, 0.0f) * (px * aspect * tanHalfFov) -
+                          vec3(0.0f, 1.0f, 0.0f) * (py * tanHalfFov));
+}
+
+static void TestTriangleLodConstant() {
+    // a unit uv square over a 2x2 world square: uv / world area = 1/4, the constant is -1 in either winding
+    CHECK_NEAR(TriangleLodConstant(vec3(0, 0, 0), vec3(2, 0, 0), vec3(0, 2, 0), vec2(0, 0), vec2(1, 0), vec2(0, 1)), -1.0f, 1e-6);
+    CHECK_NEAR(TriangleLodConstant(vec3(0, 0, 0), vec3(0, 2, 0), vec3(2, 0, 0), vec2(0, 0), vec2(1, 0), vec2(0, 1)), -1.0f, 1e-6);
+    // no uvs, no area: 0
+    CHECK(TriangleLodConstant(vec3(0, 0, 0), vec3(2, 0, 0), vec3(0, 2, 0), vec2(0, 0), vec2(0, 0), vec2(0, 0)) == 0.0f);
+    CHECK(TriangleLodConstant(vec3(0, 0, 0), vec3(1, 0, 0), vec3(2, 0, 0), vec2(0, 0), vec2(1, 0), vec2(0, 1)) == 0.0f);
+}
+
+static void TestTextureLod() {
+    // a 1024^2 texture over that square, a footprint 1/512 wide at normal incidence covers one texel: mip 0
+    const vec2 size(1024.0f, 1024.0f);
+    CHECK_NEAR(RayConeTextureLod(RayConeLodBias(-1.0f, 1.0f / 512.0f, 1.0f), size), 0.0f, 1e-5);
+    // twice as wide is a mip up, either side of the surface. 60 degrees off the normal is one more
+    CHECK_NEAR(RayConeTextureLod(RayConeLodBias(-1.0f, 2.0f / 512.0f, -1.0f), size), 1.0f, 1e-5);
+    CHECK_NEAR(RayConeTextureLod(RayConeLodBias(-1.0f, 2.0f / 512.0f, 0.5f), size), 2.0f, 1e-5);
+    // a zero wide cone (a ray from the camera's own point) hitting edge on
+    CHECK(std::isfinite(RayConeLodBias(0.0f, 0.0f, 0.0f)));
+}
+
+static void TestCameraSpread() {
+    // the angle between the rays of neighbouring pixels near the axis
+    const float tanHalfFov = std::tan(0.5f * glm::radians(45.0f));
+    const float width = 1280.0f, height = 720.0f;
+    const float spread = RayConeCameraSpread(tanHalfFov, height);
+    const vec3 a = CalcRayDir(0.0f, 0.0f, width / height, tanHalfFov);
+    const vec3 b = CalcRayDir(0.0f, 1.0f / (height - 1.0f), width / height, tanHalfFov);
+    const float angle = std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+    CHECK_NEAR(angle / spread, 1.0f, 1e-3);
+}
+
+// against the footprint a pixel actually has: random textured planes, tilted around x, in front of the camera.
+// The rays of a pixel and of the one below it hit the plane, the texels between the two hits per pixel are the
+// mip the cone should pick
+static void TestTiltedPlanes() {
+    const float tanHalfFov = std::tan(0.5f * glm::radians(45.0f));
+    const float width = 1280.0f, height = 720.0f, aspect = width / height;
+    const float texSize = 256.0f;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    const int numPlanes = 2000;
+    double maxError = 0.0, sumError = 0.0;
+    for (int i = 0; i < numPlanes; ++i) {
+        const float distance = 0.5f + 50.0f * uniform(rng);
+        const float tilt = 1.2f * uniform(rng);             // up to ~69 degrees off the view axis
+        const float texScale = 0.25f + 4.0f * uniform(rng); // uv per world unit
+        const vec3 normal(0.0f, std::sin(tilt), std::cos(tilt));
+        const vec3 origin(0.0f, 0.0f, -distance);
+        const vec3 tangentU(1.0f, 0.0f, 0.0f), tangentV = glm::cross(normal, tangentU);
+
+        // close to the axis, where one pixel's angle is the spread
+        const float px = 0.002f * uniform(rng), py = 0.002f * uniform(rng);
+        const vec3 dir = CalcRayDir(px, py, aspect, tanHalfFov);
+        const float t = glm::dot(origin, normal) / glm::dot(dir, normal);
+        const vec3 below = CalcRayDir(px, py + 1.0f / (height - 1.0f), aspect, tanHalfFov);
+        const vec3 step = below * (glm::dot(origin, normal) / glm::dot(below, normal)) - dir * t;
+        const float du = glm::dot(step, tangentU) * texScale * texSize;
+        const float dv = glm::dot(step, tangentV) * texScale * texSize;
+        const float truth = std::log2(std::sqrt(du * du + dv * dv));
+
+        const float lodConstant = TriangleLodConstant(origin, origin + tangentU, origin + tangentV,
+                                                      vec2(0.0f, 0.0f), vec2(texScale, 0.0f), vec2(0.0f, texScale));
+        const float coneWidth = RayConeWidth(0.0f, RayConeCameraSpread(tanHalfFov, height), t);
+        const float lod = RayConeTextureLod(RayConeLodBias(lodConstant, coneWidth, glm::dot(dir, normal)),
+                                            vec2(texSize, texSize));
+        const double error = std::fabs(lod - truth);
+        maxError = std::max(maxError, error);
+        sumError += error;
+    }
+    printf("ray cone vs pixel footprint over %d tilted planes: mean |lod error| %.3f, max %.3f\n",
+           numPlanes, sumError / numPlanes, maxError);
+    // the planes tilt towards the pixel below, the way the 1 / cos of RayConeLodBias stretches the cone. Across it
+    // the footprint doesn't stretch, the round cone overestimates it by up to log2(1 / cos) there
+    CHECK(maxError < 0.05);
+}
+
+static void TestBounces() {
+    // mirrors keep the spread, diffuse bounces widen it, the width grows with distance
+    CHECK(RayConeBounceSpread(0.01f, true) == 0.01f);
+    CHECK(RayConeBounceSpread(0.01f, false) > 0.01f);
+    CHECK_NEAR(RayConeWidth(0.5f, 0.1f, 10.0f), 1.5f, 1e-6);
+}
+
+int main() {
+    TestTriangleLodConstant();
+    TestTextureLod();
+    TestCameraSpread();
+    TestTiltedPlanes();
+    TestBounces();
+    return TEST_RESULT();
+}
@@ -0,0 +1,111 @@
+#include "testing.h"
+
+#include "framework/sbtlayout.h"
+
+#include <vector>
+#include <random>
+#include <cstring>
+
+// Every combination of the device limits we know of & table shapes: the regions' alignment rules, and the bytes
+// FillTable() / FillHitRecords() write against a walk of the table the way the device does it,
+// region start + (instance record offset + ray type) * stride.
+int main() {
+    std::mt19937 rng(46);
+    const uint32_t handleSizes[] = { 16, 32, 64 };
+    const uint32_t alignments[] = { 32, 64, 128, 256 };
+    const uint32_t dataSizes[] = { 0, 4, 16, 48, 60, 64, 100 };
+    const uint32_t recordCounts[] = { 1, 2, 7, 33 };
+
+    size_t numLayouts = 0;
+    for (const uint32_t h : handleSizes)
+    for (const uint32_t a : alignments)
+    for (const uint32_t d : dataSizes)
+    for (uint32_t hg = 1; hg <= 4; ++hg)
+    for (uint32_t mg = 1; mg <= 3; ++mg)
+    for (const uint32_t r : recordCounts)
+    for (uint32_t pr = 0; pr <= 2; ++pr) {
+        // the base alignment is a multiple of the handle size
+        if (a < h) {
+            continue;
+        }
+
+        SBTLayout layout;
+        layout.Initialize(hg, mg, h, a, r, d, pr);
+        const uint32_t stride = layout.GetHitGroupsStride();
+        const uint32_t numRecords = r + pr;
+        const uint32_t numPipelineHitGroups = pr ? 2 * hg : hg;
+
+        CHECK(layout.GetRaygenOffset() % a == 0);
+        CHECK(layout.GetHitGroupsOffset() % a == 0);
+        CHECK(layout.GetMissGroupsOffset() % a == 0);
+        // a multiple of the handle size with room for the data
+        CHECK(stride % h == 0 && stride >= h + d && stride < h + d + h);
+        CHECK(layout.GetGroupsStride() % h == 0);
+        CHECK(layout.GetRaygenSize() >= h);
+        CHECK(layout.GetHitGroupsOffset() >= layout.GetRaygenOffset() + layout.GetRaygenSize());
+        CHECK(layout.GetNumHitRecords() == numRecords);
+        CHECK(layout.GetHitGroupsSize() == numRecords * hg * stride);
+        CHECK(layout.GetMissGroupsOffset() >= layout.GetHitGroupsOffset() + layout.GetHitGroupsSize());
+        CHECK(layout.GetMissGroupsSize() == mg * a);
+        CHECK(layout.GetSBTSize() == layout.GetMissGroupsOffset() + layout.GetMissGroupsSize());
+        CHECK(layout.GetNumPipelineHitGroups() == numPipelineHitGroups);
+        CHECK(layout.GetNumGroups() == 1 + numPipelineHitGroups + mg);
+        for (uint32_t i = 0; i < numRecords; ++i) {
+            CHECK(layout.GetHitRecordIndex(i) == i * hg);
+            CHECK(layout.GetHitRecordsOffset(i) == layout.GetHitGroupsOffset() + uint64_t(i) * hg * stride);
+        }
+        for (uint32_t i = 0; i < pr; ++i) {
+            CHECK(layout.GetProceduralRecord(i) == r + i);
+        }
+
+        // group g's handle: every byte g + 1
+        std::vector<uint8_t> handles(layout.GetNumGroups() * h);
+        for (uint32_t g = 0; g < layout.GetNumGroups(); ++g) {
+            memset(handles.data() + g * h, int(g + 1), h);
+        }
+        // junk, FillTable() has to write every byte
+        std::vector<uint8_t> table(layout.GetSBTSize(), 0xCD);
+        layout.FillTable(table.data(), handles.data());
+
+        // record i's data: bytes 100 + i, d + 3 apart, written in two chunks split at random
+        const size_t dataStride = d + 3;
+        std::vector<uint8_t> data(numRecords * dataStride);
+        for (uint32_t i = 0; i < numRecords; ++i) {
+            memset(data.data() + i * dataStride, int(100 + i), dataStride);
+        }
+        const uint32_t split = rng() % (numRecords + 1);
+        const uint32_t chunks[2][2] = { { split, numRecords - split }, { 0, split } };
+        for (const uint32_t* chunk : chunks) {
+            // only the span it says it writes
+            const uint64_t offset = layout.GetHitRecordsOffset(chunk[0]);
+            const uint64_t size = layout.GetHitRecordsSize(chunk[1]);
+            CHECK(offset + size <= table.size());
+            std::vector<uint8_t> span(table.begin() + offset, table.begin() + offset + size);
+            if (d) {
+                layout.FillHitRecords(span.data(), chunk[1], data.data() + chunk[0] * dataStride, dataStride);
+            }
+            std::copy(span.begin(), span.end(), table.begin() + offset);
+        }
+
+        std::vector<uint8_t> expected(table.size(), 0);
+        memset(expected.data() + layout.GetRaygenOffset(), 1, h);
+        for (uint32_t i = 0; i < numRecords; ++i) {
+            // the procedural records get the procedural groups, the pipeline's hit groups hg on
+            const uint32_t firstGroup = (i < r) ? 1 : 1 + hg;
+            for (uint32_t g = 0; g < hg; ++g) {
+                uint8_t* record = expected.data() + layout.GetHitGroupsOffset() + (layout.GetHitRecordIndex(i) + g) * stride;
+                memset(record, int(firstGroup + g + 1), h);
+                memset(record + h, int(100 + i), d);
+            }
+        }
+        for (uint32_t m = 0; m < mg; ++m) {
+            memset(expected.data() + layout.GetMissGroupsOffset() + m * layout.GetGroupsStride(), int(1 + numPipelineHitGroups + m + 1), h);
+        }
+        CHECK(expected == table);
+        ++numLayouts;
+    }
+
+    printf("%zu layouts\n", numLayouts);
+    CHECK(numLayouts == 3 * 3696);
+    return TEST_RESULT();
+}
@@ -0,0 +1,123 @@
+#include "testing.h"
+
+#include "framework/slotallocator.h"
+
+#include <cstring>
+#include <csignal>
+#include <cstdlib>
+
+static void TestAllocationOrder() {
+    SlotAllocator slots;
+    slots.Initialize(4);
+    CHECK(slots.GetCapacity() == 4);
+    CHECK(slots.GetHighWater() == 0);
+
+    // fresh slots come lowest first
+    for (uint32_t i = 0; i < 4; ++i) {
+        CHECK(slots.Allocate() == i);
+        CHECK(slots.IsAllocated(i));
+        CHECK(slots.GetHighWater() == i + 1);
+    }
+    CHECK(slots.GetNumAllocated() == 4);
+    CHECK(!slots.IsAllocated(4));
+}
+
+static void TestExhaustion() {
+    SlotAllocator slots;
+    slots.Initialize(2);
+    CHECK(slots.Allocate() == 0);
+    CHECK(slots.Allocate() == 1);
+    CHECK(slots.Allocate() == SlotAllocator::InvalidSlot);
+    CHECK(slots.GetNumAllocated() == 2);
+
+    // pending slots are still taken
+    slots.Release(0, 10);
+    CHECK(slots.Allocate() == SlotAllocator::InvalidSlot);
+    CHECK(slots.Recycle(10) == 1);
+    CHECK(slots.Allocate() == 0);
+
+    SlotAllocator empty;
+    empty.Initialize(0);
+    CHECK(empty.Allocate() == SlotAllocator::InvalidSlot);
+}
+
+static void TestDeferredReuse() {
+    SlotAllocator slots;
+    slots.Initialize(8);
+    for (uint32_t i = 0; i < 4; ++i) {
+        slots.Allocate();
+    }
+
+    // frames up to 5 may still read slot 1, up to 7 slot 2
+    slots.Release(1, 5);
+    slots.Release(2, 7);
+    CHECK(!slots.IsAllocated(1));
+    CHECK(slots.GetNumAllocated() == 2);
+    CHECK(slots.GetNumPending() == 2);
+
+    // not before Recycle() covers their serial: fresh ones meanwhile
+    CHECK(slots.Allocate() == 4);
+    CHECK(slots.Recycle(4) == 0);
+    CHECK(slots.Allocate() == 5);
+
+    CHECK(slots.Recycle(5) == 1);
+    CHECK(slots.GetNumPending() == 1);
+    // recycled ones before any fresh one
+    CHECK(slots.Allocate() == 1);
+    CHECK(slots.Allocate() == 6);
+
+    CHECK(slots.Recycle(100) == 1);
+    CHECK(slots.GetNumPending() == 0);
+    CHECK(slots.Allocate() == 2);
+    CHECK(slots.Allocate() == 7);
+    CHECK(slots.Allocate() == SlotAllocator::InvalidSlot);
+    CHECK(slots.GetHighWater() == 8);
+
+    // same serial twice is fine
+    slots.Release(3, 200);
+    slots.Release(4, 200);
+    CHECK(slots.Recycle(199) == 0);
+    CHECK(slots.Recycle(200) == 2);
+
+    // the high water mark stays, Initialize() starts over
+    CHECK(slots.GetHighWater() == 8);
+    slots.Initialize(8);
+    CHECK(slots.GetHighWater() == 0);
+    CHECK(slots.GetNumPending() == 0);
+    CHECK(slots.Allocate() == 0);
+}
+
+static void OnAbort(int) {
+    // a plain failing exit code, ctest doesn't invert a crash
+    std::_Exit(EXIT_FAILURE);
+}
+
+// releases out of serial order: must hit the assert (ctest expects this one to fail)
+static void OutOfOrderRelease() {
+#ifdef _MSC_VER
+    // no message box from the debug CRT
+    _set_error_mode(_OUT_TO_STDERR);
+#endif
+    signal(SIGABRT, OnAbort);
+
+    SlotAllocator slots;
+    slots.Initialize(2);
+    slots.Allocate();
+    slots.Allocate();
+    slots.Release(0, 10);
+    slots.Release(1, 9);
+    printf("out of order release went through\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && !strcmp(argv[1], "--out-of-order")) {
+        OutOfOrderRelease();
+        return 0;
+    }
+
+    TestAllocationOrder();
+    TestExhaustion();
+    TestDeferredReuse();
+
+    return TEST_RESULT();
+}
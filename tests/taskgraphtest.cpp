@@ -0,0 +1,131 @@
+#include "testing.h"
+
+#include "framework/taskgraph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+
+// a -> b, a -> c (main thread), b & c -> d. b adds 5 pool tasks, each with a main thread task depending on it,
+// while the graph runs
+static void TestGraph(const size_t numWorkers) {
+    ThreadPool pool;
+    if (numWorkers) {
+        pool.Initialize(numWorkers);
+    }
+
+    TaskGraph graph;
+    std::mutex orderMutex;
+    std::vector<int> order;
+    std::atomic<int> numDynamic(0);
+    std::atomic<int> numOffMainThread(0);
+    const std::thread::id mainThread = std::this_thread::get_id();
+
+    const auto record = [&](const int value) {
+        std::lock_guard<std::mutex> lock(orderMutex);
+        order.push_back(value);
+    };
+    const auto checkMainThread = [&]() {
+        if (std::this_thread::get_id() != mainThread) {
+            ++numOffMainThread;
+        }
+    };
+
+    const TaskGraph::TaskId a = graph.Add("a", [&]() { record(0); });
+    const TaskGraph::TaskId b = graph.Add("b", [&]() {
+        record(1);
+        for (int i = 0; i < 5; ++i) {
+            const TaskGraph::TaskId task = graph.Add("dynamic", [&, i]() {
+                record(10 + i);
+                ++numDynamic;
+            }, {}, "mesh " + std::to_string(i));
+            graph.AddMainThread("dynamicMain", [&, i]() {
+                checkMainThread();
+                record(20 + i);
+                ++numDynamic;
+            }, { task });
+        }
+    }, { a });
+    const TaskGraph::TaskId c = graph.AddMainThread("c", [&]() {
+        checkMainThread();
+        record(2);
+    }, { a });
+    graph.Add("d", [&]() { record(3); }, { b, c });
+    graph.Run(pool);
+
+    // Run() waits for the tasks added along the way too
+    CHECK(order.size() == 14);
+    CHECK(numDynamic == 10);
+    CHECK(numOffMainThread == 0);
+    CHECK(graph.GetNumTasks() == 14);
+
+    const auto position = [&](const int value) {
+        return std::find(order.begin(), order.end(), value) - order.begin();
+    };
+    CHECK(position(0) < position(1));
+    CHECK(position(0) < position(2));
+    CHECK(position(1) < position(3));
+    CHECK(position(2) < position(3));
+    for (int i = 0; i < 5; ++i) {
+        CHECK(position(1) < position(10 + i));
+        CHECK(position(10 + i) < position(20 + i));
+    }
+
+    // every task got its timing
+    std::vector<TaskGraph::Timing> timings;
+    graph.GetTimings(timings);
+    CHECK(timings.size() == 14);
+    for (const TaskGraph::Timing& timing : timings) {
+        CHECK(timing.endMs >= timing.startMs);
+        CHECK(timing.endMs <= graph.GetTotalMs() + 1e-3);
+        if (!numWorkers) {
+            CHECK(timing.thread == 0);
+        }
+    }
+}
+
+// a long chain on many workers: every task must see its dependency finished
+static void TestChain() {
+    ThreadPool pool;
+    pool.Initialize(8);
+
+    TaskGraph graph;
+    std::vector<int> done(200, 0);
+    std::atomic<int> numEarly(0);
+    TaskGraph::TaskId previous = graph.Add("first", [&]() { done[0] = 1; });
+    for (int i = 1; i < 200; ++i) {
+        const auto func = [&, i]() {
+            if (!done[i - 1]) {
+                ++numEarly;
+            }
+            done[i] = 1;
+        };
+        previous = (i % 3) ? graph.Add("link", func, { previous }) : graph.AddMainThread("link", func, { previous });
+    }
+    graph.Run(pool);
+    CHECK(numEarly == 0);
+    CHECK(std::count(done.begin(), done.end(), 1) == 200);
+
+    // reusable after Clear()
+    graph.Clear();
+    CHECK(graph.GetNumTasks() == 0);
+    int ran = 0;
+    graph.AddMainThread("again", [&]() { ++ran; });
+    graph.Run(pool);
+    CHECK(ran == 1);
+}
+
+int main() {
+    const size_t workerCounts[] = { 0, 1, 4 };
+    for (const size_t numWorkers : workerCounts) {
+        for (int repeat = 0; repeat < 20; ++repeat) {
+            TestGraph(numWorkers);
+        }
+    }
+    TestChain();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdio>
+
+// Just enough for the CPU unit tests ctest runs: a failed CHECK prints where, the test goes on and
+// TEST_RESULT() makes main return nonzero. No Vulkan and no window in any of them.
+static int sNumFailedChecks = 0;
+
+#define CHECK(condition)                                                                    \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition);           \
+            ++sNumFailedChecks;                                                             \
+        }                                                                                   \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tolerance)                                                         \
+    do {                                                                                    \
+        const double checkA = static_cast<double>(a);                                       \
+        const double checkB = static_cast<double>(b);                                       \
+        if (!(checkA - checkB <= (tolerance) && checkB - checkA <= (tolerance))) {          \
+            printf("%s(%d): CHECK_NEAR(%s, %s) failed: %g vs %g\n",                         \
+                   __FILE__, __LINE__, #a, #b, checkA, checkB);                             \
+            ++sNumFailedChecks;                                                             \
+        }                                                                                   \
+    } while (0)
+
+#define TEST_RESULT()                                                                       \
+    (printf("%s: %s (%d failed checks)\n", __FILE__, sNumFailedChecks ? "FAILED" : "passed", \
+            sNumFailedChecks),                                                              \
+     sNumFailedChecks ? 1 : 0)